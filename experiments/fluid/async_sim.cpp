@@ -0,0 +1,119 @@
+#include "async_sim.h"
+
+#include <utility>
+
+namespace rayol::fluid {
+
+AsyncFluidSim::AsyncFluidSim(FluidExperiment& sim)
+    : sim_(sim),
+      front_(std::make_unique<FluidSnapshot>()),
+      ready_(std::make_unique<FluidSnapshot>()),
+      back_(std::make_unique<FluidSnapshot>()) {}
+
+AsyncFluidSim::~AsyncFluidSim() { stop(); }
+
+void AsyncFluidSim::start() {
+    if (running()) return;
+    publish();
+    worker_ = std::thread([this] { run(); });
+}
+
+void AsyncFluidSim::stop() {
+    if (!running()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+
+    std::optional<FluidSettings> settings;
+    bool reset = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+        settings = std::exchange(pending_settings_, std::nullopt);
+        reset = std::exchange(pending_reset_, false);
+        pending_dt_ = 0.0f;
+    }
+    if (settings) sim_.configure(*settings);
+    if (reset) sim_.reset();
+}
+
+void AsyncFluidSim::post_configure(const FluidSettings& settings) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (last_posted_settings_ == settings) return;
+        last_posted_settings_ = settings;
+        pending_settings_ = settings;
+    }
+    wake_.notify_one();
+}
+
+void AsyncFluidSim::post_reset() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_reset_ = true;
+    }
+    wake_.notify_one();
+}
+
+void AsyncFluidSim::post_update(float dt) {
+    if (!(dt > 0.0f)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_dt_ += dt;
+    }
+    wake_.notify_one();
+}
+
+const FluidSnapshot& AsyncFluidSim::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fresh_) {
+        std::swap(front_, ready_);
+        fresh_ = false;
+    }
+    return *front_;
+}
+
+void AsyncFluidSim::run() {
+    for (;;) {
+        std::optional<FluidSettings> settings;
+        bool reset = false;
+        float dt = 0.0f;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || pending_settings_ || pending_reset_ || pending_dt_ > 0.0f; });
+            if (stop_) return;
+            settings = std::exchange(pending_settings_, std::nullopt);
+            reset = std::exchange(pending_reset_, false);
+            dt = std::exchange(pending_dt_, 0.0f);
+        }
+
+        if (settings) sim_.configure(*settings);
+        if (reset) sim_.reset();
+        // A paused sim does not change, so time alone only republishes when it actually steps.
+        const bool step = dt > 0.0f && !sim_.settings().paused;
+        if (step) sim_.update(dt);
+        if (settings || reset || step) {
+            publish();
+        }
+    }
+}
+
+void AsyncFluidSim::publish() {
+    // Copies reuse the back snapshot's capacity, so steady-state publishes do not allocate.
+    back_->settings = sim_.settings();
+    back_->stats = sim_.stats();
+    back_->volume = sim_.volume();
+    back_->particles = sim_.particles();
+    back_->distance = sim_.distance();  // Empty unless the distance field is on.
+    back_->light = sim_.light();        // Empty unless the light volume is on.
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    back_->sequence = ++sequence_;
+    std::swap(back_, ready_);
+    fresh_ = true;
+}
+
+}  // namespace rayol::fluid
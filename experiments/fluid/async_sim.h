@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "fluid_experiment.h"
+
+namespace rayol::fluid {
+
+// Copy of one published sim state, owned by AsyncFluidSim.
+struct FluidSnapshot {
+    FluidSettings settings{};
+    FluidStats stats{};
+    DensityVolume volume{};
+    ParticleStore particles;
+    DistanceVolume distance{};
+    LightVolume light{};
+    uint64_t sequence = 0;  // Publish counter; increases with every new state.
+
+    FluidFrameView view() const {
+        return {&settings, &stats, &volume, &particles, settings.distance_field ? &distance : nullptr,
+                settings.light_volume ? &light : nullptr};
+    }
+};
+
+// Steps a FluidExperiment on a dedicated thread so simulation overlaps rendering. While running, the
+// wrapped sim belongs to the worker: changes go through the post_* calls and the main thread only
+// reads the snapshot returned by acquire(). Snapshots are triple-buffered (worker writes the back
+// one, the latest sits in ready, the renderer holds the front), so neither side waits on the other's
+// work, only on a pointer swap.
+class AsyncFluidSim {
+public:
+    explicit AsyncFluidSim(FluidExperiment& sim);
+    ~AsyncFluidSim();
+
+    AsyncFluidSim(const AsyncFluidSim&) = delete;
+    AsyncFluidSim& operator=(const AsyncFluidSim&) = delete;
+
+    // Publish the sim's current state, then start the worker, so the next acquire() returns it.
+    void start();
+    // Let the in-flight update finish and join the worker. Posted settings/resets it had not picked
+    // up yet are applied on the calling thread; the sim can then be used directly again.
+    void stop();
+    bool running() const { return worker_.joinable(); }
+
+    // Applied before the worker's next update; repeats of the last posted settings are ignored.
+    void post_configure(const FluidSettings& settings);
+    void post_reset();
+    // Add dt to the time the worker owes. Frames posted while it is busy merge into one update, which
+    // FluidExperiment then splits into CFL substeps.
+    void post_update(float dt);
+
+    // Latest published snapshot. It stays valid and unchanged until the next acquire(); the worker
+    // never writes the snapshot acquire() last returned. Call from one thread only.
+    const FluidSnapshot& acquire();
+
+private:
+    void run();
+    void publish();
+
+    FluidExperiment& sim_;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::optional<FluidSettings> pending_settings_;
+    std::optional<FluidSettings> last_posted_settings_;
+    bool pending_reset_ = false;
+    float pending_dt_ = 0.0f;
+    bool fresh_ = false;  // ready_ holds a snapshot the renderer has not acquired yet.
+    uint64_t sequence_ = 0;
+    std::unique_ptr<FluidSnapshot> front_;
+    std::unique_ptr<FluidSnapshot> ready_;
+    std::unique_ptr<FluidSnapshot> back_;
+};
+
+}  // namespace rayol::fluid
@@ -0,0 +1,155 @@
+#include "bench_harness.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace rayol::fluid {
+
+namespace {
+// Particle count that fills the default 32^3 x 0.02 domain at the reference neighbor density.
+constexpr float kReferenceParticles = 4096.0f;
+constexpr float kReferenceExtent = 0.64f;
+}  // namespace
+
+float elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void settle(FluidExperiment& sim, const FluidSettings& settings, int frames, float dt) {
+    FluidSettings run_settings = settings;
+    run_settings.paused = false;
+    sim.configure(run_settings);
+    sim.reset();
+    for (int i = 0; i < frames; ++i) {
+        sim.update(dt);
+    }
+}
+
+VolumeConfig seed_uniform_particles(int particle_count, ParticleStore& particles) {
+    float extent = kReferenceExtent * std::cbrt(static_cast<float>(particle_count) / kReferenceParticles);
+    VolumeConfig config{};
+    config.voxel_size = 0.02f;
+    int dim = std::max(1, static_cast<int>(std::ceil(extent / config.voxel_size)));
+    config.dims = {dim, dim, dim};
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(0.0f, extent);
+    std::uniform_real_distribution<float> dist_v(-1.0f, 1.0f);
+    particles.resize(static_cast<size_t>(particle_count));
+    for (size_t i = 0; i < particles.size(); ++i) {
+        particles.set_position(i, {dist(rng), dist(rng), dist(rng)});
+        particles.set_velocity(i, {dist_v(rng), dist_v(rng), dist_v(rng)});
+        particles.mass[i] = 1.0f;
+    }
+    return config;
+}
+
+std::vector<int> thread_counts_to_test() {
+    int hw = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (int t = 1; t < hw; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(hw);
+    return counts;
+}
+
+RayGridTiming march_ray_grid(const DensityVolume& volume, const VolumeConfig& frame, const RayMarchSettings& march,
+                             std::vector<Vec3>& colors,
+                             const std::function<Vec3(Vec3 pos, Vec3 normal, float density)>& shade) {
+    constexpr int kRayGrid = 128;
+    const VolumeConfig& cfg = frame;
+    const Vec3 extent = {static_cast<float>(cfg.dims.x) * cfg.voxel_size, static_cast<float>(cfg.dims.y) * cfg.voxel_size,
+                         static_cast<float>(cfg.dims.z) * cfg.voxel_size};
+    const Vec3 center = cfg.origin + extent * 0.5f;
+    const Vec3 eye = {center.x, cfg.origin.y + 0.4f * extent.y, cfg.origin.z - 1.5f * extent.z};
+    colors.assign(static_cast<size_t>(kRayGrid) * kRayGrid, Vec3{});
+    RayGridTiming timing{};
+    float best_ms = std::numeric_limits<float>::max();
+    for (int rep = 0; rep < kSplatRepeats; ++rep) {
+        long long steps = 0;
+        long long skipped = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int py = 0; py < kRayGrid; ++py) {
+            for (int px = 0; px < kRayGrid; ++px) {
+                const Vec3 target = {cfg.origin.x + (static_cast<float>(px) + 0.5f) / kRayGrid * extent.x,
+                                     cfg.origin.y + (static_cast<float>(py) + 0.5f) / kRayGrid * extent.y, center.z};
+                const RayMarchResult r = ray_march_volume(volume, {eye, target - eye}, march, shade);
+                colors[static_cast<size_t>(py) * kRayGrid + px] = r.color;
+                steps += r.steps;
+                skipped += r.skipped_steps;
+            }
+        }
+        best_ms = std::min(best_ms, elapsed_ms(start));
+        timing.steps_per_ray = static_cast<float>(steps) / (kRayGrid * kRayGrid);
+        timing.skipped_per_ray = static_cast<float>(skipped) / (kRayGrid * kRayGrid);
+    }
+    timing.rays_per_sec = static_cast<float>(kRayGrid * kRayGrid) / (best_ms * 1.0e-3f);
+    return timing;
+}
+
+RayGridTiming march_ray_grid(const DensityVolume& volume, const RayMarchSettings& march, std::vector<Vec3>& colors) {
+    return march_ray_grid(volume, volume.config(), march, colors);
+}
+
+TraceGridTiming trace_ray_grid(const DistanceVolume& field, const SphereTraceSettings& trace,
+                               std::vector<SphereTraceResult>& hits) {
+    constexpr int kRayGrid = 128;
+    const VolumeConfig& cfg = field.config();
+    const Vec3 extent = {static_cast<float>(cfg.dims.x) * cfg.voxel_size, static_cast<float>(cfg.dims.y) * cfg.voxel_size,
+                         static_cast<float>(cfg.dims.z) * cfg.voxel_size};
+    const Vec3 center = cfg.origin + extent * 0.5f;
+    const Vec3 eye = {center.x, cfg.origin.y + 0.4f * extent.y, cfg.origin.z - 1.5f * extent.z};
+    hits.assign(static_cast<size_t>(kRayGrid) * kRayGrid, SphereTraceResult{});
+    TraceGridTiming timing{};
+    float best_ms = std::numeric_limits<float>::max();
+    for (int rep = 0; rep < kSplatRepeats; ++rep) {
+        long long iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int py = 0; py < kRayGrid; ++py) {
+            for (int px = 0; px < kRayGrid; ++px) {
+                const Vec3 target = {cfg.origin.x + (static_cast<float>(px) + 0.5f) / kRayGrid * extent.x,
+                                     cfg.origin.y + (static_cast<float>(py) + 0.5f) / kRayGrid * extent.y, center.z};
+                const SphereTraceResult r = sphere_trace_distance(field, {eye, target - eye}, trace);
+                hits[static_cast<size_t>(py) * kRayGrid + px] = r;
+                iterations += r.iterations;
+            }
+        }
+        best_ms = std::min(best_ms, elapsed_ms(start));
+        timing.iterations_per_ray = static_cast<float>(iterations) / (kRayGrid * kRayGrid);
+    }
+    timing.rays_per_sec = static_cast<float>(kRayGrid * kRayGrid) / (best_ms * 1.0e-3f);
+    return timing;
+}
+
+float max_color_difference(const std::vector<Vec3>& a, const std::vector<Vec3>& b) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) {
+        const Vec3 d = a[i] - b[i];
+        worst = std::max({worst, std::fabs(d.x), std::fabs(d.y), std::fabs(d.z)});
+    }
+    return worst;
+}
+
+float mean_color_difference(const std::vector<Vec3>& a, const std::vector<Vec3>& b) {
+    const size_t n = std::min(a.size(), b.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3 d = a[i] - b[i];
+        sum += std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z);
+    }
+    return n > 0 ? static_cast<float>(sum / (3.0 * static_cast<double>(n))) : 0.0f;
+}
+
+BenchLine::BenchLine(std::string_view label) {
+    line_ << "[fluid] benchmark";
+    if (!label.empty()) line_ << ' ' << label;
+}
+
+BenchLine::~BenchLine() {
+    std::cout << line_.str() << std::endl;
+}
+
+}  // namespace rayol::fluid
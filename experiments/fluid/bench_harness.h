@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+#include "fluid_experiment.h"
+#include "raymarch.h"
+
+// Shared set-up, warm-up, timing and printing for the CPU benchmarks. Each subsystem keeps its
+// benchmarks next to its code (neighbor_grid_bench, density_splat_bench, raymarch_bench,
+// cpu_renderer_bench) and exposes them as a table of BenchSuites that rayol_fluid_bench runs.
+
+namespace rayol::fluid {
+
+constexpr int kWarmupSteps = 3;      // Untimed updates before a stepping benchmark.
+constexpr int kNeighborRepeats = 5;  // Averaged passes of the neighbor/kernel benchmarks (after one warm-up pass).
+constexpr int kSplatRepeats = 3;     // Best-of count for splat, sampling and ray-march timings.
+
+struct BenchSuite {
+    const char* name;
+    const char* description;
+    void (*run)(const FluidSettings&);
+};
+
+float elapsed_ms(std::chrono::steady_clock::time_point start);
+
+// Smallest wall time of `repeats` calls of fn, in milliseconds.
+template <typename Fn>
+float best_of_ms(int repeats, Fn&& fn) {
+    float best_ms = std::numeric_limits<float>::max();
+    for (int rep = 0; rep < repeats; ++rep) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        best_ms = std::min(best_ms, elapsed_ms(start));
+    }
+    return best_ms;
+}
+
+// Configure `sim` from `settings` (unpaused), reseed it and run `frames` updates of `dt`.
+void settle(FluidExperiment& sim, const FluidSettings& settings, int frames, float dt);
+
+// Uniformly seed particles in a cube sized to keep the reference neighbor density (the default 32^3 x
+// 0.02 domain holds 4096 of them), so per-particle neighbor counts stay comparable across sizes.
+VolumeConfig seed_uniform_particles(int particle_count, ParticleStore& particles);
+
+// 1, 2, 4, ... up to hardware concurrency.
+std::vector<int> thread_counts_to_test();
+
+struct RayGridTiming {
+    float rays_per_sec = 0.0f;
+    float steps_per_ray = 0.0f;
+    float skipped_per_ray = 0.0f;
+};
+
+// Best of a few CPU marches of a 128x128 ray grid from in front of the box `frame`, spread over it
+// with a mild perspective; colors receives the per-ray result. `shade` replaces the default lighting.
+RayGridTiming march_ray_grid(const DensityVolume& volume, const VolumeConfig& frame, const RayMarchSettings& march,
+                             std::vector<Vec3>& colors,
+                             const std::function<Vec3(Vec3 pos, Vec3 normal, float density)>& shade = {});
+
+// Rays framed on the volume's own box.
+RayGridTiming march_ray_grid(const DensityVolume& volume, const RayMarchSettings& march, std::vector<Vec3>& colors);
+
+struct TraceGridTiming {
+    float rays_per_sec = 0.0f;
+    float iterations_per_ray = 0.0f;
+};
+
+// Best of a few sphere_trace_distance passes over the same ray grid march_ray_grid uses; hits
+// receives the per-ray result.
+TraceGridTiming trace_ray_grid(const DistanceVolume& field, const SphereTraceSettings& trace,
+                               std::vector<SphereTraceResult>& hits);
+
+float max_color_difference(const std::vector<Vec3>& a, const std::vector<Vec3>& b);
+float mean_color_difference(const std::vector<Vec3>& a, const std::vector<Vec3>& b);
+
+// One "[fluid] benchmark <label> key=value ..." result line, written to stdout when it goes out of
+// scope. Values of one key are streamed back to back:
+//   BenchLine("sdf")("dims", x, "x", y, "x", z)("build_ms", ms);
+class BenchLine {
+public:
+    explicit BenchLine(std::string_view label);
+    ~BenchLine();
+    BenchLine(const BenchLine&) = delete;
+    BenchLine& operator=(const BenchLine&) = delete;
+
+    template <typename... Parts>
+    BenchLine& operator()(std::string_view key, const Parts&... parts) {
+        line_ << ' ' << key << '=';
+        (line_ << ... << parts);
+        return *this;
+    }
+
+private:
+    std::ostringstream line_;
+};
+
+}  // namespace rayol::fluid
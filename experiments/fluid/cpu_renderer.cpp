@@ -0,0 +1,190 @@
+#include "cpu_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace rayol::fluid {
+
+namespace {
+Vec3 composite(const float* rgba, Vec3 background) {
+    const float transmittance = 1.0f - rgba[3];
+    return {rgba[0] + background.x * transmittance, rgba[1] + background.y * transmittance,
+            rgba[2] + background.z * transmittance};
+}
+
+// Pixel blocks marched as one packet.
+constexpr int kPacketWidth = 4;
+constexpr int kPacketHeight = kRayPacketSize / kPacketWidth;
+
+// Pixel centers, as the fragment shader's vUV. fullscreen_uv.vert puts vUV.y = 1 on the top row of
+// the framebuffer, so rows count down from ndc_y = 1.
+float pixel_ndc_x(int px, float inv_width) {
+    return (static_cast<float>(px) + 0.5f) * inv_width * 2.0f - 1.0f;
+}
+
+float pixel_ndc_y(int py, float inv_height) {
+    return 1.0f - (static_cast<float>(py) + 0.5f) * inv_height * 2.0f;
+}
+
+bool open_image(std::ofstream& out, const std::string& path) {
+    out.open(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "[fluid] failed to open " << path << " for writing.\n";
+        return false;
+    }
+    return true;
+}
+
+bool finish_image(std::ofstream& out, const std::string& path) {
+    out.flush();
+    if (!out) {
+        std::cerr << "[fluid] failed to write " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+}  // namespace
+
+CpuVolumeRenderer::CpuVolumeRenderer(unsigned int thread_count) : scheduler_(thread_count) {}
+
+const CpuRenderStats& CpuVolumeRenderer::render(const DensityVolume& volume, const CameraData& camera,
+                                                const CpuRenderSettings& settings) {
+    width_ = std::max(1, settings.width);
+    height_ = std::max(1, settings.height);
+    const int tile = std::max(1, settings.tile_size);
+    const int tiles_x = (width_ + tile - 1) / tile;
+    const int tiles_y = (height_ + tile - 1) / tile;
+    const size_t tile_count = static_cast<size_t>(tiles_x) * tiles_y;
+    pixels_.assign(static_cast<size_t>(width_) * height_ * 4, 0.0f);
+    tile_steps_.assign(tile_count, 0);
+    tile_skipped_.assign(tile_count, 0);
+
+    RayMarchSettings march = settings.march;
+    if (march.adaptive.enabled) {
+        // Pixel footprint per unit of distance, as volume_raymarch.frag's minimum step.
+        march.adaptive.distance_scale = 2.0f * camera.tan_half_fov / static_cast<float>(height_);
+    }
+    if (march.adaptive.enabled && settings.frame_step_budget > 0) {
+        const long long rays = static_cast<long long>(width_) * height_;
+        march.adaptive.step_budget = static_cast<int>(std::clamp(settings.frame_step_budget / rays, 1LL, 1LL << 30));
+    }
+    const bool packets = settings.packets && !march.adaptive.enabled;
+    const float inv_width = 1.0f / static_cast<float>(width_);
+    const float inv_height = 1.0f / static_cast<float>(height_);
+    const auto start = std::chrono::steady_clock::now();
+    scheduler_.parallel_for(0, tile_count, [&](size_t t) {
+        const int x0 = static_cast<int>(t % static_cast<size_t>(tiles_x)) * tile;
+        const int y0 = static_cast<int>(t / static_cast<size_t>(tiles_x)) * tile;
+        const int x1 = std::min(x0 + tile, width_);
+        const int y1 = std::min(y0 + tile, height_);
+        long long steps = 0;
+        long long skipped = 0;
+        auto store = [&](int px, int py, const RayMarchResult& r) {
+            float* out = pixels_.data() + (static_cast<size_t>(py) * width_ + px) * 4;
+            out[0] = r.color.x;
+            out[1] = r.color.y;
+            out[2] = r.color.z;
+            out[3] = 1.0f - r.transmittance;
+            steps += r.steps;
+            skipped += r.skipped_steps;
+        };
+        if (packets) {
+            // Clipped at the tile's edges, so blocks of small or odd tiles run with fewer lanes.
+            Ray rays[kRayPacketSize];
+            RayMarchResult results[kRayPacketSize];
+            int lane_x[kRayPacketSize];
+            int lane_y[kRayPacketSize];
+            for (int by = y0; by < y1; by += kPacketHeight) {
+                for (int bx = x0; bx < x1; bx += kPacketWidth) {
+                    int count = 0;
+                    for (int py = by; py < std::min(by + kPacketHeight, y1); ++py) {
+                        for (int px = bx; px < std::min(bx + kPacketWidth, x1); ++px) {
+                            rays[count] = camera_ray(camera, pixel_ndc_x(px, inv_width), pixel_ndc_y(py, inv_height));
+                            lane_x[count] = px;
+                            lane_y[count++] = py;
+                        }
+                    }
+                    ray_march_packet(volume, rays, count, march, results);
+                    for (int i = 0; i < count; ++i) store(lane_x[i], lane_y[i], results[i]);
+                }
+            }
+        } else {
+            for (int py = y0; py < y1; ++py) {
+                const float ndc_y = pixel_ndc_y(py, inv_height);
+                for (int px = x0; px < x1; ++px) {
+                    const Ray ray = camera_ray(camera, pixel_ndc_x(px, inv_width), ndc_y);
+                    store(px, py, ray_march_volume(volume, ray, march));
+                }
+            }
+        }
+        tile_steps_[t] = steps;
+        tile_skipped_[t] = skipped;
+    }, 1);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    stats_ = {};
+    stats_.render_ms = static_cast<float>(seconds * 1.0e3);
+    stats_.thread_count = static_cast<int>(scheduler_.thread_count());
+    stats_.tile_count = static_cast<int>(tile_count);
+    stats_.rays = static_cast<long long>(width_) * height_;
+    for (size_t t = 0; t < tile_count; ++t) {
+        stats_.steps += tile_steps_[t];
+        stats_.skipped_steps += tile_skipped_[t];
+    }
+    if (seconds > 0.0) {
+        stats_.rays_per_sec = static_cast<double>(stats_.rays) / seconds;
+        stats_.steps_per_sec = static_cast<double>(stats_.steps) / seconds;
+    }
+    return stats_;
+}
+
+bool CpuVolumeRenderer::write_ppm(const std::string& path, Vec3 background) const {
+    std::ofstream out;
+    if (!open_image(out, path)) return false;
+    out << "P6\n" << width_ << " " << height_ << "\n255\n";
+    std::vector<unsigned char> row(static_cast<size_t>(width_) * 3);
+    auto to_byte = [](float v) { return static_cast<unsigned char>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            const Vec3 c = composite(pixels_.data() + (static_cast<size_t>(y) * width_ + x) * 4, background);
+            row[static_cast<size_t>(x) * 3 + 0] = to_byte(c.x);
+            row[static_cast<size_t>(x) * 3 + 1] = to_byte(c.y);
+            row[static_cast<size_t>(x) * 3 + 2] = to_byte(c.z);
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    return finish_image(out, path);
+}
+
+bool CpuVolumeRenderer::write_pfm(const std::string& path, Vec3 background) const {
+    std::ofstream out;
+    if (!open_image(out, path)) return false;
+    // A negative scale marks little-endian floats; PFM stores the bottom row first.
+    out << "PF\n" << width_ << " " << height_ << "\n-1.0\n";
+    std::vector<float> row(static_cast<size_t>(width_) * 3);
+    for (int y = height_ - 1; y >= 0; --y) {
+        for (int x = 0; x < width_; ++x) {
+            const Vec3 c = composite(pixels_.data() + (static_cast<size_t>(y) * width_ + x) * 4, background);
+            row[static_cast<size_t>(x) * 3 + 0] = c.x;
+            row[static_cast<size_t>(x) * 3 + 1] = c.y;
+            row[static_cast<size_t>(x) * 3 + 2] = c.z;
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+    }
+    return finish_image(out, path);
+}
+
+float max_image_difference(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size()) return std::numeric_limits<float>::infinity();
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff = std::max(diff, std::fabs(a[i] - b[i]));
+    }
+    return diff;
+}
+
+}  // namespace rayol::fluid
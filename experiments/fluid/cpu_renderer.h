@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "raymarch.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+struct CpuRenderSettings {
+    int width = 640;
+    int height = 360;
+    int tile_size = 16;  // Square tiles; workers take one at a time, so busy tiles do not stall the rest.
+    // March 4x2 pixel blocks as one ray_march_packet each (same pixels as one ray at a time). Adaptive
+    // marches (march.adaptive) always go one ray at a time, with distance_scale set to the pixel
+    // footprint as on the GPU.
+    bool packets = true;
+    // Density samples for the whole frame with march.adaptive (0 = unlimited), split evenly into
+    // AdaptiveStepSettings::step_budget per ray.
+    long long frame_step_budget = 0;
+    RayMarchSettings march{};
+};
+
+struct CpuRenderStats {
+    float render_ms = 0.0f;
+    int thread_count = 0;
+    int tile_count = 0;
+    long long rays = 0;
+    long long steps = 0;          // Density samples along all rays.
+    long long skipped_steps = 0;  // Steps passed over inside empty macrocells.
+    double rays_per_sec = 0.0;
+    double steps_per_sec = 0.0;   // Sampled steps only.
+};
+
+// Multithreaded CPU reference of the fluid draw's volume pass: ray_march_volume per pixel (or per 4x2
+// packet) from the same camera as FluidRenderer, with the image split into tiles spread over a TaskScheduler. Pixels do
+// not depend on the thread count or tile size, so frames can be compared exactly (golden images).
+class CpuVolumeRenderer {
+public:
+    explicit CpuVolumeRenderer(unsigned int thread_count = 0);
+
+    // Render into the RGBA float image: in-scattered color (premultiplied), alpha = 1 - transmittance.
+    const CpuRenderStats& render(const DensityVolume& volume, const CameraData& camera,
+                                 const CpuRenderSettings& settings);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::vector<float>& pixels() const { return pixels_; }  // width * height RGBA, top row first.
+    const CpuRenderStats& stats() const { return stats_; }
+
+    // The image composited over `background`: binary PPM (P6, clamped to 8 bits) or portable float
+    // map (PF, lossless, for golden images). False (and a log line) if the file cannot be written.
+    bool write_ppm(const std::string& path, Vec3 background = {}) const;
+    bool write_pfm(const std::string& path, Vec3 background = {}) const;
+
+private:
+    TaskScheduler scheduler_;
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<float> pixels_;
+    std::vector<long long> tile_steps_;    // Per tile, summed after the render (no shared counters).
+    std::vector<long long> tile_skipped_;
+    CpuRenderStats stats_{};
+};
+
+// Largest per-channel difference of two images; infinite when their sizes differ.
+float max_image_difference(const std::vector<float>& a, const std::vector<float>& b);
+
+}  // namespace rayol::fluid
@@ -0,0 +1,308 @@
+#include "cpu_renderer_bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+#include "cpu_renderer.h"
+#include "raymarch.h"
+
+namespace rayol::fluid {
+
+std::vector<DistanceFieldBenchmarkResult> benchmark_distance_field(const FluidSettings& settings, int frames, float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const VolumeConfig& box = sim.volume().config();
+    const DistanceFieldSettings base = distance_field_settings(settings);
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    DistanceScratch scratch{};
+    std::vector<DistanceFieldBenchmarkResult> results;
+    std::vector<SphereTraceResult> sphere_hits;
+    std::vector<SphereTraceResult> other_hits;
+    for (int divisor : {1, 2, 4}) {
+        // Same box and world-space surface; only the grid (and with it the band's voxel width) is finer.
+        VolumeConfig cfg = box;
+        cfg.voxel_size = box.voxel_size / static_cast<float>(divisor);
+        cfg.dims = {box.dims.x * divisor, box.dims.y * divisor, box.dims.z * divisor};
+        DistanceFieldBenchmarkResult result{};
+        result.dims = cfg.dims;
+        DistanceVolume field;
+        result.build_ms =
+            best_of_ms(kSplatRepeats, [&] { field.build(sim.particles(), cfg, base, scratch, scheduler); });
+        result.band_voxels = field.band_voxel_count();
+        result.surface_voxels = field.surface_voxel_count();
+
+        SphereTraceSettings sphere{};
+        const TraceGridTiming traced = trace_ray_grid(field, sphere, sphere_hits);
+        result.sphere_iterations = traced.iterations_per_ray;
+        result.sphere_rays_per_sec = traced.rays_per_sec;
+
+        SphereTraceSettings fixed{};
+        fixed.fixed_step = 0.75f;  // The GPU iso search's step.
+        const TraceGridTiming marched = trace_ray_grid(field, fixed, other_hits);
+        result.fixed_iterations = marched.iterations_per_ray;
+        result.fixed_rays_per_sec = marched.rays_per_sec;
+        int hits = 0;
+        int mismatches = 0;
+        int both = 0;
+        double error = 0.0;
+        for (size_t i = 0; i < sphere_hits.size(); ++i) {
+            hits += sphere_hits[i].hit ? 1 : 0;
+            if (sphere_hits[i].hit != other_hits[i].hit) {
+                ++mismatches;
+            } else if (sphere_hits[i].hit) {
+                ++both;
+                error += std::fabs(sphere_hits[i].t - other_hits[i].t);
+            }
+        }
+        const float rays = static_cast<float>(sphere_hits.size());
+        result.hit_fraction = static_cast<float>(hits) / rays;
+        result.mismatch_fraction = static_cast<float>(mismatches) / rays;
+        result.mean_hit_error = both > 0 ? static_cast<float>(error / both) / cfg.voxel_size : 0.0f;
+
+        DistanceFieldSettings narrow = base;
+        narrow.extend = false;
+        field.build(sim.particles(), cfg, narrow, scratch, scheduler);
+        result.narrow_iterations = trace_ray_grid(field, sphere, other_hits).iterations_per_ray;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<LightVolumeBenchmarkResult> benchmark_light_volume(const FluidSettings& settings, int frames, float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const DensityVolume& volume = sim.volume();
+    const VolumeConfig& cfg = volume.config();
+    const float peak = sim.stats().max_density;
+
+    RayMarchSettings march{};
+    march.step = 0.5f * cfg.voxel_size;
+    march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+    std::vector<Vec3> color;
+    const float unshadowed_rays_per_sec = march_ray_grid(volume, march, color).rays_per_sec;
+
+    // Reference: every shaded sample marches its own shadow ray to the box at the primary step.
+    const Vec3 box_min = cfg.origin;
+    const Vec3 box_max = cfg.origin + sim.frame().extent();
+    const Vec3 to_light = normalize(march.light_dir) * -1.0f;
+    const float sigma_scale = march.density_scale * march.absorption;
+    const Vec3 ambient{march.ambient, march.ambient, march.ambient};
+    auto marched_shade = [&](Vec3 pos, Vec3 normal, float /*density*/) {
+        float t_exit = std::numeric_limits<float>::max();
+        const float p[3] = {pos.x, pos.y, pos.z};
+        const float d[3] = {to_light.x, to_light.y, to_light.z};
+        const float lo[3] = {box_min.x, box_min.y, box_min.z};
+        const float hi[3] = {box_max.x, box_max.y, box_max.z};
+        for (int a = 0; a < 3; ++a) {
+            if (d[a] != 0.0f) t_exit = std::min(t_exit, ((d[a] > 0.0f ? hi[a] : lo[a]) - p[a]) / d[a]);
+        }
+        float depth = 0.0f;
+        for (float t = 0.5f * march.step; t < t_exit; t += march.step) {
+            depth += volume.sample(pos + to_light * t) * march.step;
+        }
+        const float n_dot_l = std::max(0.0f, dot(normal, to_light)) * std::exp(-depth * sigma_scale);
+        return march.light_color * n_dot_l + ambient;
+    };
+    std::vector<Vec3> reference_color;
+    const float marched_rays_per_sec = march_ray_grid(volume, cfg, march, reference_color, marched_shade).rays_per_sec;
+
+    std::vector<LightVolumeBenchmarkResult> results;
+    TaskScheduler single(1);
+    TaskScheduler all(0);
+    for (int downsample : {1, 2, 4}) {
+        LightVolumeBenchmarkResult result{};
+        result.downsample = downsample;
+        result.unshadowed_rays_per_sec = unshadowed_rays_per_sec;
+        result.marched_rays_per_sec = marched_rays_per_sec;
+        LightVolumeSettings light_settings{};
+        light_settings.light_dir = march.light_dir;
+        light_settings.downsample = downsample;
+        LightVolume light;
+        auto time_build = [&](TaskScheduler& scheduler) {
+            return best_of_ms(kSplatRepeats, [&] { light.build(volume, light_settings, scheduler); });
+        };
+        result.single_thread_build_ms = time_build(single);
+        result.build_ms = time_build(all);
+        result.dims = light.dims();
+
+        RayMarchSettings shadowed = march;
+        shadowed.light_volume = &light;
+        result.rays_per_sec = march_ray_grid(volume, shadowed, color).rays_per_sec;
+        result.max_color_error = max_color_difference(reference_color, color);
+        result.mean_color_error = mean_color_difference(reference_color, color);
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<AdaptiveStepBenchmarkResult> benchmark_adaptive_steps(const FluidSettings& settings, int frames,
+                                                                  float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const DensityVolume& volume = sim.volume();
+    const float peak = sim.stats().max_density;
+
+    RayMarchSettings march{};
+    march.step = 0.5f * volume.config().voxel_size;
+    march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+    std::vector<Vec3> reference_color;
+    std::vector<Vec3> color;
+    const RayGridTiming fixed = march_ray_grid(volume, march, reference_color);
+
+    std::vector<AdaptiveStepBenchmarkResult> results;
+    AdaptiveStepBenchmarkResult fixed_result{};
+    fixed_result.steps_per_ray = fixed.steps_per_ray;
+    fixed_result.rays_per_sec = fixed.rays_per_sec;
+    results.push_back(fixed_result);
+    // Unlimited, then budgets of a half and a quarter of the fixed march's samples.
+    for (int divisor : {0, 2, 4}) {
+        march.adaptive.enabled = true;
+        march.adaptive.step_budget =
+            divisor > 0 ? std::max(1, static_cast<int>(fixed.steps_per_ray / static_cast<float>(divisor))) : 0;
+        const RayGridTiming timing = march_ray_grid(volume, march, color);
+        AdaptiveStepBenchmarkResult result{};
+        result.adaptive = true;
+        result.step_budget = march.adaptive.step_budget;
+        result.steps_per_ray = timing.steps_per_ray;
+        result.rays_per_sec = timing.rays_per_sec;
+        result.max_color_error = max_color_difference(reference_color, color);
+        result.mean_color_error = mean_color_difference(reference_color, color);
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<CpuRenderBenchmarkResult> benchmark_cpu_renderer(const FluidSettings& settings, int frames, float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const DensityVolume& volume = sim.volume();
+    const VolumeConfig& cfg = volume.config();
+    const Vec3 extent = sim.frame().extent();
+    const Vec3 center = cfg.origin + extent * 0.5f;
+
+    // Same viewpoint as march_ray_grid, framing the box's height.
+    CpuRenderSettings render{};
+    render.width = 320;
+    render.height = 180;
+    render.march.step = 0.5f * cfg.voxel_size;
+    render.march.density_scale = sim.stats().max_density > 0.0f ? 4.0f / sim.stats().max_density : 1.0f;
+    CameraData camera{};
+    camera.pos = {center.x, cfg.origin.y + 0.4f * extent.y, cfg.origin.z - 1.5f * extent.z};
+    camera.forward = normalize(center - camera.pos);
+    camera.right = {1.0f, 0.0f, 0.0f};
+    camera.tan_half_fov = 0.6f * extent.y / length(center - camera.pos);
+    camera.aspect = static_cast<float>(render.width) / static_cast<float>(render.height);
+
+    std::vector<CpuRenderBenchmarkResult> results;
+    std::vector<float> reference;
+    std::vector<float> single_thread_ms;
+    constexpr int kTileSizes[] = {8, 16, 64};
+    for (int threads : thread_counts_to_test()) {
+        CpuVolumeRenderer renderer(static_cast<unsigned int>(threads));
+        for (size_t t = 0; t < std::size(kTileSizes); ++t) {
+            // Per-ray marcher first: its time is the baseline of the packet row.
+            float per_ray_ms = 0.0f;
+            for (bool packets : {false, true}) {
+                render.tile_size = kTileSizes[t];
+                render.packets = packets;
+                CpuRenderBenchmarkResult result{};
+                result.tile_size = render.tile_size;
+                result.packets = packets;
+                result.render_ms = std::numeric_limits<float>::max();
+                for (int rep = 0; rep < kSplatRepeats; ++rep) {
+                    const CpuRenderStats& stats = renderer.render(volume, camera, render);
+                    if (stats.render_ms < result.render_ms) {
+                        result.render_ms = stats.render_ms;
+                        result.rays_per_sec = stats.rays_per_sec;
+                        result.steps_per_sec = stats.steps_per_sec;
+                    }
+                    result.thread_count = stats.thread_count;
+                }
+                if (results.empty()) reference = renderer.pixels();
+                result.max_difference = max_image_difference(reference, renderer.pixels());
+                const size_t slot = t * 2 + (packets ? 1 : 0);
+                if (single_thread_ms.size() <= slot) single_thread_ms.push_back(result.render_ms);
+                result.speedup = result.render_ms > 0.0f ? single_thread_ms[slot] / result.render_ms : 0.0f;
+                if (!packets) per_ray_ms = result.render_ms;
+                result.packet_speedup = result.render_ms > 0.0f ? per_ray_ms / result.render_ms : 0.0f;
+                results.push_back(result);
+            }
+        }
+    }
+    return results;
+}
+
+namespace {
+
+void run_sdf(const FluidSettings& settings) {
+    for (const auto& row : benchmark_distance_field(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("sdf")("dims", row.dims.x, "x", row.dims.y, "x", row.dims.z)
+            ("build_ms", row.build_ms)
+            ("band_voxels", row.band_voxels)
+            ("surface_voxels", row.surface_voxels)
+            ("sphere_iterations", row.sphere_iterations)
+            ("narrow_iterations", row.narrow_iterations)
+            ("fixed_iterations", row.fixed_iterations)
+            ("sphere_rays_per_sec", row.sphere_rays_per_sec)
+            ("fixed_rays_per_sec", row.fixed_rays_per_sec)
+            ("hit_fraction", row.hit_fraction)
+            ("mismatch_fraction", row.mismatch_fraction)
+            ("mean_hit_error", row.mean_hit_error);
+    }
+}
+
+void run_light_volume(const FluidSettings& settings) {
+    for (const auto& row : benchmark_light_volume(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("light volume")("downsample", row.downsample)
+            ("dims", row.dims.x, "x", row.dims.y, "x", row.dims.z)
+            ("build_ms", row.build_ms)
+            ("single_thread_build_ms", row.single_thread_build_ms)
+            ("rays_per_sec", row.rays_per_sec)
+            ("unshadowed_rays_per_sec", row.unshadowed_rays_per_sec)
+            ("marched_rays_per_sec", row.marched_rays_per_sec)
+            ("max_color_error", row.max_color_error)
+            ("mean_color_error", row.mean_color_error);
+    }
+}
+
+void run_adaptive_steps(const FluidSettings& settings) {
+    for (const auto& row : benchmark_adaptive_steps(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("")("steps", row.adaptive ? "adaptive" : "fixed")
+            ("budget", row.step_budget)
+            ("steps_per_ray", row.steps_per_ray)
+            ("rays_per_sec", row.rays_per_sec)
+            ("max_color_error", row.max_color_error)
+            ("mean_color_error", row.mean_color_error);
+    }
+}
+
+void run_cpu_render(const FluidSettings& settings) {
+    for (const auto& row : benchmark_cpu_renderer(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("cpu render")("threads", row.thread_count)
+            ("tile", row.tile_size)
+            ("marcher", row.packets ? "packet" : "ray")
+            ("ms", row.render_ms)
+            ("rays_per_sec", row.rays_per_sec)
+            ("steps_per_sec", row.steps_per_sec)
+            ("speedup", row.speedup)
+            ("packet_speedup", row.packet_speedup)
+            ("max_difference", row.max_difference);
+    }
+}
+
+constexpr BenchSuite kSuites[] = {
+    {"sdf", "SDF build and sphere tracing vs. fixed steps", run_sdf},
+    {"light_volume", "light volume build, shading throughput and error", run_light_volume},
+    {"adaptive_steps", "adaptive marching with and without a sample budget", run_adaptive_steps},
+    {"cpu_render", "CPU reference render per thread count and tile size", run_cpu_render},
+};
+
+}  // namespace
+
+std::span<const BenchSuite> cpu_renderer_bench_suites() {
+    return kSuites;
+}
+
+}  // namespace rayol::fluid
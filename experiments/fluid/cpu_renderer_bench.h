@@ -0,0 +1,84 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "bench_harness.h"
+#include "fluid_experiment.h"
+
+// Rendering benchmarks: distance-field sphere tracing, the light volume, adaptive marching and the
+// tiled CPU renderer, each over the final volume of a settled sim.
+
+namespace rayol::fluid {
+
+struct DistanceFieldBenchmarkResult {
+    Int3 dims{};                       // Field voxels (the final sim volume's box at this voxel size)
+    float build_ms = 0.0f;             // DistanceVolume::build, best of a few
+    int band_voxels = 0;               // Voxels evaluated from the particles
+    int surface_voxels = 0;            // Seeds of the distance-transform extension
+    float sphere_iterations = 0.0f;    // Field samples per ray, sphere tracing the extended field
+    float narrow_iterations = 0.0f;    // Same without the extension (steps capped at the band)
+    float fixed_iterations = 0.0f;     // Same surface searched in fixed 0.75-voxel steps
+    float sphere_rays_per_sec = 0.0f;
+    float fixed_rays_per_sec = 0.0f;
+    float hit_fraction = 0.0f;         // Rays the sphere tracer hits
+    float mismatch_fraction = 0.0f;    // Rays only one of the two searches hits (grazing rays)
+    float mean_hit_error = 0.0f;       // Mean |t| difference in voxels where both hit
+};
+
+struct LightVolumeBenchmarkResult {
+    int downsample = 1;                   // Density voxels per light voxel along each axis
+    Int3 dims{};                          // Light volume voxels
+    float build_ms = 0.0f;                // LightVolume::build on every hardware thread, best of a few
+    float single_thread_build_ms = 0.0f;  // Same on one thread
+    float rays_per_sec = 0.0f;            // March shadowed through the light volume
+    float unshadowed_rays_per_sec = 0.0f; // Same march without shadows
+    float marched_rays_per_sec = 0.0f;    // Same march shadowed by a march toward the light per shaded sample
+    float max_color_error = 0.0f;         // Largest channel difference from the per-sample shadow march
+    float mean_color_error = 0.0f;        // Mean of the same over rays and channels
+};
+
+struct AdaptiveStepBenchmarkResult {
+    bool adaptive = false;          // false = the fixed-step reference row
+    int step_budget = 0;            // Samples per ray (0 = unlimited)
+    float steps_per_ray = 0.0f;     // Density samples per ray, bisection included
+    float rays_per_sec = 0.0f;
+    float max_color_error = 0.0f;   // Largest channel difference from the fixed-step march
+    float mean_color_error = 0.0f;  // Mean of the same over rays and channels
+};
+
+struct CpuRenderBenchmarkResult {
+    int thread_count = 0;
+    int tile_size = 0;
+    bool packets = false;         // 8-ray packets (ray_march_packet) instead of one ray_march_volume per pixel
+    float render_ms = 0.0f;       // Best of a few CpuVolumeRenderer::render calls
+    double rays_per_sec = 0.0;
+    double steps_per_sec = 0.0;
+    float speedup = 0.0f;         // One-thread time at the same tile size and marcher / this time
+    float packet_speedup = 1.0f;  // Per-ray time at the same thread count and tile size / this time
+    float max_difference = 0.0f;  // Largest pixel difference from the first row (should be 0)
+};
+
+// Run the sim for `frames`, then build the particle distance field over its final volume box at the
+// sim's voxel size and at 1/2 and 1/4 of it, and search the surface of each along a ray grid by
+// sphere tracing (with and without the band extension) and by fixed steps.
+std::vector<DistanceFieldBenchmarkResult> benchmark_distance_field(const FluidSettings& settings, int frames, float dt);
+
+// Run the sim for `frames`, then build the light volume of its final density at downsample 1, 2 and
+// 4, and shade a ray grid through each against a reference that marches toward the light from every
+// shaded sample.
+std::vector<LightVolumeBenchmarkResult> benchmark_light_volume(const FluidSettings& settings, int frames, float dt);
+
+// Run the sim for `frames`, then march a ray grid through its final volume at fixed steps and with
+// adaptive steps, unlimited and on budgets of a half and a quarter of the fixed march's samples.
+std::vector<AdaptiveStepBenchmarkResult> benchmark_adaptive_steps(const FluidSettings& settings, int frames,
+                                                                  float dt);
+
+// Run the sim for `frames`, then render its final volume with CpuVolumeRenderer from a camera in
+// front of the box at every tested thread count and a few tile sizes.
+std::vector<CpuRenderBenchmarkResult> benchmark_cpu_renderer(const FluidSettings& settings, int frames, float dt);
+
+// Suites for rayol_fluid_bench, in run order.
+std::span<const BenchSuite> cpu_renderer_bench_suites();
+
+}  // namespace rayol::fluid
@@ -0,0 +1,161 @@
+#include "density_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd_target.h"
+
+namespace rayol::fluid {
+
+namespace {
+constexpr float kMaxHalf = 65504.0f;
+constexpr float kUnormMax = 65535.0f;
+constexpr float kMinRange = 1.0f / 1048576.0f;  // 2^-20; keeps an empty volume's range finite.
+
+uint16_t encode_unorm16(float value) {
+    const float v = std::min(std::max(value, 0.0f), 1.0f);
+    return static_cast<uint16_t>(v * kUnormMax + 0.5f);
+}
+
+void encode_scalar(DensityFormat format, const float* src, size_t begin, size_t count, float scale, uint16_t* dst) {
+    for (size_t i = begin; i < count; ++i) {
+        const float v = src[i] * scale;
+        dst[i] = format == DensityFormat::Float16 ? float_to_half(std::min(std::max(v, -kMaxHalf), kMaxHalf))
+                                                  : encode_unorm16(v);
+    }
+}
+
+#if RAYOL_FLUID_X86
+bool cpu_has_f16c() {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#elif defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    __cpuidex(info, 7, 0);
+    return os_avx && f16c && (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+// Eight voxels per iteration; the tail goes through the scalar loop. No FMA, so the rounding matches it.
+RAYOL_TARGET_AVX2_F16C
+size_t encode_avx2(DensityFormat format, const float* src, size_t count, float scale, uint16_t* dst) {
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    if (format == DensityFormat::Float16) {
+        const __m256 hi = _mm256_set1_ps(kMaxHalf);
+        const __m256 lo = _mm256_set1_ps(-kMaxHalf);
+        for (; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vscale);
+            v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+        }
+        return i;
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 unorm_max = _mm256_set1_ps(kUnormMax);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vscale);
+        v = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+        const __m256i q = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, unorm_max), half));
+        // packus works per 128-bit lane: lanes 0 and 2 of the 64-bit view hold the eight results in order.
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(q, q), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(packed));
+    }
+    return i;
+}
+#endif
+}  // namespace
+
+size_t density_format_bytes(DensityFormat format) {
+    return format == DensityFormat::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+float density_texel_range(DensityFormat format, float max_density) {
+    if (format == DensityFormat::Float32) return 1.0f;
+    if (!(max_density > kMinRange)) return kMinRange;
+    return std::exp2(std::ceil(std::log2(max_density)));
+}
+
+void encode_density(DensityFormat format, const float* src, size_t count, float scale, void* dst, bool simd) {
+    if (format == DensityFormat::Float32) {
+        float* out = static_cast<float*>(dst);
+        if (scale == 1.0f) {
+            std::memcpy(out, src, count * sizeof(float));
+        } else {
+            for (size_t i = 0; i < count; ++i) out[i] = src[i] * scale;
+        }
+        return;
+    }
+    uint16_t* out = static_cast<uint16_t*>(dst);
+    size_t done = 0;
+#if RAYOL_FLUID_X86
+    static const bool has_f16c = cpu_has_f16c();
+    if (simd && has_f16c) {
+        done = encode_avx2(format, src, count, scale, out);
+    }
+#else
+    (void)simd;
+#endif
+    encode_scalar(format, src, done, count, scale, out);
+}
+
+float quantize_density(DensityFormat format, float value) {
+    switch (format) {
+    case DensityFormat::Float16:
+        return half_to_float(float_to_half(std::min(std::max(value, -kMaxHalf), kMaxHalf)));
+    case DensityFormat::Unorm16:
+        return static_cast<float>(encode_unorm16(value)) / kUnormMax;
+    case DensityFormat::Float32:
+        break;
+    }
+    return value;
+}
+
+uint16_t float_to_half(float value) {
+    uint32_t x = 0;
+    std::memcpy(&x, &value, sizeof(x));
+    const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+    x &= 0x7fffffffu;
+    if (x >= 0x47800000u) {  // |value| >= 65536: infinity, or a quiet NaN.
+        return static_cast<uint16_t>(sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    if (x < 0x38800000u) {  // Below the smallest normal half: a multiple of 2^-24, rounded to nearest even.
+        float magnitude = 0.0f;
+        std::memcpy(&magnitude, &x, sizeof(magnitude));
+        return static_cast<uint16_t>(sign | static_cast<uint16_t>(std::nearbyint(magnitude * 16777216.0f)));
+    }
+    // Rebias the exponent (127 -> 15) and round the 13 dropped mantissa bits to nearest even; a carry
+    // out of the mantissa correctly bumps the exponent.
+    x += 0xc8000fffu + ((x >> 13) & 1u);
+    return static_cast<uint16_t>(sign | (x >> 13));
+}
+
+float half_to_float(uint16_t bits) {
+    const uint32_t sign = static_cast<uint32_t>(bits & 0x8000u) << 16;
+    const uint32_t exponent = (bits >> 10) & 0x1fu;
+    const uint32_t mantissa = bits & 0x3ffu;
+    uint32_t x = 0;
+    if (exponent == 0) {
+        const float magnitude = static_cast<float>(mantissa) / 16777216.0f;  // Subnormal (or zero).
+        std::memcpy(&x, &magnitude, sizeof(x));
+    } else if (exponent == 0x1f) {
+        x = 0x7f800000u | (mantissa << 13);
+    } else {
+        x = ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+    x |= sign;
+    float value = 0.0f;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+}  // namespace rayol::fluid
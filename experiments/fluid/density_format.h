@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rayol::fluid {
+
+// Texel format of the GPU density image (and of the staging copy the CPU volume is converted into).
+enum class DensityFormat {
+    Float32,  // R32_SFLOAT, the CPU volume as is.
+    // Both 16-bit formats store density / range (density_texel_range); the draw multiplies samples
+    // back by the range.
+    Float16,  // R16_SFLOAT: 11 significant bits at every magnitude, steps of 2^-24 near 0.
+    Unorm16,  // R16_UNORM: steps of range / 65535 everywhere.
+};
+
+size_t density_format_bytes(DensityFormat format);
+
+// Density a texel of 1 stands for in a volume whose largest voxel is max_density: 1 for Float32,
+// otherwise the next power of two at or above it, so the range (and with it every texel) only changes
+// when the peak density doubles or drops a lot. Raw densities can exceed the largest half (65504).
+float density_texel_range(DensityFormat format, float max_density);
+
+// Write count voxels of src * scale to dst in `format` (Float32 copies, Unorm16 clamps to [0, 1],
+// Float16 to the largest finite half). The 16-bit formats use AVX2/F16C when the CPU has them unless
+// `simd` is false; both paths round to nearest and give identical bits.
+void encode_density(DensityFormat format, const float* src, size_t count, float scale, void* dst, bool simd = true);
+
+// The value a texel encoded from `value` reads back as (unfiltered); monotonic in `value`.
+float quantize_density(DensityFormat format, float value);
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t bits);
+
+}  // namespace rayol::fluid
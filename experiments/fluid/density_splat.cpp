@@ -0,0 +1,447 @@
+#include "density_splat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace rayol::fluid {
+
+namespace {
+// Slabs per worker: extra slabs let the stealing scheduler balance fluid pooled in a few z-ranges.
+constexpr size_t kSlabsPerThread = 4;
+// Voxel rows per gather task.
+constexpr size_t kGatherRowGrain = 4;
+// Widest x span whose separable weights are precomputed once per particle (on the stack).
+constexpr int kMaxSeparableSpan = 64;
+
+struct VoxelBox {
+    int min_x = 0, min_y = 0, min_z = 0;
+    int max_x = -1, max_y = -1, max_z = -1;
+    bool empty() const { return min_x > max_x || min_y > max_y || min_z > max_z; }
+};
+
+// Voxels overlapped by a particle's kernel, clamped to the volume (as in splat_particles).
+VoxelBox voxel_box(const VolumeConfig& cfg, Vec3 pos, float influence) {
+    auto to_voxel = [&](float coord, float origin_axis) {
+        return static_cast<int>(std::floor((coord - origin_axis) / cfg.voxel_size));
+    };
+    VoxelBox box{};
+    box.min_x = std::max(0, to_voxel(pos.x - influence, cfg.origin.x));
+    box.min_y = std::max(0, to_voxel(pos.y - influence, cfg.origin.y));
+    box.min_z = std::max(0, to_voxel(pos.z - influence, cfg.origin.z));
+    box.max_x = std::min(cfg.dims.x - 1, to_voxel(pos.x + influence, cfg.origin.x));
+    box.max_y = std::min(cfg.dims.y - 1, to_voxel(pos.y + influence, cfg.origin.y));
+    box.max_z = std::min(cfg.dims.z - 1, to_voxel(pos.z + influence, cfg.origin.z));
+    return box;
+}
+
+float voxel_center(float origin, int i, float voxel_size) {
+    return origin + (static_cast<float>(i) + 0.5f) * voxel_size;
+}
+
+// Splat kernel of one particle: the table when it was built for this support, else direct evaluation
+// of the same kernel.
+struct KernelEval {
+    const SplatWeightTable* table = nullptr;
+    bool gaussian = false;
+    float support = 0.0f;
+
+    float radial(float r2) const { return table ? table->lookup(r2) : poly6_weight(r2, support); }
+    float axis(float d2) const { return table ? table->lookup(d2) : gaussian_axis_weight(d2, support); }
+    // Whether a voxel row at these y/z offsets can get any weight.
+    bool reaches(float dy2, float dz2) const {
+        const float s2 = support * support;
+        return gaussian ? (dy2 < s2 && dz2 < s2) : dy2 + dz2 < s2;
+    }
+};
+
+KernelEval kernel_eval(const SplatWeightTable* table, float support) {
+    KernelEval k{};
+    k.gaussian = table && table->kernel == SplatKernel::Gaussian;
+    k.table = table && table->kernel_radius == support ? table : nullptr;
+    k.support = support;
+    return k;
+}
+
+// Calls func(row, x0, x1) for each run of voxels [x0, x1] of row (y, z) within [min_x, max_x] that
+// shares a brick. `row` points at the brick's voxel (0, y, z), so voxel x is at
+// row[Layout::x_offset(x & 7)]. Runs in unallocated bricks are skipped.
+template <typename Layout, typename Func>
+void for_each_row_segment(DensityVolume& volume, int y, int z, int min_x, int max_x, const Func& func) {
+    constexpr int mask = kBrickSize - 1;
+    const int row_offset = Layout::y_offset(y & mask) + Layout::z_offset(z & mask);
+    for (int x0 = min_x; x0 <= max_x;) {
+        const int x1 = std::min(max_x, x0 | mask);
+        if (float* data = volume.brick_data(volume.brick_id(x0 >> kBrickShift, y >> kBrickShift, z >> kBrickShift))) {
+            func(data + row_offset, x0, x1);
+        }
+        x0 = x1 + 1;
+    }
+}
+
+// Brick row offset of voxel x under Layout, for splat_row into a segment from for_each_row_segment.
+template <typename Layout>
+struct BrickRowIndex {
+    int operator()(int x) const { return Layout::x_offset(x & (kBrickSize - 1)); }
+};
+// Plain index for splat_row into a dense row buffer.
+struct DenseRowIndex {
+    int operator()(int x) const { return x; }
+};
+
+// Add one particle to the voxels [min_x, max_x] of a row at squared offsets dy2/dz2; voxel x is
+// row[index(x)].
+template <typename RowIndex>
+void splat_row(float* row, RowIndex index, const VolumeConfig& cfg, const KernelEval& k, float px, float mass,
+               float dy2, float dz2, int min_x, int max_x) {
+    if (k.gaussian) {
+        const float wyz = mass * k.axis(dy2) * k.axis(dz2);
+        for (int x = min_x; x <= max_x; ++x) {
+            const float dx = px - voxel_center(cfg.origin.x, x, cfg.voxel_size);
+            row[index(x)] += wyz * k.axis(dx * dx);
+        }
+        return;
+    }
+    for (int x = min_x; x <= max_x; ++x) {
+        const float dx = px - voxel_center(cfg.origin.x, x, cfg.voxel_size);
+        row[index(x)] += mass * k.radial(dx * dx + dy2 + dz2);
+    }
+}
+
+// Scatter one particle into voxels [z_begin, z_end] of its box. The per-axis squared offsets are
+// hoisted out of the inner loops but summed in the same order as dot(). The box's bricks must be
+// allocated (allocate_box_bricks). A negative mass removes an earlier splat at the same position.
+template <typename Layout>
+void splat_particle_as(DensityVolume& volume, Vec3 pos, float mass, float influence, const SplatWeightTable* table,
+                       int z_begin, int z_end) {
+    const VolumeConfig& cfg = volume.config();
+    const KernelEval k = kernel_eval(table, influence);
+    const VoxelBox box = voxel_box(cfg, pos, influence);
+    z_begin = std::max(z_begin, box.min_z);
+    z_end = std::min(z_end, box.max_z);
+    const int span = box.max_x - box.min_x + 1;
+    if (k.gaussian && span <= kMaxSeparableSpan) {
+        // Separable: x factors once per particle, then each voxel is a single multiply-add.
+        float wx[kMaxSeparableSpan];
+        for (int x = box.min_x; x <= box.max_x; ++x) {
+            const float dx = pos.x - voxel_center(cfg.origin.x, x, cfg.voxel_size);
+            wx[x - box.min_x] = k.axis(dx * dx);
+        }
+        for (int z = z_begin; z <= z_end; ++z) {
+            const float dz = pos.z - voxel_center(cfg.origin.z, z, cfg.voxel_size);
+            const float wz = mass * k.axis(dz * dz);
+            for (int y = box.min_y; y <= box.max_y; ++y) {
+                const float dy = pos.y - voxel_center(cfg.origin.y, y, cfg.voxel_size);
+                const float wyz = wz * k.axis(dy * dy);
+                if (wyz == 0.0f) continue;
+                for_each_row_segment<Layout>(volume, y, z, box.min_x, box.max_x, [&](float* row, int x0, int x1) {
+                    const BrickRowIndex<Layout> index;
+                    for (int x = x0; x <= x1; ++x) {
+                        row[index(x)] += wyz * wx[x - box.min_x];
+                    }
+                });
+            }
+        }
+        return;
+    }
+    for (int z = z_begin; z <= z_end; ++z) {
+        const float dz = pos.z - voxel_center(cfg.origin.z, z, cfg.voxel_size);
+        const float dz2 = dz * dz;
+        for (int y = box.min_y; y <= box.max_y; ++y) {
+            const float dy = pos.y - voxel_center(cfg.origin.y, y, cfg.voxel_size);
+            const float dy2 = dy * dy;
+            if (!k.reaches(dy2, dz2)) continue;
+            for_each_row_segment<Layout>(volume, y, z, box.min_x, box.max_x, [&](float* row, int x0, int x1) {
+                splat_row(row, BrickRowIndex<Layout>{}, cfg, k, pos.x, mass, dy2, dz2, x0, x1);
+            });
+        }
+    }
+}
+
+void splat_particle(DensityVolume& volume, Vec3 pos, float mass, float influence, const SplatWeightTable* table,
+                    int z_begin, int z_end) {
+    with_layout(volume.layout(), [&](auto layout) {
+        splat_particle_as<decltype(layout)>(volume, pos, mass, influence, table, z_begin, z_end);
+    });
+}
+
+// Allocate (zeroed) the bricks a voxel box touches and stamp them with the volume's current revision.
+// Serial: allocation grows the shared pool.
+void allocate_box_bricks(DensityVolume& volume, const VoxelBox& box) {
+    if (box.empty()) return;
+    for (int bz = box.min_z >> kBrickShift; bz <= box.max_z >> kBrickShift; ++bz) {
+        for (int by = box.min_y >> kBrickShift; by <= box.max_y >> kBrickShift; ++by) {
+            for (int bx = box.min_x >> kBrickShift; bx <= box.max_x >> kBrickShift; ++bx) {
+                const int brick = volume.brick_id(bx, by, bz);
+                if (volume.brick_allocated(brick)) {
+                    volume.mark_brick_dirty(brick);
+                } else {
+                    volume.allocate_brick(brick);
+                }
+            }
+        }
+    }
+}
+
+// Release the volume, then allocate every brick a particle's voxel box touches, the same set the
+// serial splat allocates. The boxes are marked in a brick bitmap in parallel (a word is only written
+// when one of its bits is new, so the shared words are mostly read), then one serial pass over the
+// bitmap allocates the marked bricks in id order.
+void allocate_splat_bricks(DensityVolume& volume, const ParticleStore& particles, float kernel_radius,
+                           TaskScheduler& scheduler) {
+    volume.clear();
+    const VolumeConfig& cfg = volume.config();
+    std::vector<uint64_t> marked((static_cast<size_t>(volume.brick_count()) + 63) / 64, 0);
+    scheduler.parallel_for(0, particles.size(), [&](size_t i) {
+        const VoxelBox box = voxel_box(cfg, particles.position(i), std::max(kernel_radius, particles.radius[i]));
+        if (box.empty()) return;
+        for (int bz = box.min_z >> kBrickShift; bz <= box.max_z >> kBrickShift; ++bz) {
+            for (int by = box.min_y >> kBrickShift; by <= box.max_y >> kBrickShift; ++by) {
+                for (int bx = box.min_x >> kBrickShift; bx <= box.max_x >> kBrickShift; ++bx) {
+                    const int brick = volume.brick_id(bx, by, bz);
+                    std::atomic_ref<uint64_t> word(marked[static_cast<size_t>(brick) >> 6]);
+                    const uint64_t bit = uint64_t{1} << (brick & 63);
+                    if (!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
+                }
+            }
+        }
+    });
+    for (size_t w = 0; w < marked.size(); ++w) {
+        for (uint64_t bits = marked[w]; bits != 0; bits &= bits - 1) {
+            volume.allocate_brick(static_cast<int>(w * 64 + static_cast<size_t>(std::countr_zero(bits))));
+        }
+    }
+}
+
+// Bin `count` splat items by the z-slabs their voxel boxes (box_of(i)) overlap, then run
+// splat(i, z_begin, z_end) for each item of each slab, slabs in parallel. Items keep index order
+// within a slab, and no two tasks write the same voxel.
+template <typename BoxFn, typename SplatFn>
+void scatter_by_slab(const VolumeConfig& cfg, size_t count, const BoxFn& box_of, SplatScratch& scratch,
+                     TaskScheduler& scheduler, const SplatFn& splat) {
+    const size_t nz = static_cast<size_t>(cfg.dims.z);
+    const size_t slabs = std::clamp<size_t>(scheduler.thread_count() * kSlabsPerThread, 1, nz);
+    auto slab_begin = [&](size_t s) { return static_cast<int>(s * nz / slabs); };
+    auto slab_of = [&](int z) { return static_cast<int>((static_cast<size_t>(z + 1) * slabs - 1) / nz); };
+
+    // 1) Slab range of every item.
+    scratch.particle_slabs.resize(2 * count);
+    scheduler.parallel_for(0, count, [&](size_t i) {
+        const VoxelBox box = box_of(i);
+        scratch.particle_slabs[2 * i] = box.empty() ? -1 : slab_of(box.min_z);
+        scratch.particle_slabs[2 * i + 1] = box.empty() ? -1 : slab_of(box.max_z);
+    });
+
+    // 2) Bin items per slab in index order (counting sort; an item spanning k slabs is listed k times).
+    scratch.slab_start.assign(slabs + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const int first = scratch.particle_slabs[2 * i];
+        if (first < 0) continue;
+        for (int s = first; s <= scratch.particle_slabs[2 * i + 1]; ++s) {
+            ++scratch.slab_start[static_cast<size_t>(s) + 1];
+        }
+    }
+    for (size_t s = 0; s < slabs; ++s) {
+        scratch.slab_start[s + 1] += scratch.slab_start[s];
+    }
+    scratch.slab_particles.resize(static_cast<size_t>(scratch.slab_start[slabs]));
+    std::vector<int> cursor(scratch.slab_start.begin(), scratch.slab_start.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const int first = scratch.particle_slabs[2 * i];
+        if (first < 0) continue;
+        for (int s = first; s <= scratch.particle_slabs[2 * i + 1]; ++s) {
+            scratch.slab_particles[static_cast<size_t>(cursor[static_cast<size_t>(s)]++)] = static_cast<int>(i);
+        }
+    }
+
+    // 3) Each slab fills its own z-range.
+    scheduler.parallel_for(0, slabs, [&](size_t s) {
+        const int z_begin = slab_begin(s);
+        const int z_end = slab_begin(s + 1) - 1;
+        for (int k = scratch.slab_start[s]; k < scratch.slab_start[s + 1]; ++k) {
+            splat(static_cast<size_t>(scratch.slab_particles[static_cast<size_t>(k)]), z_begin, z_end);
+        }
+    }, 1);
+}
+}  // namespace
+
+float splat_influence(const ParticleStore& particles, float kernel_radius) {
+    float influence = kernel_radius;
+    for (size_t i = 0; i < particles.size(); ++i) {
+        influence = std::max(influence, particles.radius[i]);
+    }
+    return influence;
+}
+
+void splat_density_slabs(DensityVolume& volume,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         const SplatWeightTable* table,
+                         SplatScratch& scratch,
+                         TaskScheduler& scheduler) {
+    if (volume.brick_count() == 0) return;
+    allocate_splat_bricks(volume, particles, kernel_radius, scheduler);
+    const VolumeConfig& cfg = volume.config();
+    auto influence = [&](size_t i) { return std::max(kernel_radius, particles.radius[i]); };
+    scatter_by_slab(cfg, particles.size(),
+                    [&](size_t i) { return voxel_box(cfg, particles.position(i), influence(i)); }, scratch, scheduler,
+                    [&](size_t i, int z_begin, int z_end) {
+                        splat_particle(volume, particles.position(i), particles.mass[i], influence(i), table, z_begin,
+                                       z_end);
+                    });
+}
+
+void splat_density_footprint(DensityVolume& volume, const ParticleStore& particles, float kernel_radius,
+                             TaskScheduler& scheduler) {
+    if (volume.brick_count() == 0) return;
+    allocate_splat_bricks(volume, particles, kernel_radius, scheduler);
+}
+
+void SplatHistory::record(const ParticleStore& particles) {
+    px.assign(particles.px.begin(), particles.px.end());
+    py.assign(particles.py.begin(), particles.py.end());
+    pz.assign(particles.pz.begin(), particles.pz.end());
+}
+
+size_t splat_density_delta(DensityVolume& volume,
+                           const ParticleStore& particles,
+                           float kernel_radius,
+                           const SplatWeightTable* table,
+                           float move_threshold,
+                           SplatHistory& history,
+                           SplatScratch& scratch,
+                           TaskScheduler& scheduler) {
+    const size_t n = particles.size();
+    if (volume.brick_count() == 0 || history.size() != n) return 0;
+    const VolumeConfig& cfg = volume.config();
+    const float threshold2 = move_threshold * move_threshold;
+
+    // 1) Particles that moved past the threshold since their last splat.
+    scratch.moved.clear();
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3 d = particles.position(i) - history.position(i);
+        if (dot(d, d) > threshold2) scratch.moved.push_back(static_cast<int>(i));
+    }
+    const size_t moved = scratch.moved.size();
+    if (moved == 0) return 0;
+
+    // 2) Item 2k removes particle moved[k] at its old position, item 2k + 1 adds it at the new one.
+    //    Allocate the bricks of both boxes and stamp them with a new revision.
+    auto influence = [&](size_t item) {
+        return std::max(kernel_radius, particles.radius[static_cast<size_t>(scratch.moved[item >> 1])]);
+    };
+    auto item_position = [&](size_t item) {
+        const size_t i = static_cast<size_t>(scratch.moved[item >> 1]);
+        return (item & 1) ? particles.position(i) : history.position(i);
+    };
+    auto item_box = [&](size_t item) { return voxel_box(cfg, item_position(item), influence(item)); };
+    volume.begin_edit();
+    for (size_t item = 0; item < 2 * moved; ++item) {
+        allocate_box_bricks(volume, item_box(item));
+    }
+
+    // 3) Scatter the removals and additions by slab, as in splat_density_slabs.
+    scatter_by_slab(cfg, 2 * moved, item_box, scratch, scheduler, [&](size_t item, int z_begin, int z_end) {
+        const float mass = particles.mass[static_cast<size_t>(scratch.moved[item >> 1])];
+        splat_particle(volume, item_position(item), (item & 1) ? mass : -mass, influence(item), table, z_begin, z_end);
+    });
+
+    for (int i : scratch.moved) {
+        history.px[static_cast<size_t>(i)] = particles.px[static_cast<size_t>(i)];
+        history.py[static_cast<size_t>(i)] = particles.py[static_cast<size_t>(i)];
+        history.pz[static_cast<size_t>(i)] = particles.pz[static_cast<size_t>(i)];
+    }
+    return moved;
+}
+
+void splat_density_gather(DensityVolume& volume,
+                          const NeighborGrid& grid,
+                          const ParticleStore& particles,
+                          float kernel_radius,
+                          const SplatWeightTable* table,
+                          TaskScheduler& scheduler) {
+    if (volume.brick_count() == 0) return;
+    allocate_splat_bricks(volume, particles, kernel_radius, scheduler);
+    if (grid.order.empty()) return;
+    const VolumeConfig& cfg = volume.config();
+    const Int3 bricks = volume.brick_dims();
+    const size_t rows = static_cast<size_t>(cfg.dims.y) * static_cast<size_t>(cfg.dims.z);
+    // Voxel rows along x, a few per task. The row's y/z offsets are tested once per candidate from the
+    // 3x3 block of grid cell rows around it; survivors add into the x span their kernel covers. Rows
+    // are summed in a dense buffer and copied into their allocated bricks; rows whose brick row holds
+    // no bricks are skipped.
+    scheduler.parallel_for_range(0, rows, kGatherRowGrain, [&](size_t row_begin, size_t row_end) {
+        std::vector<float> row(static_cast<size_t>(cfg.dims.x));
+        for (size_t r = row_begin; r < row_end; ++r) {
+            const int y = static_cast<int>(r % static_cast<size_t>(cfg.dims.y));
+            const int z = static_cast<int>(r / static_cast<size_t>(cfg.dims.y));
+            const int first_brick = volume.brick_id(0, y >> kBrickShift, z >> kBrickShift);
+            bool occupied = false;
+            for (int bx = 0; bx < bricks.x && !occupied; ++bx) {
+                occupied = volume.brick_allocated(first_brick + bx);
+            }
+            if (!occupied) continue;
+            std::fill(row.begin(), row.end(), 0.0f);
+            const float cy = voxel_center(cfg.origin.y, y, cfg.voxel_size);
+            const float cz = voxel_center(cfg.origin.z, z, cfg.voxel_size);
+            const Int3 cell = grid.cell_coord({grid.origin.x, cy, cz});
+            for (int gz = std::max(cell.z - 1, 0); gz <= std::min(cell.z + 1, grid.dims.z - 1); ++gz) {
+                for (int gy = std::max(cell.y - 1, 0); gy <= std::min(cell.y + 1, grid.dims.y - 1); ++gy) {
+                    const int cell_row = grid.cell_index(0, gy, gz);
+                    const int end = grid.cell_start[cell_row + grid.dims.x];
+                    for (int s = grid.cell_start[cell_row]; s < end; ++s) {
+                        const float influence =
+                            std::max(kernel_radius, particles.radius[static_cast<size_t>(grid.order[s])]);
+                        const float dy = grid.py[s] - cy;
+                        const float dz = grid.pz[s] - cz;
+                        const float dy2 = dy * dy;
+                        const float dz2 = dz * dz;
+                        const KernelEval k = kernel_eval(table, influence);
+                        if (!k.reaches(dy2, dz2)) continue;
+                        const VoxelBox box = voxel_box(cfg, grid.position(s), influence);
+                        splat_row(row.data(), DenseRowIndex{}, cfg, k, grid.px[s], grid.mass[s], dy2, dz2, box.min_x,
+                                  box.max_x);
+                    }
+                }
+            }
+            with_layout(volume.layout(), [&](auto layout) {
+                using Layout = decltype(layout);
+                for_each_row_segment<Layout>(volume, y, z, 0, cfg.dims.x - 1, [&](float* segment, int x0, int x1) {
+                    const BrickRowIndex<Layout> index;
+                    for (int x = x0; x <= x1; ++x) {
+                        segment[index(x)] = row[static_cast<size_t>(x)];
+                    }
+                });
+            });
+        }
+    });
+}
+
+SplatDifference compare_dense_splat(const DensityVolume& volume, std::span<const float> dense) {
+    SplatDifference diff{};
+    const Int3 dims = volume.config().dims;
+    const size_t count = static_cast<size_t>(dims.x) * dims.y * dims.z;
+    if (dense.size() != count) {
+        diff.max_error = diff.mean_error = std::numeric_limits<float>::infinity();
+        return diff;
+    }
+    std::vector<float> reference;
+    volume.copy_dense(reference);
+    double sum = 0.0;
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        diff.peak = std::max(diff.peak, reference[i]);
+        const float d = std::fabs(dense[i] - reference[i]);
+        max_abs = std::max(max_abs, d);
+        sum += d;
+    }
+    const float scale = diff.peak > 0.0f ? 1.0f / diff.peak : 1.0f;
+    diff.max_error = max_abs * scale;
+    diff.mean_error = count > 0 ? static_cast<float>(sum / static_cast<double>(count)) * scale : 0.0f;
+    return diff;
+}
+
+}  // namespace rayol::fluid
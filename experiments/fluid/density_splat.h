@@ -0,0 +1,103 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "fluid_sim.h"
+#include "neighbor_grid.h"
+#include "splat_weights.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+enum class SplatMode {
+    Auto,         // Time SlabScatter and GridGather on the current volume and keep the faster.
+    Serial,       // DensityVolume::splat_particles on the calling thread (reference).
+    SlabScatter,  // Particles binned by z-slab; each task scatters into its own slab, no atomics.
+    GridGather,   // Each voxel row sums the particles of the neighbor grid cells around it.
+};
+
+// Slab binning scratch, kept to avoid reallocating every frame.
+struct SplatScratch {
+    std::vector<int> slab_start;      // Slab s owns entries [slab_start[s], slab_start[s + 1]).
+    std::vector<int> slab_particles;  // Particle indices in index order within each slab.
+    std::vector<int> particle_slabs;  // First/last slab per particle (2 entries each, -1 = outside).
+    std::vector<int> moved;           // splat_density_delta: particles re-splatted this call.
+};
+
+// Position of every particle at its last splat, for incremental splats. Indexed like the particle
+// store, so it must be permuted along with it (or re-recorded after a full splat).
+struct SplatHistory {
+    std::vector<float> px, py, pz;
+
+    size_t size() const { return px.size(); }
+    Vec3 position(size_t i) const { return {px[i], py[i], pz[i]}; }
+    void record(const ParticleStore& particles);
+    void clear() { px.clear(); py.clear(); pz.clear(); }
+};
+
+// Largest splat support of any particle: max(kernel_radius, radius[i]). A GridGather grid must be
+// built with at least this cell size so the 27-cell block covers every contributing particle.
+float splat_influence(const ParticleStore& particles, float kernel_radius);
+
+// Both parallel splats take an optional weight table (SplatWeightCache::get): nullptr splats exact
+// poly6; otherwise weights come from the table's kernel. Particles whose support max(h, radius)
+// differs from the table radius are weighted directly with the same kernel.
+
+// Both clear the volume and allocate the bricks every particle's voxel box touches (the bricks the
+// serial splat allocates) before splatting in parallel.
+
+// Overwrite the volume with the splat of all particles (same per-particle support as
+// DensityVolume::splat_particles). Voxels accumulate particles in index order, as in the serial
+// splat, so without a table the result matches it exactly.
+void splat_density_slabs(DensityVolume& volume,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         const SplatWeightTable* table,
+                         SplatScratch& scratch,
+                         TaskScheduler& scheduler);
+
+// Clear the volume and allocate the bricks splat_density_slabs would, left zero, without splatting:
+// for a volume whose density is splatted elsewhere (the renderer's GPU splat). Pair it with
+// DensityVolume::bound_macrocells so empty space can still be skipped.
+void splat_density_footprint(DensityVolume& volume,
+                             const ParticleStore& particles,
+                             float kernel_radius,
+                             TaskScheduler& scheduler);
+
+// Update a volume last rebuilt from `history` in place: every particle that moved more than
+// `move_threshold` from its history position is subtracted there and added at its current position,
+// and its history entry is updated. Particles below the threshold keep their old splat. Touched
+// bricks are stamped with a new volume revision (see DensityVolume::begin_edit) so uploads can be
+// partial. Returns the number of particles re-splatted. Float cancellation leaves residue of order
+// 1e-7 relative per update, so callers should rebuild fully now and then.
+size_t splat_density_delta(DensityVolume& volume,
+                           const ParticleStore& particles,
+                           float kernel_radius,
+                           const SplatWeightTable* table,
+                           float move_threshold,
+                           SplatHistory& history,
+                           SplatScratch& scratch,
+                           TaskScheduler& scheduler);
+
+// Overwrite the volume by gathering, per voxel row, the particles in the grid cells around it. `grid`
+// must hold the current particle positions with a cell size of at least splat_influence(); the
+// per-particle radius is read through grid.order. Sums run in slot order, so results differ from
+// the serial splat by rounding only.
+void splat_density_gather(DensityVolume& volume,
+                          const NeighborGrid& grid,
+                          const ParticleStore& particles,
+                          float kernel_radius,
+                          const SplatWeightTable* table,
+                          TaskScheduler& scheduler);
+
+// Difference between a dense x-major grid over the volume's dims (a GPU splat read back) and the
+// volume, relative to the volume's peak.
+struct SplatDifference {
+    float peak = 0.0f;        // Largest voxel of the volume.
+    float max_error = 0.0f;   // max |dense - volume| / peak
+    float mean_error = 0.0f;  // mean |dense - volume| / peak over all voxels
+};
+SplatDifference compare_dense_splat(const DensityVolume& volume, std::span<const float> dense);
+
+}  // namespace rayol::fluid
@@ -0,0 +1,458 @@
+#include "density_splat_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "density_splat.h"
+
+namespace rayol::fluid {
+
+std::vector<SplatBenchmarkResult> benchmark_splat(const FluidSettings& settings,
+                                                  const std::vector<int>& dims,
+                                                  int frames,
+                                                  float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const ParticleStore& particles = sim.particles();
+    const float h = sim.settings().kernel_radius;
+    const Vec3 extent = sim.volume_extent();
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    SplatScratch scratch{};
+    NeighborGrid grid{};
+
+    std::vector<SplatBenchmarkResult> results;
+    for (int dim : dims) {
+        if (dim <= 0) continue;
+        VolumeConfig config = sim.volume().config();
+        config.dims = {dim, dim, dim};
+        config.voxel_size = extent.x / static_cast<float>(dim);
+        DensityVolume serial(config);
+        DensityVolume slab(config);
+        DensityVolume gather(config);
+
+        SplatBenchmarkResult result{};
+        result.dim = dim;
+        result.serial_ms = result.slab_ms = result.gather_ms = std::numeric_limits<float>::max();
+        for (int rep = 0; rep < kSplatRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            serial.clear();
+            serial.splat_particles(particles, h);
+            result.serial_ms = std::min(result.serial_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            splat_density_slabs(slab, particles, h, nullptr, scratch, scheduler);
+            result.slab_ms = std::min(result.slab_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            build_neighbor_grid(grid, config, particles, splat_influence(particles, h), scheduler);
+            splat_density_gather(gather, grid, particles, h, nullptr, scheduler);
+            result.gather_ms = std::min(result.gather_ms, elapsed_ms(start));
+        }
+
+        std::vector<float> serial_dense, slab_dense, gather_dense;
+        serial.copy_dense(serial_dense);
+        slab.copy_dense(slab_dense);
+        gather.copy_dense(gather_dense);
+        float peak = 0.0f;
+        for (size_t i = 0; i < serial_dense.size(); ++i) {
+            const float ref = serial_dense[i];
+            peak = std::max(peak, ref);
+            result.max_slab_error = std::max(result.max_slab_error, std::fabs(slab_dense[i] - ref));
+            result.max_gather_error = std::max(result.max_gather_error, std::fabs(gather_dense[i] - ref));
+        }
+        if (peak > 0.0f) {
+            result.max_slab_error /= peak;
+            result.max_gather_error /= peak;
+        }
+        result.fastest = result.gather_ms < result.slab_ms ? SplatMode::GridGather : SplatMode::SlabScatter;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<SplatKernelBenchmarkResult> benchmark_splat_kernels(const FluidSettings& settings,
+                                                                int dim,
+                                                                int frames,
+                                                                float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const ParticleStore& particles = sim.particles();
+    const float h = sim.settings().kernel_radius;
+    VolumeConfig config = sim.volume().config();
+    dim = std::max(1, dim);
+    config.dims = {dim, dim, dim};
+    config.voxel_size = sim.volume_extent().x / static_cast<float>(dim);
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    SplatScratch scratch{};
+    SplatWeightCache cache{};
+
+    DensityVolume exact(config);
+    splat_density_slabs(exact, particles, h, nullptr, scratch, scheduler);
+    std::vector<float> exact_dense;
+    exact.copy_dense(exact_dense);
+    float peak = 0.0f;
+    double exact_mass = 0.0;
+    size_t touched = 0;
+    for (float v : exact_dense) {
+        peak = std::max(peak, v);
+        exact_mass += v;
+        touched += v > 0.0f ? 1 : 0;
+    }
+
+    std::vector<SplatKernelBenchmarkResult> results;
+    std::vector<float> dense;
+    for (SplatKernel kernel : {SplatKernel::Poly6, SplatKernel::Poly6Table, SplatKernel::Gaussian}) {
+        const SplatWeightTable* table = cache.get(kernel, h);
+        DensityVolume volume(config);
+        SplatKernelBenchmarkResult result{};
+        result.kernel = kernel;
+        result.splat_ms =
+            best_of_ms(kSplatRepeats, [&] { splat_density_slabs(volume, particles, h, table, scratch, scheduler); });
+        double mass = 0.0;
+        double sq = 0.0;
+        volume.copy_dense(dense);
+        for (size_t i = 0; i < dense.size(); ++i) {
+            const float diff = dense[i] - exact_dense[i];
+            result.max_error = std::max(result.max_error, std::fabs(diff));
+            sq += static_cast<double>(diff) * diff;
+            mass += dense[i];
+        }
+        if (peak > 0.0f && touched > 0) {
+            result.max_error /= peak;
+            result.rms_error = static_cast<float>(std::sqrt(sq / static_cast<double>(touched))) / peak;
+        }
+        if (exact_mass > 0.0) {
+            result.mass_error = static_cast<float>(std::fabs(mass - exact_mass) / exact_mass);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<SparseVolumeBenchmarkResult> benchmark_sparse_volume(const FluidSettings& settings,
+                                                                 const std::vector<int>& dims,
+                                                                 int frames,
+                                                                 float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const ParticleStore& particles = sim.particles();
+    const float h = sim.settings().kernel_radius;
+    const Vec3 extent = sim.volume_extent();
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    SplatScratch scratch{};
+
+    std::vector<SparseVolumeBenchmarkResult> results;
+    std::vector<float> dense;
+    std::vector<float> staging;
+    std::vector<int> bricks;
+    for (int dim : dims) {
+        if (dim <= 0) continue;
+        VolumeConfig config = sim.volume().config();
+        config.dims = {dim, dim, dim};
+        config.voxel_size = extent.x / static_cast<float>(dim);
+        DensityVolume volume(config);
+
+        SparseVolumeBenchmarkResult result{};
+        result.dim = dim;
+        result.splat_ms = std::numeric_limits<float>::max();
+        result.sparse_clear_ms = result.dense_clear_ms = std::numeric_limits<float>::max();
+        result.sparse_stats_ms = result.dense_stats_ms = std::numeric_limits<float>::max();
+        result.sparse_upload_ms = result.dense_upload_ms = std::numeric_limits<float>::max();
+        volatile float sink = 0.0f;  // Keeps the reductions from being optimized away.
+        for (int rep = 0; rep < kSplatRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            volume.clear();
+            result.sparse_clear_ms = std::min(result.sparse_clear_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            splat_density_slabs(volume, particles, h, nullptr, scratch, scheduler);
+            result.splat_ms = std::min(result.splat_ms, elapsed_ms(start));
+            volume.copy_dense(dense);
+
+            // Stats pass as in FluidExperiment::compute_stats, single-threaded for both layouts.
+            start = std::chrono::steady_clock::now();
+            bricks.clear();
+            volume.for_each_brick([&](int brick) { bricks.push_back(brick); });
+            float max_density = 0.0f;
+            float sum = 0.0f;
+            for (int brick : bricks) {
+                const float* data = volume.brick_data(brick);
+                for (int i = 0; i < kBrickVoxels; ++i) {
+                    max_density = std::max(max_density, data[i]);
+                    sum += data[i];
+                }
+            }
+            result.sparse_stats_ms = std::min(result.sparse_stats_ms, elapsed_ms(start));
+            sink = sink + max_density + sum;
+
+            start = std::chrono::steady_clock::now();
+            max_density = 0.0f;
+            sum = 0.0f;
+            for (float v : dense) {
+                max_density = std::max(max_density, v);
+                sum += v;
+            }
+            result.dense_stats_ms = std::min(result.dense_stats_ms, elapsed_ms(start));
+            sink = sink + max_density + sum;
+
+            // Upload packing: what FluidRenderer::upload_cpu_density copies into staging.
+            start = std::chrono::steady_clock::now();
+            staging.resize(volume.pool().size());
+            std::memcpy(staging.data(), volume.pool().data(), volume.pool().size() * sizeof(float));
+            result.sparse_upload_ms = std::min(result.sparse_upload_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            staging.resize(dense.size());
+            std::memcpy(staging.data(), dense.data(), dense.size() * sizeof(float));
+            result.dense_upload_ms = std::min(result.dense_upload_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            std::fill(dense.begin(), dense.end(), 0.0f);
+            result.dense_clear_ms = std::min(result.dense_clear_ms, elapsed_ms(start));
+        }
+        result.occupied_bricks = static_cast<int>(volume.allocated_bricks());
+        result.total_bricks = volume.brick_count();
+        result.sparse_bytes = volume.memory_bytes();
+        result.dense_bytes = static_cast<size_t>(dim) * dim * dim * sizeof(float);
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<IncrementalSplatBenchmarkResult> benchmark_incremental_splat(const FluidSettings& settings,
+                                                                         const std::vector<float>& thresholds,
+                                                                         int frames,
+                                                                         float dt) {
+    std::vector<IncrementalSplatBenchmarkResult> results;
+    frames = std::max(1, frames);
+    for (float threshold : thresholds) {
+        FluidSettings run_settings = settings;
+        run_settings.incremental_splat = false;
+        run_settings.reorder_interval = 0;  // Keep particle indices stable for the history.
+        FluidExperiment sim;
+        settle(sim, run_settings, frames, dt);
+        const ParticleStore& particles = sim.particles();
+        const float h = sim.settings().kernel_radius;
+        const VolumeConfig config = sim.volume().config();
+        TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+        SplatScratch scratch{};
+        SplatHistory history{};
+        DensityVolume full(config);
+        DensityVolume delta(config);
+        splat_density_slabs(delta, particles, h, nullptr, scratch, scheduler);
+        history.record(particles);
+
+        IncrementalSplatBenchmarkResult result{};
+        result.move_threshold = threshold;
+        std::vector<float> full_dense;
+        std::vector<float> delta_dense;
+        int delta_frames = 0;
+        int since_rebuild = 0;
+        for (int frame = 0; frame < frames; ++frame) {
+            sim.update(dt);
+            auto start = std::chrono::steady_clock::now();
+            splat_density_slabs(full, particles, h, nullptr, scratch, scheduler);
+            result.full_ms += elapsed_ms(start);
+
+            start = std::chrono::steady_clock::now();
+            const uint64_t before = delta.revision();
+            if (since_rebuild < settings.splat_rebuild_interval) {
+                const size_t moved = splat_density_delta(delta, particles, h, nullptr, threshold * config.voxel_size,
+                                                         history, scratch, scheduler);
+                result.delta_ms += elapsed_ms(start);
+                ++since_rebuild;
+                ++delta_frames;
+                result.moved_fraction += static_cast<float>(moved) / static_cast<float>(std::max<size_t>(1, particles.size()));
+                int dirty = 0;
+                delta.for_each_brick([&](int brick) { dirty += delta.brick_revision(brick) > before ? 1 : 0; });
+                result.dirty_fraction += static_cast<float>(dirty) / static_cast<float>(std::max<size_t>(1, delta.allocated_bricks()));
+            } else {
+                splat_density_slabs(delta, particles, h, nullptr, scratch, scheduler);
+                history.record(particles);
+                result.delta_ms += elapsed_ms(start);
+                since_rebuild = 0;
+            }
+
+            full.copy_dense(full_dense);
+            delta.copy_dense(delta_dense);
+            float peak = 0.0f;
+            float error = 0.0f;
+            for (size_t i = 0; i < full_dense.size(); ++i) {
+                peak = std::max(peak, full_dense[i]);
+                error = std::max(error, std::fabs(delta_dense[i] - full_dense[i]));
+            }
+            if (peak > 0.0f) result.max_error = std::max(result.max_error, error / peak);
+        }
+        result.full_ms /= static_cast<float>(frames);
+        result.delta_ms /= static_cast<float>(frames);
+        if (delta_frames > 0) {
+            result.moved_fraction /= static_cast<float>(delta_frames);
+            result.dirty_fraction /= static_cast<float>(delta_frames);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<DynamicDomainBenchmarkResult> benchmark_dynamic_domain(const FluidSettings& settings, int frames, float dt) {
+    FluidSettings run_settings = settings;
+    run_settings.paused = false;
+    run_settings.dynamic_domain = false;
+    FluidExperiment sim;
+    settle(sim, run_settings, frames, dt);
+    frames = std::max(1, frames);
+    const VolumeConfig container = sim.volume().config();
+    const float container_voxels =
+        static_cast<float>(container.dims.x) * static_cast<float>(container.dims.y) * static_cast<float>(container.dims.z);
+
+    // The fixed-domain volume of the final state, for the error check.
+    DensityVolume fixed_volume;
+    std::vector<DynamicDomainBenchmarkResult> results;
+    std::vector<Vec3> fixed_color;
+    std::vector<Vec3> color;
+    for (bool dynamic : {false, true}) {
+        const int refits_before = sim.stats().domain_refits;
+        run_settings.dynamic_domain = dynamic;
+        sim.configure(run_settings);
+        DynamicDomainBenchmarkResult result{};
+        result.dynamic = dynamic;
+        double splat_ms = 0.0;
+        double bytes = 0.0;
+        double voxels = 0.0;
+        for (int i = 0; i < frames; ++i) {
+            sim.update(dt);
+            const FluidStats& stats = sim.stats();
+            splat_ms += stats.splat_ms + stats.macrocell_ms;
+            bytes += static_cast<double>(stats.volume_bytes);
+            voxels += static_cast<double>(stats.domain_dims.x) * stats.domain_dims.y * stats.domain_dims.z;
+        }
+        result.avg_splat_ms = static_cast<float>(splat_ms / frames);
+        result.avg_volume_mb = static_cast<float>(bytes / frames / (1024.0 * 1024.0));
+        result.avg_domain_fraction = static_cast<float>(voxels / frames) / container_voxels;
+        result.refits = sim.stats().domain_refits - refits_before;
+
+        // March the same container-framed ray grid through the final volume; against the fixed
+        // domain, re-splat the same particles without it.
+        const DensityVolume& volume = sim.volume();
+        if (!dynamic) {
+            fixed_volume = volume;
+        } else {
+            fixed_volume.resize(container);
+            SplatScratch scratch{};
+            TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+            splat_density_slabs(fixed_volume, sim.particles(), sim.settings().kernel_radius, nullptr, scratch, scheduler);
+            fixed_volume.update_macrocells();
+        }
+        float peak = 0.0f;
+        for (const MacrocellRange& c : fixed_volume.macrocells()) {
+            peak = std::max(peak, c.max);
+        }
+        RayMarchSettings march{};
+        march.step = 0.5f * container.voxel_size;
+        march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+        const RayGridTiming timing = march_ray_grid(volume, container, march, color);
+        result.steps_per_ray = timing.steps_per_ray + timing.skipped_per_ray;
+        result.rays_per_sec = timing.rays_per_sec;
+        if (dynamic) {
+            march_ray_grid(fixed_volume, container, march, fixed_color);
+            result.max_color_error = max_color_difference(fixed_color, color);
+            for (int z = 0; z < container.dims.z; ++z) {
+                for (int y = 0; y < container.dims.y; ++y) {
+                    for (int x = 0; x < container.dims.x; ++x) {
+                        const Vec3 p = {container.origin.x + (static_cast<float>(x) + 0.5f) * container.voxel_size,
+                                        container.origin.y + (static_cast<float>(y) + 0.5f) * container.voxel_size,
+                                        container.origin.z + (static_cast<float>(z) + 0.5f) * container.voxel_size};
+                        result.max_density_error =
+                            std::max(result.max_density_error, std::fabs(volume.sample(p) - fixed_volume.sample(p)));
+                    }
+                }
+            }
+            if (peak > 0.0f) result.max_density_error /= peak;
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+namespace {
+
+void run_splat(const FluidSettings& settings) {
+    for (const auto& row : benchmark_splat(settings, {32, 64, 128}, 60, 1.0f / 60.0f)) {
+        BenchLine("splat")("dim", row.dim)
+            ("serial_ms", row.serial_ms)
+            ("slab_ms", row.slab_ms)
+            ("gather_ms", row.gather_ms)
+            ("max_slab_error", row.max_slab_error)
+            ("max_gather_error", row.max_gather_error)
+            ("fastest", row.fastest == SplatMode::GridGather ? "gather" : "slab");
+    }
+}
+
+void run_splat_kernels(const FluidSettings& settings) {
+    const char* kernel_names[] = {"poly6", "poly6_table", "gaussian"};
+    for (const auto& row : benchmark_splat_kernels(settings, 64, 60, 1.0f / 60.0f)) {
+        BenchLine("splat")("kernel", kernel_names[static_cast<int>(row.kernel)])
+            ("splat_ms", row.splat_ms)
+            ("max_error", row.max_error)
+            ("rms_error", row.rms_error)
+            ("mass_error", row.mass_error);
+    }
+}
+
+void run_sparse_volume(const FluidSettings& settings) {
+    constexpr double kMb = 1024.0 * 1024.0;
+    for (const auto& row : benchmark_sparse_volume(settings, {64, 128, 256}, 60, 1.0f / 60.0f)) {
+        BenchLine("sparse volume")("dim", row.dim)
+            ("bricks", row.occupied_bricks, "/", row.total_bricks)
+            ("sparse_mb", static_cast<double>(row.sparse_bytes) / kMb)
+            ("dense_mb", static_cast<double>(row.dense_bytes) / kMb)
+            ("splat_ms", row.splat_ms)
+            ("clear_ms", row.sparse_clear_ms, "/", row.dense_clear_ms)
+            ("stats_ms", row.sparse_stats_ms, "/", row.dense_stats_ms)
+            ("upload_ms", row.sparse_upload_ms, "/", row.dense_upload_ms);
+    }
+}
+
+void run_incremental_splat(const FluidSettings& settings) {
+    for (const auto& row : benchmark_incremental_splat(settings, {0.0f, 0.1f, 0.25f, 0.5f}, 120, 1.0f / 60.0f)) {
+        BenchLine("incremental splat")("threshold", row.move_threshold)
+            ("full_ms", row.full_ms)
+            ("delta_ms", row.delta_ms)
+            ("moved", row.moved_fraction)
+            ("dirty_bricks", row.dirty_fraction)
+            ("max_error", row.max_error);
+    }
+}
+
+void run_domain(const FluidSettings& settings) {
+    for (const auto& row : benchmark_dynamic_domain(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("")("domain", row.dynamic ? "dynamic" : "fixed")
+            ("splat_ms", row.avg_splat_ms)
+            ("volume_mb", row.avg_volume_mb)
+            ("domain_fraction", row.avg_domain_fraction)
+            ("refits", row.refits)
+            ("steps_per_ray", row.steps_per_ray)
+            ("rays_per_sec", row.rays_per_sec)
+            ("density_error", row.max_density_error)
+            ("color_error", row.max_color_error);
+    }
+}
+
+constexpr BenchSuite kSuites[] = {
+    {"splat", "serial vs. slab vs. gather splat per volume size", run_splat},
+    {"splat_kernels", "splat kernel cost and error vs. exact poly6", run_splat_kernels},
+    {"sparse_volume", "sparse vs. dense volume memory, clear, stats and upload", run_sparse_volume},
+    {"incremental_splat", "incremental vs. full splat per move threshold", run_incremental_splat},
+    {"domain", "fixed vs. particle-fitted volume domain", run_domain},
+};
+
+}  // namespace
+
+std::span<const BenchSuite> density_splat_bench_suites() {
+    return kSuites;
+}
+
+}  // namespace rayol::fluid
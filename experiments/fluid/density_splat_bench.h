@@ -0,0 +1,105 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "bench_harness.h"
+#include "fluid_experiment.h"
+
+// Density splat benchmarks: the serial, slab and gather splats, splat kernels, the sparse volume,
+// incremental splatting and the particle-fitted domain, each from a settled sim.
+
+namespace rayol::fluid {
+
+struct SplatBenchmarkResult {
+    int dim = 0;  // Voxels per axis (the default domain is split into dim^3 voxels).
+    float serial_ms = 0.0f;  // DensityVolume::splat_particles
+    float slab_ms = 0.0f;    // splat_density_slabs
+    float gather_ms = 0.0f;  // build_neighbor_grid + splat_density_gather
+    float max_slab_error = 0.0f;    // Largest deviation from the serial splat relative to its peak.
+    float max_gather_error = 0.0f;
+    SplatMode fastest = SplatMode::SlabScatter;  // What SplatMode::Auto would settle on.
+};
+
+struct SplatKernelBenchmarkResult {
+    SplatKernel kernel = SplatKernel::Poly6;
+    float splat_ms = 0.0f;  // splat_density_slabs with this kernel (best of a few runs)
+    float max_error = 0.0f;  // Largest voxel deviation from exact poly6, relative to its peak.
+    float rms_error = 0.0f;  // RMS deviation over voxels the exact splat touches, relative to its peak.
+    float mass_error = 0.0f;  // Relative difference of the summed density (splat mass) from exact poly6.
+};
+
+struct SparseVolumeBenchmarkResult {
+    int dim = 0;  // Voxels per axis.
+    int occupied_bricks = 0;  // Allocated 8^3 bricks after the splat.
+    int total_bricks = 0;
+    size_t sparse_bytes = 0;  // DensityVolume::memory_bytes
+    size_t dense_bytes = 0;   // dim^3 floats
+    float splat_ms = 0.0f;    // splat_density_slabs, including brick allocation
+    float sparse_clear_ms = 0.0f;  // DensityVolume::clear vs. zero-filling a dense grid
+    float dense_clear_ms = 0.0f;
+    float sparse_stats_ms = 0.0f;  // max/sum over allocated bricks vs. over every voxel
+    float dense_stats_ms = 0.0f;
+    float sparse_upload_ms = 0.0f;  // Staging copy of the brick pool vs. of the dense grid
+    float dense_upload_ms = 0.0f;
+};
+
+struct IncrementalSplatBenchmarkResult {
+    float move_threshold = 0.0f;  // Voxels a particle must move before it is re-splatted.
+    float full_ms = 0.0f;         // Average splat_density_slabs per frame
+    float delta_ms = 0.0f;        // Average splat_density_delta per frame (full rebuilds included)
+    float moved_fraction = 0.0f;  // Average share of particles re-splatted per delta frame.
+    float dirty_fraction = 0.0f;  // Average share of allocated bricks a delta frame marked dirty.
+    float max_error = 0.0f;       // Largest voxel deviation from the full splat over all frames, relative to its peak.
+};
+
+struct DynamicDomainBenchmarkResult {
+    bool dynamic = false;             // FluidSettings::dynamic_domain
+    float avg_splat_ms = 0.0f;        // Resplat plus macrocell update per frame
+    float avg_volume_mb = 0.0f;       // DensityVolume::memory_bytes per frame
+    float avg_domain_fraction = 0.0f;  // Density volume voxels / container voxels
+    int refits = 0;                   // Domain refits over the run
+    float steps_per_ray = 0.0f;       // Sampled plus skipped march steps per ray (ray length in steps)
+    float rays_per_sec = 0.0f;        // Same container-framed ray grid for both runs
+    float max_density_error = 0.0f;   // Dynamic run: vs. the full-container splat of its final state, relative to the peak
+    float max_color_error = 0.0f;     // Dynamic run: ray-march color vs. the full-container volume
+};
+
+// Settle a sim from `settings` for `frames` steps, then splat its particles into the same domain at
+// each voxel resolution with the serial, slab-scatter and grid-gather splats (best of a few runs).
+std::vector<SplatBenchmarkResult> benchmark_splat(const FluidSettings& settings,
+                                                  const std::vector<int>& dims,
+                                                  int frames,
+                                                  float dt);
+
+// Settle a sim from `settings`, then slab-splat it at `dim`^3 voxels with exact poly6, the poly6
+// table and the separable Gaussian, and report each against exact poly6.
+std::vector<SplatKernelBenchmarkResult> benchmark_splat_kernels(const FluidSettings& settings,
+                                                                int dim,
+                                                                int frames,
+                                                                float dt);
+
+// Settle a sim from `settings`, then slab-splat it at each voxel resolution and compare the sparse
+// volume's memory, clear, stats reduction and upload packing against a dense grid of the same size.
+std::vector<SparseVolumeBenchmarkResult> benchmark_sparse_volume(const FluidSettings& settings,
+                                                                 const std::vector<int>& dims,
+                                                                 int frames,
+                                                                 float dt);
+
+// Settle a sim from `settings` for `frames` steps, then run as many more keeping one volume fully re-splatted and
+// one updated with splat_density_delta (full rebuild every settings.splat_rebuild_interval frames) for
+// each move threshold, and compare cost, re-splatted share, dirty bricks and error.
+std::vector<IncrementalSplatBenchmarkResult> benchmark_incremental_splat(const FluidSettings& settings,
+                                                                         const std::vector<float>& thresholds,
+                                                                         int frames,
+                                                                         float dt);
+
+// Settle a sim from `settings` with the container-sized volume, then run `frames` more with it and
+// `frames` with the dynamic domain, reporting splat cost, memory, domain size and refits of each, a
+// CPU ray march of the final volume, and the dynamic volume's difference from the full container.
+std::vector<DynamicDomainBenchmarkResult> benchmark_dynamic_domain(const FluidSettings& settings, int frames, float dt);
+
+// Suites for rayol_fluid_bench, in run order.
+std::span<const BenchSuite> density_splat_bench_suites();
+
+}  // namespace rayol::fluid
@@ -0,0 +1,258 @@
+#include "distance_field.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace rayol::fluid {
+
+namespace {
+// Voxel rows per band-gather task, and lines per distance-transform task.
+constexpr size_t kBandRowGrain = 4;
+constexpr size_t kEdtLineGrain = 16;
+// Squared voxel distance standing for "no surface voxel on this line yet".
+constexpr float kFarSquared = 1e20f;
+// Particles are summed out to band + this many smoothing widths past their sphere, and terms this many
+// widths beyond the nearest sphere seen so far are dropped, so every term left out of an in-band
+// voxel is below e^-4 of its nearest sphere's.
+constexpr float kTailWidths = 4.0f;
+
+float voxel_center(float origin, int i, float voxel_size) {
+    return origin + (static_cast<float>(i) + 0.5f) * voxel_size;
+}
+
+// Exact 1D squared distance transform (Felzenszwalb & Huttenlocher): d[q] = min_p (q - p)^2 + f[p], the
+// lower envelope of the parabolas rooted at the finite f. v / z hold the envelope's roots and the
+// boundaries between them (n and n + 1 entries).
+void distance_transform_1d(const float* f, int n, float* d, int* v, float* z) {
+    int k = -1;
+    for (int q = 0; q < n; ++q) {
+        if (f[q] >= kFarSquared) continue;
+        float s = 0.0f;
+        while (k >= 0) {
+            const int p = v[k];
+            s = ((f[q] + static_cast<float>(q * q)) - (f[p] + static_cast<float>(p * p))) /
+                static_cast<float>(2 * (q - p));
+            if (s > z[k]) break;
+            --k;
+        }
+        if (k < 0) {
+            k = 0;
+            z[0] = -std::numeric_limits<float>::infinity();
+        } else {
+            ++k;
+            z[k] = s;
+        }
+        v[k] = q;
+        z[k + 1] = std::numeric_limits<float>::infinity();
+    }
+    if (k < 0) {
+        std::fill(d, d + n, kFarSquared);
+        return;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < static_cast<float>(q)) ++k;
+        const float dq = static_cast<float>(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+// Run the 1D transform in place along every line of `values` with `count` entries `stride` apart;
+// line l starts at first(l).
+template <typename First>
+void transform_lines(std::vector<float>& values, size_t lines, int count, size_t stride, const First& first,
+                     TaskScheduler& scheduler) {
+    scheduler.parallel_for_range(0, lines, kEdtLineGrain, [&](size_t line_begin, size_t line_end) {
+        const size_t n = static_cast<size_t>(count);
+        std::vector<float> in(n), out(n), z(n + 1);
+        std::vector<int> v(n);
+        for (size_t l = line_begin; l < line_end; ++l) {
+            float* line = values.data() + first(l);
+            for (size_t i = 0; i < n; ++i) in[i] = line[i * stride];
+            distance_transform_1d(in.data(), count, out.data(), v.data(), z.data());
+            for (size_t i = 0; i < n; ++i) line[i * stride] = out[i];
+        }
+    });
+}
+}  // namespace
+
+void DistanceVolume::build(const ParticleStore& particles, const VolumeConfig& cfg,
+                           const DistanceFieldSettings& settings, DistanceScratch& scratch, TaskScheduler& scheduler) {
+    static std::atomic<uint64_t> next_revision{1};
+    config_ = cfg;
+    settings_ = settings;
+    band_ = std::max(settings.band_voxels, 1.0f) * cfg.voxel_size;
+    values_.resize(static_cast<size_t>(cfg.dims.x) * static_cast<size_t>(cfg.dims.y) *
+                   static_cast<size_t>(cfg.dims.z));
+    build_band(particles, scratch, scheduler);
+    surface_voxels_ = 0;
+    if (settings.extend) {
+        extend_band(scratch, scheduler);
+    }
+    revision_ = next_revision.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DistanceVolume::clear() {
+    values_.clear();
+    values_.shrink_to_fit();
+    band_voxels_ = 0;
+    surface_voxels_ = 0;
+    revision_ = 0;
+}
+
+void DistanceVolume::build_band(const ParticleStore& particles, DistanceScratch& scratch, TaskScheduler& scheduler) {
+    const VolumeConfig& cfg = config_;
+    const float vs = cfg.voxel_size;
+    const float r = std::max(settings_.particle_radius, 0.0f);
+    // A tiny k would turn the sum into a hard min with 0/0 at ties; keep it above a fraction of a voxel.
+    const float k = std::max(settings_.smoothing, 1e-3f * vs);
+    const float inv_k = 1.0f / k;
+    const float tail = kTailWidths * k;
+    const float cutoff = r + band_ + tail;
+    const float cutoff2 = cutoff * cutoff;
+    std::fill(values_.begin(), values_.end(), band_);
+    if (particles.empty()) {
+        band_voxels_ = 0;
+        return;
+    }
+    NeighborGrid& grid = scratch.grid;
+    build_neighbor_grid(grid, cfg, particles, cutoff, scheduler);
+
+    const size_t rows = static_cast<size_t>(cfg.dims.y) * static_cast<size_t>(cfg.dims.z);
+    std::atomic<int> band_voxels{0};
+    // Per voxel row, like the density gather: candidates come from the 3x3 block of grid cell rows
+    // around it and add into the x span within the cutoff. The log-sum-exp runs relative to the
+    // smallest sphere distance m seen so far, f = m - k log sum exp((m - a_i) / k), so no term overflows.
+    scheduler.parallel_for_range(0, rows, kBandRowGrain, [&](size_t row_begin, size_t row_end) {
+        const size_t nx = static_cast<size_t>(cfg.dims.x);
+        std::vector<float> nearest(nx), sum(nx);
+        int counted = 0;
+        for (size_t row = row_begin; row < row_end; ++row) {
+            const int y = static_cast<int>(row % static_cast<size_t>(cfg.dims.y));
+            const int z = static_cast<int>(row / static_cast<size_t>(cfg.dims.y));
+            std::fill(nearest.begin(), nearest.end(), std::numeric_limits<float>::infinity());
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            const float cy = voxel_center(cfg.origin.y, y, vs);
+            const float cz = voxel_center(cfg.origin.z, z, vs);
+            const Int3 cell = grid.cell_coord({grid.origin.x, cy, cz});
+            for (int gz = std::max(cell.z - 1, 0); gz <= std::min(cell.z + 1, grid.dims.z - 1); ++gz) {
+                for (int gy = std::max(cell.y - 1, 0); gy <= std::min(cell.y + 1, grid.dims.y - 1); ++gy) {
+                    const int cell_row = grid.cell_index(0, gy, gz);
+                    const int end = grid.cell_start[cell_row + grid.dims.x];
+                    for (int s = grid.cell_start[cell_row]; s < end; ++s) {
+                        const float dy = grid.py[s] - cy;
+                        const float dz = grid.pz[s] - cz;
+                        const float dyz2 = dy * dy + dz * dz;
+                        if (dyz2 >= cutoff2) continue;
+                        const float span = std::sqrt(cutoff2 - dyz2);
+                        const float px = grid.px[s];
+                        const int x0 = std::max(0, static_cast<int>(std::ceil((px - span - cfg.origin.x) / vs - 0.5f)));
+                        const int x1 = std::min(cfg.dims.x - 1,
+                                                static_cast<int>(std::floor((px + span - cfg.origin.x) / vs - 0.5f)));
+                        for (int x = x0; x <= x1; ++x) {
+                            const float dx = voxel_center(cfg.origin.x, x, vs) - px;
+                            float& m = nearest[static_cast<size_t>(x)];
+                            if (m <= -band_) continue;  // f <= m: already clamped to -band.
+                            const float a = std::sqrt(dx * dx + dyz2) - r;
+                            if (a - m >= tail) continue;  // Below e^-4 of a term in the sum.
+                            float& acc = sum[static_cast<size_t>(x)];
+                            if (a >= m) {
+                                acc += std::exp((m - a) * inv_k);
+                            } else {
+                                acc = acc * std::exp((a - m) * inv_k) + 1.0f;
+                                m = a;
+                            }
+                        }
+                    }
+                }
+            }
+            float* out = values_.data() + row * nx;
+            for (size_t x = 0; x < nx; ++x) {
+                if (sum[x] <= 0.0f) continue;  // No particle within the cutoff: stays at band.
+                out[x] = std::clamp(nearest[x] - k * std::log(sum[x]), -band_, band_);
+                ++counted;
+            }
+        }
+        band_voxels.fetch_add(counted, std::memory_order_relaxed);
+    });
+    band_voxels_ = band_voxels.load(std::memory_order_relaxed);
+}
+
+void DistanceVolume::extend_band(DistanceScratch& scratch, TaskScheduler& scheduler) {
+    const VolumeConfig& cfg = config_;
+    const float vs = cfg.voxel_size;
+    // A zero crossing lies within half a voxel diagonal of some voxel center, and a 1-Lipschitz field
+    // is at most that far from 0 there, so these voxels bracket the whole surface.
+    const float seed_band = 0.5f * std::sqrt(3.0f) * vs;
+    std::vector<float>& edt = scratch.edt;
+    edt.resize(values_.size());
+    std::atomic<int> seeds{0};
+    scheduler.parallel_for_range(0, values_.size(), 4096, [&](size_t begin, size_t end) {
+        int counted = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const bool seed = std::abs(values_[i]) <= seed_band;
+            edt[i] = seed ? 0.0f : kFarSquared;
+            counted += seed ? 1 : 0;
+        }
+        seeds.fetch_add(counted, std::memory_order_relaxed);
+    });
+    surface_voxels_ = seeds.load(std::memory_order_relaxed);
+
+    // Separable exact transform: rows along x, then columns along y, then along z.
+    const size_t nx = static_cast<size_t>(cfg.dims.x);
+    const size_t ny = static_cast<size_t>(cfg.dims.y);
+    const size_t nz = static_cast<size_t>(cfg.dims.z);
+    transform_lines(edt, ny * nz, cfg.dims.x, 1, [&](size_t l) { return l * nx; }, scheduler);
+    transform_lines(edt, nx * nz, cfg.dims.y, nx, [&](size_t l) { return (l / nx) * nx * ny + l % nx; }, scheduler);
+    transform_lines(edt, nx * ny, cfg.dims.z, nx * ny, [&](size_t l) { return l; }, scheduler);
+
+    // Beyond the band, |v - seed| - seed_band never exceeds the distance to the surface. Without seeds
+    // there is no surface: the box diagonal lets a tracer leave in one step.
+    const float diagonal = std::sqrt(static_cast<float>(nx * nx + ny * ny + nz * nz)) * vs;
+    scheduler.parallel_for_range(0, values_.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (values_[i] < band_) continue;
+            values_[i] = edt[i] >= kFarSquared ? diagonal : std::sqrt(edt[i]) * vs - seed_band;
+        }
+    });
+}
+
+float DistanceVolume::sample(Vec3 pos) const {
+    if (values_.empty()) return std::numeric_limits<float>::infinity();
+    const VolumeConfig& cfg = config_;
+    // Clamp to the outermost voxel centers (the GPU samples with clamp-to-edge).
+    auto axis = [&](float p, float origin, int dim, int& i0, float& t) {
+        const float g = std::clamp((p - origin) / cfg.voxel_size - 0.5f, 0.0f, static_cast<float>(dim - 1));
+        i0 = std::min(static_cast<int>(g), std::max(dim - 2, 0));
+        t = g - static_cast<float>(i0);
+    };
+    int x0, y0, z0;
+    float tx, ty, tz;
+    axis(pos.x, cfg.origin.x, cfg.dims.x, x0, tx);
+    axis(pos.y, cfg.origin.y, cfg.dims.y, y0, ty);
+    axis(pos.z, cfg.origin.z, cfg.dims.z, z0, tz);
+    const size_t sx = cfg.dims.x > 1 ? 1 : 0;
+    const size_t sy = cfg.dims.y > 1 ? static_cast<size_t>(cfg.dims.x) : 0;
+    const size_t sz = cfg.dims.z > 1 ? static_cast<size_t>(cfg.dims.x) * static_cast<size_t>(cfg.dims.y) : 0;
+    const float* v = values_.data() +
+                     (static_cast<size_t>(z0) * cfg.dims.y + static_cast<size_t>(y0)) * cfg.dims.x +
+                     static_cast<size_t>(x0);
+    auto lerp1 = [](float a, float b, float t) { return a + (b - a) * t; };
+    const float c00 = lerp1(v[0], v[sx], tx);
+    const float c10 = lerp1(v[sy], v[sy + sx], tx);
+    const float c01 = lerp1(v[sz], v[sz + sx], tx);
+    const float c11 = lerp1(v[sz + sy], v[sz + sy + sx], tx);
+    return lerp1(lerp1(c00, c10, ty), lerp1(c01, c11, ty), tz);
+}
+
+Vec3 DistanceVolume::gradient(Vec3 pos) const {
+    const float h = config_.voxel_size;
+    const float gx = sample(pos + Vec3{h, 0.0f, 0.0f}) - sample(pos - Vec3{h, 0.0f, 0.0f});
+    const float gy = sample(pos + Vec3{0.0f, h, 0.0f}) - sample(pos - Vec3{0.0f, h, 0.0f});
+    const float gz = sample(pos + Vec3{0.0f, 0.0f, h}) - sample(pos - Vec3{0.0f, 0.0f, h});
+    return Vec3{gx, gy, gz} / (2.0f * h);
+}
+
+}  // namespace rayol::fluid
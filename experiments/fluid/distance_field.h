@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "fluid_sim.h"
+#include "neighbor_grid.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+struct DistanceFieldSettings {
+    float particle_radius = 0.03f;  // Sphere radius around every particle (world units).
+    float smoothing = 0.01f;        // Smooth-min width k; larger blends neighboring spheres further.
+    float band_voxels = 3.0f;       // Half-width of the narrow band evaluated from the particles.
+    // Outside the band store a lower bound on the distance to the band's zero set (exact Euclidean
+    // distance transform of the surface voxels) instead of the band value, so sphere tracing takes
+    // long steps through empty space.
+    bool extend = true;
+};
+
+// Build scratch, kept to avoid reallocating every frame.
+struct DistanceScratch {
+    NeighborGrid grid;       // Cell size = summation cutoff, so a voxel row's candidates are in 3x3 cell rows.
+    std::vector<float> edt;  // Squared voxel distance to the nearest surface voxel.
+};
+
+// Signed distance to the particle surface on a dense x-major voxel grid (negative inside). Near the
+// particles it is the smooth minimum of sphere distances, f = -k log sum exp((r - |x - p|) / k), which
+// is 1-Lipschitz like a true distance, so a sphere tracer may step by it. Particles farther than
+// r + band + 4k from a voxel are left out of its sum; with `extend` the field beyond the band is the
+// distance to the nearest surface voxel minus half a voxel diagonal, otherwise it is clamped to band.
+class DistanceVolume {
+public:
+    // Rebuild over `cfg` (normally the density volume's box) in parallel: a per-row gather of the
+    // exp sums over a neighbor grid, then the distance transform for the extension.
+    void build(const ParticleStore& particles, const VolumeConfig& cfg, const DistanceFieldSettings& settings,
+               DistanceScratch& scratch, TaskScheduler& scheduler);
+    void clear();
+
+    bool empty() const { return values_.empty(); }
+    const VolumeConfig& config() const { return config_; }
+    const DistanceFieldSettings& settings() const { return settings_; }
+    float band() const { return band_; }  // Narrow band half-width in world units.
+    // Identifies the build the values came from (unique across volumes, 0 = never built).
+    uint64_t revision() const { return revision_; }
+    int band_voxel_count() const { return band_voxels_; }      // Voxels evaluated from the particles.
+    int surface_voxel_count() const { return surface_voxels_; }  // Seeds of the extension.
+    const std::vector<float>& values() const { return values_; }
+
+    float value(int x, int y, int z) const {
+        return values_[(static_cast<size_t>(z) * config_.dims.y + static_cast<size_t>(y)) * config_.dims.x +
+                       static_cast<size_t>(x)];
+    }
+    // Trilinear sample at a world position (clamped to the grid), like DensityVolume::sample.
+    float sample(Vec3 pos) const;
+    // Central-difference gradient (the surface normal direction near the zero set).
+    Vec3 gradient(Vec3 pos) const;
+
+private:
+    void build_band(const ParticleStore& particles, DistanceScratch& scratch, TaskScheduler& scheduler);
+    void extend_band(DistanceScratch& scratch, TaskScheduler& scheduler);
+
+    VolumeConfig config_{};
+    DistanceFieldSettings settings_{};
+    float band_ = 0.0f;
+    uint64_t revision_ = 0;
+    int band_voxels_ = 0;
+    int surface_voxels_ = 0;
+    std::vector<float> values_;
+};
+
+}  // namespace rayol::fluid
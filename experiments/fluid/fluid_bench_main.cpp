@@ -0,0 +1,92 @@
+// Command-line runner for the CPU benchmarks each subsystem keeps in its *_bench.h (see bench_harness.h),
+// so they run outside the interactive app (and on machines without a GPU). Results go to stdout, one line
+// per row.
+//
+//   rayol_fluid_bench [--particles N] [--threads N] [--list] [suite...]
+//
+// With no suites named, every suite runs in table order.
+
+#include <charconv>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "bench_harness.h"
+#include "cpu_renderer_bench.h"
+#include "density_splat_bench.h"
+#include "neighbor_grid_bench.h"
+#include "raymarch_bench.h"
+
+namespace rayol::fluid {
+namespace {
+
+// Every subsystem's suites, in run order.
+std::vector<BenchSuite> all_suites() {
+    std::vector<BenchSuite> suites;
+    for (std::span<const BenchSuite> table :
+         {neighbor_grid_bench_suites(), density_splat_bench_suites(), raymarch_bench_suites(),
+          cpu_renderer_bench_suites()}) {
+        suites.insert(suites.end(), table.begin(), table.end());
+    }
+    return suites;
+}
+
+const BenchSuite* find_suite(const std::vector<BenchSuite>& suites, std::string_view name) {
+    for (const BenchSuite& suite : suites) {
+        if (name == suite.name) return &suite;
+    }
+    return nullptr;
+}
+
+bool parse_int(std::string_view text, int& out) {
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+void print_usage() {
+    std::cerr << "usage: rayol_fluid_bench [--particles N] [--threads N] [--list] [suite...]\n";
+}
+
+}  // namespace
+}  // namespace rayol::fluid
+
+int main(int argc, char** argv) {
+    using namespace rayol::fluid;
+    const std::vector<BenchSuite> all = all_suites();
+    FluidSettings settings{};
+    std::vector<const BenchSuite*> suites;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--list") {
+            for (const BenchSuite& suite : all) std::cout << suite.name << "  " << suite.description << "\n";
+            return 0;
+        }
+        if (arg == "--particles" || arg == "--threads") {
+            int value = 0;
+            if (i + 1 >= argc || !parse_int(argv[i + 1], value) || value < 0) {
+                std::cerr << "[fluid] " << arg << " needs a non-negative integer.\n";
+                print_usage();
+                return 2;
+            }
+            ++i;
+            (arg == "--particles" ? settings.particle_count : settings.thread_count) = value;
+            continue;
+        }
+        const BenchSuite* suite = find_suite(all, arg);
+        if (!suite) {
+            std::cerr << "[fluid] unknown benchmark suite '" << arg << "' (see --list).\n";
+            print_usage();
+            return 2;
+        }
+        suites.push_back(suite);
+    }
+    if (suites.empty()) {
+        for (const BenchSuite& suite : all) suites.push_back(&suite);
+    }
+
+    std::cout << "[fluid] benchmark: " << settings.particle_count << " particles, threads="
+              << settings.thread_count << std::endl;
+    for (const BenchSuite* suite : suites) suite->run(settings);
+    return 0;
+}
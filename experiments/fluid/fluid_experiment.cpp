@@ -1,8 +1,11 @@
 #include "fluid_experiment.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <random>
-#include <thread>
 
 namespace rayol::fluid {
 
@@ -13,186 +16,58 @@ constexpr float kBounceDamping = 0.8f;
 // but low enough to allow visible motion and sloshing.
 constexpr float kViscosity = 0.02f;
 
-// Bounded SPH-like kernels (heuristic, not physically normalized).
-inline float poly6_kernel(float r, float h) {
-    if (r >= h || h <= 0.0f) return 0.0f;
-    float q = 1.0f - (r / h);  // in [0,1)
-    return q * q * q;          // smooth, bounded [0,1]
-}
-
-inline Vec3 spiky_gradient(const Vec3& rij, float r, float h) {
-    if (r <= 0.0f || r >= h || h <= 0.0f) return {0.0f, 0.0f, 0.0f};
-    float q = 1.0f - (r / h);
-    // Gradient magnitude ~ q^2 / h, direction along -rij.
-    float scalar = -(q * q) / (h * r);
-    return rij * scalar;
-}
-
-inline float visc_laplacian(float r, float h) {
-    if (r >= h || h <= 0.0f) return 0.0f;
-    float q = 1.0f - (r / h);
-    return q;  // simple, bounded [0,1]
-}
-
 // Pressure stiffness: larger values make the fluid less compressible.
 constexpr float kPressureStiffness = 3.0f;
 // Viscosity coefficient for SPH pairwise term.
 constexpr float kSphViscosity = 0.01f;
+// XSPH velocity smoothing after each PBF step (fraction of the neighbor-average velocity difference).
+constexpr float kPbfXsph = 0.05f;
 // Safety clamps to keep the toy sim numerically stable.
 constexpr float kMaxAccel = 200.0f;
 constexpr float kMaxSpeed = 20.0f;
-
-// Simple helper to run a parallel-for over [begin, end).
-template <typename Func>
-void parallel_for(size_t begin, size_t end, const Func& func) {
-    if (end <= begin) return;
-    unsigned int hw = std::thread::hardware_concurrency();
-    if (hw == 0) hw = 1;
-    size_t total = end - begin;
-    size_t block = (total + hw - 1) / hw;
-    if (block == 0) block = total;
-
-    std::vector<std::thread> threads;
-    threads.reserve(hw);
-    size_t start = begin;
-    for (unsigned int t = 0; t < hw && start < end; ++t) {
-        size_t block_end = std::min(start + block, end);
-        threads.emplace_back([start, block_end, &func]() {
-            for (size_t i = start; i < block_end; ++i) {
-                func(i);
-            }
-        });
-        start = block_end;
-    }
-    for (auto& th : threads) {
-        th.join();
-    }
+// SplatMode::Auto: timed resplats per parallel strategy before picking, and resplats between
+// recalibrations (the particle distribution, and with it the faster strategy, drifts as fluid pools).
+constexpr int kSplatTrials = 3;
+constexpr int kSplatRecalibrateInterval = 600;
+// NeighborMode::VerletList: steps a list should last at the fastest particle's speed. The list holds
+// while nothing moved more than skin / 2, so the step's CFL number is capped at skin / (2 * this).
+constexpr float kVerletListReuseSteps = 4.0f;
+
+struct MaxSum {
+    float max = 0.0f;
+    float sum = 0.0f;
+};
+
+MaxSum combine_max_sum(const MaxSum& a, const MaxSum& b) { return {std::max(a.max, b.max), a.sum + b.sum}; }
+
+SphNeighborData neighbor_data(const NeighborGrid& grid, const FloatArray& densities, const FloatArray& pressures) {
+    SphNeighborData data{};
+    data.px = grid.px.data();
+    data.py = grid.py.data();
+    data.pz = grid.pz.data();
+    data.vx = grid.vx.data();
+    data.vy = grid.vy.data();
+    data.vz = grid.vz.data();
+    data.mass = grid.mass.data();
+    data.density = densities.data();
+    data.pressure = pressures.data();
+    return data;
 }
 
-// Build a simple uniform grid over the simulation volume for SPH neighbor queries.
-void build_neighbor_grid(NeighborGrid& grid,
-                         const VolumeConfig& volume_config,
-                         const std::vector<Particle>& particles,
-                         float kernel_radius) {
-    grid.origin = volume_config.origin;
-    float h = kernel_radius;
-    if (h <= 0.0f) {
-        h = 0.01f;
-    }
-    grid.cell_size = h;
-
-    Vec3 extent{
-        static_cast<float>(volume_config.dims.x) * volume_config.voxel_size,
-        static_cast<float>(volume_config.dims.y) * volume_config.voxel_size,
-        static_cast<float>(volume_config.dims.z) * volume_config.voxel_size,
-    };
-
-    auto dim_for_axis = [&](float axis_extent) {
-        int d = static_cast<int>(std::ceil(axis_extent / grid.cell_size));
-        return std::max(d, 1);
-    };
-
-    grid.dims.x = dim_for_axis(extent.x);
-    grid.dims.y = dim_for_axis(extent.y);
-    grid.dims.z = dim_for_axis(extent.z);
-
-    const int cell_count = grid.dims.x * grid.dims.y * grid.dims.z;
-    grid.cell_heads.assign(cell_count, -1);
-    grid.next.assign(static_cast<int>(particles.size()), -1);
-
-    auto clamp_coord = [](int v, int max_v) {
-        if (v < 0) return 0;
-        if (v >= max_v) return max_v - 1;
-        return v;
-    };
-
-    auto cell_index = [&](int x, int y, int z) {
-        return z * grid.dims.y * grid.dims.x + y * grid.dims.x + x;
-    };
-
-    for (size_t i = 0; i < particles.size(); ++i) {
-        const Particle& p = particles[i];
-        Vec3 rel{p.position.x - grid.origin.x,
-                 p.position.y - grid.origin.y,
-                 p.position.z - grid.origin.z};
-
-        int cx = static_cast<int>(std::floor(rel.x / grid.cell_size));
-        int cy = static_cast<int>(std::floor(rel.y / grid.cell_size));
-        int cz = static_cast<int>(std::floor(rel.z / grid.cell_size));
-
-        cx = clamp_coord(cx, grid.dims.x);
-        cy = clamp_coord(cy, grid.dims.y);
-        cz = clamp_coord(cz, grid.dims.z);
-
-        int idx = cell_index(cx, cy, cz);
-        grid.next[static_cast<int>(i)] = grid.cell_heads[idx];
-        grid.cell_heads[idx] = static_cast<int>(i);
-    }
-}
-
-template <typename Func>
-void for_each_neighbor(const NeighborGrid& grid,
-                       int particle_index,
-                       const std::vector<Particle>& particles,
-                       float radius,
-                       const Func& func) {
-    if (particles.empty()) return;
-
-    const Particle& p = particles[particle_index];
-    float r2_max = radius * radius;
-
-    Vec3 rel{p.position.x - grid.origin.x,
-             p.position.y - grid.origin.y,
-             p.position.z - grid.origin.z};
-
-    int cx = static_cast<int>(std::floor(rel.x / grid.cell_size));
-    int cy = static_cast<int>(std::floor(rel.y / grid.cell_size));
-    int cz = static_cast<int>(std::floor(rel.z / grid.cell_size));
-
-    auto clamp_coord = [](int v, int max_v) {
-        if (v < 0) return 0;
-        if (v >= max_v) return max_v - 1;
-        return v;
-    };
-
-    cx = clamp_coord(cx, grid.dims.x);
-    cy = clamp_coord(cy, grid.dims.y);
-    cz = clamp_coord(cz, grid.dims.z);
-
-    auto cell_index = [&](int x, int y, int z) {
-        return z * grid.dims.y * grid.dims.x + y * grid.dims.x + x;
-    };
+}  // namespace
 
-    int min_x = std::max(cx - 1, 0);
-    int max_x = std::min(cx + 1, grid.dims.x - 1);
-    int min_y = std::max(cy - 1, 0);
-    int max_y = std::min(cy + 1, grid.dims.y - 1);
-    int min_z = std::max(cz - 1, 0);
-    int max_z = std::min(cz + 1, grid.dims.z - 1);
-
-    for (int z = min_z; z <= max_z; ++z) {
-        for (int y = min_y; y <= max_y; ++y) {
-            for (int x = min_x; x <= max_x; ++x) {
-                int cell = cell_index(x, y, z);
-                int j = grid.cell_heads[cell];
-                while (j != -1) {
-                    Vec3 rij = particles[particle_index].position - particles[j].position;
-                    float r2 = dot(rij, rij);
-                    if (r2 <= r2_max) {
-                        float r = std::sqrt(r2);
-                        func(j, rij, r);
-                    }
-                    j = grid.next[j];
-                }
-            }
-        }
-    }
+DistanceFieldSettings distance_field_settings(const FluidSettings& settings) {
+    DistanceFieldSettings result{};
+    result.particle_radius = settings.sdf_radius * settings.kernel_radius;
+    result.smoothing = settings.sdf_smoothing * result.particle_radius;
+    result.band_voxels = settings.sdf_band;
+    return result;
 }
-}  // namespace
 
-FluidExperiment::FluidExperiment() {
+FluidExperiment::FluidExperiment() : scheduler_(static_cast<unsigned int>(std::max(0, settings_.thread_count))) {
     volume_config_.dims = {kDefaultDim, kDefaultDim, kDefaultDim};
     volume_config_.voxel_size = settings_.voxel_size;
+    volume_config_.layout = settings_.voxel_layout;
     rebuild_volume();
     reseed_particles();
     resplat_density();
@@ -201,29 +76,57 @@ FluidExperiment::FluidExperiment() {
 
 void FluidExperiment::configure(const FluidSettings& new_settings) {
     bool volume_changed = new_settings.voxel_size != settings_.voxel_size;
+    bool layout_changed = new_settings.voxel_layout != settings_.voxel_layout ||
+                          new_settings.dynamic_domain != settings_.dynamic_domain ||
+                          new_settings.domain_margin != settings_.domain_margin;
     bool particle_count_changed = new_settings.particle_count != settings_.particle_count;
     bool kernel_radius_changed = new_settings.kernel_radius != settings_.kernel_radius;
+    bool thread_count_changed = new_settings.thread_count != settings_.thread_count;
+    bool distance_changed = new_settings.distance_field != settings_.distance_field ||
+                            new_settings.sdf_radius != settings_.sdf_radius ||
+                            new_settings.sdf_smoothing != settings_.sdf_smoothing ||
+                            new_settings.sdf_band != settings_.sdf_band;
+    bool light_changed = new_settings.light_volume != settings_.light_volume ||
+                         new_settings.light_downsample != settings_.light_downsample;
+    const bool was_footprint = footprint_only();
+    if (kernel_radius_changed || new_settings.splat_kernel != settings_.splat_kernel ||
+        new_settings.incremental_splat != settings_.incremental_splat) {
+        splat_history_.clear();  // The next resplat rebuilds with the new kernel.
+    }
 
+    settings_changed_ = settings_changed_ || !(new_settings == settings_);
     settings_ = new_settings;
+    grid_current_ = false;  // Its cell size or binning may no longer match.
+    if (thread_count_changed) {
+        scheduler_.resize(static_cast<unsigned int>(std::max(0, settings_.thread_count)));
+        stats_.thread_count = static_cast<int>(scheduler_.thread_count());
+    }
     if (volume_changed) {
         volume_config_.voxel_size = settings_.voxel_size;
     }
+    volume_config_.layout = settings_.voxel_layout;
 
-    if (volume_changed) {
+    if (volume_changed || layout_changed) {
         rebuild_volume();
     }
     if (volume_changed || particle_count_changed) {
         reseed_particles();
         resplat_density();
         compute_stats();
-    } else if (kernel_radius_changed) {
-        // Re-splat and refresh stats when only the kernel radius changes.
+    } else if (kernel_radius_changed || layout_changed || footprint_only() != was_footprint) {
+        // Re-splat and refresh stats when only the kernel radius, volume layout/domain or the side
+        // that splats the density changes.
         resplat_density();
         compute_stats();
+    } else {
+        if (distance_changed) build_distance_field();
+        if (light_changed) build_light_volume();
     }
 }
 
 void FluidExperiment::reset() {
+    stats_.sim_time = 0.0;
+    stats_.domain_refits = 0;
     reseed_particles();
     resplat_density();
     compute_stats();
@@ -231,24 +134,240 @@ void FluidExperiment::reset() {
 
 void FluidExperiment::update(float dt) {
     if (settings_.paused) return;
-    NeighborGrid grid{};
-    build_neighbor_grid(grid, volume_config_, particles_, settings_.kernel_radius);
+    auto frame_start = std::chrono::steady_clock::now();
+    dt = std::isfinite(dt) ? std::max(0.0f, dt) : 0.0f;
+    if (dt <= 0.0f) {
+        // Nothing moves; the density only needs redoing for settings configure() left to the next resplat.
+        if (settings_changed_) {
+            resplat_density();
+            compute_stats();
+            settings_changed_ = false;
+        }
+        stats_.substeps = 0;
+        stats_.substep_dt = 0.0f;
+        stats_.sim_time_ratio = 1.0f;
+        stats_.step_ms =
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+        return;
+    }
 
-    // SPH step: compute per-particle densities/pressures, then integrate using neighbor grid.
-    compute_sph_densities(grid);
-    integrate_particles(dt, grid);
+    // Equal substeps within the frame: as few as the CFL limit allows, capped by max_substeps.
+    // When capped, each substep stays at the stable size and the frame runs in slow motion rather
+    // than taking one oversized, clamp-dominated step.
+    int substeps = 1;
+    float substep_dt = dt;
+    const float cfl = settings_.solver == SolverType::Pbf ? settings_.pbf_cfl_number : settings_.cfl_number;
+    if (cfl > 0.0f) {
+        const float stable_dt = stable_timestep();
+        const int max_substeps = std::max(1, settings_.max_substeps);
+        substeps = static_cast<int>(std::min<float>(std::ceil(dt / stable_dt), static_cast<float>(max_substeps)));
+        substeps = std::max(1, substeps);
+        substep_dt = std::min(dt / static_cast<float>(substeps), stable_dt);
+    }
 
-    // Rebuild density for rendering and stats after integration.
+    // The first substep always runs; later ones only if the last substep's cost still fits the budget.
+    int done = 0;
+    float sim_ms = 0.0f;
+    float last_substep_ms = 0.0f;
+    while (done < substeps) {
+        if (done > 0 && settings_.frame_budget_ms > 0.0f && sim_ms + last_substep_ms > settings_.frame_budget_ms) {
+            break;
+        }
+        auto substep_start = std::chrono::steady_clock::now();
+        step(substep_dt);
+        last_substep_ms =
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - substep_start).count();
+        sim_ms += last_substep_ms;
+        ++done;
+    }
+
+    // Rebuild density for rendering and stats once per frame, after the last substep.
     resplat_density();
     compute_stats();
+    settings_changed_ = false;
+    const float simulated = substep_dt * static_cast<float>(done);
+    stats_.substeps = done;
+    stats_.substep_dt = substep_dt;
+    stats_.sim_time_ratio = simulated / dt;
+    stats_.sim_time += simulated;
+    stats_.step_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+}
+
+void FluidExperiment::step(float dt) {
+    if (settings_.solver == SolverType::Pbf) {
+        step_pbf(dt);
+        return;
+    }
+    if (settings_.reorder_interval > 0 && ++steps_since_reorder_ >= settings_.reorder_interval) {
+        reorder_particles();
+    }
+    update_neighbors();
+
+    // SPH step: compute per-particle densities/pressures, then integrate using neighbor grid.
+    compute_sph_densities(grid_);
+    integrate_particles(dt, grid_);
+}
+
+void FluidExperiment::step_pbf(float dt) {
+    if (settings_.reorder_interval > 0 && ++steps_since_reorder_ >= settings_.reorder_interval) {
+        reorder_particles();
+    }
+    const size_t n = particles_.size();
+    densities_.resize(n, 0.0f);
+    pressures_.assign(n, 0.0f);
+    if (n == 0 || dt <= 0.0f) return;
+
+    float h = settings_.kernel_radius;
+    if (h <= 0.0f) h = 0.01f;
+    Vec3 min_bound = volume_config_.origin;
+    min_bound.y += h * 0.5f;
+    const Vec3 max_bound = volume_extent();
+
+    // Predict: external forces, then move. The grid is built on the predicted positions.
+    for (FloatArray* a : {&pbf_prev_px_, &pbf_prev_py_, &pbf_prev_pz_}) {
+        a->resize(n);
+    }
+    scheduler_.parallel_for(0, n, [&](size_t i) {
+        Vec3 velocity = particles_.velocity(i);
+        Vec3 accel{-kViscosity * velocity.x, settings_.gravity_y - kViscosity * velocity.y, -kViscosity * velocity.z};
+        velocity = velocity + accel * dt;
+        float v_len = length(velocity);
+        if (!std::isfinite(v_len)) {
+            velocity = {0.0f, 0.0f, 0.0f};
+        } else if (v_len > kMaxSpeed) {
+            velocity = velocity * (kMaxSpeed / v_len);
+        }
+        const Vec3 position = particles_.position(i);
+        pbf_prev_px_[i] = position.x;
+        pbf_prev_py_[i] = position.y;
+        pbf_prev_pz_[i] = position.z;
+        Vec3 predicted = position + velocity * dt;
+        predicted = {std::clamp(predicted.x, min_bound.x, max_bound.x), std::clamp(predicted.y, min_bound.y, max_bound.y),
+                     std::clamp(predicted.z, min_bound.z, max_bound.z)};
+        particles_.set_position(i, predicted);
+        particles_.set_velocity(i, velocity);
+    });
+    use_neighbor_list_ = false;
+    neighbor_list_.clear();
+    build_neighbor_grid(grid_, volume_config_, particles_, h, scheduler_);
+    grid_current_ = false;  // Binned on the predicted positions.
+
+    rest_density_ = pbf_rest_density(kPbfRestSpacing);
+    PbfParams params{};
+    params.kernel_radius = h;
+    params.rest_density = rest_density_;
+    params.iterations = settings_.pbf_iterations;
+    params.min_bound = min_bound;
+    params.max_bound = max_bound;
+    const SphKernels& kernels = active_kernels();
+    solve_pbf_density(pbf_, grid_, params, kernels, scheduler_);
+
+    // Velocity from the projected displacement, written over the gathered (predicted) velocities so
+    // the XSPH pass below reads every neighbor's new velocity.
+    const float inv_dt = 1.0f / dt;
+    scheduler_.parallel_for(0, n, [&](size_t s) {
+        const size_t i = static_cast<size_t>(grid_.order[s]);
+        grid_.vx[s] = (grid_.px[s] - pbf_prev_px_[i]) * inv_dt;
+        grid_.vy[s] = (grid_.py[s] - pbf_prev_py_[i]) * inv_dt;
+        grid_.vz[s] = (grid_.pz[s] - pbf_prev_pz_[i]) * inv_dt;
+    });
+
+    // XSPH: blend toward the density-weighted neighbor velocity, then write back in particle order.
+    const SphNeighborData data = neighbor_data(grid_, pbf_.density, cell_pressures_);
+    scheduler_.parallel_for(0, n, [&](size_t s) {
+        const Vec3 pos = grid_.position(static_cast<int>(s));
+        const Vec3 v_i = grid_.velocity(static_cast<int>(s));
+        Vec3 blend{};
+        for_each_neighbor_run(grid_, pos, [&](int begin, int end) {
+            blend = blend + kernels.xsph(data, begin, end, pos, v_i, h);
+        });
+        Vec3 velocity = v_i + blend * kPbfXsph;
+        float v_len = length(velocity);
+        if (!std::isfinite(v_len)) {
+            velocity = {0.0f, 0.0f, 0.0f};
+        } else if (v_len > kMaxSpeed) {
+            velocity = velocity * (kMaxSpeed / v_len);
+        }
+        const size_t i = static_cast<size_t>(grid_.order[s]);
+        particles_.set_position(i, pos);
+        particles_.set_velocity(i, velocity);
+        densities_[i] = pbf_.density[s];
+    });
+}
+
+float FluidExperiment::stable_timestep() const {
+    float h = settings_.kernel_radius;
+    if (h <= 0.0f) h = 0.01f;
+    // stats_.max_speed is current: compute_stats runs after every update and reseed. A resting
+    // fluid still falls, so the speed is floored at the free-fall speed over one kernel radius.
+    const float fall_speed = std::sqrt(std::fabs(settings_.gravity_y) * h);
+    const float speed = std::max({stats_.max_speed, fall_speed, 1e-3f});
+    float cfl = settings_.solver == SolverType::Pbf ? settings_.pbf_cfl_number : settings_.cfl_number;
+    if (settings_.solver == SolverType::Sph && settings_.neighbor_mode == NeighborMode::VerletList &&
+        settings_.verlet_skin > 0.0f) {
+        cfl = std::min(cfl, settings_.verlet_skin / (2.0f * kVerletListReuseSteps));
+    }
+    return cfl * h / speed;
+}
+
+void FluidExperiment::reorder_particles() {
+    auto start = std::chrono::steady_clock::now();
+    float h = settings_.kernel_radius;
+    if (h <= 0.0f) h = 0.01f;
+    compute_morton_order(morton_, particles_, volume_config_.origin, h, scheduler_);
+    apply_morton_order(morton_, particles_, scheduler_);
+    apply_morton_order(morton_, densities_, scheduler_);
+    apply_morton_order(morton_, pressures_, scheduler_);
+    if (splat_history_.size() == particles_.size()) {
+        for (std::vector<float>* a : {&splat_history_.px, &splat_history_.py, &splat_history_.pz}) {
+            apply_morton_order(morton_, *a, scheduler_);
+        }
+    }
+    // The list's reference positions and the grid's slot -> particle map use the old indices.
+    neighbor_list_.clear();
+    grid_current_ = false;
+    steps_since_reorder_ = 0;
+    stats_.reorder_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FluidExperiment::update_neighbors() {
+    float h = settings_.kernel_radius;
+    if (h <= 0.0f) h = 0.01f;
+
+    use_neighbor_list_ = settings_.neighbor_mode == NeighborMode::VerletList;
+    if (!use_neighbor_list_) {
+        neighbor_list_.clear();
+        // The last GridGather splat may have built this grid already; the step then moves the particles.
+        if (!grid_current_) build_neighbor_grid(grid_, volume_config_, particles_, h, scheduler_);
+        grid_current_ = false;
+        return;
+    }
+    grid_current_ = false;
+
+    // The grid is built with cells of the list cutoff so the 27-cell block covers h + skin. While
+    // the list holds, only the gathered slot data is refreshed; slot order stays as built.
+    const float skin = std::max(0.0f, settings_.verlet_skin) * h;
+    if (neighbor_list_expired(neighbor_list_, particles_, h, skin, scheduler_)) {
+        build_neighbor_grid(grid_, volume_config_, particles_, h + skin, scheduler_);
+        build_neighbor_list(neighbor_list_, grid_, particles_, h, skin, active_kernels(), scheduler_);
+        stats_.neighbor_list_age = 0;
+    } else {
+        gather_neighbor_grid(grid_, particles_, scheduler_);
+        ++stats_.neighbor_list_age;
+    }
 }
 
 void FluidExperiment::rebuild_volume() {
     volume_.resize(volume_config_);
     volume_.clear();
+    splat_history_.clear();
 }
 
 void FluidExperiment::reseed_particles() {
+    neighbor_list_.clear();
+    grid_current_ = false;
+    splat_history_.clear();
+    steps_since_reorder_ = settings_.reorder_interval;  // Sort the fresh random layout on the next step.
     particles_.clear();
     particles_.resize(settings_.particle_count);
     densities_.assign(particles_.size(), 0.0f);
@@ -263,11 +382,13 @@ void FluidExperiment::reseed_particles() {
     std::uniform_real_distribution<float> dist_z(0.1f * ext.z, 0.9f * ext.z);
     std::uniform_real_distribution<float> dist_v(-1.5f, 1.5f);
 
-    for (auto& p : particles_) {
+    for (size_t i = 0; i < particles_.size(); ++i) {
+        Particle p{};
         p.position = {dist_x(rng), dist_y(rng), dist_z(rng)};
         p.velocity = {dist_v(rng), dist_v(rng) * 0.5f, dist_v(rng)};
         p.radius = settings_.kernel_radius;
         p.mass = 1.0f;
+        particles_.set_particle(i, p);
     }
 }
 
@@ -282,51 +403,48 @@ void FluidExperiment::integrate_particles(float dt, const NeighborGrid& grid) {
     float h = settings_.kernel_radius;
     if (h <= 0.0f) h = 0.01f;
 
-    std::vector<Vec3> forces(n, Vec3{0.0f, 0.0f, 0.0f});
+    const SphKernels& kernels = active_kernels();
+    const SphNeighborData data = neighbor_data(grid, cell_densities_, cell_pressures_);
+
+    // Symmetric mode accumulates every pair's force on both particles first; the pass below then
+    // only integrates.
+    const bool symmetric = use_symmetric_pairs();
+    if (symmetric) {
+        for (FloatArray* a : {&cell_ax_, &cell_ay_, &cell_az_}) {
+            a->resize(n + kSphRunPadding);
+        }
+        accumulate_pair_forces(grid, kernels, data, h, kSphViscosity, cell_ax_.data(), cell_ay_.data(), cell_az_.data(),
+                               scheduler_);
+    }
+
+    // Force, integration and bounds fused into one pass in cell order. Neighbor reads come from the
+    // grid's gathered copies, so each particle can be written back in place as soon as its force is
+    // known without racing with other particles' force sums.
+    scheduler_.parallel_for(0, n, [&](size_t s) {
+        SphParticle self{};
+        self.position = grid.position(static_cast<int>(s));
+        self.velocity = grid.velocity(static_cast<int>(s));
+        self.density = cell_densities_[s];
+        self.pressure = cell_pressures_[s];
 
-    parallel_for(0, n, [&](size_t i) {
         Vec3 accel{0.0f, settings_.gravity_y, 0.0f};
-        Vec3 drag{-kViscosity * particles_[i].velocity.x,
-                  -kViscosity * particles_[i].velocity.y,
-                  -kViscosity * particles_[i].velocity.z};
+        Vec3 drag{-kViscosity * self.velocity.x,
+                  -kViscosity * self.velocity.y,
+                  -kViscosity * self.velocity.z};
         accel = accel + drag;
 
-        float rho_i = densities_[i];
-        float p_i = pressures_[i];
-
-        for_each_neighbor(grid, static_cast<int>(i), particles_, h,
-                          [&](int j, const Vec3& rij, float r) {
-                              if (j == static_cast<int>(i) || r <= 0.0f || r >= h) {
-                                  return;
-                              }
-
-                              float rho_j = densities_[j];
-                              if (rho_i <= 0.0f || rho_j <= 0.0f) {
-                                  return;
-                              }
-
-                              float p_j = pressures_[j];
-                              float p_term = (p_i + p_j) * 0.5f;
-                              if (p_term > 0.0f) {
-                                  Vec3 gradW = spiky_gradient(rij, r, h);
-                                  Vec3 f = gradW * (-p_term / (rho_i * rho_j));
-                                  accel = accel + f;
-                              }
-
-                              Vec3 vel_diff = particles_[j].velocity - particles_[i].velocity;
-                              float lap = visc_laplacian(r, h);
-                              if (lap > 0.0f) {
-                                  Vec3 f_visc = vel_diff * (kSphViscosity * lap / rho_j);
-                                  accel = accel + f_visc;
-                              }
-                          });
-
-        forces[i] = accel;
-    });
+        if (symmetric) {
+            accel = accel + Vec3{cell_ax_[s], cell_ay_[s], cell_az_[s]};
+        } else if (use_neighbor_list_) {
+            const int slot = static_cast<int>(s);
+            accel = accel + kernels.force_list(data, neighbor_list_.slots(slot), neighbor_list_.count(slot), self, h,
+                                               kSphViscosity);
+        } else {
+            for_each_neighbor_run(grid, self.position, [&](int begin, int end) {
+                accel = accel + kernels.force(data, begin, end, self, h, kSphViscosity);
+            });
+        }
 
-    // Integrate and handle bounds.
-    for (size_t i = 0; i < n; ++i) {
-        Vec3 accel = forces[i];
         float a_len = length(accel);
         if (!std::isfinite(a_len) || a_len <= 0.0f) {
             accel = {0.0f, 0.0f, 0.0f};
@@ -334,40 +452,42 @@ void FluidExperiment::integrate_particles(float dt, const NeighborGrid& grid) {
             accel = accel * (kMaxAccel / a_len);
         }
 
-        particles_[i].velocity = particles_[i].velocity + accel * dt;
+        Vec3 velocity = self.velocity + accel * dt;
 
-        float v_len = length(particles_[i].velocity);
+        float v_len = length(velocity);
         if (!std::isfinite(v_len) || v_len <= 0.0f) {
-            particles_[i].velocity = {0.0f, 0.0f, 0.0f};
+            velocity = {0.0f, 0.0f, 0.0f};
         } else if (v_len > kMaxSpeed) {
-            particles_[i].velocity = particles_[i].velocity * (kMaxSpeed / v_len);
+            velocity = velocity * (kMaxSpeed / v_len);
         }
 
-        particles_[i].position = particles_[i].position + particles_[i].velocity * dt;
+        Vec3 position = self.position + velocity * dt;
 
-        auto& p = particles_[i];
-        if (p.position.x < min_bound.x) {
-            p.position.x = min_bound.x;
-            p.velocity.x = -p.velocity.x * kBounceDamping;
-        } else if (p.position.x > max_bound.x) {
-            p.position.x = max_bound.x;
-            p.velocity.x = -p.velocity.x * kBounceDamping;
+        if (position.x < min_bound.x) {
+            position.x = min_bound.x;
+            velocity.x = -velocity.x * kBounceDamping;
+        } else if (position.x > max_bound.x) {
+            position.x = max_bound.x;
+            velocity.x = -velocity.x * kBounceDamping;
         }
-        if (p.position.y < floor_y) {
-            p.position.y = floor_y;
-            p.velocity.y = -p.velocity.y * kBounceDamping;
-        } else if (p.position.y > max_bound.y) {
-            p.position.y = max_bound.y;
-            p.velocity.y = -p.velocity.y * kBounceDamping;
+        if (position.y < floor_y) {
+            position.y = floor_y;
+            velocity.y = -velocity.y * kBounceDamping;
+        } else if (position.y > max_bound.y) {
+            position.y = max_bound.y;
+            velocity.y = -velocity.y * kBounceDamping;
         }
-        if (p.position.z < min_bound.z) {
-            p.position.z = min_bound.z;
-            p.velocity.z = -p.velocity.z * kBounceDamping;
-        } else if (p.position.z > max_bound.z) {
-            p.position.z = max_bound.z;
-            p.velocity.z = -p.velocity.z * kBounceDamping;
+        if (position.z < min_bound.z) {
+            position.z = min_bound.z;
+            velocity.z = -velocity.z * kBounceDamping;
+        } else if (position.z > max_bound.z) {
+            position.z = max_bound.z;
+            velocity.z = -velocity.z * kBounceDamping;
         }
-    }
+        const size_t i = static_cast<size_t>(grid.order[s]);
+        particles_.set_position(i, position);
+        particles_.set_velocity(i, velocity);
+    });
 }
 
 void FluidExperiment::compute_sph_densities(const NeighborGrid& grid) {
@@ -381,73 +501,330 @@ void FluidExperiment::compute_sph_densities(const NeighborGrid& grid) {
     float h = settings_.kernel_radius;
     if (h <= 0.0f) h = 0.01f;
 
-    // Compute per-particle density using poly6 kernel in parallel.
-    parallel_for(0, n, [&](size_t i) {
-        float rho = 0.0f;
-        for_each_neighbor(grid, static_cast<int>(i), particles_, h,
-                          [&](int j, const Vec3& rij, float r) {
-                              (void)rij;
-                              rho += particles_[j].mass * poly6_kernel(r, h);
-                          });
-        densities_[i] = rho;
-    });
-
-    for (size_t i = 0; i < n; ++i) {
-        rest_density_ += densities_[i];
+    // Compute per-particle density using poly6 kernel in parallel, in cell order.
+    cell_densities_.resize(n + kSphRunPadding, 0.0f);
+    cell_pressures_.resize(n + kSphRunPadding, 0.0f);
+    const SphKernels& kernels = active_kernels();
+    const SphNeighborData data = neighbor_data(grid, cell_densities_, cell_pressures_);
+    if (use_symmetric_pairs()) {
+        accumulate_pair_densities(grid, kernels, data, h, cell_densities_.data(), scheduler_);
+        scheduler_.parallel_for(0, n, [&](size_t s) { densities_[grid.order[s]] = cell_densities_[s]; });
+    } else {
+        scheduler_.parallel_for(0, n, [&](size_t s) {
+            const Vec3 pos = grid.position(static_cast<int>(s));
+            float rho = 0.0f;
+            if (use_neighbor_list_) {
+                const int slot = static_cast<int>(s);
+                rho = kernels.density_list(data, neighbor_list_.slots(slot), neighbor_list_.count(slot), pos, h);
+            } else {
+                for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+                    rho += kernels.density(data, begin, end, pos, h);
+                });
+            }
+            cell_densities_[s] = rho;
+            densities_[grid.order[s]] = rho;
+        });
     }
 
+    // Summed in slot order with a fixed chunking so the rest density (and every pressure derived
+    // from it) does not change with the thread count.
+    rest_density_ = scheduler_.parallel_reduce(0, n, 0, 0.0f, [&](size_t begin, size_t end) {
+        float sum = 0.0f;
+        for (size_t s = begin; s < end; ++s) {
+            sum += cell_densities_[s];
+        }
+        return sum;
+    }, std::plus<float>());
+
     rest_density_ /= static_cast<float>(n);
 
     if (rest_density_ <= 0.0f) {
         std::fill(pressures_.begin(), pressures_.end(), 0.0f);
+        std::fill(cell_pressures_.begin(), cell_pressures_.end(), 0.0f);
         return;
     }
 
     // Compute pressures from densities (can be parallel, each index independent).
-    parallel_for(0, n, [&](size_t i) {
-        float rho = densities_[i];
+    scheduler_.parallel_for(0, n, [&](size_t s) {
+        float rho = cell_densities_[s];
         float compression = (rho - rest_density_) / rest_density_;
-        pressures_[i] = (compression > 0.0f)
-                            ? (kPressureStiffness * compression)
-                            : 0.0f;
+        float pressure = (compression > 0.0f)
+                             ? (kPressureStiffness * compression)
+                             : 0.0f;
+        cell_pressures_[s] = pressure;
+        pressures_[grid.order[s]] = pressure;
     });
 }
 
 void FluidExperiment::resplat_density() {
-    volume_.clear();
-    volume_.splat_particles(particles_, settings_.kernel_radius);
+    fit_volume_domain();
+    splat_volume();
+    const auto start = std::chrono::steady_clock::now();
+    if (stats_.density_footprint) {
+        volume_.bound_macrocells(std::numeric_limits<float>::infinity());
+    } else {
+        volume_.update_macrocells();
+    }
+    stats_.macrocell_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    build_distance_field();
+    build_light_volume();
+}
+
+void FluidExperiment::build_distance_field() {
+    if (!settings_.distance_field) {
+        distance_.clear();
+        stats_.distance_ms = 0.0f;
+        stats_.distance_band_voxels = 0;
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    distance_.build(particles_, volume_.config(), distance_field_settings(settings_), distance_scratch_, scheduler_);
+    stats_.distance_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats_.distance_band_voxels = distance_.band_voxel_count();
+}
+
+void FluidExperiment::build_light_volume() {
+    if (!settings_.light_volume) {
+        light_.clear();
+        stats_.light_ms = 0.0f;
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    LightVolumeSettings light{};
+    light.downsample = settings_.light_downsample;
+    light_.build(volume_, light, scheduler_);
+    stats_.light_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool FluidExperiment::fit_volume_domain() {
+    if (!settings_.dynamic_domain || particles_.empty()) return false;
+    struct Bounds {
+        float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::max()};
+        float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                       std::numeric_limits<float>::lowest()};
+        float radius = 0.0f;
+    };
+    const Bounds bounds = scheduler_.parallel_reduce(0, particles_.size(), 0, Bounds{},
+        [&](size_t begin, size_t end) {
+            Bounds r{};
+            for (size_t i = begin; i < end; ++i) {
+                const float p[3] = {particles_.px[i], particles_.py[i], particles_.pz[i]};
+                for (int a = 0; a < 3; ++a) {
+                    r.lo[a] = std::min(r.lo[a], p[a]);
+                    r.hi[a] = std::max(r.hi[a], p[a]);
+                }
+                r.radius = std::max(r.radius, particles_.radius[i]);
+            }
+            return r;
+        },
+        [](const Bounds& a, const Bounds& b) {
+            Bounds r{};
+            for (int i = 0; i < 3; ++i) {
+                r.lo[i] = std::min(a.lo[i], b.lo[i]);
+                r.hi[i] = std::max(a.hi[i], b.hi[i]);
+            }
+            r.radius = std::max(a.radius, b.radius);
+            return r;
+        });
+
+    // Work in container voxels so the domain's voxels coincide with the container's. The footprint
+    // is the union of the particles' splat voxel boxes: nothing outside it gets density.
+    const VolumeConfig& container = volume_config_;
+    const VolumeConfig& current = volume_.config();
+    const float voxel = container.voxel_size;
+    const float influence = std::max(settings_.kernel_radius, bounds.radius);
+    const float container_origin[3] = {container.origin.x, container.origin.y, container.origin.z};
+    const float current_origin[3] = {current.origin.x, current.origin.y, current.origin.z};
+    const int container_dims[3] = {container.dims.x, container.dims.y, container.dims.z};
+    const int current_dims[3] = {current.dims.x, current.dims.y, current.dims.z};
+    const int margin = std::max(0, settings_.domain_margin);
+    const int slack = 2 * margin + kBrickSize;
+    bool keep = true;
+    int lo[3], hi[3];  // New domain in container voxels, [lo, hi).
+    for (int a = 0; a < 3; ++a) {
+        auto to_voxel = [&](float coord) {
+            const float v = std::floor((coord - container_origin[a]) / voxel);
+            return static_cast<int>(std::clamp(v, 0.0f, static_cast<float>(container_dims[a] - 1)));
+        };
+        const int need_lo = to_voxel(bounds.lo[a] - influence);
+        const int need_hi = to_voxel(bounds.hi[a] + influence) + 1;
+        const int cur_lo = static_cast<int>(std::lround((current_origin[a] - container_origin[a]) / voxel));
+        const int cur_hi = cur_lo + current_dims[a];
+        keep = keep && cur_lo <= need_lo && cur_hi >= need_hi && need_lo - cur_lo <= slack && cur_hi - need_hi <= slack;
+        lo[a] = std::max(0, need_lo - margin) & ~(kBrickSize - 1);
+        hi[a] = std::min(container_dims[a], (need_hi + margin + kBrickSize - 1) & ~(kBrickSize - 1));
+    }
+    if (keep) return false;
+
+    VolumeConfig domain = container;
+    domain.origin = {container.origin.x + static_cast<float>(lo[0]) * voxel,
+                     container.origin.y + static_cast<float>(lo[1]) * voxel,
+                     container.origin.z + static_cast<float>(lo[2]) * voxel};
+    domain.dims = {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]};
+    volume_.resize(domain);
+    splat_history_.clear();  // The next splat is a full rebuild into the new domain.
+    ++stats_.domain_refits;
+    return true;
+}
+
+void FluidExperiment::splat_volume() {
+    auto start = std::chrono::steady_clock::now();
+    stats_.density_footprint = footprint_only();
+    if (stats_.density_footprint) {
+        splat_density_footprint(volume_, particles_, settings_.kernel_radius, scheduler_);
+        splat_history_.clear();
+        stats_.splat_particles = 0;
+        stats_.splat_incremental = false;
+        stats_.splat_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return;
+    }
+    const SplatWeightTable* table = splat_weights_.get(settings_.splat_kernel, settings_.kernel_radius);
+    // Delta update while the recorded splat is still valid; the history is cleared whenever the
+    // volume, particle set or kernel changes, which forces the full rebuild below.
+    const bool incremental = settings_.incremental_splat && settings_.splat_mode != SplatMode::Serial;
+    if (incremental && splat_history_.size() == particles_.size() && splat_delta_frames_ < settings_.splat_rebuild_interval) {
+        const float threshold = std::max(0.0f, settings_.splat_move_threshold) * volume_config_.voxel_size;
+        stats_.splat_particles = static_cast<int>(splat_density_delta(volume_, particles_, settings_.kernel_radius, table,
+                                                                      threshold, splat_history_, splat_scratch_, scheduler_));
+        stats_.splat_incremental = true;
+        ++splat_delta_frames_;
+        stats_.splat_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return;
+    }
+
+    const bool automatic = settings_.splat_mode == SplatMode::Auto;
+    const SplatMode mode = automatic ? pick_splat_mode() : settings_.splat_mode;
+    switch (mode) {
+    case SplatMode::SlabScatter:
+        splat_density_slabs(volume_, particles_, settings_.kernel_radius, table, splat_scratch_, scheduler_);
+        break;
+    case SplatMode::GridGather: {
+        // When no particle reaches past the kernel radius, the splat grid is the next SPH grid-mode
+        // step's neighbor grid: build it in grid_ and let update_neighbors reuse it.
+        const float influence = splat_influence(particles_, settings_.kernel_radius);
+        const bool share = influence == settings_.kernel_radius && settings_.kernel_radius > 0.0f &&
+                           settings_.solver == SolverType::Sph && settings_.neighbor_mode == NeighborMode::Grid;
+        NeighborGrid& grid = share ? grid_ : splat_grid_;
+        if (!share || !grid_current_) build_neighbor_grid(grid, volume_config_, particles_, influence, scheduler_);
+        grid_current_ = share;
+        splat_density_gather(volume_, grid, particles_, settings_.kernel_radius, table, scheduler_);
+        break;
+    }
+    default:
+        volume_.clear();
+        volume_.splat_particles(particles_, settings_.kernel_radius);
+        break;
+    }
+    if (incremental) {
+        splat_history_.record(particles_);
+        splat_delta_frames_ = 0;
+    } else {
+        splat_history_.clear();
+    }
+    stats_.splat_particles = static_cast<int>(particles_.size());
+    stats_.splat_incremental = false;
+    stats_.splat_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats_.splat_mode = mode;
+    if (automatic) {
+        if (splat_trials_ < 2 * kSplatTrials) {
+            float& best = splat_best_ms_[mode == SplatMode::GridGather ? 1 : 0];
+            best = splat_trials_ < 2 ? stats_.splat_ms : std::min(best, stats_.splat_ms);
+        }
+        ++splat_trials_;
+    }
+}
+
+SplatMode FluidExperiment::pick_splat_mode() {
+    const Int3 dims = volume_.config().dims;
+    const Int3& calibrated = splat_calibrated_dims_;
+    if (dims.x != calibrated.x || dims.y != calibrated.y || dims.z != calibrated.z ||
+        particles_.size() != splat_calibrated_particles_ || scheduler_.thread_count() != splat_calibrated_threads_ ||
+        splat_trials_ >= 2 * kSplatTrials + kSplatRecalibrateInterval) {
+        splat_calibrated_dims_ = dims;
+        splat_calibrated_particles_ = particles_.size();
+        splat_calibrated_threads_ = scheduler_.thread_count();
+        splat_trials_ = 0;
+    }
+    // Alternate the two strategies while calibrating, then keep the faster one.
+    if (splat_trials_ < 2 * kSplatTrials) {
+        return (splat_trials_ % 2) == 0 ? SplatMode::SlabScatter : SplatMode::GridGather;
+    }
+    return splat_best_ms_[1] < splat_best_ms_[0] ? SplatMode::GridGather : SplatMode::SlabScatter;
 }
 
 void FluidExperiment::compute_stats() {
     stats_.particle_count = static_cast<int>(particles_.size());
+    stats_.thread_count = static_cast<int>(scheduler_.thread_count());
+    stats_.simd_width = active_kernels().width;
     stats_.max_density = 0.0f;
     stats_.avg_density = 0.0f;
     stats_.max_speed = 0.0f;
     stats_.avg_speed = 0.0f;
     stats_.avg_height = 0.0f;
-    if (volume().density().empty()) return;
-
-    float accum = 0.0f;
-    for (float d : volume().density()) {
-        stats_.max_density = std::max(stats_.max_density, d);
-        accum += d;
-    }
-    stats_.avg_density = accum / static_cast<float>(volume().density().size());
+    stats_.occupied_bricks = static_cast<int>(volume_.allocated_bricks());
+    stats_.total_bricks = volume_.brick_count();
+    stats_.volume_bytes = volume_.memory_bytes();
+    stats_.empty_macrocells = static_cast<int>(std::count_if(volume_.macrocells().begin(), volume_.macrocells().end(),
+                                                             [](const MacrocellRange& cell) { return cell.max <= 0.0f; }));
+    stats_.total_macrocells = static_cast<int>(volume_.macrocells().size());
+    stats_.domain_dims = volume_.config().dims;
+    if (volume_.brick_count() == 0) return;
+
+    // Deterministic parallel reductions (fixed chunks folded in order), see parallel_reduce. Only
+    // allocated bricks hold density; padding voxels past the volume edge stay 0. The average is over
+    // the container, so it does not depend on the dynamic domain.
+    stats_bricks_.clear();
+    volume_.for_each_brick([&](int brick) { stats_bricks_.push_back(brick); });
+    MaxSum dens = scheduler_.parallel_reduce(0, stats_bricks_.size(), 0, MaxSum{}, [&](size_t begin, size_t end) {
+        MaxSum r{};
+        for (size_t b = begin; b < end; ++b) {
+            const float* data = volume_.brick_data(stats_bricks_[b]);
+            for (int i = 0; i < kBrickVoxels; ++i) {
+                r.max = std::max(r.max, data[i]);
+                r.sum += data[i];
+            }
+        }
+        return r;
+    }, combine_max_sum);
+    const Int3 dims = volume_config_.dims;
+    stats_.max_density = dens.max;
+    stats_.avg_density = dens.sum / (static_cast<float>(dims.x) * static_cast<float>(dims.y) * static_cast<float>(dims.z));
 
     if (!particles_.empty()) {
-        float speed_accum = 0.0f;
-        float height_accum = 0.0f;
-        for (const auto& p : particles_) {
-            float s = length(p.velocity);
-            stats_.max_speed = std::max(stats_.max_speed, s);
-            speed_accum += s;
-            height_accum += p.position.y;
-        }
-        stats_.avg_speed = speed_accum / static_cast<float>(particles_.size());
-        stats_.avg_height = height_accum / static_cast<float>(particles_.size());
+        struct MotionSums {
+            MaxSum speed{};
+            float height = 0.0f;
+        };
+        MotionSums motion = scheduler_.parallel_reduce(0, particles_.size(), 0, MotionSums{},
+            [&](size_t begin, size_t end) {
+                MotionSums r{};
+                for (size_t i = begin; i < end; ++i) {
+                    float s = length(particles_.velocity(i));
+                    r.speed.max = std::max(r.speed.max, s);
+                    r.speed.sum += s;
+                    r.height += particles_.py[i];
+                }
+                return r;
+            },
+            [](const MotionSums& a, const MotionSums& b) {
+                return MotionSums{combine_max_sum(a.speed, b.speed), a.height + b.height};
+            });
+        stats_.max_speed = motion.speed.max;
+        stats_.avg_speed = motion.speed.sum / static_cast<float>(particles_.size());
+        stats_.avg_height = motion.height / static_cast<float>(particles_.size());
     }
 }
 
+bool FluidExperiment::use_symmetric_pairs() const {
+    // Pairs are enumerated from grid cells, so Verlet list mode keeps the per-particle gather.
+    return settings_.symmetric_pairs && !use_neighbor_list_;
+}
+
+const SphKernels& FluidExperiment::active_kernels() const {
+    return settings_.use_simd ? best_sph_kernels() : sph_kernels(SimdLevel::Scalar);
+}
+
 Vec3 FluidExperiment::volume_extent() const {
     return {
         static_cast<float>(volume_config_.dims.x) * volume_config_.voxel_size,
@@ -2,16 +2,101 @@
 
 #include <vector>
 
+#include "density_format.h"
+#include "density_splat.h"
+#include "distance_field.h"
 #include "fluid_sim.h"
+#include "light_volume.h"
+#include "morton_order.h"
+#include "neighbor_grid.h"
+#include "neighbor_list.h"
+#include "pbf_solver.h"
+#include "sph_kernels.h"
+#include "task_scheduler.h"
 
 namespace rayol::fluid {
 
+enum class NeighborMode {
+    Grid,        // Rebuild the cell grid every step and scan its 27-cell block per particle.
+    VerletList,  // Cached per-particle lists within kernel radius + skin, rebuilt when stale.
+};
+
+enum class SolverType {
+    Sph,  // Explicit pressure SPH with the stiffness/clamp heuristics; needs small steps.
+    Pbf,  // Position-based fluids: density constraints projected in Jacobi iterations.
+};
+
 struct FluidSettings {
     int particle_count = 512;
     float kernel_radius = 0.06f;
     float voxel_size = 0.02f;
     float gravity_y = -9.8f;
     bool paused = false;
+    int thread_count = 0;  // Sim worker threads including the caller; 0 = hardware concurrency.
+    bool use_simd = true;  // SSE/AVX2 SPH kernels when the CPU supports them; scalar otherwise.
+    SolverType solver = SolverType::Sph;
+    int pbf_iterations = 4;       // Jacobi iterations per PBF step.
+    // CFL number used instead of cfl_number while the PBF solver runs. Above ~0.7 particles cross
+    // most of a kernel radius per step and the projection starts missing collisions.
+    float pbf_cfl_number = 0.6f;
+    NeighborMode neighbor_mode = NeighborMode::Grid;  // SPH solver only; PBF always uses the grid.
+    // Verlet list margin as a fraction of kernel_radius. A list holds until some particle moved skin / 2,
+    // so list mode caps the substep CFL number at skin / 8 for each list to last about four substeps.
+    float verlet_skin = 0.3f;
+    bool symmetric_pairs = false;  // SPH grid mode: visit each pair once (half stencil) and apply both sides.
+    int reorder_interval = 16;  // Steps between Morton (Z-order) particle reorders; 0 = never.
+    // Adaptive substepping: each update(dt) runs equal substeps no longer than
+    // cfl_number * kernel_radius / max speed; 0 = one step of the raw frame dt.
+    float cfl_number = 0.4f;
+    int max_substeps = 8;          // Frames needing more are simulated in slow motion instead.
+    float frame_budget_ms = 12.0f;  // Stop substepping once a frame's sim work would exceed this; 0 = no limit.
+    SplatMode splat_mode = SplatMode::Auto;  // How the CPU density volume is rebuilt each frame.
+    SplatKernel splat_kernel = SplatKernel::Poly6;  // Parallel splats only; Serial is always exact poly6.
+    // Incremental splat (not in Serial mode): between full rebuilds, only particles that moved more
+    // than splat_move_threshold voxels since their last splat are subtracted and re-added.
+    bool incremental_splat = false;
+    float splat_move_threshold = 0.1f;
+    int splat_rebuild_interval = 60;  // Incremental frames between full rebuilds (bounds float drift).
+    VoxelLayout voxel_layout = VoxelLayout::Linear;  // Voxel order inside the density volume's bricks.
+    // Dynamic domain: the density volume covers only the particles' splat footprint, snapped to bricks
+    // with domain_margin voxels of slack, instead of the whole container. It is refit when the
+    // footprint leaves it or a side has more than 2 * domain_margin + one brick of slack.
+    bool dynamic_domain = false;
+    int domain_margin = 4;
+    // Narrow-band particle SDF rebuilt after every resplat over the density volume's box: a smooth
+    // union of spheres of sdf_radius * kernel_radius, blended over sdf_smoothing * that radius, exact
+    // within sdf_band voxels. The renderer sphere-traces it for the surface instead of searching the
+    // density iso level.
+    bool distance_field = false;
+    float sdf_radius = 0.5f;
+    float sdf_smoothing = 0.3f;
+    float sdf_band = 3.0f;
+    // Build the field in the renderer's compute pass instead of uploading the CPU one (needs float
+    // atomics; the CPU field is still built for the UI stats and benchmarks).
+    bool gpu_distance_field = false;
+    // Texel format the renderer uploads the density volume in (the CPU volume stays float).
+    DensityFormat density_format = DensityFormat::Float32;
+    // Splat the density image in the renderer's compute pass from the particles (32 bytes each)
+    // instead of uploading the CPU volume's bricks; the image is then R32F whatever density_format
+    // says. Needs float image atomics; devices without them upload. Checked once against the CPU splat
+    // per kernel; a mismatch falls back to the upload. Unless the light volume needs CPU density, the
+    // sim then skips its splat: the volume only holds the footprint (FluidStats::density_footprint).
+    bool gpu_splat = false;
+    // Light volume rebuilt after every resplat: optical depth toward the default light (LightVolumeSettings)
+    // on a grid light_downsample times coarser than the density, so the marchers shadow the light with
+    // one lookup per step.
+    bool light_volume = false;
+    int light_downsample = 2;
+    // Sweep the light volume in the renderer's compute pass from the density image instead of
+    // uploading the CPU one (which is still built for the UI stats and benchmarks).
+    bool gpu_light_volume = false;
+    // Draw with adaptive steps (AdaptiveStepSettings defaults): long steps through empty space and thin
+    // or hidden fog, bisection back to surface crossings. frame_step_budget caps the density samples of
+    // a frame, in millions over all pixels (0 = unlimited). Read by the renderer only.
+    bool adaptive_steps = false;
+    int frame_step_budget = 0;
+
+    bool operator==(const FluidSettings&) const = default;
 };
 
 struct FluidStats {
@@ -21,19 +106,56 @@ struct FluidStats {
     float max_speed = 0.0f;
     float avg_speed = 0.0f;
     float avg_height = 0.0f;
+    float step_ms = 0.0f;  // Wall time of the last update() (neighbor search, SPH, splat, stats).
+    int thread_count = 0;
+    int simd_width = 1;  // Lanes of the SPH kernels in use (1 = scalar).
+    int neighbor_list_age = 0;  // Steps since the Verlet list was rebuilt (0 = rebuilt this step).
+    float reorder_ms = 0.0f;    // Cost of the last Morton reorder.
+    int substeps = 0;            // Substeps run by the last update().
+    float substep_dt = 0.0f;     // Seconds per substep in the last update().
+    float sim_time_ratio = 1.0f;  // Simulated / requested time of the last update() (< 1 = slow motion).
+    double sim_time = 0.0;       // Simulated seconds since the last reset.
+    float splat_ms = 0.0f;       // Cost of the last density resplat.
+    float macrocell_ms = 0.0f;   // Cost of the macrocell update after it.
+    SplatMode splat_mode = SplatMode::Serial;  // Strategy the last resplat used (Auto resolved).
+    int splat_particles = 0;     // Particles the last resplat splatted (all of them unless incremental).
+    bool splat_incremental = false;  // The last resplat was a delta update.
+    int occupied_bricks = 0;     // Allocated 8^3 bricks of the density volume.
+    int total_bricks = 0;        // Bricks covering the whole volume.
+    size_t volume_bytes = 0;     // Memory held by the sparse volume.
+    int empty_macrocells = 0;    // 4^3 macrocells ray marchers skip.
+    int total_macrocells = 0;
+    Int3 domain_dims{};          // Voxels of the density volume (the container unless dynamic_domain).
+    int domain_refits = 0;       // Dynamic-domain refits since the last reset.
+    float distance_ms = 0.0f;    // Cost of the last distance field build (0 when off).
+    int distance_band_voxels = 0;  // Voxels the last build evaluated from the particles.
+    float light_ms = 0.0f;       // Cost of the last light volume build (0 when off).
+    // gpu_splat: the last resplat only allocated the touched bricks (left zero) and bounded the
+    // macrocells; the density is splatted by the renderer, and max/avg_density read 0.
+    bool density_footprint = false;
 };
 
-// Simple uniform grid to accelerate SPH neighbor queries.
-struct NeighborGrid {
-    Int3 dims{};
-    Vec3 origin{};
-    float cell_size = 0.0f;
-    // For each cell, head index into a singly-linked list of particles (-1 for empty).
-    std::vector<int> cell_heads;
-    // For each particle, index of the next particle in the same cell (-1 for end).
-    std::vector<int> next;
+// Non-owning view of one finished sim state: everything the renderer and UI read per frame. Comes
+// from FluidExperiment::frame() or from a snapshot published by AsyncFluidSim.
+struct FluidFrameView {
+    const FluidSettings* settings = nullptr;
+    const FluidStats* stats = nullptr;
+    const DensityVolume* volume = nullptr;
+    const ParticleStore* particles = nullptr;
+    const DistanceVolume* distance = nullptr;  // Null unless FluidSettings::distance_field.
+    const LightVolume* light = nullptr;        // Null unless FluidSettings::light_volume.
+
+    bool valid() const { return settings && stats && volume && particles; }
+    Vec3 extent() const {
+        const VolumeConfig& cfg = volume->config();
+        return {static_cast<float>(cfg.dims.x) * cfg.voxel_size, static_cast<float>(cfg.dims.y) * cfg.voxel_size,
+                static_cast<float>(cfg.dims.z) * cfg.voxel_size};
+    }
 };
 
+// Distance field parameters in world units for the settings' kernel radius and voxel size.
+DistanceFieldSettings distance_field_settings(const FluidSettings& settings);
+
 // Lightweight CPU-only prototype of the fluid sim: integrates particles, bounces off bounds, and
 // splats into a density volume. Acts as a driver for the shader-based version.
 class FluidExperiment {
@@ -44,32 +166,96 @@ public:
     void configure(const FluidSettings& settings);
     // Re-seed particles and clear density.
     void reset();
-    // Step simulation and recompute density/stats if enabled.
+    // Advance the simulation by up to dt seconds in CFL-limited substeps, then recompute
+    // density/stats once. Time the substep or budget limits cannot cover is dropped. With dt <= 0
+    // nothing is stepped, and density/stats are only recomputed if configure() changed the settings.
     void update(float dt);
 
     const FluidSettings& settings() const { return settings_; }
     const FluidStats& stats() const { return stats_; }
     const DensityVolume& volume() const { return volume_; }
-    const std::vector<Particle>& particles() const { return particles_; }
+    const ParticleStore& particles() const { return particles_; }
+    const DistanceVolume& distance() const { return distance_; }
+    const LightVolume& light() const { return light_; }
+    FluidFrameView frame() const {
+        return {&settings_, &stats_, &volume_, &particles_, settings_.distance_field ? &distance_ : nullptr,
+                settings_.light_volume ? &light_ : nullptr};
+    }
 
+    // Size of the container (volume_config_); the density volume's own box is frame().extent().
     Vec3 volume_extent() const;
 
 private:
     void rebuild_volume();
     void reseed_particles();
+    void reorder_particles();
+    void step(float dt);
+    void step_pbf(float dt);
+    float stable_timestep() const;
+    void update_neighbors();
     void integrate_particles(float dt, const NeighborGrid& grid);
     void compute_sph_densities(const NeighborGrid& grid);
+    // Fit the domain (dynamic_domain), splat, bring the volume's macrocells up to date, then rebuild
+    // the distance field and the light volume.
     void resplat_density();
+    // Rebuild distance_ over volume_'s box (distance_field), or release it.
+    void build_distance_field();
+    // Rebuild light_ from volume_ (light_volume), or release it.
+    void build_light_volume();
+    // Move/resize volume_ around the particles when they left it or it grew too loose; true if it did.
+    bool fit_volume_domain();
+    void splat_volume();
+    // gpu_splat leaves the CPU splat to the renderer unless the light volume reads the density.
+    bool footprint_only() const { return settings_.gpu_splat && !settings_.light_volume; }
+    SplatMode pick_splat_mode();
     void compute_stats();
+    bool use_symmetric_pairs() const;
+    const SphKernels& active_kernels() const;
 
     FluidSettings settings_{};
+    bool settings_changed_ = false;  // configure() changed settings_ since the last resplat in update().
     FluidStats stats_{};
-    VolumeConfig volume_config_{};
-    DensityVolume volume_{};
-    std::vector<Particle> particles_;
+    TaskScheduler scheduler_;
+    VolumeConfig volume_config_{};  // The container: particle bounds, neighbor grids, seeding.
+    DensityVolume volume_{};        // Spans volume_config_, or a brick-snapped part of it (dynamic_domain).
+    ParticleStore particles_;
     std::vector<float> densities_;
     std::vector<float> pressures_;
+    NeighborGrid grid_{};
+    // grid_ was built with cells of kernel_radius on the current particles (by a GridGather splat), so
+    // the next grid-mode step skips its rebuild. Cleared whenever particles move or are reordered.
+    bool grid_current_ = false;
+    NeighborList neighbor_list_{};
+    bool use_neighbor_list_ = false;  // The current step reads neighbor_list_ instead of grid runs.
+    // Densities/pressures in grid (cell) order, read by the force pass's linear neighbor scans.
+    FloatArray cell_densities_;
+    FloatArray cell_pressures_;
+    // Symmetric pair mode: SPH acceleration per sorted slot, accumulated from both sides of each pair.
+    FloatArray cell_ax_, cell_ay_, cell_az_;
     float rest_density_ = 0.0f;
+    PbfSolver pbf_{};
+    // Positions at the start of the PBF step (particle order); velocities come from the displacement.
+    FloatArray pbf_prev_px_, pbf_prev_py_, pbf_prev_pz_;
+    SplatScratch splat_scratch_{};
+    SplatWeightCache splat_weights_{};
+    // GridGather grid (cell = splat support) when it cannot share grid_: wider particles, PBF or list mode.
+    NeighborGrid splat_grid_{};
+    // SplatMode::Auto: best time of SlabScatter / GridGather over the trial resplats since the
+    // volume, particle count or thread count last changed.
+    Int3 splat_calibrated_dims_{};
+    size_t splat_calibrated_particles_ = 0;
+    size_t splat_calibrated_threads_ = 0;
+    int splat_trials_ = 0;
+    float splat_best_ms_[2] = {0.0f, 0.0f};
+    // Incremental splat: positions of the splat in volume_ and frames since it was fully rebuilt.
+    SplatHistory splat_history_{};
+    int splat_delta_frames_ = 0;
+    DistanceVolume distance_{};
+    DistanceScratch distance_scratch_{};
+    LightVolume light_{};
+    std::vector<int> stats_bricks_;  // Allocated brick ids, gathered for the density reduction.
+    MortonOrder morton_{};
+    int steps_since_reorder_ = 0;
 };
 
 }  // namespace rayol::fluid
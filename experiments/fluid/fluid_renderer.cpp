@@ -7,6 +7,8 @@
 #include <cstring>
 #include <string>
 
+#include "density_splat.h"
+
 namespace rayol::fluid {
 
 namespace {
@@ -17,15 +19,49 @@ const char* kShaderDir = "../shaders/fluid/";
 #endif
 const char* kShaderDirFallback = "shaders/fluid/";
 const char* kParticleSplatComp = "particle_splat.comp.spv";
+const char* kDistanceFieldComp = "distance_field.comp.spv";
+const char* kLightVolumeComp = "light_volume.comp.spv";
 const char* kVolumeRaymarchFrag = "volume_raymarch.frag.spv";
 const char* kFullscreenVert = "fullscreen_uv.vert.spv";
 
+// std430 push-constant layout of particle_splat.comp (a vec3 is followed directly by a scalar).
 struct ComputePush {
     float origin[3];
     float voxel_size;
+    int dims[3];
     float kernel_radius;
+    uint32_t particle_count;
+    uint32_t kernel_mode;  // 0 = exact poly6, 1 = poly6 table, 2 = separable Gaussian table
+    float table_inv_step;
+    uint32_t table_size;
+};
+
+// Largest voxel difference from the CPU splat, relative to its peak, the GPU splat may show when
+// validated. Float atomics only reorder the sums, so anything near this is a broken kernel, not rounding.
+constexpr float kGpuSplatTolerance = 1e-3f;
+
+// std430 push-constant layout of distance_field.comp.
+struct DistancePush {
+    float origin[3];
+    float voxel_size;
     int dims[3];
+    float particle_radius;
     uint32_t particle_count;
+    float smoothing;
+    float band;
+    uint32_t pass;  // 0 = scatter, 1 = resolve, 2 = jump, 3 = extend
+    int jump;
+    uint32_t read_b;  // Current jump-flood seeds are in seed image 1
+};
+
+// std430 push-constant layout of light_volume.comp.
+struct LightPush {
+    int dims[3];
+    int axis;
+    float upstream[3];
+    int slice;
+    float step_length;
+    int first_slice;
 };
 
 struct GraphicsPush {
@@ -33,15 +69,33 @@ struct GraphicsPush {
     float volume_extent[4];        // xyz extent, w = density scale
     float light_dir_absorb[4];     // xyz dir, w = absorption
     float light_color_ambient[4];  // xyz color, w = ambient
-    float camera_pos[4];           // xyz position, w unused
+    float camera_pos[4];           // xyz position, w = 1: sphere-trace the distance field
     float camera_forward[4];       // xyz forward, w = tan(fov/2)
     float camera_right[4];         // xyz right, w = aspect
     float max_distance;
     uint32_t frame_index;
-    uint32_t padding[2];
+    float macrocell_size;  // World size of a macrocell texel
+    uint32_t flags;        // kDraw* bits; bits 8-31 = adaptive sample budget per ray and pass (0 = unlimited)
 };
 
+constexpr uint32_t kDrawUseMacrocells = 1u;     // Skip with the macrocells (else march every step).
+constexpr uint32_t kDrawUseLightVolume = 2u;    // Shadow the light with the light volume.
+constexpr uint32_t kDrawUseAdaptiveSteps = 4u;  // Adaptive step lengths (AdaptiveStepSettings defaults).
+constexpr int kDrawBudgetShift = 8;
+
 constexpr VkDeviceSize kParticleStride = sizeof(float) * 8;  // matches shader struct (vec4 + vec4)
+
+VkFormat vk_density_format(DensityFormat format) {
+    switch (format) {
+    case DensityFormat::Float16:
+        return VK_FORMAT_R16_SFLOAT;
+    case DensityFormat::Unorm16:
+        return VK_FORMAT_R16_UNORM;
+    case DensityFormat::Float32:
+        break;
+    }
+    return VK_FORMAT_R32_SFLOAT;
+}
 }  // namespace
 
 bool FluidRenderer::init(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, VkQueue queue,
@@ -74,13 +128,53 @@ void FluidRenderer::on_swapchain_recreated(VkRenderPass render_pass, VkExtent2D
 
 void FluidRenderer::cleanup() {
     destroy_pipelines();
-    destroy_buffer(particle_buffer_);
+    for (Buffer& particles : particle_buffers_) {
+        destroy_buffer(particles);
+    }
+    for (Buffer& staging : cpu_staging_) {
+        destroy_buffer(staging);
+    }
+    destroy_buffer(splat_table_buffer_);
+    splat_table_radius_ = -1.0f;
+    splat_check_ = {};
     destroy_image(density_image_);
     density_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
     if (density_sampler_ != VK_NULL_HANDLE) {
         vkDestroySampler(device_, density_sampler_, nullptr);
         density_sampler_ = VK_NULL_HANDLE;
     }
+    destroy_image(macrocell_image_);
+    macrocell_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (macrocell_sampler_ != VK_NULL_HANDLE) {
+        vkDestroySampler(device_, macrocell_sampler_, nullptr);
+        macrocell_sampler_ = VK_NULL_HANDLE;
+    }
+    for (Buffer& staging : macrocell_staging_) {
+        destroy_buffer(staging);
+    }
+    uploaded_macrocell_storage_id_ = 0;
+    destroy_image(distance_image_);
+    distance_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (distance_sampler_ != VK_NULL_HANDLE) {
+        vkDestroySampler(device_, distance_sampler_, nullptr);
+        distance_sampler_ = VK_NULL_HANDLE;
+    }
+    for (Buffer& staging : distance_staging_) {
+        destroy_buffer(staging);
+    }
+    destroy_image(seed_images_[0]);
+    destroy_image(seed_images_[1]);
+    uploaded_distance_revision_ = 0;
+    destroy_image(light_image_);
+    light_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (light_sampler_ != VK_NULL_HANDLE) {
+        vkDestroySampler(device_, light_sampler_, nullptr);
+        light_sampler_ = VK_NULL_HANDLE;
+    }
+    for (Buffer& staging : light_staging_) {
+        destroy_buffer(staging);
+    }
+    uploaded_light_revision_ = 0;
     destroy_image(noise_image_);
     noise_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
     if (noise_sampler_ != VK_NULL_HANDLE) {
@@ -90,28 +184,47 @@ void FluidRenderer::cleanup() {
 }
 
 bool FluidRenderer::init_pipelines() {
-    bool ok = create_compute_pipeline();
-    if (!ok) {
+    // The GPU splat needs float image atomics; without them the CPU volume is uploaded.
+    if (atomic_float_supported_ && !create_compute_pipeline()) {
         std::cerr << "[fluid] compute pipeline creation failed.\n";
     }
     bool gok = create_graphics_pipeline();
     if (!gok) {
         std::cerr << "[fluid] graphics pipeline creation failed.\n";
     }
-    return ok && gok;
+    if (!create_distance_pipeline()) {
+        std::cerr << "[fluid] distance field pipeline creation failed; the CPU field is uploaded instead.\n";
+    }
+    if (!create_light_pipeline()) {
+        std::cerr << "[fluid] light volume pipeline creation failed; the CPU light volume is uploaded instead.\n";
+    }
+    return gok;
 }
 
 bool FluidRenderer::ensure_particle_buffer(size_t count) {
     VkDeviceSize needed = static_cast<VkDeviceSize>(count) * kParticleStride;
-    if (particle_buffer_.handle != VK_NULL_HANDLE && needed <= particle_buffer_.size) {
+    // This slot's last dispatch has completed (its fence was waited), so it can be replaced right away.
+    Buffer& particles = particle_buffers_[frame_slot_];
+    if (particles.handle != VK_NULL_HANDLE && needed <= particles.size) {
         return true;
     }
-    destroy_buffer(particle_buffer_);
+    destroy_buffer(particles);
     return create_buffer(needed, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, particle_buffer_);
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, particles);
+}
+
+bool FluidRenderer::density_format_supported(DensityFormat format) const {
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(physical_device_, vk_density_format(format), &props);
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (props.optimalTilingFeatures & needed) == needed;
 }
 
-bool FluidRenderer::ensure_density_image(const VolumeConfig& cfg) {
+bool FluidRenderer::ensure_density_image(const VolumeConfig& cfg, DensityFormat format) {
+    if (format != DensityFormat::Float32 && !density_format_supported(format)) {
+        log_once("[fluid] 16-bit density format not filterable on this device; using R32F.", warned_density_format_);
+        format = DensityFormat::Float32;
+    }
     VkExtent3D extent{
         static_cast<uint32_t>(cfg.dims.x),
         static_cast<uint32_t>(cfg.dims.y),
@@ -120,7 +233,7 @@ bool FluidRenderer::ensure_density_image(const VolumeConfig& cfg) {
     if (density_image_.handle != VK_NULL_HANDLE &&
         density_image_.extent.width == extent.width &&
         density_image_.extent.height == extent.height &&
-        density_image_.extent.depth == extent.depth) {
+        density_image_.extent.depth == extent.depth && density_format_ == format) {
         if (density_image_.view == VK_NULL_HANDLE) {
             std::cerr << "[fluid] density image exists but view is null; recreating.\n";
             destroy_image(density_image_);
@@ -129,22 +242,123 @@ bool FluidRenderer::ensure_density_image(const VolumeConfig& cfg) {
             return true;
         }
     }
+    if (density_image_.handle != VK_NULL_HANDLE) {
+        // Resized volume (voxel size or dynamic domain) or new format: frames in flight may still sample
+        // the old image.
+        vkDeviceWaitIdle(device_);
+    }
     destroy_image(density_image_);
     density_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    uploaded_storage_id_ = 0;  // New image contents are undefined.
+    uploaded_macrocell_range_ = 0.0f;  // Macrocells are quantized for the image's format.
     if (density_sampler_ == VK_NULL_HANDLE) {
         if (!create_sampler(VK_FILTER_LINEAR, density_sampler_)) return false;
     }
-    bool ok = create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, VK_FORMAT_R32_SFLOAT,
-                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+    // Only the R32F image is a storage target (particle_splat.comp writes r32f); 16-bit ones are upload-only.
+    density_format_ = format;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (format == DensityFormat::Float32) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    bool ok = create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, vk_density_format(format), usage,
                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, density_image_);
     if (!ok) {
         std::cerr << "[fluid] failed to create density image.\n";
     } else {
-        std::cerr << "[fluid] density image created: " << extent.width << "x" << extent.height << "x" << extent.depth << "\n";
+        std::cerr << "[fluid] density image created: " << extent.width << "x" << extent.height << "x" << extent.depth
+                  << " (" << density_format_bytes(format) * 8 << "-bit)\n";
+    }
+    return ok;
+}
+
+bool FluidRenderer::ensure_macrocell_image(const VolumeConfig& cfg) {
+    auto cells = [](int voxels) { return static_cast<uint32_t>(std::max(1, (voxels + kMacrocellSize - 1) >> kMacrocellShift)); };
+    VkExtent3D extent{cells(cfg.dims.x), cells(cfg.dims.y), cells(cfg.dims.z)};
+    if (macrocell_image_.handle != VK_NULL_HANDLE && macrocell_image_.extent.width == extent.width &&
+        macrocell_image_.extent.height == extent.height && macrocell_image_.extent.depth == extent.depth) {
+        return true;
+    }
+    if (macrocell_image_.handle != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
+    }
+    destroy_image(macrocell_image_);
+    macrocell_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    uploaded_macrocell_storage_id_ = 0;
+    if (macrocell_sampler_ == VK_NULL_HANDLE) {
+        if (!create_sampler(VK_FILTER_NEAREST, macrocell_sampler_)) return false;
+    }
+    bool ok = create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, VK_FORMAT_R32G32_SFLOAT,
+                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, macrocell_image_);
+    if (!ok) {
+        std::cerr << "[fluid] failed to create macrocell image.\n";
+    }
+    return ok;
+}
+
+bool FluidRenderer::ensure_distance_image(VkExtent3D extent) {
+    if (distance_image_.handle != VK_NULL_HANDLE && distance_image_.extent.width == extent.width &&
+        distance_image_.extent.height == extent.height && distance_image_.extent.depth == extent.depth) {
+        return true;
+    }
+    if (distance_image_.handle != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
+    }
+    destroy_image(distance_image_);
+    distance_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    uploaded_distance_revision_ = 0;
+    if (distance_sampler_ == VK_NULL_HANDLE) {
+        if (!create_sampler(VK_FILTER_LINEAR, distance_sampler_, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)) return false;
+    }
+    bool ok = create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, VK_FORMAT_R32_SFLOAT,
+                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, distance_image_);
+    if (!ok) {
+        std::cerr << "[fluid] failed to create distance field image.\n";
+    }
+    return ok;
+}
+
+bool FluidRenderer::ensure_light_image(VkExtent3D extent) {
+    if (light_image_.handle != VK_NULL_HANDLE && light_image_.extent.width == extent.width &&
+        light_image_.extent.height == extent.height && light_image_.extent.depth == extent.depth) {
+        return true;
+    }
+    if (light_image_.handle != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
+    }
+    destroy_image(light_image_);
+    light_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+    uploaded_light_revision_ = 0;
+    if (light_sampler_ == VK_NULL_HANDLE) {
+        if (!create_sampler(VK_FILTER_LINEAR, light_sampler_, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)) return false;
+    }
+    bool ok = create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, VK_FORMAT_R32_SFLOAT,
+                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, light_image_);
+    if (!ok) {
+        std::cerr << "[fluid] failed to create light volume image.\n";
     }
     return ok;
 }
 
+bool FluidRenderer::ensure_seed_images(VkExtent3D extent) {
+    for (Image& seeds : seed_images_) {
+        if (seeds.handle != VK_NULL_HANDLE && seeds.extent.width == extent.width &&
+            seeds.extent.height == extent.height && seeds.extent.depth == extent.depth) {
+            continue;
+        }
+        if (seeds.handle != VK_NULL_HANDLE) {
+            vkDeviceWaitIdle(device_);
+        }
+        destroy_image(seeds);
+        if (!create_image(VK_IMAGE_TYPE_3D, VK_IMAGE_VIEW_TYPE_3D, extent, VK_FORMAT_R32_SINT,
+                          VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, seeds)) {
+            std::cerr << "[fluid] failed to create jump-flood seed image.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
 bool FluidRenderer::ensure_noise_image() {
     if (noise_image_.handle != VK_NULL_HANDLE) return true;
     static const float kNoise[16] = {
@@ -224,128 +438,746 @@ bool FluidRenderer::ensure_noise_image() {
     return true;
 }
 
-bool FluidRenderer::write_particles(const std::vector<Particle>& particles) {
+bool FluidRenderer::write_particles(const ParticleStore& particles) {
     if (particles.empty()) return true;
     if (!ensure_particle_buffer(particles.size())) return false;
+    const Buffer& buffer = particle_buffers_[frame_slot_];
     void* mapped = nullptr;
-    vkMapMemory(device_, particle_buffer_.memory, 0, particle_buffer_.size, 0, &mapped);
+    vkMapMemory(device_, buffer.memory, 0, buffer.size, 0, &mapped);
     char* dst = static_cast<char*>(mapped);
-    for (const auto& p : particles) {
-        float data[8] = {p.position.x, p.position.y, p.position.z, p.radius,
-                         p.velocity.x, p.velocity.y, p.velocity.z, p.mass};
+    for (size_t i = 0; i < particles.size(); ++i) {
+        float data[8] = {particles.px[i], particles.py[i], particles.pz[i], particles.radius[i],
+                         particles.vx[i], particles.vy[i], particles.vz[i], particles.mass[i]};
         std::memcpy(dst, data, sizeof(data));
         dst += sizeof(data);
     }
-    vkUnmapMemory(device_, particle_buffer_.memory);
+    vkUnmapMemory(device_, buffer.memory);
+    return true;
+}
+
+bool FluidRenderer::write_splat_table(const SplatWeightTable* table) {
+    const VkDeviceSize size = sizeof(float) * (kSplatTableSize + 1);
+    if (splat_table_buffer_.handle == VK_NULL_HANDLE) {
+        if (!create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           splat_table_buffer_)) {
+            return false;
+        }
+        splat_table_radius_ = -1.0f;
+    }
+    // Exact poly6 binds the buffer without reading it; only upload when the table changes.
+    if (!table || (table->kernel == splat_table_kernel_ && table->kernel_radius == splat_table_radius_)) return true;
+    if (splat_table_radius_ >= 0.0f) {
+        // Frames in flight may still read the old table; changes are rare (a new kernel or radius).
+        vkDeviceWaitIdle(device_);
+    }
+    void* mapped = nullptr;
+    vkMapMemory(device_, splat_table_buffer_.memory, 0, size, 0, &mapped);
+    std::memcpy(mapped, table->weights.data(), static_cast<size_t>(size));
+    vkUnmapMemory(device_, splat_table_buffer_.memory);
+    splat_table_kernel_ = table->kernel;
+    splat_table_radius_ = table->kernel_radius;
     return true;
 }
 
 bool FluidRenderer::ensure_cpu_staging(size_t byte_size) {
-    if (cpu_staging_.handle != VK_NULL_HANDLE && cpu_staging_.size >= byte_size) {
+    // This slot's last copy has completed (its fence was waited), so it can be replaced right away.
+    Buffer& staging = cpu_staging_[frame_slot_];
+    if (staging.handle != VK_NULL_HANDLE && staging.size >= byte_size) {
         return true;
     }
-    destroy_buffer(cpu_staging_);
+    destroy_buffer(staging);
     return create_buffer(byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cpu_staging_);
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging);
 }
 
-void FluidRenderer::upload_cpu_density(VkCommandBuffer cmd, const FluidExperiment& sim) {
-    const auto& density = sim.volume().density();
-    if (density.empty()) return;
+void FluidRenderer::upload_cpu_density(VkCommandBuffer cmd, const DensityVolume& volume, float max_density) {
+    if (volume.brick_count() == 0) return;
 
-    size_t byte_size = density.size() * sizeof(float);
-    if (!ensure_cpu_staging(byte_size)) {
+    // 16-bit texels hold density / density_range_; the range follows the peak density in powers of two,
+    // and only moves down once the peak is below a quarter of it so it does not flip every frame.
+    if (density_format_ == DensityFormat::Float32) {
+        density_range_ = 1.0f;
+    } else {
+        if (max_density > density_range_ || max_density < 0.25f * density_range_) {
+            density_range_ = density_texel_range(density_format_, max_density);
+        }
+    }
+
+    // Only allocated bricks are uploaded, one 8^3 copy region each (clipped at the volume edge). After
+    // a reset revision (or a range change) the image is cleared and every brick is sent; otherwise only
+    // bricks written since the revision already in the image are.
+    const bool full = volume.storage_id() != uploaded_storage_id_ || volume.reset_revision() > uploaded_revision_ ||
+                      density_range_ != uploaded_density_range_;
+    if (!full && volume.revision() == uploaded_revision_) return;
+    const std::vector<float>& pool = volume.pool();
+    const size_t texel_bytes = density_format_bytes(density_format_);
+    brick_copies_.clear();
+    volume.for_each_brick([&](int brick) {
+        if (!full && volume.brick_revision(brick) <= uploaded_revision_) return;
+        VkBufferImageCopy copy{};
+        // Full uploads copy the pool as is (offset = slot); partial ones pack dirty bricks in order.
+        const size_t packed = full ? static_cast<size_t>(volume.brick_slot(brick)) : brick_copies_.size();
+        copy.bufferOffset = static_cast<VkDeviceSize>(packed) * kBrickVoxels * texel_bytes;
+        copy.bufferRowLength = kBrickSize;
+        copy.bufferImageHeight = kBrickSize;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.layerCount = 1;
+        const Int3 b = volume.brick_coord(brick);
+        const VolumeConfig& cfg = volume.config();
+        copy.imageOffset = {b.x * kBrickSize, b.y * kBrickSize, b.z * kBrickSize};
+        copy.imageExtent = {static_cast<uint32_t>(std::min(kBrickSize, cfg.dims.x - b.x * kBrickSize)),
+                            static_cast<uint32_t>(std::min(kBrickSize, cfg.dims.y - b.y * kBrickSize)),
+                            static_cast<uint32_t>(std::min(kBrickSize, cfg.dims.z - b.z * kBrickSize))};
+        brick_copies_.push_back(copy);
+    });
+
+    // Sized for every brick of the grid (the most the pool can hold), so the buffer is only replaced when
+    // the volume's dims or the texel format change, not as the pool's high-water mark grows.
+    const size_t voxels = full ? pool.size() : brick_copies_.size() * kBrickVoxels;
+    const size_t byte_size = std::max<size_t>(voxels, 1) * texel_bytes;
+    if (!ensure_cpu_staging(static_cast<size_t>(volume.brick_count()) * kBrickVoxels * texel_bytes)) {
         log_once("[fluid] Failed to create CPU staging buffer.", warned_no_density_);
         return;
     }
+    const Buffer& staging = cpu_staging_[frame_slot_];
+    if (voxels > 0) {
+        void* mapped = nullptr;
+        vkMapMemory(device_, staging.memory, 0, byte_size, 0, &mapped);
+        // Copy regions read x-major bricks; other voxel layouts are converted brick by brick. 16-bit
+        // formats are encoded (SIMD) on the way into the staging buffer.
+        const float encode_scale = 1.0f / density_range_;
+        if (full && volume.layout() == VoxelLayout::Linear) {
+            encode_density(density_format_, pool.data(), voxels, encode_scale, mapped);
+        } else {
+            float linear[kBrickVoxels];
+            for (const VkBufferImageCopy& copy : brick_copies_) {
+                const Int3 b{static_cast<int>(copy.imageOffset.x) >> kBrickShift,
+                             static_cast<int>(copy.imageOffset.y) >> kBrickShift,
+                             static_cast<int>(copy.imageOffset.z) >> kBrickShift};
+                const int brick = volume.brick_id(b.x, b.y, b.z);
+                void* dst = static_cast<char*>(mapped) + copy.bufferOffset;
+                if (volume.layout() == VoxelLayout::Linear) {
+                    encode_density(density_format_, volume.brick_data(brick), kBrickVoxels, encode_scale, dst);
+                } else {
+                    volume.copy_brick_linear(brick, linear);
+                    encode_density(density_format_, linear, kBrickVoxels, encode_scale, dst);
+                }
+            }
+        }
+        vkUnmapMemory(device_, staging.memory);
+    }
 
-    void* mapped = nullptr;
-    vkMapMemory(device_, cpu_staging_.memory, 0, byte_size, 0, &mapped);
-    std::memcpy(mapped, density.data(), byte_size);
-    vkUnmapMemory(device_, cpu_staging_.memory);
-
-    // Transition to TRANSFER_DST, copy, then to SHADER_READ.
+    // Transition to TRANSFER_DST, clear (full uploads), copy the bricks, then to SHADER_READ.
     transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                      VK_IMAGE_ASPECT_COLOR_BIT);
     density_layout_ = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 
+    if (full) {
+        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        VkClearColorValue zero{{0.0f, 0.0f, 0.0f, 0.0f}};
+        vkCmdClearColorImage(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1, &range);
+    }
+    if (!brick_copies_.empty()) {
+        if (full) {
+            // Clear and copies both write the image in the transfer stage.
+            VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                                 nullptr, 0, nullptr);
+        }
+        vkCmdCopyBufferToImage(cmd, staging.handle, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(brick_copies_.size()), brick_copies_.data());
+    }
+
+    transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    density_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_storage_id_ = volume.storage_id();
+    uploaded_revision_ = volume.revision();
+    uploaded_density_range_ = density_range_;
+}
+
+void FluidRenderer::make_macrocells_readable(VkCommandBuffer cmd) {
+    if (macrocell_layout_ == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) return;
+    // Contents are ignored while macrocells_valid_ is false; the layout only has to match the descriptor.
+    transition_image(cmd, macrocell_image_.handle, macrocell_layout_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    macrocell_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void FluidRenderer::upload_macrocells(VkCommandBuffer cmd, const DensityVolume& volume) {
+    macrocells_valid_ = false;
+    const std::vector<MacrocellRange>& cells = volume.macrocells();
+    const VkExtent3D extent = macrocell_image_.extent;
+    if (!volume.macrocells_current() ||
+        cells.size() != static_cast<size_t>(extent.width) * extent.height * extent.depth) {
+        make_macrocells_readable(cmd);
+        return;
+    }
+    if (volume.storage_id() == uploaded_macrocell_storage_id_ &&
+        volume.macrocell_revision() == uploaded_macrocell_revision_ && density_range_ == uploaded_macrocell_range_) {
+        macrocells_valid_ = true;
+        return;
+    }
+    // The whole grid is small (8 bytes per 4^3 voxels), so it is re-sent in one copy.
+    const VkDeviceSize byte_size = cells.size() * sizeof(MacrocellRange);
+    Buffer& staging = macrocell_staging_[frame_slot_];  // Free: this slot's last copy has completed.
+    if (staging.size < byte_size) {
+        destroy_buffer(staging);
+        if (!create_buffer(byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging)) {
+            make_macrocells_readable(cmd);
+            return;
+        }
+    }
+    void* mapped = nullptr;
+    vkMapMemory(device_, staging.memory, 0, byte_size, 0, &mapped);
+    if (density_format_ == DensityFormat::Float32) {
+        std::memcpy(mapped, cells.data(), static_cast<size_t>(byte_size));
+    } else {
+        // Quantization is monotonic, so rounded bounds still bound the rounded texels.
+        MacrocellRange* out = static_cast<MacrocellRange*>(mapped);
+        const float encode_scale = 1.0f / density_range_;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            out[i].min = quantize_density(density_format_, cells[i].min * encode_scale);
+            out[i].max = quantize_density(density_format_, cells[i].max * encode_scale);
+        }
+    }
+    vkUnmapMemory(device_, staging.memory);
+
+    VkBufferImageCopy copy{};
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageExtent = extent;
+    transition_image(cmd, macrocell_image_.handle, macrocell_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdCopyBufferToImage(cmd, staging.handle, macrocell_image_.handle,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+    transition_image(cmd, macrocell_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    macrocell_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_macrocell_storage_id_ = volume.storage_id();
+    uploaded_macrocell_revision_ = volume.macrocell_revision();
+    uploaded_macrocell_range_ = density_range_;
+    macrocells_valid_ = true;
+}
+
+void FluidRenderer::update_distance_field(VkCommandBuffer cmd, const FluidFrameView& sim) {
+    distance_valid_ = false;
+    const DistanceVolume* field = sim.distance;
+    const Int3 dims = field ? field->config().dims : Int3{};
+    if (field && !field->empty() && distance_image_.extent.width == static_cast<uint32_t>(dims.x) &&
+        distance_image_.extent.height == static_cast<uint32_t>(dims.y) &&
+        distance_image_.extent.depth == static_cast<uint32_t>(dims.z)) {
+        if (field->revision() != uploaded_distance_revision_) {
+            const bool gpu = sim.settings->gpu_distance_field && atomic_float_supported_ &&
+                             distance_pipeline_ != VK_NULL_HANDLE && !sim.particles->empty();
+            if (gpu) {
+                build_gpu_distance(cmd, sim);
+            } else {
+                upload_cpu_distance(cmd, *field);
+            }
+        }
+        distance_valid_ = field->revision() == uploaded_distance_revision_;
+    }
+    if (distance_layout_ != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        // Unused while distance_valid_ is false; the layout only has to match the descriptor.
+        transition_image(cmd, distance_image_.handle, distance_layout_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_ASPECT_COLOR_BIT);
+        distance_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+}
+
+void FluidRenderer::upload_cpu_distance(VkCommandBuffer cmd, const DistanceVolume& field) {
+    // The field is dense and rebuilt as a whole, so it is sent in one copy.
+    const std::vector<float>& values = field.values();
+    const VkDeviceSize byte_size = values.size() * sizeof(float);
+    Buffer& staging = distance_staging_[frame_slot_];  // Free: this slot's last copy has completed.
+    if (staging.size < byte_size) {
+        destroy_buffer(staging);
+        if (!create_buffer(byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging)) {
+            log_once("[fluid] Failed to create distance field staging buffer.", warned_no_density_);
+            return;
+        }
+    }
+    void* mapped = nullptr;
+    vkMapMemory(device_, staging.memory, 0, byte_size, 0, &mapped);
+    std::memcpy(mapped, values.data(), static_cast<size_t>(byte_size));
+    vkUnmapMemory(device_, staging.memory);
+
     VkBufferImageCopy copy{};
-    copy.imageExtent = density_image_.extent;
     copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     copy.imageSubresource.layerCount = 1;
-    vkCmdCopyBufferToImage(cmd, cpu_staging_.handle, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+    copy.imageExtent = distance_image_.extent;
+    transition_image(cmd, distance_image_.handle, distance_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdCopyBufferToImage(cmd, staging.handle, distance_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
                            &copy);
+    transition_image(cmd, distance_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    distance_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_distance_revision_ = field.revision();
+}
 
-    transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+void FluidRenderer::build_gpu_distance(VkCommandBuffer cmd, const FluidFrameView& sim) {
+    const VkExtent3D extent = distance_image_.extent;
+    if (!ensure_seed_images(extent) || !ensure_particle_buffer(sim.particles->size()) ||
+        !write_particles(*sim.particles)) {
+        upload_cpu_distance(cmd, *sim.distance);
+        return;
+    }
+    // The frame slot's set: the previous frame may still be reading the other ones.
+    const VkDescriptorSet set = distance_sets_[frame_slot_];
+    const Buffer& particles = particle_buffers_[frame_slot_];
+    VkDescriptorBufferInfo buf{particles.handle, 0, particles.size};
+    VkDescriptorImageInfo images[3]{};
+    images[0].imageView = distance_image_.view;
+    images[1].imageView = seed_images_[0].view;
+    images[2].imageView = seed_images_[1].view;
+    VkWriteDescriptorSet writes[4]{};
+    for (uint32_t i = 0; i < 4; ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        if (i == 0) {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &buf;
+        } else {
+            images[i - 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &images[i - 1];
+        }
+    }
+    vkUpdateDescriptorSets(device_, 4, writes, 0, nullptr);
+
+    // Clear the sums, then run the passes with a compute-to-compute barrier between each.
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkClearColorValue zero{{0.0f, 0.0f, 0.0f, 0.0f}};
+    transition_image(cmd, distance_image_.handle, distance_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdClearColorImage(cmd, distance_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1, &range);
+    transition_image(cmd, distance_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    for (Image& seeds : seed_images_) {
+        // Seeds are fully rewritten by the resolve pass; old contents can go.
+        transition_image(cmd, seeds.handle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                         VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+    auto compute_barrier = [&]() {
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    };
+
+    const VolumeConfig& cfg = sim.distance->config();
+    const DistanceFieldSettings field = distance_field_settings(*sim.settings);
+    DistancePush push{};
+    push.origin[0] = cfg.origin.x;
+    push.origin[1] = cfg.origin.y;
+    push.origin[2] = cfg.origin.z;
+    push.voxel_size = cfg.voxel_size;
+    push.dims[0] = cfg.dims.x;
+    push.dims[1] = cfg.dims.y;
+    push.dims[2] = cfg.dims.z;
+    push.particle_radius = field.particle_radius;
+    push.particle_count = static_cast<uint32_t>(sim.particles->size());
+    push.smoothing = std::max(field.smoothing, 1e-3f * cfg.voxel_size);
+    push.band = sim.distance->band();
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, distance_pipeline_);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, distance_pipeline_layout_, 0, 1, &set, 0, nullptr);
+    const uint32_t groups[3] = {(extent.width + 3) / 4, (extent.height + 3) / 4, (extent.depth + 3) / 4};
+    auto dispatch = [&](uint32_t pass, int jump) {
+        push.pass = pass;
+        push.jump = jump;
+        vkCmdPushConstants(cmd, distance_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        if (pass == 0) {
+            vkCmdDispatch(cmd, (push.particle_count + 63) / 64, 1, 1);
+        } else {
+            vkCmdDispatch(cmd, groups[0], groups[1], groups[2]);
+        }
+        compute_barrier();
+    };
+    dispatch(0, 0);
+    dispatch(1, 0);
+    // Jump flood from half the largest dimension down to 1, plus one more 1-step pass (JFA+1) to fix
+    // most of the remaining misses.
+    if (sim.distance->settings().extend) {
+        int jump = 1;
+        while (jump * 2 < std::max({cfg.dims.x, cfg.dims.y, cfg.dims.z})) jump *= 2;
+        for (; jump >= 1; jump /= 2) {
+            dispatch(2, jump);
+            push.read_b ^= 1u;
+        }
+        dispatch(2, 1);
+        push.read_b ^= 1u;
+        dispatch(3, 0);
+    }
+
+    barrier_compute_to_fragment(cmd, distance_image_.handle);
+    distance_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_distance_revision_ = sim.distance->revision();
+}
+
+void FluidRenderer::update_light_volume(VkCommandBuffer cmd, const FluidFrameView& sim) {
+    light_valid_ = false;
+    const LightVolume* light = sim.light;
+    const Int3 dims = light ? light->dims() : Int3{};
+    if (light && !light->empty() && light_image_.extent.width == static_cast<uint32_t>(dims.x) &&
+        light_image_.extent.height == static_cast<uint32_t>(dims.y) &&
+        light_image_.extent.depth == static_cast<uint32_t>(dims.z)) {
+        // Depth is stored in density texel units, so a new texel range needs it again too.
+        if (light->revision() != uploaded_light_revision_ || density_range_ != uploaded_light_range_) {
+            if (sim.settings->gpu_light_volume && light_pipeline_ != VK_NULL_HANDLE) {
+                build_gpu_light(cmd, *light);
+            } else {
+                upload_cpu_light(cmd, *light);
+            }
+        }
+        light_valid_ = light->revision() == uploaded_light_revision_ && density_range_ == uploaded_light_range_;
+    }
+    if (light_layout_ != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        // Unused while light_valid_ is false; the layout only has to match the descriptor.
+        transition_image(cmd, light_image_.handle, light_layout_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                         VK_IMAGE_ASPECT_COLOR_BIT);
+        light_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+}
+
+void FluidRenderer::upload_cpu_light(VkCommandBuffer cmd, const LightVolume& light) {
+    const std::vector<float>& values = light.values();
+    const VkDeviceSize byte_size = values.size() * sizeof(float);
+    Buffer& staging = light_staging_[frame_slot_];  // Free: this slot's last copy has completed.
+    if (staging.size < byte_size) {
+        destroy_buffer(staging);
+        if (!create_buffer(byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging)) {
+            log_once("[fluid] Failed to create light volume staging buffer.", warned_no_density_);
+            return;
+        }
+    }
+    void* mapped = nullptr;
+    vkMapMemory(device_, staging.memory, 0, byte_size, 0, &mapped);
+    encode_density(DensityFormat::Float32, values.data(), values.size(), 1.0f / density_range_, mapped);
+    vkUnmapMemory(device_, staging.memory);
+
+    VkBufferImageCopy copy{};
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageExtent = light_image_.extent;
+    transition_image(cmd, light_image_.handle, light_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                      VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdCopyBufferToImage(cmd, staging.handle, light_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+    transition_image(cmd, light_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+    light_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_light_revision_ = light.revision();
+    uploaded_light_range_ = density_range_;
+}
+
+void FluidRenderer::build_gpu_light(VkCommandBuffer cmd, const LightVolume& light) {
+    const VkDescriptorSet set = light_sets_[frame_slot_];  // The other slots' may still be in use.
+    VkDescriptorImageInfo images[2]{};
+    images[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    images[0].imageView = density_image_.view;
+    images[0].sampler = density_sampler_;
+    images[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    images[1].imageView = light_image_.view;
+    VkWriteDescriptorSet writes[2]{};
+    for (uint32_t i = 0; i < 2; ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[i].pImageInfo = &images[i];
+    }
+    vkUpdateDescriptorSets(device_, 2, writes, 0, nullptr);
+
+    // The density image was last written by the upload (transfer) or the splat (compute), and the sweep
+    // rewrites every light voxel, after the previous frame's draw read them.
+    VkMemoryBarrier density_ready{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    density_ready.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    density_ready.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &density_ready, 0, nullptr, 0, nullptr);
+    transition_image(cmd, light_image_.handle, light_layout_, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    const LightSweep sweep = light_sweep(light.dims(), light.cell_size(), light.settings().light_dir);
+    LightPush push{};
+    push.dims[0] = light.dims().x;
+    push.dims[1] = light.dims().y;
+    push.dims[2] = light.dims().z;
+    push.axis = sweep.axis;
+    push.upstream[0] = sweep.upstream.x;
+    push.upstream[1] = sweep.upstream.y;
+    push.upstream[2] = sweep.upstream.z;
+    push.step_length = sweep.step_length;
+    push.first_slice = sweep.first;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, light_pipeline_);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, light_pipeline_layout_, 0, 1, &set, 0, nullptr);
+    // One dispatch per slice over the other two axes (axis + 1 along x, axis + 2 along y); each reads
+    // the slice before it.
+    const uint32_t extent[3] = {light_image_.extent.width, light_image_.extent.height, light_image_.extent.depth};
+    const uint32_t groups_x = (extent[(sweep.axis + 1) % 3] + 7) / 8;
+    const uint32_t groups_y = (extent[(sweep.axis + 2) % 3] + 7) / 8;
+    const int slice_step = sweep.first <= sweep.last ? 1 : -1;
+    for (int s = sweep.first;; s += slice_step) {
+        push.slice = s;
+        vkCmdPushConstants(cmd, light_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(cmd, groups_x, groups_y, 1);
+        if (s == sweep.last) break;
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    barrier_compute_to_fragment(cmd, light_image_.handle);
+    light_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_light_revision_ = light.revision();
+    uploaded_light_range_ = density_range_;
+}
+
+FluidRenderer::SplatPath FluidRenderer::select_splat_path(const FluidSettings& settings) {
+    if (!settings.gpu_splat) return SplatPath::Upload;
+    if (compute_pipeline_ != VK_NULL_HANDLE) return SplatPath::AtomicFloat;
+    log_once("[fluid] No GPU splat pipeline; uploading the CPU volume instead.", warned_no_gpu_splat_);
+    return SplatPath::Upload;
+}
+
+void FluidRenderer::record_gpu_splat(VkCommandBuffer cmd, const FluidFrameView& sim, const SplatWeightTable* table) {
+    // The frame slot's set and particles: the other slots' may still be in use by frames in flight.
+    const VkDescriptorSet set = compute_sets_[frame_slot_];
+    const Buffer& particles = particle_buffers_[frame_slot_];
+
+    // 0 = particles, 1 = density (r32f), 2 = weight table.
+    VkDescriptorBufferInfo buffers[2] = {{particles.handle, 0, particles.size},
+                                         {splat_table_buffer_.handle, 0, splat_table_buffer_.size}};
+    VkDescriptorImageInfo image{};
+    image.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    image.imageView = density_image_.view;
+    VkWriteDescriptorSet writes[3]{};
+    for (uint32_t i = 0; i < 3; ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        if (i == 1) {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &image;
+        } else {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &buffers[i / 2];
+        }
+    }
+    vkUpdateDescriptorSets(device_, 3, writes, 0, nullptr);
+
+    // The splat adds into the density image, so it starts from zero.
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkClearColorValue zero{};
+    transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdClearColorImage(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1, &range);
+    transition_image(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    density_layout_ = VK_IMAGE_LAYOUT_GENERAL;
+
+    const VolumeConfig& cfg = sim.volume->config();
+    ComputePush push{};
+    push.origin[0] = cfg.origin.x;
+    push.origin[1] = cfg.origin.y;
+    push.origin[2] = cfg.origin.z;
+    push.voxel_size = cfg.voxel_size;
+    push.kernel_radius = sim.settings->kernel_radius;
+    push.dims[0] = cfg.dims.x;
+    push.dims[1] = cfg.dims.y;
+    push.dims[2] = cfg.dims.z;
+    push.particle_count = static_cast<uint32_t>(sim.particles->size());
+    push.kernel_mode = static_cast<uint32_t>(sim.settings->splat_kernel);
+    push.table_inv_step = table ? table->inv_step : 0.0f;
+    push.table_size = kSplatTableSize;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(cmd, compute_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(cmd, (push.particle_count + 127) / 128, 1, 1);
+
+    barrier_compute_to_fragment(cmd, density_image_.handle);
+    density_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    uploaded_storage_id_ = 0;  // The image no longer holds the CPU volume.
+    density_range_ = 1.0f;
+}
+
+bool FluidRenderer::validate_gpu_splat(const FluidFrameView& sim, const SplatWeightTable* table) {
+    const char* name = "atomic float";
+    const VkExtent3D extent = density_image_.extent;
+    const size_t voxels = static_cast<size_t>(extent.width) * extent.height * extent.depth;
+    Buffer readback{};
+    if (!create_buffer(voxels * sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readback)) {
+        std::cerr << "[fluid] gpu splat validation (" << name << "): failed to create readback buffer.\n";
+        return false;
+    }
+
+    VkCommandPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.queueFamilyIndex = queue_family_;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    if (vkCreateCommandPool(device_, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+        destroy_buffer(readback);
+        return false;
+    }
+    VkCommandBufferAllocateInfo alloc_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    alloc_info.commandPool = pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(device_, &alloc_info, &cmd) != VK_SUCCESS) {
+        vkDestroyCommandPool(device_, pool, nullptr);
+        destroy_buffer(readback);
+        return false;
+    }
+
+    // Frames in flight may still sample the density image the splat clears.
+    vkQueueWaitIdle(queue_);
+    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &begin_info);
+    record_gpu_splat(cmd, sim, table);
+    VkBufferImageCopy copy{};
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageExtent = extent;
+    transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCmdCopyImageToBuffer(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.handle, 1, &copy);
+    transition_image(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
     density_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkMemoryBarrier to_host{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &to_host, 0, nullptr,
+                         0, nullptr);
+    vkEndCommandBuffer(cmd);
+    VkSubmitInfo submit{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &cmd;
+    vkQueueSubmit(queue_, 1, &submit, VK_NULL_HANDLE);
+    vkQueueWaitIdle(queue_);
+    vkFreeCommandBuffers(device_, pool, 1, &cmd);
+    vkDestroyCommandPool(device_, pool, nullptr);
+
+    std::vector<float> gpu(voxels);
+    void* mapped = nullptr;
+    vkMapMemory(device_, readback.memory, 0, readback.size, 0, &mapped);
+    std::memcpy(gpu.data(), mapped, voxels * sizeof(float));
+    vkUnmapMemory(device_, readback.memory);
+    destroy_buffer(readback);
+
+    // The reference is splatted here rather than taken from the sim, whose volume may be incremental
+    // or built with another splat mode.
+    DensityVolume reference(sim.volume->config());
+    SplatScratch scratch;
+    TaskScheduler scheduler;
+    splat_density_slabs(reference, *sim.particles, sim.settings->kernel_radius, table, scratch, scheduler);
+    const SplatDifference diff = compare_dense_splat(reference, gpu);
+    const bool passed = diff.max_error <= kGpuSplatTolerance;
+    std::cerr << "[fluid] gpu splat validation (" << name << ", " << sim.particles->size()
+              << " particles): max error " << diff.max_error << ", mean error " << diff.mean_error << " of peak "
+              << diff.peak << (passed ? ", ok" : ", too large; uploading the CPU volume instead") << "\n";
+    return passed;
+}
+
+float FluidRenderer::splat_fallback_density(const FluidFrameView& sim, const SplatWeightTable* table) {
+    fallback_volume_.resize(sim.volume->config());
+    splat_density_slabs(fallback_volume_, *sim.particles, sim.settings->kernel_radius, table, fallback_scratch_,
+                        fallback_scheduler_);
+    fallback_volume_.update_macrocells();
+    float max_density = 0.0f;
+    fallback_volume_.for_each_brick([&](int brick) {
+        const float* data = fallback_volume_.brick_data(brick);
+        max_density = std::max(max_density, *std::max_element(data, data + kBrickVoxels));
+    });
+    return max_density;
 }
 
-void FluidRenderer::record_compute(VkCommandBuffer cmd, const FluidExperiment& sim, bool enabled) {
+void FluidRenderer::record_compute(VkCommandBuffer cmd, const FluidFrameView& sim, bool enabled,
+                                   uint32_t frame_slot) {
     if (!enabled) return;
+    frame_slot_ = frame_slot % kMaxFramesInFlight;
+    draw_set_written_ = false;
     log_once("[fluid] record_compute invoked.", logged_compute_start_);
-    if (!ensure_density_image(sim.volume().config())) {
+    SplatPath path = sim.particles->empty() ? SplatPath::Upload : select_splat_path(*sim.settings);
+    // The splat shaders write r32f.
+    const DensityFormat format = path == SplatPath::Upload ? sim.settings->density_format : DensityFormat::Float32;
+    if (!ensure_density_image(sim.volume->config(), format) || !ensure_macrocell_image(sim.volume->config())) {
         log_once("[fluid] Failed to create/resize density image.", warned_no_density_);
         return;
     }
+    const Int3 field_dims = sim.distance && !sim.distance->empty() ? sim.distance->config().dims : Int3{1, 1, 1};
+    if (!ensure_distance_image({static_cast<uint32_t>(field_dims.x), static_cast<uint32_t>(field_dims.y),
+                                static_cast<uint32_t>(field_dims.z)})) {
+        log_once("[fluid] Failed to create/resize distance field image.", warned_no_density_);
+        return;
+    }
+    const Int3 light_dims = sim.light && !sim.light->empty() ? sim.light->dims() : Int3{1, 1, 1};
+    if (!ensure_light_image({static_cast<uint32_t>(light_dims.x), static_cast<uint32_t>(light_dims.y),
+                             static_cast<uint32_t>(light_dims.z)})) {
+        log_once("[fluid] Failed to create/resize light volume image.", warned_no_density_);
+        return;
+    }
     // Debug spam reduced: layout info is still helpful once.
     log_once("[fluid] density image is ready for compute", logged_compute_start_);
+    const SplatWeightTable* splat_table = splat_weights_.get(sim.settings->splat_kernel, sim.settings->kernel_radius);
+    if (!write_splat_table(splat_table)) {
+        log_once("[fluid] Failed to create splat weight table buffer.", warned_descriptor_);
+        return;
+    }
     if (!update_descriptors()) {
         log_once("[fluid] Descriptor update failed; compute/draw skipped.", warned_descriptor_);
         return;
     }
-    // Temporarily rely on CPU density upload for rendering while the GPU splat
-    // path is being validated against the SPH CPU sim.
-    bool gpu_splat = false;
-
-    if (gpu_splat) {
-        size_t particle_capacity = std::max<size_t>(1, sim.particles().size());
-        if (!ensure_particle_buffer(particle_capacity)) return;
-        write_particles(sim.particles());
+    draw_set_written_ = true;
+    // The GPU splat reads 32 bytes per particle instead of 4 per voxel of the written bricks.
+    if (path != SplatPath::Upload && !write_particles(*sim.particles)) {
+        log_once("[fluid] GPU splat resources unavailable; uploading the CPU volume instead.", warned_no_gpu_splat_);
+        path = SplatPath::Upload;
     }
-
-    if (gpu_splat) {
-        log_once("[fluid] descriptors updated; dispatching compute", logged_draw_start_);
-
-        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-        VkClearColorValue zero{{0.0f, 0.0f, 0.0f, 0.0f}};
-        transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                         VK_IMAGE_ASPECT_COLOR_BIT);
-        density_layout_ = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        vkCmdClearColorImage(cmd, density_image_.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1, &range);
-        transition_image(cmd, density_image_.handle, density_layout_, VK_IMAGE_LAYOUT_GENERAL,
-                         VK_IMAGE_ASPECT_COLOR_BIT);
-        density_layout_ = VK_IMAGE_LAYOUT_GENERAL;
-
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_);
-        ComputePush push{};
-        push.origin[0] = sim.volume().config().origin.x;
-        push.origin[1] = sim.volume().config().origin.y;
-        push.origin[2] = sim.volume().config().origin.z;
-        push.voxel_size = sim.volume().config().voxel_size;
-        push.kernel_radius = sim.settings().kernel_radius;
-        push.dims[0] = sim.volume().config().dims.x;
-        push.dims[1] = sim.volume().config().dims.y;
-        push.dims[2] = sim.volume().config().dims.z;
-        push.particle_count = static_cast<uint32_t>(sim.particles().size());
-        vkCmdPushConstants(cmd, compute_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_, 0, 1, &compute_set_, 0, nullptr);
-        uint32_t groups = (push.particle_count + 127) / 128;
-        if (groups > 0) {
-            vkCmdDispatch(cmd, groups, 1, 1);
-        } else {
-            log_once("[fluid] No particles to dispatch; skipping compute.", warned_no_compute_);
+    if (path != SplatPath::Upload) {
+        // Checked against the CPU splat on first use of a path and whenever the kernel changes.
+        const SplatCheck check{path, sim.settings->splat_kernel, sim.settings->kernel_radius};
+        if (!(check == splat_check_)) {
+            splat_check_ = check;
+            splat_check_passed_ = validate_gpu_splat(sim, splat_table);
         }
+        if (!splat_check_passed_) path = SplatPath::Upload;
+    }
 
-        barrier_compute_to_fragment(cmd, density_image_.handle);
-        density_layout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    const DensityVolume* volume = sim.volume;
+    if (path != SplatPath::Upload) {
+        record_gpu_splat(cmd, sim, splat_table);
+    } else if (sim.stats->density_footprint) {
+        log_once("[fluid] The sim left the density to the GPU splat; splatting it on the render thread instead.",
+                 warned_fallback_splat_);
+        const float max_density = splat_fallback_density(sim, splat_table);
+        volume = &fallback_volume_;
+        upload_cpu_density(cmd, *volume, max_density);
     } else {
-        // CPU fallback: upload density from the CPU volume when compute is unavailable.
-        upload_cpu_density(cmd, sim);
+        upload_cpu_density(cmd, *volume, sim.stats->max_density);
     }
+    upload_macrocells(cmd, *volume);
+    update_distance_field(cmd, sim);
+    update_light_volume(cmd, sim);
 }
 
-void FluidRenderer::record_draw(VkCommandBuffer cmd, const FluidExperiment& sim, bool enabled, uint32_t frame_index,
+void FluidRenderer::record_draw(VkCommandBuffer cmd, const FluidFrameView& sim, bool enabled, uint32_t frame_index,
                                 float density_scale, float absorption) {
     if (!enabled) return;
     log_once("[fluid] record_draw invoked.", logged_draw_start_);
@@ -357,17 +1189,18 @@ void FluidRenderer::record_draw(VkCommandBuffer cmd, const FluidExperiment& sim,
         log_once("[fluid] record_draw: density view missing.", warned_no_density_);
         return;
     }
+    if (!draw_set_written_) return;  // record_compute stopped before writing this frame's set.
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
     GraphicsPush gpush{};
-    gpush.volume_origin[0] = sim.volume().config().origin.x;
-    gpush.volume_origin[1] = sim.volume().config().origin.y;
-    gpush.volume_origin[2] = sim.volume().config().origin.z;
-    Vec3 ext = sim.volume_extent();
-    gpush.volume_origin[3] = sim.volume().config().voxel_size * 0.75f;  // step
+    gpush.volume_origin[0] = sim.volume->config().origin.x;
+    gpush.volume_origin[1] = sim.volume->config().origin.y;
+    gpush.volume_origin[2] = sim.volume->config().origin.z;
+    Vec3 ext = sim.extent();
+    gpush.volume_origin[3] = sim.volume->config().voxel_size * 0.75f;  // step
     gpush.volume_extent[0] = ext.x;
     gpush.volume_extent[1] = ext.y;
     gpush.volume_extent[2] = ext.z;
-    gpush.volume_extent[3] = density_scale;  // density scale
+    gpush.volume_extent[3] = density_scale * density_range_;  // density scale (and 16-bit texel range)
     gpush.light_dir_absorb[0] = -0.4f;
     gpush.light_dir_absorb[1] = -1.0f;
     gpush.light_dir_absorb[2] = -0.2f;
@@ -379,7 +1212,7 @@ void FluidRenderer::record_draw(VkCommandBuffer cmd, const FluidExperiment& sim,
     gpush.camera_pos[0] = fluid_draw_camera_.pos.x;
     gpush.camera_pos[1] = fluid_draw_camera_.pos.y;
     gpush.camera_pos[2] = fluid_draw_camera_.pos.z;
-    gpush.camera_pos[3] = 0.0f;
+    gpush.camera_pos[3] = distance_valid_ ? 1.0f : 0.0f;
     gpush.camera_forward[0] = fluid_draw_camera_.forward.x;
     gpush.camera_forward[1] = fluid_draw_camera_.forward.y;
     gpush.camera_forward[2] = fluid_draw_camera_.forward.z;
@@ -390,9 +1223,21 @@ void FluidRenderer::record_draw(VkCommandBuffer cmd, const FluidExperiment& sim,
     gpush.camera_right[3] = fluid_draw_camera_.aspect;
     gpush.max_distance = ext.z;
     gpush.frame_index = frame_index;
+    gpush.macrocell_size = static_cast<float>(kMacrocellSize) * sim.volume->config().voxel_size;
+    gpush.flags = (macrocells_valid_ ? kDrawUseMacrocells : 0u) | (light_valid_ ? kDrawUseLightVolume : 0u);
+    if (sim.settings->adaptive_steps) {
+        gpush.flags |= kDrawUseAdaptiveSteps;
+        // The frame's budget split over the pixels and the two searches of a ray (surface, then fog).
+        const uint64_t pixels = std::max<uint64_t>(1, uint64_t{swapchain_extent_.width} * swapchain_extent_.height);
+        const uint64_t per_ray = static_cast<uint64_t>(std::max(0, sim.settings->frame_step_budget)) * 1000000u /
+                                 (pixels * 2u);
+        if (sim.settings->frame_step_budget > 0) {
+            gpush.flags |= static_cast<uint32_t>(std::clamp<uint64_t>(per_ray, 1u, 0xFFFFFFu)) << kDrawBudgetShift;
+        }
+    }
     vkCmdPushConstants(cmd, graphics_pipeline_layout_, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(gpush), &gpush);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_layout_, 0, 1, &graphics_set_, 0,
-                            nullptr);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_layout_, 0, 1,
+                            &graphics_sets_[frame_slot_], 0, nullptr);
     vkCmdDraw(cmd, 3, 1, 0, 0);
 }
 
@@ -400,7 +1245,7 @@ bool FluidRenderer::create_compute_pipeline() {
     VkShaderModule comp = VK_NULL_HANDLE;
     if (!load_shader(kParticleSplatComp, comp)) return false;
 
-    VkDescriptorSetLayoutBinding bindings[2]{};
+    VkDescriptorSetLayoutBinding bindings[3]{};
     bindings[0].binding = 0;
     bindings[0].descriptorCount = 1;
     bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -409,9 +1254,13 @@ bool FluidRenderer::create_compute_pipeline() {
     bindings[1].descriptorCount = 1;
     bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
     bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorCount = 1;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
     VkDescriptorSetLayoutCreateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    set_info.bindingCount = 2;
+    set_info.bindingCount = 3;
     set_info.pBindings = bindings;
     if (vkCreateDescriptorSetLayout(device_, &set_info, nullptr, &compute_set_layout_) != VK_SUCCESS) {
         return false;
@@ -441,11 +1290,113 @@ bool FluidRenderer::create_compute_pipeline() {
     }
     vkDestroyShaderModule(device_, comp, nullptr);
 
-    VkDescriptorSetAllocateInfo alloc_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    alloc_info.descriptorPool = descriptor_pool_;
-    alloc_info.descriptorSetCount = 1;
-    alloc_info.pSetLayouts = &compute_set_layout_;
-    if (vkAllocateDescriptorSets(device_, &alloc_info, &compute_set_) != VK_SUCCESS) {
+    if (!allocate_frame_sets(compute_set_layout_, compute_sets_)) {
+        // Without a set the pipeline is unusable; drop it so another splat path is used.
+        vkDestroyPipeline(device_, compute_pipeline_, nullptr);
+        compute_pipeline_ = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+bool FluidRenderer::create_distance_pipeline() {
+    VkShaderModule comp = VK_NULL_HANDLE;
+    if (!load_shader(kDistanceFieldComp, comp)) return false;
+
+    // 0 = particles, 1 = distance (r32f), 2/3 = jump-flood seeds (r32i).
+    VkDescriptorSetLayoutBinding bindings[4]{};
+    for (uint32_t i = 0; i < 4; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    set_info.bindingCount = 4;
+    set_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device_, &set_info, nullptr, &distance_set_layout_) != VK_SUCCESS) {
+        vkDestroyShaderModule(device_, comp, nullptr);
+        return false;
+    }
+
+    VkPushConstantRange range{};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(DistancePush);
+    VkPipelineLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &range;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &distance_set_layout_;
+    if (vkCreatePipelineLayout(device_, &layout_info, nullptr, &distance_pipeline_layout_) != VK_SUCCESS) {
+        vkDestroyShaderModule(device_, comp, nullptr);
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipe_info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipe_info.layout = distance_pipeline_layout_;
+    pipe_info.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT,
+                       comp, "main", nullptr};
+    const bool created =
+        vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &pipe_info, nullptr, &distance_pipeline_) == VK_SUCCESS;
+    vkDestroyShaderModule(device_, comp, nullptr);
+    if (!created) return false;
+
+    if (!allocate_frame_sets(distance_set_layout_, distance_sets_)) {
+        // Without a set the pipeline is unusable; drop it so the CPU upload is used.
+        vkDestroyPipeline(device_, distance_pipeline_, nullptr);
+        distance_pipeline_ = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+bool FluidRenderer::create_light_pipeline() {
+    VkShaderModule comp = VK_NULL_HANDLE;
+    if (!load_shader(kLightVolumeComp, comp)) return false;
+
+    // 0 = density (sampled), 1 = optical depth (r32f).
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    for (uint32_t i = 0; i < 2; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    set_info.bindingCount = 2;
+    set_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device_, &set_info, nullptr, &light_set_layout_) != VK_SUCCESS) {
+        vkDestroyShaderModule(device_, comp, nullptr);
+        return false;
+    }
+
+    VkPushConstantRange range{};
+    range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    range.offset = 0;
+    range.size = sizeof(LightPush);
+    VkPipelineLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &range;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &light_set_layout_;
+    if (vkCreatePipelineLayout(device_, &layout_info, nullptr, &light_pipeline_layout_) != VK_SUCCESS) {
+        vkDestroyShaderModule(device_, comp, nullptr);
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipe_info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipe_info.layout = light_pipeline_layout_;
+    pipe_info.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT,
+                       comp, "main", nullptr};
+    const bool created =
+        vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &pipe_info, nullptr, &light_pipeline_) == VK_SUCCESS;
+    vkDestroyShaderModule(device_, comp, nullptr);
+    if (!created) return false;
+
+    if (!allocate_frame_sets(light_set_layout_, light_sets_)) {
+        vkDestroyPipeline(device_, light_pipeline_, nullptr);
+        light_pipeline_ = VK_NULL_HANDLE;
         return false;
     }
     return true;
@@ -460,7 +1411,7 @@ bool FluidRenderer::create_graphics_pipeline() {
         return false;
     }
 
-    VkDescriptorSetLayoutBinding bindings[2]{};
+    VkDescriptorSetLayoutBinding bindings[5]{};
     bindings[0].binding = 0;
     bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     bindings[0].descriptorCount = 1;
@@ -469,9 +1420,21 @@ bool FluidRenderer::create_graphics_pipeline() {
     bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     bindings[1].descriptorCount = 1;
     bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[2].descriptorCount = 1;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[3].binding = 3;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[3].descriptorCount = 1;
+    bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[4].binding = 4;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[4].descriptorCount = 1;
+    bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutCreateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    set_info.bindingCount = 2;
+    set_info.bindingCount = 5;
     set_info.pBindings = bindings;
     if (vkCreateDescriptorSetLayout(device_, &set_info, nullptr, &graphics_set_layout_) != VK_SUCCESS) {
         return false;
@@ -567,21 +1530,14 @@ bool FluidRenderer::create_graphics_pipeline() {
     vkDestroyShaderModule(device_, vert, nullptr);
     vkDestroyShaderModule(device_, frag, nullptr);
 
-    VkDescriptorSetAllocateInfo alloc_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    alloc_info.descriptorPool = descriptor_pool_;
-    alloc_info.descriptorSetCount = 1;
-    alloc_info.pSetLayouts = &graphics_set_layout_;
-    if (vkAllocateDescriptorSets(device_, &alloc_info, &graphics_set_) != VK_SUCCESS) {
+    if (!allocate_frame_sets(graphics_set_layout_, graphics_sets_)) {
         return false;
     }
     return true;
 }
 
 void FluidRenderer::destroy_pipelines() {
-    if (compute_set_ != VK_NULL_HANDLE && descriptor_pool_ != VK_NULL_HANDLE) {
-        vkFreeDescriptorSets(device_, descriptor_pool_, 1, &compute_set_);
-        compute_set_ = VK_NULL_HANDLE;
-    }
+    free_frame_sets(compute_sets_);
     if (compute_pipeline_ != VK_NULL_HANDLE) {
         vkDestroyPipeline(device_, compute_pipeline_, nullptr);
         compute_pipeline_ = VK_NULL_HANDLE;
@@ -595,10 +1551,36 @@ void FluidRenderer::destroy_pipelines() {
         compute_set_layout_ = VK_NULL_HANDLE;
     }
 
-    if (graphics_set_ != VK_NULL_HANDLE && descriptor_pool_ != VK_NULL_HANDLE) {
-        vkFreeDescriptorSets(device_, descriptor_pool_, 1, &graphics_set_);
-        graphics_set_ = VK_NULL_HANDLE;
+
+    free_frame_sets(distance_sets_);
+    if (distance_pipeline_ != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device_, distance_pipeline_, nullptr);
+        distance_pipeline_ = VK_NULL_HANDLE;
+    }
+    if (distance_pipeline_layout_ != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device_, distance_pipeline_layout_, nullptr);
+        distance_pipeline_layout_ = VK_NULL_HANDLE;
+    }
+    if (distance_set_layout_ != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device_, distance_set_layout_, nullptr);
+        distance_set_layout_ = VK_NULL_HANDLE;
+    }
+
+    free_frame_sets(light_sets_);
+    if (light_pipeline_ != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device_, light_pipeline_, nullptr);
+        light_pipeline_ = VK_NULL_HANDLE;
+    }
+    if (light_pipeline_layout_ != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device_, light_pipeline_layout_, nullptr);
+        light_pipeline_layout_ = VK_NULL_HANDLE;
     }
+    if (light_set_layout_ != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device_, light_set_layout_, nullptr);
+        light_set_layout_ = VK_NULL_HANDLE;
+    }
+
+    free_frame_sets(graphics_sets_);
     if (graphics_pipeline_ != VK_NULL_HANDLE) {
         vkDestroyPipeline(device_, graphics_pipeline_, nullptr);
         graphics_pipeline_ = VK_NULL_HANDLE;
@@ -613,40 +1595,35 @@ void FluidRenderer::destroy_pipelines() {
     }
 }
 
+bool FluidRenderer::allocate_frame_sets(VkDescriptorSetLayout layout, VkDescriptorSet (&sets)[kMaxFramesInFlight]) {
+    VkDescriptorSetLayout layouts[kMaxFramesInFlight];
+    std::fill(std::begin(layouts), std::end(layouts), layout);
+    VkDescriptorSetAllocateInfo alloc_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = kMaxFramesInFlight;
+    alloc_info.pSetLayouts = layouts;
+    return vkAllocateDescriptorSets(device_, &alloc_info, sets) == VK_SUCCESS;
+}
+
+void FluidRenderer::free_frame_sets(VkDescriptorSet (&sets)[kMaxFramesInFlight]) {
+    if (sets[0] != VK_NULL_HANDLE && descriptor_pool_ != VK_NULL_HANDLE) {
+        vkFreeDescriptorSets(device_, descriptor_pool_, kMaxFramesInFlight, sets);
+    }
+    std::fill(std::begin(sets), std::end(sets), VK_NULL_HANDLE);
+}
+
 bool FluidRenderer::update_descriptors() {
-    if (compute_set_ == VK_NULL_HANDLE || graphics_set_ == VK_NULL_HANDLE) {
+    // Compute sets are written where they are dispatched; this is the draw's set for the frame slot.
+    const VkDescriptorSet graphics_set = graphics_sets_[frame_slot_];
+    if (graphics_set == VK_NULL_HANDLE) {
         log_once("[fluid] Descriptor sets not allocated.", warned_descriptor_);
         return false;
     }
-    if (density_image_.view == VK_NULL_HANDLE) {
+    if (density_image_.view == VK_NULL_HANDLE || macrocell_image_.view == VK_NULL_HANDLE ||
+        distance_image_.view == VK_NULL_HANDLE || light_image_.view == VK_NULL_HANDLE) {
         log_once("[fluid] Density image view missing.", warned_descriptor_);
         return false;
     }
-    VkDescriptorBufferInfo buf{};
-    buf.buffer = particle_buffer_.handle;
-    buf.offset = 0;
-    buf.range = particle_buffer_.size;
-
-    VkDescriptorImageInfo density_storage{};
-    density_storage.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    density_storage.imageView = density_image_.view;
-
-    VkWriteDescriptorSet writes[2]{};
-    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writes[0].dstSet = compute_set_;
-    writes[0].dstBinding = 0;
-    writes[0].descriptorCount = 1;
-    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    writes[0].pBufferInfo = &buf;
-
-    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writes[1].dstSet = compute_set_;
-    writes[1].dstBinding = 1;
-    writes[1].descriptorCount = 1;
-    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    writes[1].pImageInfo = &density_storage;
-    vkUpdateDescriptorSets(device_, 2, writes, 0, nullptr);
-
     VkDescriptorImageInfo density_sample{};
     density_sample.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     density_sample.imageView = density_image_.view;
@@ -657,21 +1634,57 @@ bool FluidRenderer::update_descriptors() {
     noise_sample.imageView = noise_image_.view;
     noise_sample.sampler = noise_sampler_;
 
-    VkWriteDescriptorSet gwrites[2]{};
+    VkDescriptorImageInfo macrocell_sample{};
+    macrocell_sample.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    macrocell_sample.imageView = macrocell_image_.view;
+    macrocell_sample.sampler = macrocell_sampler_;
+
+    VkDescriptorImageInfo distance_sample{};
+    distance_sample.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    distance_sample.imageView = distance_image_.view;
+    distance_sample.sampler = distance_sampler_;
+
+    VkDescriptorImageInfo light_sample{};
+    light_sample.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    light_sample.imageView = light_image_.view;
+    light_sample.sampler = light_sampler_;
+
+    VkWriteDescriptorSet gwrites[5]{};
     gwrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    gwrites[0].dstSet = graphics_set_;
+    gwrites[0].dstSet = graphics_set;
     gwrites[0].dstBinding = 0;
     gwrites[0].descriptorCount = 1;
     gwrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     gwrites[0].pImageInfo = &density_sample;
 
     gwrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    gwrites[1].dstSet = graphics_set_;
+    gwrites[1].dstSet = graphics_set;
     gwrites[1].dstBinding = 1;
     gwrites[1].descriptorCount = 1;
     gwrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     gwrites[1].pImageInfo = &noise_sample;
-    vkUpdateDescriptorSets(device_, 2, gwrites, 0, nullptr);
+
+    gwrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gwrites[2].dstSet = graphics_set;
+    gwrites[2].dstBinding = 2;
+    gwrites[2].descriptorCount = 1;
+    gwrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    gwrites[2].pImageInfo = &macrocell_sample;
+
+    gwrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gwrites[3].dstSet = graphics_set;
+    gwrites[3].dstBinding = 3;
+    gwrites[3].descriptorCount = 1;
+    gwrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    gwrites[3].pImageInfo = &distance_sample;
+
+    gwrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gwrites[4].dstSet = graphics_set;
+    gwrites[4].dstBinding = 4;
+    gwrites[4].descriptorCount = 1;
+    gwrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    gwrites[4].pImageInfo = &light_sample;
+    vkUpdateDescriptorSets(device_, 5, gwrites, 0, nullptr);
     return true;
 }
 
@@ -783,14 +1796,14 @@ void FluidRenderer::destroy_image(Image& img) {
     img.format = VK_FORMAT_UNDEFINED;
 }
 
-bool FluidRenderer::create_sampler(VkFilter filter, VkSampler& sampler) {
+bool FluidRenderer::create_sampler(VkFilter filter, VkSampler& sampler, VkSamplerAddressMode address) {
     VkSamplerCreateInfo info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     info.magFilter = filter;
     info.minFilter = filter;
     info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    info.addressModeU = address;
+    info.addressModeV = address;
+    info.addressModeW = address;
     info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     info.maxLod = 1.0f;
     return vkCreateSampler(device_, &info, nullptr, &sampler) == VK_SUCCESS;
@@ -848,10 +1861,15 @@ void FluidRenderer::transition_image(VkCommandBuffer cmd, VkImage image, VkImage
     } else if (old_layout == VK_IMAGE_LAYOUT_GENERAL) {
         barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
         src_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     }
     if (new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
         barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (new_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     } else if (new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
         dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
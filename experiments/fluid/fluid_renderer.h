@@ -6,6 +6,8 @@
 #include <iostream>
 
 #include "fluid_experiment.h"
+#include "raymarch.h"
+#include "splat_weights.h"
 
 namespace rayol::fluid {
 
@@ -14,13 +16,7 @@ class FluidRenderer {
 public:
     FluidRenderer() = default;
 
-    struct CameraData {
-        fluid::Vec3 pos{0.0f, 0.0f, -1.0f};
-        fluid::Vec3 forward{0.0f, 0.0f, 1.0f};
-        fluid::Vec3 right{1.0f, 0.0f, 0.0f};
-        float tan_half_fov{0.577f};  // tan(30 deg)
-        float aspect{16.0f / 9.0f};
-    };
+    using CameraData = fluid::CameraData;  // Shared with CpuVolumeRenderer (raymarch.h).
 
     bool init(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, VkQueue queue,
               VkDescriptorPool descriptor_pool, VkRenderPass render_pass, VkExtent2D swapchain_extent,
@@ -28,11 +24,16 @@ public:
     void on_swapchain_recreated(VkRenderPass render_pass, VkExtent2D swapchain_extent);
     void cleanup();
 
-    // Record compute work (before render pass) and graphics work (inside render pass).
-    void record_compute(VkCommandBuffer cmd, const FluidExperiment& sim, bool enabled);
+    // FrameSync's fence count: the most frames in flight. Buffers the host rewrites each frame are kept
+    // per frame slot and only touched again once that slot's fence has signalled.
+    static constexpr uint32_t kMaxFramesInFlight = 3;
+
+    // Record compute work (before render pass) and graphics work (inside render pass). frame_slot is
+    // FrameSync::current_frame(), whose previous submission has completed.
+    void record_compute(VkCommandBuffer cmd, const FluidFrameView& sim, bool enabled, uint32_t frame_slot);
     void set_camera(const CameraData& cam) { fluid_draw_camera_ = cam; }
 
-    void record_draw(VkCommandBuffer cmd, const FluidExperiment& sim, bool enabled, uint32_t frame_index,
+    void record_draw(VkCommandBuffer cmd, const FluidFrameView& sim, bool enabled, uint32_t frame_index,
                      float density_scale, float absorption);
 
 private:
@@ -50,19 +51,66 @@ private:
         VkExtent3D extent{};
     };
 
+    // Where the density image comes from this frame.
+    enum class SplatPath {
+        Upload,       // The CPU volume's bricks.
+        AtomicFloat,  // particle_splat.comp (float image atomics).
+    };
+
     bool init_pipelines();
     bool create_compute_pipeline();
     bool create_graphics_pipeline();
+    bool create_distance_pipeline();
+    bool create_light_pipeline();
     void destroy_pipelines();
+    // One descriptor set of `layout` per frame slot, so a set is only rewritten once its frame completed.
+    bool allocate_frame_sets(VkDescriptorSetLayout layout, VkDescriptorSet (&sets)[kMaxFramesInFlight]);
+    void free_frame_sets(VkDescriptorSet (&sets)[kMaxFramesInFlight]);
 
     bool ensure_particle_buffer(size_t count);
-    bool ensure_density_image(const VolumeConfig& cfg);
+    // Density image of cfg's dims in `format`, or R32F when the device cannot filter it.
+    bool ensure_density_image(const VolumeConfig& cfg, DensityFormat format);
+    bool density_format_supported(DensityFormat format) const;
+    bool ensure_macrocell_image(const VolumeConfig& cfg);
     bool ensure_noise_image();
+    // Distance field image: the volume's dims while the sim builds a field, 1x1x1 otherwise (the
+    // draw set always binds one).
+    bool ensure_distance_image(VkExtent3D extent);
+    bool ensure_seed_images(VkExtent3D extent);
+    // Light volume image: the sim's light grid while it builds one, 1x1x1 otherwise.
+    bool ensure_light_image(VkExtent3D extent);
     bool update_descriptors();
 
-    bool write_particles(const std::vector<Particle>& particles);
+    bool write_particles(const ParticleStore& particles);
+    // GPU splat path for the settings and this device; Upload when none is requested or usable.
+    SplatPath select_splat_path(const FluidSettings& settings);
+    // Clear and splat density_image_ (R32F) from the slot's particle buffer, leaving it shader-readable.
+    void record_gpu_splat(VkCommandBuffer cmd, const FluidFrameView& sim, const SplatWeightTable* table);
+    // Run the GPU splat once on its own, read the image back and compare it with the CPU splat of the
+    // same particles and kernel (splat_density_slabs, exact poly6 without a table). Waits for the queue.
+    bool validate_gpu_splat(const FluidFrameView& sim, const SplatWeightTable* table);
+    // Create the splat table buffer on first use and upload `table` when it changed (nullptr = exact poly6).
+    bool write_splat_table(const SplatWeightTable* table);
     bool ensure_cpu_staging(size_t byte_size);
-    void upload_cpu_density(VkCommandBuffer cmd, const FluidExperiment& sim);
+    void upload_cpu_density(VkCommandBuffer cmd, const DensityVolume& volume, float max_density);
+    // Splat fallback_volume_ from the particles when the upload path gets a footprint-only volume
+    // (FluidStats::density_footprint); returns its peak density.
+    float splat_fallback_density(const FluidFrameView& sim, const SplatWeightTable* table);
+    // Upload the CPU volume's macrocell ranges when they changed; without current ones the shader is
+    // told not to skip. The GPU splat uses them too: it splats the same particles (and a footprint-only
+    // volume's macrocells are bounds from the bricks those particles touch).
+    void upload_macrocells(VkCommandBuffer cmd, const DensityVolume& volume);
+    void make_macrocells_readable(VkCommandBuffer cmd);
+    // Bring distance_image_ to the sim's current field (uploaded, or rebuilt in compute with
+    // gpu_distance_field) when its revision changed; sets distance_valid_.
+    void update_distance_field(VkCommandBuffer cmd, const FluidFrameView& sim);
+    void upload_cpu_distance(VkCommandBuffer cmd, const DistanceVolume& field);
+    void build_gpu_distance(VkCommandBuffer cmd, const FluidFrameView& sim);
+    // Bring light_image_ to the sim's light volume (uploaded, or swept in compute from the density image
+    // with gpu_light_volume) when its revision or the density texel range changed; sets light_valid_.
+    void update_light_volume(VkCommandBuffer cmd, const FluidFrameView& sim);
+    void upload_cpu_light(VkCommandBuffer cmd, const LightVolume& light);
+    void build_gpu_light(VkCommandBuffer cmd, const LightVolume& light);
 
     uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags) const;
     bool create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags flags, Buffer& out);
@@ -70,7 +118,8 @@ private:
     bool create_image(VkImageType type, VkImageViewType view_type, VkExtent3D extent, VkFormat format,
                       VkImageUsageFlags usage, VkMemoryPropertyFlags flags, Image& out);
     void destroy_image(Image& img);
-    bool create_sampler(VkFilter filter, VkSampler& sampler);
+    bool create_sampler(VkFilter filter, VkSampler& sampler,
+                        VkSamplerAddressMode address = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
 
     bool load_shader(const char* path, VkShaderModule& out_module);
 
@@ -93,28 +142,101 @@ private:
     VkRenderPass render_pass_{VK_NULL_HANDLE};
     VkExtent2D swapchain_extent_{};
     bool atomic_float_supported_{false};
-    bool warned_no_compute_{false};
     bool warned_no_pipeline_{false};
     bool warned_no_density_{false};
     bool warned_descriptor_{false};
+    bool warned_density_format_{false};
     bool logged_compute_start_{false};
     bool logged_draw_start_{false};
+    bool warned_no_gpu_splat_{false};
+    bool warned_fallback_splat_{false};
 
+    // particle_splat.comp (created only with float image atomics).
     VkDescriptorSetLayout compute_set_layout_{VK_NULL_HANDLE};
     VkPipelineLayout compute_pipeline_layout_{VK_NULL_HANDLE};
     VkPipeline compute_pipeline_{VK_NULL_HANDLE};
-    VkDescriptorSet compute_set_{VK_NULL_HANDLE};
+    VkDescriptorSet compute_sets_[kMaxFramesInFlight]{};  // Per frame slot.
+
+    // distance_field.comp (optional: without it the CPU field is always uploaded).
+    VkDescriptorSetLayout distance_set_layout_{VK_NULL_HANDLE};
+    VkPipelineLayout distance_pipeline_layout_{VK_NULL_HANDLE};
+    VkPipeline distance_pipeline_{VK_NULL_HANDLE};
+    VkDescriptorSet distance_sets_[kMaxFramesInFlight]{};  // Per frame slot (rewritten each build).
+
+    // light_volume.comp (optional: without it the CPU light volume is always uploaded).
+    VkDescriptorSetLayout light_set_layout_{VK_NULL_HANDLE};
+    VkPipelineLayout light_pipeline_layout_{VK_NULL_HANDLE};
+    VkPipeline light_pipeline_{VK_NULL_HANDLE};
+    VkDescriptorSet light_sets_[kMaxFramesInFlight]{};  // Per frame slot (rewritten each sweep).
 
     VkDescriptorSetLayout graphics_set_layout_{VK_NULL_HANDLE};
     VkPipelineLayout graphics_pipeline_layout_{VK_NULL_HANDLE};
     VkPipeline graphics_pipeline_{VK_NULL_HANDLE};
-    VkDescriptorSet graphics_set_{VK_NULL_HANDLE};
-
-    Buffer particle_buffer_{};
-    Buffer cpu_staging_{};  // Host-visible staging for CPU density upload (debug fallback).
+    VkDescriptorSet graphics_sets_[kMaxFramesInFlight]{};  // Per frame slot.
+    bool draw_set_written_{false};  // graphics_sets_[frame_slot_] was written for this frame.
+
+    Buffer particle_buffers_[kMaxFramesInFlight]{};  // Per frame slot: rewritten every splat.
+    uint32_t frame_slot_{0};  // Slot of the frame being recorded (< kMaxFramesInFlight).
+    Buffer cpu_staging_[kMaxFramesInFlight]{};  // Host-visible staging for CPU density upload, per frame slot.
+    std::vector<VkBufferImageCopy> brick_copies_;  // One region per uploaded density brick.
+    // CPU volume state held by density_image_ (DensityVolume::storage_id / revision); 0 = none.
+    uint64_t uploaded_storage_id_{0};
+    uint64_t uploaded_revision_{0};
+    Buffer splat_table_buffer_{};  // Kernel weight table read by particle_splat.comp (binding 2).
+    SplatWeightCache splat_weights_{};  // Same tables the CPU splat builds, keyed on kernel and radius.
+    SplatKernel splat_table_kernel_ = SplatKernel::Poly6;  // Key of the table in splat_table_buffer_
+    float splat_table_radius_ = -1.0f;                     // (radius < 0 = nothing uploaded).
+    // GPU splat path and kernel last checked against the CPU splat, and whether it matched.
+    struct SplatCheck {
+        SplatPath path = SplatPath::Upload;
+        SplatKernel kernel = SplatKernel::Poly6;
+        float kernel_radius = -1.0f;
+        bool operator==(const SplatCheck&) const = default;
+    };
+    SplatCheck splat_check_{};
+    bool splat_check_passed_{false};
+    // Density splatted on the render thread when the sim skipped its splat for gpu_splat but the upload
+    // path runs; the one-thread scheduler runs it inline.
+    DensityVolume fallback_volume_{};
+    SplatScratch fallback_scratch_{};
+    TaskScheduler fallback_scheduler_{1};
     Image density_image_{};
     VkSampler density_sampler_{VK_NULL_HANDLE};
     VkImageLayout density_layout_{VK_IMAGE_LAYOUT_UNDEFINED};
+    // Texel format of density_image_ and the density a texel of 1 stands for (1 for R32F; the draw
+    // scales samples by it). Changing the range re-sends every brick and the macrocells.
+    DensityFormat density_format_ = DensityFormat::Float32;
+    float density_range_ = 1.0f;
+    float uploaded_density_range_ = 0.0f;  // Range of the texels in density_image_; 0 = none.
+
+    // Macrocell min/max (RG32F, one texel per 4^3 voxels) read by the ray march to skip empty space; in
+    // density texel units, rounded like the texels so a bound never falls below what a sample reads.
+    Image macrocell_image_{};
+    VkSampler macrocell_sampler_{VK_NULL_HANDLE};
+    VkImageLayout macrocell_layout_{VK_IMAGE_LAYOUT_UNDEFINED};
+    Buffer macrocell_staging_[kMaxFramesInFlight]{};  // Per frame slot.
+    uint64_t uploaded_macrocell_storage_id_{0};  // DensityVolume::storage_id / macrocell_revision in
+    uint64_t uploaded_macrocell_revision_{0};    // macrocell_image_; 0 = none.
+    float uploaded_macrocell_range_{0.0f};       // density_range_ the macrocells were quantized for.
+    bool macrocells_valid_{false};  // macrocell_image_ matches the density image this frame.
+
+    // Particle SDF (R32F, world units) sphere-traced by the draw for the surface.
+    Image distance_image_{};
+    VkSampler distance_sampler_{VK_NULL_HANDLE};  // Linear, clamp-to-edge (a border of 0 would be surface).
+    VkImageLayout distance_layout_{VK_IMAGE_LAYOUT_UNDEFINED};
+    Buffer distance_staging_[kMaxFramesInFlight]{};  // Per frame slot.
+    Image seed_images_[2]{};  // Jump-flood ping-pong (R32_SINT) for the GPU build.
+    uint64_t uploaded_distance_revision_{0};  // DistanceVolume::revision in distance_image_; 0 = none.
+    bool distance_valid_{false};  // distance_image_ holds the current field this frame.
+
+    // Optical depth toward the light (R32F, density texel units) shadowing the draw's lighting.
+    Image light_image_{};
+    VkSampler light_sampler_{VK_NULL_HANDLE};  // Linear, clamp-to-edge.
+    VkImageLayout light_layout_{VK_IMAGE_LAYOUT_UNDEFINED};
+    Buffer light_staging_[kMaxFramesInFlight]{};  // Per frame slot.
+    uint64_t uploaded_light_revision_{0};  // LightVolume::revision in light_image_; 0 = none.
+    float uploaded_light_range_{0.0f};     // density_range_ the depth was stored for.
+    bool light_valid_{false};  // light_image_ holds the current light volume this frame.
 
     Image noise_image_{};
     VkSampler noise_sampler_{VK_NULL_HANDLE};
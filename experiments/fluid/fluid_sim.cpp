@@ -1,34 +1,263 @@
 #include "fluid_sim.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <type_traits>
+
+#include "simd_target.h"
+#include "sph_kernels.h"
 
 namespace rayol::fluid {
 
 namespace {
-float poly6(float r, float h) {
-    if (r >= h || h <= 0.0f) return 0.0f;
-    float h2 = h * h;
-    float r2 = r * r;
-    float term = h2 - r2;
-    // Normalized poly6 kernel: 315 / (64 * pi * h^9) * (h^2 - r^2)^3
-    constexpr float k = 315.0f / (64.0f * 3.14159265359f);
-    float h9 = h2 * h2 * h2 * h * h;
-    return k * term * term * term / h9;
-}
-
 float clamp01(float v) { return std::clamp(v, 0.0f, 1.0f); }
+
+// Stands in for empty bricks and bricks outside the grid when sampling.
+const std::array<float, kBrickVoxels> kZeroBrick{};
 }  // namespace
 
 void DensityVolume::resize(const VolumeConfig& cfg) {
     config_ = cfg;
-    size_t total = static_cast<size_t>(config_.dims.x) * config_.dims.y * config_.dims.z;
-    density_.assign(total, 0.0f);
+    auto bricks_for = [](int voxels) { return std::max(0, (voxels + kBrickSize - 1) >> kBrickShift); };
+    brick_dims_ = {bricks_for(config_.dims.x), bricks_for(config_.dims.y), bricks_for(config_.dims.z)};
+    auto cells_for = [](int voxels) { return std::max(0, (voxels + kMacrocellSize - 1) >> kMacrocellShift); };
+    macrocell_dims_ = {cells_for(config_.dims.x), cells_for(config_.dims.y), cells_for(config_.dims.z)};
+    const size_t bricks = static_cast<size_t>(brick_dims_.x) * brick_dims_.y * brick_dims_.z;
+    brick_slot_.assign(bricks, -1);
+    occupancy_.assign((bricks + 63) / 64, 0);
+    pool_.clear();
+    free_slots_.clear();
+    allocated_ = 0;
+    static std::atomic<uint64_t> next_storage_id{1};
+    storage_id_ = next_storage_id.fetch_add(1, std::memory_order_relaxed);
+    brick_revision_.assign(bricks, 0);
+    reset_revision_ = ++revision_;
+}
+
+void DensityVolume::clear() {
+    for_each_brick([&](int brick) { brick_slot_[static_cast<size_t>(brick)] = -1; });
+    std::fill(occupancy_.begin(), occupancy_.end(), 0);
+    pool_.clear();  // Keeps capacity; slots are re-zeroed as they are handed out again.
+    free_slots_.clear();
+    allocated_ = 0;
+    reset_revision_ = ++revision_;
+}
+
+float* DensityVolume::allocate_brick(int brick) {
+    int& slot = brick_slot_[static_cast<size_t>(brick)];
+    if (slot >= 0) return pool_.data() + static_cast<size_t>(slot) * kBrickVoxels;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        std::fill_n(pool_.begin() + static_cast<std::ptrdiff_t>(slot) * kBrickVoxels, kBrickVoxels, 0.0f);
+    } else {
+        slot = static_cast<int>(pool_.size() / kBrickVoxels);
+        pool_.resize(pool_.size() + kBrickVoxels, 0.0f);
+    }
+    occupancy_[static_cast<size_t>(brick) >> 6] |= uint64_t{1} << (brick & 63);
+    ++allocated_;
+    mark_brick_dirty(brick);
+    return pool_.data() + static_cast<size_t>(slot) * kBrickVoxels;
 }
 
-void DensityVolume::clear() { std::fill(density_.begin(), density_.end(), 0.0f); }
+void DensityVolume::release_brick(int brick) {
+    int& slot = brick_slot_[static_cast<size_t>(brick)];
+    if (slot < 0) return;
+    free_slots_.push_back(slot);
+    slot = -1;
+    occupancy_[static_cast<size_t>(brick) >> 6] &= ~(uint64_t{1} << (brick & 63));
+    --allocated_;
+    reset_revision_ = ++revision_;  // Uploads have no per-brick "now empty" state.
+}
 
-size_t DensityVolume::index(int x, int y, int z) const {
-    return static_cast<size_t>(z * config_.dims.y * config_.dims.x + y * config_.dims.x + x);
+float DensityVolume::voxel(int x, int y, int z) const {
+    if (x < 0 || y < 0 || z < 0 || x >= config_.dims.x || y >= config_.dims.y || z >= config_.dims.z) {
+        return 0.0f;
+    }
+    const float* data = brick_data(brick_id(x >> kBrickShift, y >> kBrickShift, z >> kBrickShift));
+    return data ? data[local_index(x, y, z)] : 0.0f;
+}
+
+void DensityVolume::copy_dense(std::vector<float>& out) const {
+    const Int3 d = config_.dims;
+    out.assign(static_cast<size_t>(d.x) * d.y * d.z, 0.0f);
+    std::array<float, kBrickVoxels> linear;
+    for_each_brick([&](int brick) {
+        const Int3 b = brick_coord(brick);
+        copy_brick_linear(brick, linear.data());
+        for (int lz = 0; lz < kBrickSize && b.z * kBrickSize + lz < d.z; ++lz) {
+            for (int ly = 0; ly < kBrickSize && b.y * kBrickSize + ly < d.y; ++ly) {
+                const int z = b.z * kBrickSize + lz;
+                const int y = b.y * kBrickSize + ly;
+                const int x0 = b.x * kBrickSize;
+                const int width = std::min(kBrickSize, d.x - x0);
+                std::copy_n(linear.begin() + kBrickSize * (ly + kBrickSize * lz), width,
+                            out.begin() + static_cast<std::ptrdiff_t>((static_cast<size_t>(z) * d.y + y) * d.x + x0));
+            }
+        }
+    });
+}
+
+void DensityVolume::copy_brick_linear(int brick, float* out) const {
+    const float* data = brick_data(brick);
+    if (config_.layout == VoxelLayout::Linear) {
+        std::copy_n(data, kBrickVoxels, out);
+        return;
+    }
+    with_layout(config_.layout, [&](auto layout) {
+        using Layout = decltype(layout);
+        for (int z = 0; z < kBrickSize; ++z) {
+            for (int y = 0; y < kBrickSize; ++y) {
+                const float* row = data + Layout::y_offset(y) + Layout::z_offset(z);
+                for (int x = 0; x < kBrickSize; ++x) {
+                    *out++ = row[Layout::x_offset(x)];
+                }
+            }
+        }
+    });
+}
+
+size_t DensityVolume::memory_bytes() const {
+    return brick_slot_.capacity() * sizeof(int) + occupancy_.capacity() * sizeof(uint64_t) +
+           pool_.capacity() * sizeof(float) + free_slots_.capacity() * sizeof(int) +
+           cell_ranges_.capacity() * sizeof(CellRanges) + macrocells_.capacity() * sizeof(MacrocellRange) +
+           macrocell_stamp_.capacity() * sizeof(uint32_t);
+}
+
+// Voxel and face ranges of the 2^3 macrocells in a brick. Voxels past the volume edge in an edge
+// brick stay 0, which is also what samples read there.
+template <typename Layout>
+void DensityVolume::scan_macrocells(int brick) {
+    constexpr int kCellsPerBrick = kBrickSize / kMacrocellSize;
+    const Int3 cells = macrocell_dims_;
+    const Int3 b = brick_coord(brick);
+    const float* data = brick_data(brick);
+    for (int oz = 0; oz < kCellsPerBrick; ++oz) {
+        for (int oy = 0; oy < kCellsPerBrick; ++oy) {
+            for (int ox = 0; ox < kCellsPerBrick; ++ox) {
+                const int cx = b.x * kCellsPerBrick + ox, cy = b.y * kCellsPerBrick + oy, cz = b.z * kCellsPerBrick + oz;
+                if (cx >= cells.x || cy >= cells.y || cz >= cells.z) continue;
+                CellRanges ranges;
+                ranges.voxels = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+                std::fill(std::begin(ranges.faces), std::end(ranges.faces), ranges.voxels);
+                auto merge = [](MacrocellRange& range, MacrocellRange v) {
+                    range = {std::min(range.min, v.min), std::max(range.max, v.max)};
+                };
+                static_assert(kMacrocellSize == 4);
+                int x_offset[kMacrocellSize];
+                for (int x = 0; x < kMacrocellSize; ++x) {
+                    x_offset[x] = Layout::x_offset(ox * kMacrocellSize + x);
+                }
+                for (int z = 0; z < kMacrocellSize; ++z) {
+                    for (int y = 0; y < kMacrocellSize; ++y) {
+                        const float* row =
+                            data + Layout::y_offset(oy * kMacrocellSize + y) + Layout::z_offset(oz * kMacrocellSize + z);
+                        const float v0 = row[x_offset[0]], v1 = row[x_offset[1]], v2 = row[x_offset[2]], v3 = row[x_offset[3]];
+                        const MacrocellRange row_range = {std::min(std::min(v0, v1), std::min(v2, v3)),
+                                                          std::max(std::max(v0, v1), std::max(v2, v3))};
+                        merge(ranges.voxels, row_range);
+                        merge(ranges.faces[0], {v0, v0});
+                        merge(ranges.faces[1], {v3, v3});
+                        if (y == 0) merge(ranges.faces[2], row_range);
+                        if (y == kMacrocellSize - 1) merge(ranges.faces[3], row_range);
+                        if (z == 0) merge(ranges.faces[4], row_range);
+                        if (z == kMacrocellSize - 1) merge(ranges.faces[5], row_range);
+                    }
+                }
+                cell_ranges_[static_cast<size_t>(macrocell_id(cx, cy, cz))] = ranges;
+            }
+        }
+    }
+}
+
+void DensityVolume::update_macrocells() {
+    if (macrocells_current()) return;
+    const Int3 cells = macrocell_dims_;
+    const size_t cell_count = static_cast<size_t>(cells.x) * cells.y * cells.z;
+    const bool full = macrocell_revision_ < reset_revision_ || macrocells_.size() != cell_count ||
+                      cell_ranges_.size() != cell_count;
+    if (full) {
+        // Cells away from every allocated brick keep these zero ranges.
+        cell_ranges_.assign(cell_count, {});
+        macrocells_.assign(cell_count, {});
+        macrocell_stamp_.assign(cell_count, 0);
+        macrocell_generation_ = 0;
+    }
+    if (++macrocell_generation_ == 0) {
+        std::fill(macrocell_stamp_.begin(), macrocell_stamp_.end(), 0);
+        macrocell_generation_ = 1;
+    }
+
+    // Rescan the 2^3 cells of each changed brick.
+    constexpr int kCellsPerBrick = kBrickSize / kMacrocellSize;
+    macrocell_bricks_.clear();
+    with_layout(config_.layout, [&](auto layout) {
+        for_each_brick([&](int brick) {
+            if (!full && brick_revision_[static_cast<size_t>(brick)] <= macrocell_revision_) return;
+            macrocell_bricks_.push_back(brick);
+            scan_macrocells<decltype(layout)>(brick);
+        });
+    });
+
+    // A cell's apron is the touching face layer of each of its 26 neighbors; for an edge or corner
+    // neighbor any touching face is a superset of the voxels involved. Neighbors outside the grid read 0.
+    auto rebuild = [&](int cx, int cy, int cz) {
+        const int id = macrocell_id(cx, cy, cz);
+        uint32_t& stamp = macrocell_stamp_[static_cast<size_t>(id)];
+        if (stamp == macrocell_generation_) return;
+        stamp = macrocell_generation_;
+        MacrocellRange range = cell_ranges_[static_cast<size_t>(id)].voxels;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (dx == 0 && dy == 0 && dz == 0) continue;
+                    const int nx = cx + dx, ny = cy + dy, nz = cz + dz;
+                    MacrocellRange face{};
+                    if (nx >= 0 && ny >= 0 && nz >= 0 && nx < cells.x && ny < cells.y && nz < cells.z) {
+                        const int axis = dx != 0 ? 0 : dy != 0 ? 1 : 2;
+                        const int d = axis == 0 ? dx : axis == 1 ? dy : dz;
+                        face = cell_ranges_[static_cast<size_t>(macrocell_id(nx, ny, nz))].faces[2 * axis + (d < 0 ? 1 : 0)];
+                    }
+                    range = {std::min(range.min, face.min), std::max(range.max, face.max)};
+                }
+            }
+        }
+        macrocells_[static_cast<size_t>(id)] = range;
+    };
+    for (int brick : macrocell_bricks_) {
+        const Int3 b = brick_coord(brick);
+        for (int cz = std::max(0, b.z * kCellsPerBrick - 1); cz <= std::min(cells.z - 1, (b.z + 1) * kCellsPerBrick); ++cz) {
+            for (int cy = std::max(0, b.y * kCellsPerBrick - 1); cy <= std::min(cells.y - 1, (b.y + 1) * kCellsPerBrick); ++cy) {
+                for (int cx = std::max(0, b.x * kCellsPerBrick - 1); cx <= std::min(cells.x - 1, (b.x + 1) * kCellsPerBrick);
+                     ++cx) {
+                    rebuild(cx, cy, cz);
+                }
+            }
+        }
+    }
+    macrocell_revision_ = revision_;
+}
+
+void DensityVolume::bound_macrocells(float max) {
+    const Int3 cells = macrocell_dims_;
+    const size_t cell_count = static_cast<size_t>(cells.x) * cells.y * cells.z;
+    cell_ranges_.clear();  // No voxel ranges behind these; the next update_macrocells rescans every brick.
+    macrocells_.assign(cell_count, {});
+    constexpr int kCellsPerBrick = kBrickSize / kMacrocellSize;
+    for_each_brick([&](int brick) {
+        const Int3 b = brick_coord(brick);
+        for (int cz = std::max(0, b.z * kCellsPerBrick - 1); cz <= std::min(cells.z - 1, (b.z + 1) * kCellsPerBrick); ++cz) {
+            for (int cy = std::max(0, b.y * kCellsPerBrick - 1); cy <= std::min(cells.y - 1, (b.y + 1) * kCellsPerBrick); ++cy) {
+                for (int cx = std::max(0, b.x * kCellsPerBrick - 1); cx <= std::min(cells.x - 1, (b.x + 1) * kCellsPerBrick);
+                     ++cx) {
+                    macrocells_[static_cast<size_t>(macrocell_id(cx, cy, cz))] = {0.0f, max};
+                }
+            }
+        }
+    });
+    macrocell_revision_ = revision_;
 }
 
 Vec3 DensityVolume::voxel_center(int x, int y, int z) const {
@@ -39,10 +268,16 @@ Vec3 DensityVolume::voxel_center(int x, int y, int z) const {
     };
 }
 
-void DensityVolume::splat_particles(const std::vector<Particle>& particles, float kernel_radius) {
-    if (density_.empty()) return;
+void DensityVolume::splat_particles(const ParticleStore& particles, float kernel_radius) {
+    if (brick_slot_.empty()) return;
+    with_layout(config_.layout, [&](auto layout) { splat_particles_as<decltype(layout)>(particles, kernel_radius); });
+}
+
+template <typename Layout>
+void DensityVolume::splat_particles_as(const ParticleStore& particles, float kernel_radius) {
     float h = kernel_radius;
-    for (const auto& p : particles) {
+    for (size_t i = 0; i < particles.size(); ++i) {
+        const Particle p = particles.particle(i);
         float influence = std::max(h, p.radius);
         // Compute the voxel bounds overlapped by the kernel.
         Vec3 min_p = {p.position.x - influence, p.position.y - influence, p.position.z - influence};
@@ -69,74 +304,413 @@ void DensityVolume::splat_particles(const std::vector<Particle>& particles, floa
         for (int z = min_z; z <= max_z; ++z) {
             for (int y = min_y; y <= max_y; ++y) {
                 for (int x = min_x; x <= max_x; ++x) {
-                    Vec3 c = voxel_center(x, y, z);
-                    float r = length(p.position - c);
-                    float w = poly6(r, influence);
-                    density_[index(x, y, z)] += p.mass * w;
+                    Vec3 d = p.position - voxel_center(x, y, z);
+                    float w = poly6_weight(dot(d, d), influence);
+                    float* data = allocate_brick(brick_id(x >> kBrickShift, y >> kBrickShift, z >> kBrickShift));
+                    data[brick_local_index<Layout>(x, y, z)] += p.mass * w;
                 }
             }
         }
     }
 }
 
-float DensityVolume::sample(Vec3 world_pos) const {
-    if (density_.empty()) return 0.0f;
-    Vec3 rel = {world_pos.x - config_.origin.x,
-                world_pos.y - config_.origin.y,
-                world_pos.z - config_.origin.z};
-
-    float fx = rel.x / config_.voxel_size - 0.5f;
-    float fy = rel.y / config_.voxel_size - 0.5f;
-    float fz = rel.z / config_.voxel_size - 0.5f;
-
-    int x0 = static_cast<int>(std::floor(fx));
-    int y0 = static_cast<int>(std::floor(fy));
-    int z0 = static_cast<int>(std::floor(fz));
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
-    int z1 = z0 + 1;
-
-    float tx = clamp01(fx - static_cast<float>(x0));
-    float ty = clamp01(fy - static_cast<float>(y0));
-    float tz = clamp01(fz - static_cast<float>(z0));
-
-    auto fetch = [&](int xi, int yi, int zi) -> float {
-        if (xi < 0 || yi < 0 || zi < 0 || xi >= config_.dims.x || yi >= config_.dims.y || zi >= config_.dims.z) {
-            return 0.0f;
-        }
-        return density_[index(xi, yi, zi)];
-    };
+namespace {
+struct Trilinear {
+    float tx, ty, tz;
+
+    float operator()(float c000, float c100, float c010, float c110, float c001, float c101, float c011,
+                     float c111) const {
+        float c00 = c000 * (1.0f - tx) + c100 * tx;
+        float c10 = c010 * (1.0f - tx) + c110 * tx;
+        float c01 = c001 * (1.0f - tx) + c101 * tx;
+        float c11 = c011 * (1.0f - tx) + c111 * tx;
 
-    float c000 = fetch(x0, y0, z0);
-    float c100 = fetch(x1, y0, z0);
-    float c010 = fetch(x0, y1, z0);
-    float c110 = fetch(x1, y1, z0);
-    float c001 = fetch(x0, y0, z1);
-    float c101 = fetch(x1, y0, z1);
-    float c011 = fetch(x0, y1, z1);
-    float c111 = fetch(x1, y1, z1);
+        float c0 = c00 * (1.0f - ty) + c10 * ty;
+        float c1 = c01 * (1.0f - ty) + c11 * ty;
+
+        return c0 * (1.0f - tz) + c1 * tz;
+    }
+};
 
-    float c00 = c000 * (1.0f - tx) + c100 * tx;
-    float c10 = c010 * (1.0f - tx) + c110 * tx;
-    float c01 = c001 * (1.0f - tx) + c101 * tx;
-    float c11 = c011 * (1.0f - tx) + c111 * tx;
+// Lower corner voxel of the trilinear cell around a point and the blend weights within it.
+struct Cell {
+    int x0, y0, z0;
+    Trilinear lerp;
+};
 
-    float c0 = c00 * (1.0f - ty) + c10 * ty;
-    float c1 = c01 * (1.0f - ty) + c11 * ty;
+// Voxels of a block of up to 4^3 starting at (x, y, z), addressed relative to that corner. The
+// block spans at most 2 bricks per axis; their storage is looked up once, with empty bricks and
+// bricks outside the grid standing in as a zero brick, so each fetch is a plain load. Voxels past
+// the volume edge inside an edge brick are never written and read 0 like the rest of the outside.
+template <typename Layout>
+struct BrickBlock {
+    static constexpr int kMaxWidth = 4;
+    const float* data[2][2][2];
+    int pick_x[kMaxWidth], pick_y[kMaxWidth], pick_z[kMaxWidth];  // Brick (0/1) per block offset.
+    int local_x[kMaxWidth], local_y[kMaxWidth], local_z[kMaxWidth];  // Brick-local offset per axis (Layout).
+
+    BrickBlock(const DensityVolume& volume, int x, int y, int z) {
+        constexpr int mask = kBrickSize - 1;
+        const int bx0 = x >> kBrickShift, by0 = y >> kBrickShift, bz0 = z >> kBrickShift;
+        for (int i = 0; i < kMaxWidth; ++i) {
+            pick_x[i] = ((x + i) >> kBrickShift) - bx0;
+            pick_y[i] = ((y + i) >> kBrickShift) - by0;
+            pick_z[i] = ((z + i) >> kBrickShift) - bz0;
+            local_x[i] = Layout::x_offset((x + i) & mask);
+            local_y[i] = Layout::y_offset((y + i) & mask);
+            local_z[i] = Layout::z_offset((z + i) & mask);
+        }
+        const Int3& bricks = volume.brick_dims();
+        for (int dz = 0; dz < 2; ++dz) {
+            for (int dy = 0; dy < 2; ++dy) {
+                for (int dx = 0; dx < 2; ++dx) {
+                    const int bx = bx0 + dx, by = by0 + dy, bz = bz0 + dz;
+                    const bool inside = bx >= 0 && by >= 0 && bz >= 0 && bx < bricks.x && by < bricks.y && bz < bricks.z;
+                    const float* brick = inside ? volume.brick_data(volume.brick_id(bx, by, bz)) : nullptr;
+                    data[dz][dy][dx] = brick ? brick : kZeroBrick.data();
+                }
+            }
+        }
+    }
+
+    float operator()(int i, int j, int k) const {
+        return data[pick_z[k]][pick_y[j]][pick_x[i]][local_x[i] + local_y[j] + local_z[k]];
+    }
+};
+
+// Offsets into the 4^3 block around a trilinear cell (cell = 1..2 per axis) read by
+// sample_with_gradient: the 2x2x2 cell plus one 2x2 face layer on each side.
+constexpr auto kGradientStencil = [] {
+    std::array<std::array<int, 3>, 32> offsets{};
+    size_t n = 0;
+    for (int z = 0; z < 4; ++z) {
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                if ((x == 0 || x == 3) + (y == 0 || y == 3) + (z == 0 || z == 3) <= 1) offsets[n++] = {x, y, z};
+            }
+        }
+    }
+    return offsets;
+}();
 
-    return c0 * (1.0f - tz) + c1 * tz;
+Cell locate_cell(const VolumeConfig& config, Vec3 world_pos) {
+    Vec3 rel = {world_pos.x - config.origin.x,
+                world_pos.y - config.origin.y,
+                world_pos.z - config.origin.z};
+
+    float fx = rel.x / config.voxel_size - 0.5f;
+    float fy = rel.y / config.voxel_size - 0.5f;
+    float fz = rel.z / config.voxel_size - 0.5f;
+
+    Cell cell{};
+    cell.x0 = static_cast<int>(std::floor(fx));
+    cell.y0 = static_cast<int>(std::floor(fy));
+    cell.z0 = static_cast<int>(std::floor(fz));
+    cell.lerp = {clamp01(fx - static_cast<float>(cell.x0)), clamp01(fy - static_cast<float>(cell.y0)),
+                 clamp01(fz - static_cast<float>(cell.z0))};
+    return cell;
+}
+
+#if RAYOL_FLUID_X86
+RAYOL_TARGET_AVX2 inline __m256 lerp(__m256 a, __m256 b, __m256 w, __m256 inv_w) {
+    return _mm256_add_ps(_mm256_mul_ps(a, inv_w), _mm256_mul_ps(b, w));
+}
+
+// Trilinear cells of 8 points, one lane each (the vector form of Cell).
+struct CellLanes {
+    __m256i base[3];  // Lower corner voxel per axis.
+    __m256 t[3];      // Blend weight per axis.
+    __m256 u[3];      // 1 - t.
+
+    RAYOL_TARGET_AVX2 __m256 blend(const __m256 c[8]) const {
+        const __m256 c00 = lerp(c[0], c[1], t[0], u[0]);
+        const __m256 c10 = lerp(c[2], c[3], t[0], u[0]);
+        const __m256 c01 = lerp(c[4], c[5], t[0], u[0]);
+        const __m256 c11 = lerp(c[6], c[7], t[0], u[0]);
+        const __m256 c0 = lerp(c00, c10, t[1], u[1]);
+        const __m256 c1 = lerp(c01, c11, t[1], u[1]);
+        return lerp(c0, c1, t[2], u[2]);
+    }
+    // Blend of the 2x2x2 voxels at offset (ox, oy, oz) from the cell in a [z][y][x] block that
+    // starts one voxel below it (sample_with_gradient's layout).
+    RAYOL_TARGET_AVX2 __m256 blend_block(const __m256 (&b)[4][4][4], int ox, int oy, int oz) const {
+        const int x = 1 + ox, y = 1 + oy, z = 1 + oz;
+        const __m256 c[8] = {b[z][y][x],     b[z][y][x + 1],     b[z][y + 1][x],     b[z][y + 1][x + 1],
+                             b[z + 1][y][x], b[z + 1][y][x + 1], b[z + 1][y + 1][x], b[z + 1][y + 1][x + 1]};
+        return blend(c);
+    }
+};
+
+// locate_cell for 8 positions. Coordinates are clamped to [-3, dims + 2] to stay in int range; a
+// clamped point's whole 4^3 block is outside the volume, as it was before clamping.
+RAYOL_TARGET_AVX2 CellLanes locate_cells_avx2(const VolumeConfig& cfg, const Vec3* positions) {
+    const __m256 voxel_size = _mm256_set1_ps(cfg.voxel_size);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const float origin[3] = {cfg.origin.x, cfg.origin.y, cfg.origin.z};
+    const int dims[3] = {cfg.dims.x, cfg.dims.y, cfg.dims.z};
+    CellLanes cells;
+    for (int axis = 0; axis < 3; ++axis) {
+        alignas(32) float rel[8];
+        for (int k = 0; k < 8; ++k) {
+            const Vec3& p = positions[k];
+            rel[k] = (axis == 0 ? p.x : axis == 1 ? p.y : p.z) - origin[axis];
+        }
+        __m256 f = _mm256_sub_ps(_mm256_div_ps(_mm256_load_ps(rel), voxel_size), _mm256_set1_ps(0.5f));
+        f = _mm256_min_ps(_mm256_max_ps(f, _mm256_set1_ps(-3.0f)), _mm256_set1_ps(static_cast<float>(dims[axis]) + 2.0f));
+        const __m256 fl = _mm256_floor_ps(f);
+        cells.base[axis] = _mm256_cvttps_epi32(fl);
+        cells.t[axis] = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(f, fl), zero), one);
+        cells.u[axis] = _mm256_sub_ps(one, cells.t[axis]);
+    }
+    return cells;
+}
+
+// Pool slot of brick (bx, by, bz) per lane; -1 for empty bricks and bricks outside the grid.
+RAYOL_TARGET_AVX2 inline __m256i gather_brick_slots(const DensityVolume& volume, __m256i bx, __m256i by, __m256i bz) {
+    const Int3& bricks = volume.brick_dims();
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(bx, minus_one), _mm256_cmpgt_epi32(_mm256_set1_epi32(bricks.x), bx));
+    inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(by, minus_one),
+                                                       _mm256_cmpgt_epi32(_mm256_set1_epi32(bricks.y), by)));
+    inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(bz, minus_one),
+                                                       _mm256_cmpgt_epi32(_mm256_set1_epi32(bricks.z), bz)));
+    __m256i brick = _mm256_add_epi32(_mm256_mullo_epi32(bz, _mm256_set1_epi32(bricks.y)), by);
+    brick = _mm256_add_epi32(_mm256_mullo_epi32(brick, _mm256_set1_epi32(bricks.x)), bx);
+    return _mm256_mask_i32gather_epi32(minus_one, volume.brick_slots().data(), brick, inside, 4);
+}
+
+// Layout offset along one axis of per-lane brick-local coordinates in [0, 8): shifts for Linear,
+// an 8-entry table permute otherwise.
+template <typename Layout>
+RAYOL_TARGET_AVX2 inline __m256i local_offsets_avx2(int axis, __m256i local) {
+    if constexpr (std::is_same_v<Layout, LinearLayout>) {
+        return _mm256_slli_epi32(local, kBrickShift * axis);
+    } else {
+        alignas(32) int table[kBrickSize];
+        for (int i = 0; i < kBrickSize; ++i) {
+            table[i] = axis == 0 ? Layout::x_offset(i) : axis == 1 ? Layout::y_offset(i) : Layout::z_offset(i);
+        }
+        return _mm256_permutevar8x32_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(table)), local);
+    }
+}
+
+// Voxel per lane from its brick slot and brick-local index; 0 where the slot is -1.
+RAYOL_TARGET_AVX2 inline __m256 gather_voxels(const float* pool, __m256i slot, __m256i local) {
+    const __m256i index = _mm256_add_epi32(_mm256_slli_epi32(slot, 9), local);  // slot * kBrickVoxels
+    const __m256 valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(slot, _mm256_set1_epi32(-1)));
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), pool, index, valid, 4);
+}
+
+// Eight sample() lookups: per corner, one gather of the brick slots and one of the voxels. Voxels
+// past the volume edge inside an edge brick are never written, so only the brick needs a bounds
+// check. Same arithmetic as the scalar path up to FMA contraction.
+template <typename Layout>
+RAYOL_TARGET_AVX2 void sample8_avx2(const DensityVolume& volume, const Vec3* positions, float* out) {
+    const CellLanes cells = locate_cells_avx2(volume.config(), positions);
+    const __m256i local_mask = _mm256_set1_epi32(kBrickSize - 1);
+    __m256 c[8];
+    for (int corner = 0; corner < 8; ++corner) {
+        __m256i coord[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            coord[axis] = _mm256_add_epi32(cells.base[axis], _mm256_set1_epi32((corner >> axis) & 1));
+        }
+        const __m256i slot = gather_brick_slots(volume, _mm256_srai_epi32(coord[0], kBrickShift),
+                                                _mm256_srai_epi32(coord[1], kBrickShift),
+                                                _mm256_srai_epi32(coord[2], kBrickShift));
+        __m256i local = local_offsets_avx2<Layout>(0, _mm256_and_si256(coord[0], local_mask));
+        local = _mm256_add_epi32(local, local_offsets_avx2<Layout>(1, _mm256_and_si256(coord[1], local_mask)));
+        local = _mm256_add_epi32(local, local_offsets_avx2<Layout>(2, _mm256_and_si256(coord[2], local_mask)));
+        c[corner] = gather_voxels(volume.pool().data(), slot, local);
+    }
+    _mm256_storeu_ps(out, cells.blend(c));
+}
+
+// Eight sample_with_gradient() lookups. Like BrickBlock, the 4^3 block from cell - 1 touches at most
+// 2x2x2 bricks; their slots are gathered once and each of the 32 stencil voxels selects its brick
+// per lane with blends, so a voxel costs one gather.
+template <typename Layout>
+RAYOL_TARGET_AVX2 void sample_with_gradient8_avx2(const DensityVolume& volume, const Vec3* positions,
+                                                  DensitySample* out) {
+    const CellLanes cells = locate_cells_avx2(volume.config(), positions);
+    const __m256i local_mask = _mm256_set1_epi32(kBrickSize - 1);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256i zero_i = _mm256_setzero_si256();
+
+    __m256i brick0[3];
+    __m256i far[3][4];    // Lane takes the upper brick of the pair at block offset i.
+    __m256i local[3][4];  // Brick-local offset along the axis at block offset i.
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m256i first = _mm256_add_epi32(cells.base[axis], minus_one);
+        brick0[axis] = _mm256_srai_epi32(first, kBrickShift);
+        for (int i = 0; i < 4; ++i) {
+            const __m256i coord = _mm256_add_epi32(first, _mm256_set1_epi32(i));
+            far[axis][i] = _mm256_cmpgt_epi32(_mm256_sub_epi32(_mm256_srai_epi32(coord, kBrickShift), brick0[axis]), zero_i);
+            local[axis][i] = local_offsets_avx2<Layout>(axis, _mm256_and_si256(coord, local_mask));
+        }
+    }
+    __m256i slots[2][2][2];
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dy = 0; dy < 2; ++dy) {
+            for (int dx = 0; dx < 2; ++dx) {
+                slots[dz][dy][dx] = gather_brick_slots(volume, _mm256_add_epi32(brick0[0], _mm256_set1_epi32(dx)),
+                                                       _mm256_add_epi32(brick0[1], _mm256_set1_epi32(dy)),
+                                                       _mm256_add_epi32(brick0[2], _mm256_set1_epi32(dz)));
+            }
+        }
+    }
+
+    const float* pool = volume.pool().data();
+    __m256 b[4][4][4];
+    for (int z = 0; z < 4; ++z) {
+        for (int y = 0; y < 4; ++y) {
+            // Slot of the lower and upper x brick for this row, picked along z then y.
+            __m256i row[2];
+            for (int dx = 0; dx < 2; ++dx) {
+                const __m256i near_z = _mm256_blendv_epi8(slots[0][0][dx], slots[0][1][dx], far[1][y]);
+                const __m256i far_z = _mm256_blendv_epi8(slots[1][0][dx], slots[1][1][dx], far[1][y]);
+                row[dx] = _mm256_blendv_epi8(near_z, far_z, far[2][z]);
+            }
+            const __m256i row_local = _mm256_add_epi32(local[1][y], local[2][z]);
+            for (int x = 0; x < 4; ++x) {
+                if ((x == 0 || x == 3) + (y == 0 || y == 3) + (z == 0 || z == 3) > 1) continue;  // kGradientStencil
+                const __m256i slot = _mm256_blendv_epi8(row[0], row[1], far[0][x]);
+                b[z][y][x] = gather_voxels(pool, slot, _mm256_add_epi32(row_local, local[0][x]));
+            }
+        }
+    }
+
+    const __m256 h2 = _mm256_set1_ps(2.0f * volume.config().voxel_size);
+    alignas(32) float value[8], gx[8], gy[8], gz[8];
+    _mm256_store_ps(value, cells.blend_block(b, 0, 0, 0));
+    _mm256_store_ps(gx, _mm256_div_ps(_mm256_sub_ps(cells.blend_block(b, 1, 0, 0), cells.blend_block(b, -1, 0, 0)), h2));
+    _mm256_store_ps(gy, _mm256_div_ps(_mm256_sub_ps(cells.blend_block(b, 0, 1, 0), cells.blend_block(b, 0, -1, 0)), h2));
+    _mm256_store_ps(gz, _mm256_div_ps(_mm256_sub_ps(cells.blend_block(b, 0, 0, 1), cells.blend_block(b, 0, 0, -1)), h2));
+    for (int k = 0; k < 8; ++k) {
+        out[k] = {value[k], {gx[k], gy[k], gz[k]}};
+    }
+}
+
+// Runs an 8-lane kernel over count items; a partial last group repeats its final position in the
+// spare lanes and keeps only the real results.
+template <typename T, typename Kernel>
+void for_each_group8(const Vec3* positions, T* out, size_t count, Kernel&& kernel) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        kernel(positions + i, out + i);
+    }
+    if (i < count) {
+        Vec3 padded[8];
+        T results[8];
+        for (size_t k = 0; k < 8; ++k) {
+            padded[k] = positions[std::min(i + k, count - 1)];
+        }
+        kernel(padded, results);
+        std::copy(results, results + (count - i), out + i);
+    }
+}
+
+bool use_avx2_sampling() {
+    static const bool avx2 = detect_simd_level() == SimdLevel::Avx2;
+    return avx2;
+}
+#endif
+
+template <typename Layout>
+float sample_as(const DensityVolume& volume, Vec3 world_pos) {
+    const Cell cell = locate_cell(volume.config(), world_pos);
+    constexpr int mask = kBrickSize - 1;
+    if ((cell.x0 & mask) != mask && (cell.y0 & mask) != mask && (cell.z0 & mask) != mask) {
+        // All 8 corners in one brick (most cells): one lookup, fixed offsets.
+        const int bx = cell.x0 >> kBrickShift, by = cell.y0 >> kBrickShift, bz = cell.z0 >> kBrickShift;
+        const Int3& bricks = volume.brick_dims();
+        if (bx < 0 || by < 0 || bz < 0 || bx >= bricks.x || by >= bricks.y || bz >= bricks.z) return 0.0f;
+        const float* brick = volume.brick_data(volume.brick_id(bx, by, bz));
+        if (!brick) return 0.0f;
+        const int lx = cell.x0 & mask, ly = cell.y0 & mask, lz = cell.z0 & mask;
+        const int x0 = Layout::x_offset(lx), x1 = Layout::x_offset(lx + 1);
+        const int y0 = Layout::y_offset(ly), y1 = Layout::y_offset(ly + 1);
+        const int z0 = Layout::z_offset(lz), z1 = Layout::z_offset(lz + 1);
+        return cell.lerp(brick[x0 + y0 + z0], brick[x1 + y0 + z0], brick[x0 + y1 + z0], brick[x1 + y1 + z0],
+                         brick[x0 + y0 + z1], brick[x1 + y0 + z1], brick[x0 + y1 + z1], brick[x1 + y1 + z1]);
+    }
+    const BrickBlock<Layout> fetch(volume, cell.x0, cell.y0, cell.z0);
+    return cell.lerp(fetch(0, 0, 0), fetch(1, 0, 0), fetch(0, 1, 0), fetch(1, 1, 0), fetch(0, 0, 1), fetch(1, 0, 1),
+                     fetch(0, 1, 1), fetch(1, 1, 1));
+}
+
+template <typename Layout>
+DensitySample sample_with_gradient_as(const DensityVolume& volume, Vec3 world_pos) {
+    const Cell cell = locate_cell(volume.config(), world_pos);
+
+    // Voxels x0-1 .. x0+2 (and likewise y, z), [z][y][x]. Only the cell and its six face neighbors
+    // (32 voxels) feed the value and the differences; the rest of b is never read.
+    const BrickBlock<Layout> fetch(volume, cell.x0 - 1, cell.y0 - 1, cell.z0 - 1);
+    float b[4][4][4];
+    for (const auto& o : kGradientStencil) {
+        b[o[2]][o[1]][o[0]] = fetch(o[0], o[1], o[2]);
+    }
+    // Trilinear blend of the 2x2x2 block whose lower corner is offset (ox, oy, oz) from the cell.
+    auto blend = [&](int ox, int oy, int oz) {
+        const int x = 1 + ox, y = 1 + oy, z = 1 + oz;
+        return cell.lerp(b[z][y][x], b[z][y][x + 1], b[z][y + 1][x], b[z][y + 1][x + 1], b[z + 1][y][x],
+                         b[z + 1][y][x + 1], b[z + 1][y + 1][x], b[z + 1][y + 1][x + 1]);
+    };
+    const float h2 = 2.0f * volume.config().voxel_size;
+    DensitySample result{};
+    result.density = blend(0, 0, 0);
+    result.gradient = {(blend(1, 0, 0) - blend(-1, 0, 0)) / h2, (blend(0, 1, 0) - blend(0, -1, 0)) / h2,
+                       (blend(0, 0, 1) - blend(0, 0, -1)) / h2};
+    return result;
+}
+}  // namespace
+
+float DensityVolume::sample(Vec3 world_pos) const {
+    if (brick_slot_.empty()) return 0.0f;
+    return with_layout(config_.layout, [&](auto layout) { return sample_as<decltype(layout)>(*this, world_pos); });
 }
 
 Vec3 DensityVolume::gradient(Vec3 world_pos) const {
-    float h = config_.voxel_size;
-    Vec3 dx = {h, 0.0f, 0.0f};
-    Vec3 dy = {0.0f, h, 0.0f};
-    Vec3 dz = {0.0f, 0.0f, h};
-
-    float gx = sample(world_pos + dx) - sample(world_pos - dx);
-    float gy = sample(world_pos + dy) - sample(world_pos - dy);
-    float gz = sample(world_pos + dz) - sample(world_pos - dz);
-    return {gx / (2.0f * h), gy / (2.0f * h), gz / (2.0f * h)};
+    return sample_with_gradient(world_pos).gradient;
+}
+
+DensitySample DensityVolume::sample_with_gradient(Vec3 world_pos) const {
+    if (brick_slot_.empty()) return {};
+    return with_layout(config_.layout,
+                       [&](auto layout) { return sample_with_gradient_as<decltype(layout)>(*this, world_pos); });
+}
+
+void DensityVolume::sample_n(std::span<const Vec3> positions, std::span<float> out) const {
+    const size_t count = std::min(positions.size(), out.size());
+#if RAYOL_FLUID_X86
+    if (use_avx2_sampling() && !brick_slot_.empty()) {
+        with_layout(config_.layout, [&](auto layout) {
+            for_each_group8(positions.data(), out.data(), count,
+                            [this](const Vec3* p, float* o) { sample8_avx2<decltype(layout)>(*this, p, o); });
+        });
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = sample(positions[i]);
+    }
+}
+
+void DensityVolume::sample_with_gradient_n(std::span<const Vec3> positions, std::span<DensitySample> out) const {
+    const size_t count = std::min(positions.size(), out.size());
+#if RAYOL_FLUID_X86
+    if (use_avx2_sampling() && !brick_slot_.empty()) {
+        with_layout(config_.layout, [&](auto layout) {
+            for_each_group8(positions.data(), out.data(), count, [this](const Vec3* p, DensitySample* o) {
+                sample_with_gradient8_avx2<decltype(layout)>(*this, p, o);
+            });
+        });
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = sample_with_gradient(positions[i]);
+    }
 }
 
 }  // namespace rayol::fluid
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <bit>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
 #include <vector>
 
 namespace rayol::fluid {
@@ -32,6 +36,17 @@ inline Vec3 normalize(Vec3 v) {
 inline Vec3 hadamard(Vec3 a, Vec3 b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
 inline Vec3 lerp(Vec3 a, Vec3 b, float t) { return a * (1.0f - t) + b * t; }
 
+// Normalized poly6 kernel 315 / (64 pi h^9) * (h^2 - r^2)^3 from the squared distance; shared by
+// every CPU splat path so they agree bit for bit.
+inline float poly6_weight(float r2, float h) {
+    const float h2 = h * h;
+    if (r2 >= h2 || h <= 0.0f) return 0.0f;
+    const float term = h2 - r2;
+    constexpr float k = 315.0f / (64.0f * 3.14159265359f);
+    const float h9 = h2 * h2 * h2 * h * h;
+    return k * term * term * term / h9;
+}
+
 struct Particle {
     Vec3 position{};
     Vec3 velocity{};
@@ -39,38 +54,292 @@ struct Particle {
     float mass = 1.0f;
 };
 
+// Minimal aligned allocator so SoA arrays start on a SIMD register boundary.
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment})); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t{Alignment}); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+};
+
+constexpr size_t kSimdAlignment = 32;  // One AVX register.
+using FloatArray = std::vector<float, AlignedAllocator<float, kSimdAlignment>>;
+
+// Structure-of-arrays particle container: one aligned float array per component so the SPH
+// kernels can stream positions/velocities into SIMD lanes. Particle is the per-element view.
+struct ParticleStore {
+    FloatArray px, py, pz;
+    FloatArray vx, vy, vz;
+    FloatArray radius;
+    FloatArray mass;
+
+    size_t size() const { return px.size(); }
+    bool empty() const { return px.empty(); }
+
+    void resize(size_t n) {
+        for (FloatArray* a : {&px, &py, &pz, &vx, &vy, &vz, &radius, &mass}) {
+            a->resize(n, 0.0f);
+        }
+    }
+    void clear() { resize(0); }
+
+    Vec3 position(size_t i) const { return {px[i], py[i], pz[i]}; }
+    Vec3 velocity(size_t i) const { return {vx[i], vy[i], vz[i]}; }
+    void set_position(size_t i, Vec3 p) {
+        px[i] = p.x;
+        py[i] = p.y;
+        pz[i] = p.z;
+    }
+    void set_velocity(size_t i, Vec3 v) {
+        vx[i] = v.x;
+        vy[i] = v.y;
+        vz[i] = v.z;
+    }
+
+    Particle particle(size_t i) const { return {position(i), velocity(i), radius[i], mass[i]}; }
+    void set_particle(size_t i, const Particle& p) {
+        set_position(i, p.position);
+        set_velocity(i, p.velocity);
+        radius[i] = p.radius;
+        mass[i] = p.mass;
+    }
+};
+
+// Order of the voxels inside a DensityVolume brick. The 8^3 bricks already tile the volume; this
+// picks how each brick's 512 floats are laid out.
+enum class VoxelLayout {
+    Linear,  // x-major rows: x + 8 * (y + 8 * z).
+    Tiled4,  // 4^3 tiles of 64 floats, x-major inside a tile and tiles x-major in the brick.
+    Morton,  // Z-order: the bits of x, y and z interleaved.
+};
+
 struct VolumeConfig {
     Int3 dims{32, 32, 32};
     float voxel_size = 0.02f;
     Vec3 origin{0.0f, 0.0f, 0.0f};
+    VoxelLayout layout = VoxelLayout::Linear;
 };
 
-// CPU reference volume for density accumulation; GPU path will mirror this layout.
+// Density and its gradient at one point (DensityVolume::sample_with_gradient).
+struct DensitySample {
+    float density = 0.0f;
+    Vec3 gradient{};
+};
+
+// Range of voxel values within one macrocell of a DensityVolume (see update_macrocells).
+struct MacrocellRange {
+    float min = 0.0f;
+    float max = 0.0f;
+};
+
+// Edge length of a DensityVolume brick in voxels; 8^3 floats = 2 KB per brick.
+constexpr int kBrickSize = 8;
+constexpr int kBrickShift = 3;
+constexpr int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+// Edge length of a macrocell (DensityVolume::update_macrocells) in voxels; 2^3 per brick.
+constexpr int kMacrocellSize = 4;
+constexpr int kMacrocellShift = 2;
+
+// Voxel layout policies. A brick-local index is x_offset(x) + y_offset(y) + z_offset(z) for local
+// coordinates in [0, 8), so loops can hoist each axis; LinearLayout reduces to fixed strides.
+struct LinearLayout {
+    static constexpr int x_offset(int x) { return x; }
+    static constexpr int y_offset(int y) { return y * kBrickSize; }
+    static constexpr int z_offset(int z) { return z * kBrickSize * kBrickSize; }
+};
+struct Tiled4Layout {
+    static constexpr int x_offset(int x) { return (x & 3) + (x >> 2) * 64; }
+    static constexpr int y_offset(int y) { return (y & 3) * 4 + (y >> 2) * 128; }
+    static constexpr int z_offset(int z) { return (z & 3) * 16 + (z >> 2) * 256; }
+};
+struct MortonLayout {
+    static constexpr int spread(int v) { return (v & 1) | ((v & 2) << 2) | ((v & 4) << 4); }
+    static constexpr int x_offset(int x) { return spread(x); }
+    static constexpr int y_offset(int y) { return spread(y) << 1; }
+    static constexpr int z_offset(int z) { return spread(z) << 2; }
+};
+
+// Brick-local index of voxel (x, y, z) (any coordinates; only the low bits are used).
+template <typename Layout>
+constexpr int brick_local_index(int x, int y, int z) {
+    constexpr int mask = kBrickSize - 1;
+    return Layout::x_offset(x & mask) + Layout::y_offset(y & mask) + Layout::z_offset(z & mask);
+}
+
+// Calls func with the policy object for layout and returns its result.
+template <typename Func>
+decltype(auto) with_layout(VoxelLayout layout, Func&& func) {
+    switch (layout) {
+    case VoxelLayout::Tiled4:
+        return func(Tiled4Layout{});
+    case VoxelLayout::Morton:
+        return func(MortonLayout{});
+    case VoxelLayout::Linear:
+    default:
+        return func(LinearLayout{});
+    }
+}
+
+// CPU reference volume for density accumulation, stored sparsely: the domain is split into 8^3
+// bricks and only bricks something was written to hold memory (slots of a pool behind a brick
+// index, with an occupancy bitmap). Unallocated voxels read as 0, so sample/gradient behave as on a
+// dense grid while clear, stats and upload scale with the allocated bricks. Voxels within a brick
+// follow config().layout; the GPU image stays dense and receives bricks as x-major regions.
 class DensityVolume {
 public:
     DensityVolume() = default;
     explicit DensityVolume(const VolumeConfig& cfg) { resize(cfg); }
 
     void resize(const VolumeConfig& cfg);
+    // Release every brick (cost proportional to the allocated bricks, not the domain).
     void clear();
 
-    // Splat particles with a smooth kernel (poly6) to prefilter density.
-    void splat_particles(const std::vector<Particle>& particles, float kernel_radius);
+    // Splat particles with a smooth kernel (poly6) to prefilter density. Serial reference; allocates
+    // bricks as it goes.
+    void splat_particles(const ParticleStore& particles, float kernel_radius);
 
     // Tri-linear sample at world position; returns 0 outside the volume.
     float sample(Vec3 world_pos) const;
-    // Gradient via central differences for lighting.
+    // Gradient via central differences for lighting (sample_with_gradient().gradient).
     Vec3 gradient(Vec3 world_pos) const;
+    // sample() and its gradient from one fetch of the 4^3 voxels around the point (32 of them used).
+    // The gradient is the trilinear blend of per-voxel central differences, which equals central
+    // differences of sample() one voxel apart up to rounding, at a sixth of the fetches.
+    DensitySample sample_with_gradient(Vec3 world_pos) const;
+    // sample() at each position into out (same size); 8 lanes at a time with AVX2 gathers when the
+    // CPU supports them.
+    void sample_n(std::span<const Vec3> positions, std::span<float> out) const;
+    // sample_with_gradient() at each position into out, batched the same way.
+    void sample_with_gradient_n(std::span<const Vec3> positions, std::span<DensitySample> out) const;
 
     const VolumeConfig& config() const { return config_; }
-    const std::vector<float>& density() const { return density_; }
+    VoxelLayout layout() const { return config_.layout; }
+    // Voxel value (0 outside the volume or in an unallocated brick).
+    float voxel(int x, int y, int z) const;
+    // Dense x-major copy of the whole volume (tests, benchmarks, debug upload).
+    void copy_dense(std::vector<float>& out) const;
+    // An allocated brick's kBrickVoxels voxels in Linear order into out, whatever the layout (uploads).
+    void copy_brick_linear(int brick, float* out) const;
+
+    // Brick grid. Brick ids are x-major over brick_dims(); allocation is not thread-safe, but
+    // writes into distinct voxels of allocated bricks may run in parallel.
+    const Int3& brick_dims() const { return brick_dims_; }
+    int brick_count() const { return static_cast<int>(brick_slot_.size()); }
+    int brick_id(int bx, int by, int bz) const { return (bz * brick_dims_.y + by) * brick_dims_.x + bx; }
+    Int3 brick_coord(int brick) const {
+        return {brick % brick_dims_.x, (brick / brick_dims_.x) % brick_dims_.y, brick / (brick_dims_.x * brick_dims_.y)};
+    }
+    bool brick_allocated(int brick) const { return (occupancy_[static_cast<size_t>(brick) >> 6] >> (brick & 63)) & 1u; }
+    // Zero-filled storage for the brick, allocating a pool slot if it has none.
+    float* allocate_brick(int brick);
+    void release_brick(int brick);
+    float* brick_data(int brick) {
+        const int slot = brick_slot_[static_cast<size_t>(brick)];
+        return slot < 0 ? nullptr : pool_.data() + static_cast<size_t>(slot) * kBrickVoxels;
+    }
+    const float* brick_data(int brick) const {
+        const int slot = brick_slot_[static_cast<size_t>(brick)];
+        return slot < 0 ? nullptr : pool_.data() + static_cast<size_t>(slot) * kBrickVoxels;
+    }
+    // Pointer to voxel (x, y, z) inside an allocated brick, nullptr if the brick is unallocated.
+    float* voxel_ptr(int x, int y, int z) {
+        float* data = brick_data(brick_id(x >> kBrickShift, y >> kBrickShift, z >> kBrickShift));
+        return data ? data + local_index(x, y, z) : nullptr;
+    }
+    // Brick-local index under this volume's layout (hot loops use brick_local_index<Layout>).
+    int local_index(int x, int y, int z) const {
+        return with_layout(config_.layout, [&](auto layout) { return brick_local_index<decltype(layout)>(x, y, z); });
+    }
+    // Calls func(brick) for every allocated brick in ascending id order (scans the bitmap).
+    template <typename Func>
+    void for_each_brick(const Func& func) const {
+        for (size_t w = 0; w < occupancy_.size(); ++w) {
+            for (uint64_t bits = occupancy_[w]; bits != 0; bits &= bits - 1) {
+                func(static_cast<int>(w * 64 + static_cast<size_t>(std::countr_zero(bits))));
+            }
+        }
+    }
+    size_t allocated_bricks() const { return allocated_; }
+    // Pool slot of a brick (-1 if unallocated) and the pool itself, for packed uploads.
+    int brick_slot(int brick) const { return brick_slot_[static_cast<size_t>(brick)]; }
+    const std::vector<float>& pool() const { return pool_; }
+    const std::vector<int>& brick_slots() const { return brick_slot_; }
+    // Bytes held by the index, bitmap and pool.
+    size_t memory_bytes() const;
+
+    // Change tracking for partial uploads. resize() gives the storage a new id (copies keep it);
+    // clear(), resize() and release_brick() start a reset revision, meaning every voxel may have
+    // changed. Between resets, an edit calls begin_edit() and then every brick it writes is stamped
+    // with the new revision (allocate_brick stamps on its own). A consumer that last saw revision r
+    // of the same storage, with reset_revision() <= r, only needs bricks whose revision is > r.
+    uint64_t storage_id() const { return storage_id_; }
+    uint64_t revision() const { return revision_; }
+    uint64_t reset_revision() const { return reset_revision_; }
+    uint64_t brick_revision(int brick) const { return brick_revision_[static_cast<size_t>(brick)]; }
+    void begin_edit() { ++revision_; }
+    void mark_brick_dirty(int brick) { brick_revision_[static_cast<size_t>(brick)] = revision_; }
+
+    // Macrocells for empty-space skipping: 4^3-voxel cells (2^3 per brick) over macrocell_dims(),
+    // x-major like bricks. Each holds the value range a trilinear sample anywhere in the cell can
+    // read: its voxels plus a one-voxel apron, since samples within half a voxel of a face blend
+    // across it (voxels outside the volume count as 0). max <= 0 means every sample there is <= 0.
+    // update_macrocells() rebuilds the cells around bricks written since its last call (all of them
+    // after a reset revision); until then the ranges are stale and macrocells_current() is false.
+    void update_macrocells();
+    // Macrocells from the brick occupancy alone, for a volume whose bricks only mark where density
+    // is (splat_density_footprint): [0, max] for every cell an allocated brick can reach, update_macrocells'
+    // apron included, and [0, 0] elsewhere. Counts as current until the next edit.
+    void bound_macrocells(float max);
+    bool macrocells_current() const { return macrocell_revision_ == revision_ && !macrocells_.empty(); }
+    uint64_t macrocell_revision() const { return macrocell_revision_; }
+    const Int3& macrocell_dims() const { return macrocell_dims_; }
+    int macrocell_id(int cx, int cy, int cz) const { return (cz * macrocell_dims_.y + cy) * macrocell_dims_.x + cx; }
+    const MacrocellRange& macrocell(int cell) const { return macrocells_[static_cast<size_t>(cell)]; }
+    const std::vector<MacrocellRange>& macrocells() const { return macrocells_; }
 
 private:
-    size_t index(int x, int y, int z) const;
     Vec3 voxel_center(int x, int y, int z) const;
+    template <typename Layout>
+    void splat_particles_as(const ParticleStore& particles, float kernel_radius);
+    template <typename Layout>
+    void scan_macrocells(int brick);
 
     VolumeConfig config_{};
-    std::vector<float> density_;
+    Int3 brick_dims_{};
+    std::vector<int> brick_slot_;      // Brick id -> pool slot, -1 = empty.
+    std::vector<uint64_t> occupancy_;  // One bit per brick id.
+    std::vector<float> pool_;          // kBrickVoxels floats per slot; grows to the high-water mark.
+    std::vector<int> free_slots_;      // Released slots reused before the pool grows.
+    size_t allocated_ = 0;
+    std::vector<uint64_t> brick_revision_;  // Revision of the last write to each brick.
+    uint64_t storage_id_ = 0;
+    uint64_t revision_ = 0;
+    uint64_t reset_revision_ = 0;
+    // Range of one macrocell's own voxels and of each face layer ([2 * axis + side], side 1 = high),
+    // which is all a neighboring cell's apron can see of it.
+    struct CellRanges {
+        MacrocellRange voxels;
+        MacrocellRange faces[6];
+    };
+    Int3 macrocell_dims_{};
+    std::vector<CellRanges> cell_ranges_;
+    std::vector<MacrocellRange> macrocells_;   // Cell plus apron, from cell_ranges_.
+    std::vector<uint32_t> macrocell_stamp_;    // Update generation that last rebuilt each macrocell.
+    uint32_t macrocell_generation_ = 0;
+    std::vector<int> macrocell_bricks_;        // Scratch: bricks rescanned by this update.
+    uint64_t macrocell_revision_ = 0;          // Revision the macrocells were built from.
 };
 
 }  // namespace rayol::fluid
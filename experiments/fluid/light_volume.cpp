@@ -0,0 +1,150 @@
+#include "light_volume.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace rayol::fluid {
+
+namespace {
+// Slice rows per sweep task.
+constexpr size_t kRowGrain = 4;
+
+float component(Vec3 v, int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+}  // namespace
+
+LightSweep light_sweep(const Int3& dims, Vec3 cell, Vec3 light_dir) {
+    const Vec3 l = length(light_dir) > 0.0f ? normalize(light_dir) : Vec3{0.0f, -1.0f, 0.0f};
+    const int n[3] = {dims.x, dims.y, dims.z};
+    LightSweep sweep{};
+    // Slice across the axis the light crosses the most cells of per unit length, so a step toward the
+    // light ends within one cell of the voxel on the other two axes.
+    float best = -1.0f;
+    for (int a = 0; a < 3; ++a) {
+        const float rate = std::fabs(component(l, a)) / component(cell, a);
+        if (rate > best) {
+            best = rate;
+            sweep.axis = a;
+        }
+    }
+    const int a = sweep.axis;
+    const float along = component(l, a);
+    sweep.step_length = component(cell, a) / std::fabs(along);
+    // Light moving toward +axis enters through slice 0.
+    sweep.first = along > 0.0f ? 0 : n[a] - 1;
+    sweep.last = along > 0.0f ? n[a] - 1 : 0;
+    float up[3];
+    for (int i = 0; i < 3; ++i) up[i] = -component(l, i) * sweep.step_length / component(cell, i);
+    up[a] = along > 0.0f ? -1.0f : 1.0f;
+    sweep.upstream = {up[0], up[1], up[2]};
+    return sweep;
+}
+
+void LightVolume::build(const DensityVolume& density, const LightVolumeSettings& settings, TaskScheduler& scheduler) {
+    static std::atomic<uint64_t> next_revision{1};
+    const VolumeConfig& cfg = density.config();
+    settings_ = settings;
+    const int ds = std::max(1, settings.downsample);
+    auto cells = [ds](int voxels) { return std::max(1, (voxels + ds - 1) / ds); };
+    dims_ = {cells(cfg.dims.x), cells(cfg.dims.y), cells(cfg.dims.z)};
+    origin_ = cfg.origin;
+    cell_ = {static_cast<float>(cfg.dims.x) * cfg.voxel_size / static_cast<float>(dims_.x),
+             static_cast<float>(cfg.dims.y) * cfg.voxel_size / static_cast<float>(dims_.y),
+             static_cast<float>(cfg.dims.z) * cfg.voxel_size / static_cast<float>(dims_.z)};
+    values_.assign(static_cast<size_t>(dims_.x) * static_cast<size_t>(dims_.y) * static_cast<size_t>(dims_.z), 0.0f);
+
+    const LightSweep sweep = light_sweep(dims_, cell_, settings.light_dir);
+    const int a = sweep.axis;
+    const int b = (a + 1) % 3;
+    const int c = (a + 2) % 3;
+    const int n[3] = {dims_.x, dims_.y, dims_.z};
+    const size_t stride[3] = {1, static_cast<size_t>(dims_.x), static_cast<size_t>(dims_.x) * dims_.y};
+    const Vec3 to_upstream{sweep.upstream.x * cell_.x, sweep.upstream.y * cell_.y, sweep.upstream.z * cell_.z};
+    // The upstream point sits at the same offset from every voxel, so the bilinear taps on the previous
+    // slice share offsets and weights. Taps outside the grid are light entering through a side: depth 0.
+    const float ub = component(sweep.upstream, b);
+    const float uc = component(sweep.upstream, c);
+    const int ob = static_cast<int>(std::floor(ub));
+    const int oc = static_cast<int>(std::floor(uc));
+    const float fb = ub - static_cast<float>(ob);
+    const float fc = uc - static_cast<float>(oc);
+    const float weights[2][2] = {{(1.0f - fb) * (1.0f - fc), fb * (1.0f - fc)}, {(1.0f - fb) * fc, fb * fc}};
+
+    const int slice_step = sweep.first <= sweep.last ? 1 : -1;
+    for (int s = sweep.first;; s += slice_step) {
+        const bool has_prev = s != sweep.first;
+        const size_t prev_base = has_prev ? static_cast<size_t>(s - slice_step) * stride[a] : 0;
+        scheduler.parallel_for_range(0, static_cast<size_t>(n[c]), kRowGrain, [&](size_t row_begin, size_t row_end) {
+            // Densities at the row's voxel centers, then at their upstream points.
+            const size_t nb = static_cast<size_t>(n[b]);
+            std::vector<Vec3> pos(nb * 2);
+            std::vector<float> rho(nb * 2);
+            for (size_t row = row_begin; row < row_end; ++row) {
+                int v[3];
+                v[a] = s;
+                v[c] = static_cast<int>(row);
+                for (size_t i = 0; i < nb; ++i) {
+                    v[b] = static_cast<int>(i);
+                    pos[i] = {origin_.x + (static_cast<float>(v[0]) + 0.5f) * cell_.x,
+                              origin_.y + (static_cast<float>(v[1]) + 0.5f) * cell_.y,
+                              origin_.z + (static_cast<float>(v[2]) + 0.5f) * cell_.z};
+                    pos[nb + i] = pos[i] + to_upstream;
+                }
+                density.sample_n(pos, rho);
+                const size_t row_base = static_cast<size_t>(s) * stride[a] + row * stride[c];
+                for (size_t i = 0; i < nb; ++i) {
+                    float depth = 0.5f * (rho[i] + rho[nb + i]) * sweep.step_length;
+                    if (has_prev) {
+                        for (int dc = 0; dc < 2; ++dc) {
+                            const int jc = static_cast<int>(row) + oc + dc;
+                            if (jc < 0 || jc >= n[c]) continue;
+                            for (int db = 0; db < 2; ++db) {
+                                const int jb = static_cast<int>(i) + ob + db;
+                                if (jb < 0 || jb >= n[b]) continue;
+                                depth += weights[dc][db] *
+                                         values_[prev_base + static_cast<size_t>(jb) * stride[b] +
+                                                 static_cast<size_t>(jc) * stride[c]];
+                            }
+                        }
+                    }
+                    values_[row_base + i * stride[b]] = depth;
+                }
+            }
+        });
+        if (s == sweep.last) break;
+    }
+    revision_ = next_revision.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LightVolume::clear() {
+    values_.clear();
+    values_.shrink_to_fit();
+    dims_ = {};
+    revision_ = 0;
+}
+
+float LightVolume::optical_depth(Vec3 pos) const {
+    if (values_.empty()) return 0.0f;
+    auto axis = [](float p, float origin, float cell, int dim, int& i0, float& t) {
+        const float g = std::clamp((p - origin) / cell - 0.5f, 0.0f, static_cast<float>(dim - 1));
+        i0 = std::min(static_cast<int>(g), std::max(dim - 2, 0));
+        t = g - static_cast<float>(i0);
+    };
+    int x0, y0, z0;
+    float tx, ty, tz;
+    axis(pos.x, origin_.x, cell_.x, dims_.x, x0, tx);
+    axis(pos.y, origin_.y, cell_.y, dims_.y, y0, ty);
+    axis(pos.z, origin_.z, cell_.z, dims_.z, z0, tz);
+    const size_t sx = dims_.x > 1 ? 1 : 0;
+    const size_t sy = dims_.y > 1 ? static_cast<size_t>(dims_.x) : 0;
+    const size_t sz = dims_.z > 1 ? static_cast<size_t>(dims_.x) * static_cast<size_t>(dims_.y) : 0;
+    const float* v = values_.data() + (static_cast<size_t>(z0) * dims_.y + static_cast<size_t>(y0)) * dims_.x +
+                     static_cast<size_t>(x0);
+    auto lerp1 = [](float lo, float hi, float t) { return lo + (hi - lo) * t; };
+    const float c00 = lerp1(v[0], v[sx], tx);
+    const float c10 = lerp1(v[sy], v[sy + sx], tx);
+    const float c01 = lerp1(v[sz], v[sz + sx], tx);
+    const float c11 = lerp1(v[sz + sy], v[sz + sy + sx], tx);
+    return lerp1(lerp1(c00, c10, ty), lerp1(c01, c11, ty), tz);
+}
+
+}  // namespace rayol::fluid
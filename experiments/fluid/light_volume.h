@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "fluid_sim.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+struct LightVolumeSettings {
+    Vec3 light_dir{-0.4f, -1.0f, -0.2f};  // Direction the light travels (RayMarchSettings::light_dir).
+    int downsample = 2;  // Density voxels per light voxel along each axis.
+};
+
+// How the sweep walks the light grid: slices across `axis` from `first` to `last` (inclusive, `first`
+// facing the light). A voxel's step toward the light ends `upstream` voxels away, on the previous slice
+// (upstream[axis] = +-1), after step_length world units. Shared with light_volume.comp.
+struct LightSweep {
+    int axis = 1;
+    int first = 0;
+    int last = 0;
+    Vec3 upstream{};
+    float step_length = 0.0f;
+};
+
+LightSweep light_sweep(const Int3& dims, Vec3 cell, Vec3 light_dir);
+
+// Optical depth toward a directional light over the density volume's box: for each voxel center of a
+// dense x-major grid, the integral of the (unscaled) density from it to the box along -light_dir. Built
+// by sweeping slices in light order, each voxel adding one trapezoid step to the depth interpolated on
+// the previous slice, so a build costs two density samples per voxel instead of a march per sample.
+// Marchers turn it into shadowed light with one lookup: exp(-depth * density_scale * absorption), so
+// changing those does not need a rebuild. The grid spans the density box exactly (cells need not be
+// cubes when the dims do not divide by the downsample).
+class LightVolume {
+public:
+    // Rebuild from `density` in parallel (rows of a slice per task, slices in order).
+    void build(const DensityVolume& density, const LightVolumeSettings& settings, TaskScheduler& scheduler);
+    void clear();
+
+    bool empty() const { return values_.empty(); }
+    const LightVolumeSettings& settings() const { return settings_; }
+    const Int3& dims() const { return dims_; }
+    Vec3 origin() const { return origin_; }
+    Vec3 cell_size() const { return cell_; }
+    // Identifies the build the values came from (unique across volumes, 0 = never built).
+    uint64_t revision() const { return revision_; }
+    const std::vector<float>& values() const { return values_; }  // Optical depth per voxel.
+
+    // Trilinear optical depth at a world position, clamped to the outermost voxel centers like the
+    // GPU's clamp-to-edge sampler; 0 when empty.
+    float optical_depth(Vec3 pos) const;
+    // Fraction of the light reaching pos for an extinction of sigma_scale per unit of density.
+    float transmittance(Vec3 pos, float sigma_scale) const { return std::exp(-optical_depth(pos) * sigma_scale); }
+
+private:
+    LightVolumeSettings settings_{};
+    Int3 dims_{};
+    Vec3 origin_{};
+    Vec3 cell_{};
+    uint64_t revision_ = 0;
+    std::vector<float> values_;
+};
+
+}  // namespace rayol::fluid
@@ -0,0 +1,115 @@
+#include "morton_order.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace rayol::fluid {
+
+namespace {
+constexpr int kRadixBits = 8;
+constexpr size_t kRadixBuckets = size_t{1} << kRadixBits;
+// Minimum particles per sort block; each block keeps its own digit histogram so the scatter is
+// stable without atomics (same scheme as build_neighbor_grid).
+constexpr size_t kMinParticlesPerBlock = 4096;
+constexpr int kMaxCellCoord = 1023;
+}  // namespace
+
+void compute_morton_order(MortonOrder& morton,
+                          const ParticleStore& particles,
+                          Vec3 origin,
+                          float cell_size,
+                          TaskScheduler& scheduler) {
+    const size_t n = particles.size();
+    morton.keys.resize(n);
+    morton.keys_tmp.resize(n);
+    morton.order.resize(n);
+    morton.order_tmp.resize(n);
+    if (n == 0) return;
+
+    const float inv_cell = cell_size > 0.0f ? 1.0f / cell_size : 1.0f;
+    auto axis = [&](float p, float o) {
+        int c = static_cast<int>(std::floor((p - o) * inv_cell));
+        return static_cast<uint32_t>(std::clamp(c, 0, kMaxCellCoord));
+    };
+    scheduler.parallel_for(0, n, [&](size_t i) {
+        morton.keys[i] = morton_encode(axis(particles.px[i], origin.x), axis(particles.py[i], origin.y),
+                                       axis(particles.pz[i], origin.z));
+        morton.order[i] = static_cast<int>(i);
+    });
+
+    uint32_t max_key = 0;
+    for (uint32_t key : morton.keys) {
+        max_key = std::max(max_key, key);
+    }
+    const int key_bits = std::bit_width(max_key);
+
+    size_t blocks = std::min<size_t>(scheduler.thread_count(), n / kMinParticlesPerBlock);
+    blocks = std::max<size_t>(1, blocks);
+    const size_t block_size = (n + blocks - 1) / blocks;
+
+    // LSD radix sort of (key, index) pairs, one digit per pass.
+    for (int shift = 0; shift < key_bits; shift += kRadixBits) {
+        morton.block_offsets.assign(blocks * kRadixBuckets, 0);
+        scheduler.parallel_for(0, blocks, [&](size_t b) {
+            int* counts = morton.block_offsets.data() + b * kRadixBuckets;
+            const size_t end = std::min(n, (b + 1) * block_size);
+            for (size_t i = b * block_size; i < end; ++i) {
+                ++counts[(morton.keys[i] >> shift) & (kRadixBuckets - 1)];
+            }
+        }, 1);
+
+        int running = 0;
+        for (size_t digit = 0; digit < kRadixBuckets; ++digit) {
+            for (size_t b = 0; b < blocks; ++b) {
+                int& slot = morton.block_offsets[b * kRadixBuckets + digit];
+                int count = slot;
+                slot = running;
+                running += count;
+            }
+        }
+
+        scheduler.parallel_for(0, blocks, [&](size_t b) {
+            int* cursor = morton.block_offsets.data() + b * kRadixBuckets;
+            const size_t end = std::min(n, (b + 1) * block_size);
+            for (size_t i = b * block_size; i < end; ++i) {
+                const uint32_t key = morton.keys[i];
+                const int dst = cursor[(key >> shift) & (kRadixBuckets - 1)]++;
+                morton.keys_tmp[dst] = key;
+                morton.order_tmp[dst] = morton.order[i];
+            }
+        }, 1);
+        morton.keys.swap(morton.keys_tmp);
+        morton.order.swap(morton.order_tmp);
+    }
+}
+
+void apply_morton_order(MortonOrder& morton, ParticleStore& particles, TaskScheduler& scheduler) {
+    const size_t n = particles.size();
+    if (n != morton.order.size()) return;
+    ParticleStore& dst = morton.particles_tmp;
+    dst.resize(n);
+    scheduler.parallel_for(0, n, [&](size_t i) {
+        const size_t src = static_cast<size_t>(morton.order[i]);
+        dst.px[i] = particles.px[src];
+        dst.py[i] = particles.py[src];
+        dst.pz[i] = particles.pz[src];
+        dst.vx[i] = particles.vx[src];
+        dst.vy[i] = particles.vy[src];
+        dst.vz[i] = particles.vz[src];
+        dst.radius[i] = particles.radius[src];
+        dst.mass[i] = particles.mass[src];
+    });
+    std::swap(particles, dst);
+}
+
+void apply_morton_order(MortonOrder& morton, std::vector<float>& values, TaskScheduler& scheduler) {
+    if (values.size() != morton.order.size()) return;
+    morton.values_tmp.resize(values.size());
+    scheduler.parallel_for(0, values.size(), [&](size_t i) {
+        morton.values_tmp[i] = values[static_cast<size_t>(morton.order[i])];
+    });
+    values.swap(morton.values_tmp);
+}
+
+}  // namespace rayol::fluid
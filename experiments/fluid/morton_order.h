@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "fluid_sim.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+// Interleave the low 10 bits of x, y and z (x in the lowest bit) into a 30-bit Z-order key.
+inline uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z) {
+    auto spread = [](uint32_t v) {
+        v &= 0x3ffu;
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8)) & 0x0300f00fu;
+        v = (v | (v << 4)) & 0x030c30c3u;
+        v = (v | (v << 2)) & 0x09249249u;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+// Z-order permutation of a particle set over cells of a uniform grid, plus the scratch to apply it.
+// Sorting particles this way keeps spatial neighbors close in memory, so the grid gather, the SPH
+// passes and the density splat stop jumping across the arrays.
+struct MortonOrder {
+    // New index -> previous particle index (stable within a cell).
+    std::vector<int> order;
+
+    // Scratch, kept to avoid reallocating on every reorder.
+    std::vector<uint32_t> keys, keys_tmp;
+    std::vector<int> order_tmp;
+    std::vector<int> block_offsets;
+    ParticleStore particles_tmp;
+    std::vector<float> values_tmp;
+};
+
+// Radix sort particles by the Morton code of their cell (cells of cell_size from origin, up to 1024
+// per axis) in parallel. Only the key bits in use are sorted.
+void compute_morton_order(MortonOrder& morton,
+                          const ParticleStore& particles,
+                          Vec3 origin,
+                          float cell_size,
+                          TaskScheduler& scheduler);
+
+// Permute particles (and per-particle values) into morton.order; no-op on a size mismatch.
+void apply_morton_order(MortonOrder& morton, ParticleStore& particles, TaskScheduler& scheduler);
+void apply_morton_order(MortonOrder& morton, std::vector<float>& values, TaskScheduler& scheduler);
+
+}  // namespace rayol::fluid
@@ -0,0 +1,166 @@
+#include "neighbor_grid.h"
+
+#include <algorithm>
+
+namespace rayol::fluid {
+
+namespace {
+// Minimum particles per counting-sort block. Each block (at most one per thread) keeps its own
+// per-cell histogram so the scatter stays stable without atomics.
+constexpr size_t kMinParticlesPerBlock = 4096;
+// Upper bound on histogram entries (blocks * cells) to keep scratch memory small on fine grids.
+constexpr size_t kMaxHistogramEntries = size_t{1} << 22;
+}  // namespace
+
+void build_neighbor_grid(NeighborGrid& grid,
+                         const VolumeConfig& volume_config,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         TaskScheduler& scheduler) {
+    grid.origin = volume_config.origin;
+    float h = kernel_radius;
+    if (h <= 0.0f) {
+        h = 0.01f;
+    }
+    grid.cell_size = h;
+
+    Vec3 extent{
+        static_cast<float>(volume_config.dims.x) * volume_config.voxel_size,
+        static_cast<float>(volume_config.dims.y) * volume_config.voxel_size,
+        static_cast<float>(volume_config.dims.z) * volume_config.voxel_size,
+    };
+
+    auto dim_for_axis = [&](float axis_extent) {
+        int d = static_cast<int>(std::ceil(axis_extent / grid.cell_size));
+        return std::max(d, 1);
+    };
+
+    grid.dims.x = dim_for_axis(extent.x);
+    grid.dims.y = dim_for_axis(extent.y);
+    grid.dims.z = dim_for_axis(extent.z);
+
+    const size_t n = particles.size();
+    const size_t cells = static_cast<size_t>(grid.cell_count());
+    grid.particle_cell.resize(n);
+    grid.order.resize(n);
+    for (FloatArray* a : {&grid.px, &grid.py, &grid.pz, &grid.vx, &grid.vy, &grid.vz, &grid.mass}) {
+        a->resize(n + kSphRunPadding, 0.0f);
+    }
+
+    // 1) Cell of every particle.
+    scheduler.parallel_for(0, n, [&](size_t i) {
+        Int3 c = grid.cell_coord(particles.position(i));
+        grid.particle_cell[i] = grid.cell_index(c.x, c.y, c.z);
+    });
+
+    // 2) Per-block histograms.
+    size_t blocks = std::min<size_t>(scheduler.thread_count(), n / kMinParticlesPerBlock);
+    blocks = std::max<size_t>(1, blocks);
+    blocks = std::min(blocks, std::max<size_t>(1, kMaxHistogramEntries / std::max<size_t>(cells, 1)));
+    const size_t block_size = (n + blocks - 1) / std::max<size_t>(blocks, 1);
+    grid.block_offsets.assign(blocks * cells, 0);
+    scheduler.parallel_for(0, blocks, [&](size_t b) {
+        int* counts = grid.block_offsets.data() + b * cells;
+        size_t end = std::min(n, (b + 1) * block_size);
+        for (size_t i = b * block_size; i < end; ++i) {
+            ++counts[grid.particle_cell[i]];
+        }
+    }, 1);
+
+    // 3) Prefix sum: cell starts, then each block's write cursor within every cell.
+    grid.cell_start.resize(cells + 1);
+    int running = 0;
+    for (size_t c = 0; c < cells; ++c) {
+        grid.cell_start[c] = running;
+        for (size_t b = 0; b < blocks; ++b) {
+            int& slot = grid.block_offsets[b * cells + c];
+            int count = slot;
+            slot = running;
+            running += count;
+        }
+    }
+    grid.cell_start[cells] = running;
+
+    // 4) Stable scatter of particle indices into cell order.
+    scheduler.parallel_for(0, blocks, [&](size_t b) {
+        int* cursor = grid.block_offsets.data() + b * cells;
+        size_t end = std::min(n, (b + 1) * block_size);
+        for (size_t i = b * block_size; i < end; ++i) {
+            grid.order[cursor[grid.particle_cell[i]]++] = static_cast<int>(i);
+        }
+    }, 1);
+
+    // 5) Gather particle data in sorted order.
+    gather_neighbor_grid(grid, particles, scheduler);
+}
+
+void gather_neighbor_grid(NeighborGrid& grid, const ParticleStore& particles, TaskScheduler& scheduler) {
+    // Sequential writes, independent reads.
+    scheduler.parallel_for(0, grid.order.size(), [&](size_t slot) {
+        const size_t i = static_cast<size_t>(grid.order[slot]);
+        grid.px[slot] = particles.px[i];
+        grid.py[slot] = particles.py[i];
+        grid.pz[slot] = particles.pz[i];
+        grid.vx[slot] = particles.vx[i];
+        grid.vy[slot] = particles.vy[i];
+        grid.vz[slot] = particles.vz[i];
+        grid.mass[slot] = particles.mass[i];
+    });
+}
+
+void accumulate_pair_densities(const NeighborGrid& grid,
+                               const SphKernels& kernels,
+                               const SphNeighborData& data,
+                               float kernel_radius,
+                               float* rho,
+                               TaskScheduler& scheduler) {
+    const float h = kernel_radius;
+    // Start from the self term (r = 0), then add both sides of every pair.
+    scheduler.parallel_for(0, grid.order.size(), [&](size_t s) { rho[s] = grid.mass[s]; });
+    for_each_cell_colored(grid, scheduler, [&](int x, int y, int z) {
+        const int cell = grid.cell_index(x, y, z);
+        const int cell_end = grid.cell_start[cell + 1];
+        for (int i = grid.cell_start[cell]; i < cell_end; ++i) {
+            const Vec3 pos = grid.position(i);
+            const float mass = grid.mass[i];
+            float rho_i = kernels.density_pairs(data, i + 1, cell_end, pos, mass, h, rho);
+            for_each_half_stencil_run(grid, x, y, z, [&](int begin, int end) {
+                rho_i += kernels.density_pairs(data, begin, end, pos, mass, h, rho);
+            });
+            rho[i] += rho_i;
+        }
+    });
+}
+
+void accumulate_pair_forces(const NeighborGrid& grid,
+                            const SphKernels& kernels,
+                            const SphNeighborData& data,
+                            float kernel_radius,
+                            float viscosity,
+                            float* ax,
+                            float* ay,
+                            float* az,
+                            TaskScheduler& scheduler) {
+    const float h = kernel_radius;
+    scheduler.parallel_for(0, grid.order.size(), [&](size_t s) {
+        ax[s] = 0.0f;
+        ay[s] = 0.0f;
+        az[s] = 0.0f;
+    });
+    for_each_cell_colored(grid, scheduler, [&](int x, int y, int z) {
+        const int cell = grid.cell_index(x, y, z);
+        const int cell_end = grid.cell_start[cell + 1];
+        for (int i = grid.cell_start[cell]; i < cell_end; ++i) {
+            const SphParticle self{grid.position(i), grid.velocity(i), data.density[i], data.pressure[i]};
+            Vec3 a = kernels.force_pairs(data, i + 1, cell_end, self, h, viscosity, ax, ay, az);
+            for_each_half_stencil_run(grid, x, y, z, [&](int begin, int end) {
+                a = a + kernels.force_pairs(data, begin, end, self, h, viscosity, ax, ay, az);
+            });
+            ax[i] += a.x;
+            ay[i] += a.y;
+            az[i] += a.z;
+        }
+    });
+}
+
+}  // namespace rayol::fluid
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "fluid_sim.h"
+#include "sph_kernels.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+// Cell-ordered uniform grid to accelerate SPH neighbor queries. Built with a counting sort:
+// per-cell counts, a prefix sum into cell_start, then a stable scatter that copies particle data
+// into cell order so a neighbor query is a handful of linear scans instead of a pointer chase.
+struct NeighborGrid {
+    Int3 dims{};
+    Vec3 origin{};
+    float cell_size = 0.0f;
+    // Cell c owns sorted slots [cell_start[c], cell_start[c + 1]); cell count + 1 entries.
+    std::vector<int> cell_start;
+    // Sorted slot -> particle index (particles keep their index order within a cell).
+    std::vector<int> order;
+    // Particle data gathered into sorted order (SoA, aligned for the SIMD kernels, with
+    // kSphRunPadding trailing floats so masked tail loads stay in bounds).
+    FloatArray px, py, pz;
+    FloatArray vx, vy, vz;
+    FloatArray mass;
+
+    // Build scratch, kept to avoid reallocating every frame.
+    std::vector<int> particle_cell;
+    std::vector<int> block_offsets;
+
+    int cell_count() const { return dims.x * dims.y * dims.z; }
+    Vec3 position(int slot) const { return {px[slot], py[slot], pz[slot]}; }
+    Vec3 velocity(int slot) const { return {vx[slot], vy[slot], vz[slot]}; }
+    int cell_index(int x, int y, int z) const { return (z * dims.y + y) * dims.x + x; }
+    // Clamped cell coordinate containing a world position.
+    Int3 cell_coord(Vec3 pos) const {
+        auto axis = [&](float p, float o, int d) {
+            int c = static_cast<int>(std::floor((p - o) / cell_size));
+            return c < 0 ? 0 : (c >= d ? d - 1 : c);
+        };
+        return {axis(pos.x, origin.x, dims.x), axis(pos.y, origin.y, dims.y), axis(pos.z, origin.z, dims.z)};
+    }
+};
+
+// Rebuild the grid over the simulation volume (cell size = kernel radius) in parallel.
+void build_neighbor_grid(NeighborGrid& grid,
+                         const VolumeConfig& volume_config,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         TaskScheduler& scheduler);
+
+// Refresh the gathered position/velocity/mass arrays from `particles` without re-sorting. Slots keep
+// the order of the last build, so cell_start goes stale as particles move; callers that only need
+// per-slot data (e.g. a cached NeighborList) can skip the full rebuild.
+void gather_neighbor_grid(NeighborGrid& grid, const ParticleStore& particles, TaskScheduler& scheduler);
+
+// Visit the sorted-slot runs that can hold neighbors of `pos`: func(begin, end) once per row of
+// the 3x3x3 cell block. Cells along x are adjacent in sorted order, so each row is one run.
+template <typename Func>
+void for_each_neighbor_run(const NeighborGrid& grid, Vec3 pos, const Func& func) {
+    if (grid.order.empty()) return;
+    const Int3 c = grid.cell_coord(pos);
+
+    const int min_x = std::max(c.x - 1, 0);
+    const int max_x = std::min(c.x + 1, grid.dims.x - 1);
+    const int min_y = std::max(c.y - 1, 0);
+    const int max_y = std::min(c.y + 1, grid.dims.y - 1);
+    const int min_z = std::max(c.z - 1, 0);
+    const int max_z = std::min(c.z + 1, grid.dims.z - 1);
+
+    for (int z = min_z; z <= max_z; ++z) {
+        for (int y = min_y; y <= max_y; ++y) {
+            const int row = grid.cell_index(0, y, z);
+            const int begin = grid.cell_start[row + min_x];
+            const int end = grid.cell_start[row + max_x + 1];
+            if (begin < end) {
+                func(begin, end);
+            }
+        }
+    }
+}
+
+// Half stencil for symmetric pair sums: visit the slot runs of the 13 "forward" neighbor cells of
+// cell (x, y, z) (+x; the y + 1 row; the z + 1 layer), so every pair of distinct neighboring cells
+// is seen from exactly one side. Pairs inside the cell itself are left to the caller. Calls
+// func(begin, end) for up to 5 runs.
+template <typename Func>
+void for_each_half_stencil_run(const NeighborGrid& grid, int x, int y, int z, const Func& func) {
+    const int min_x = std::max(x - 1, 0);
+    const int max_x = std::min(x + 1, grid.dims.x - 1);
+    auto run = [&](int first_x, int last_x, int ry, int rz) {
+        const int row = grid.cell_index(0, ry, rz);
+        const int begin = grid.cell_start[row + first_x];
+        const int end = grid.cell_start[row + last_x + 1];
+        if (begin < end) {
+            func(begin, end);
+        }
+    };
+    if (x + 1 < grid.dims.x) {
+        run(x + 1, x + 1, y, z);
+    }
+    if (y + 1 < grid.dims.y) {
+        run(min_x, max_x, y + 1, z);
+    }
+    if (z + 1 < grid.dims.z) {
+        for (int ry = std::max(y - 1, 0); ry <= std::min(y + 1, grid.dims.y - 1); ++ry) {
+            run(min_x, max_x, ry, z + 1);
+        }
+    }
+}
+
+// Run func(x, y, z) for every cell such that cells running concurrently never share a half
+// stencil: a cell's stencil writes rows y..y+1 of its own z layer and y-1..y+1 of the next. A task
+// takes two rows (y = 2b, 2b + 1) of one layer, and the four colors of (z, b) parity run one after
+// another, so tasks of a color are two layers or two row pairs apart: about dims.y * dims.z / 8
+// tasks per color. Accumulation order is fixed, so results do not depend on the thread count.
+template <typename Func>
+void for_each_cell_colored(const NeighborGrid& grid, TaskScheduler& scheduler, const Func& func) {
+    const int row_pairs = (grid.dims.y + 1) / 2;
+    for (int color = 0; color < 4; ++color) {
+        const int z_phase = color & 1;
+        const int pair_phase = color >> 1;
+        const size_t layers = static_cast<size_t>(std::max(0, grid.dims.z - z_phase + 1) / 2);
+        const size_t pairs = static_cast<size_t>(std::max(0, row_pairs - pair_phase + 1) / 2);
+        scheduler.parallel_for(0, layers * pairs, [&](size_t task) {
+            const int z = static_cast<int>(task / pairs) * 2 + z_phase;
+            const int y_begin = (static_cast<int>(task % pairs) * 2 + pair_phase) * 2;
+            const int y_end = std::min(y_begin + 2, grid.dims.y);
+            for (int y = y_begin; y < y_end; ++y) {
+                for (int x = 0; x < grid.dims.x; ++x) {
+                    func(x, y, z);
+                }
+            }
+        }, 1);
+    }
+}
+
+// Symmetric SPH passes over the grid's sorted slots: each pair is evaluated once via the half
+// stencil (for_each_cell_colored keeps the in-place writes race-free) and applied to both
+// particles. rho / ax, ay, az are per-slot outputs that are overwritten (densities include the self
+// term); like the kernel inputs they need kSphRunPadding trailing entries.
+void accumulate_pair_densities(const NeighborGrid& grid,
+                               const SphKernels& kernels,
+                               const SphNeighborData& data,
+                               float kernel_radius,
+                               float* rho,
+                               TaskScheduler& scheduler);
+void accumulate_pair_forces(const NeighborGrid& grid,
+                            const SphKernels& kernels,
+                            const SphNeighborData& data,
+                            float kernel_radius,
+                            float viscosity,
+                            float* ax,
+                            float* ay,
+                            float* az,
+                            TaskScheduler& scheduler);
+
+// Visit every sorted slot j within `radius` of `pos`: func(j, pos - position(j), distance).
+template <typename Func>
+void for_each_neighbor(const NeighborGrid& grid, Vec3 pos, float radius, const Func& func) {
+    const float r2_max = radius * radius;
+    for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+            Vec3 rij = pos - grid.position(j);
+            float r2 = dot(rij, rij);
+            if (r2 <= r2_max) {
+                func(j, rij, std::sqrt(r2));
+            }
+        }
+    });
+}
+
+}  // namespace rayol::fluid
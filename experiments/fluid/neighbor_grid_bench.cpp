@@ -0,0 +1,522 @@
+#include "neighbor_grid_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "neighbor_grid.h"
+#include "neighbor_list.h"
+#include "pbf_solver.h"
+#include "sph_kernels.h"
+
+namespace rayol::fluid {
+
+namespace {
+// Average and largest kernel density of the sim's particles relative to the PBF rest density.
+std::pair<float, float> measure_compression(const FluidExperiment& sim) {
+    const ParticleStore& particles = sim.particles();
+    const size_t n = particles.size();
+    if (n == 0) return {0.0f, 0.0f};
+    TaskScheduler scheduler(1);
+    NeighborGrid grid{};
+    const float h = sim.settings().kernel_radius;
+    build_neighbor_grid(grid, sim.volume().config(), particles, h, scheduler);
+    SphNeighborData data{};
+    data.px = grid.px.data();
+    data.py = grid.py.data();
+    data.pz = grid.pz.data();
+    data.mass = grid.mass.data();
+    const SphKernels& kernels = best_sph_kernels();
+    const float inv_rho0 = 1.0f / pbf_rest_density(kPbfRestSpacing);
+    float sum = 0.0f;
+    float max = 0.0f;
+    for (size_t s = 0; s < n; ++s) {
+        const Vec3 pos = grid.position(static_cast<int>(s));
+        float rho = 0.0f;
+        for_each_neighbor_run(grid, pos, [&](int begin, int end) { rho += kernels.density(data, begin, end, pos, h); });
+        sum += rho * inv_rho0;
+        max = std::max(max, rho * inv_rho0);
+    }
+    return {sum / static_cast<float>(n), max};
+}
+}  // namespace
+
+std::vector<StepBenchmarkResult> benchmark_step_scaling(const FluidSettings& settings, int steps, float dt) {
+    std::vector<StepBenchmarkResult> results;
+    steps = std::max(1, steps);
+    for (int threads : thread_counts_to_test()) {
+        FluidSettings run_settings = settings;
+        run_settings.thread_count = threads;
+        run_settings.max_substeps = 1;  // Time single SPH steps.
+
+        FluidExperiment sim;
+        settle(sim, run_settings, kWarmupSteps, dt);
+
+        StepBenchmarkResult result{};
+        result.thread_count = static_cast<int>(sim.stats().thread_count);
+        result.particle_count = sim.stats().particle_count;
+        result.min_step_ms = 0.0f;
+        float total_ms = 0.0f;
+        for (int i = 0; i < steps; ++i) {
+            sim.update(dt);
+            float ms = sim.stats().step_ms;
+            total_ms += ms;
+            result.min_step_ms = (i == 0) ? ms : std::min(result.min_step_ms, ms);
+        }
+        result.avg_step_ms = total_ms / static_cast<float>(steps);
+        results.push_back(result);
+    }
+    return results;
+}
+
+NeighborBenchmarkResult benchmark_neighbor_grid(int particle_count, float kernel_radius, int thread_count) {
+    NeighborBenchmarkResult result{};
+    result.particle_count = std::max(0, particle_count);
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, thread_count)));
+
+    ParticleStore particles;
+    VolumeConfig config = seed_uniform_particles(result.particle_count, particles);
+
+    NeighborGrid grid{};
+    NeighborList list{};
+    std::vector<float> densities(particles.size(), 0.0f);
+    std::vector<int> neighbor_counts(particles.size(), 0);
+    const float h = kernel_radius;
+    const float skin = FluidSettings{}.verlet_skin * h;
+    for (int rep = 0; rep <= kNeighborRepeats; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        build_neighbor_grid(grid, config, particles, h, scheduler);
+        float build_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        scheduler.parallel_for(0, particles.size(), [&](size_t s) {
+            float rho = 0.0f;
+            int count = 0;
+            for_each_neighbor(grid, grid.position(static_cast<int>(s)), h, [&](int j, const Vec3&, float r) {
+                float q = 1.0f - r / h;
+                rho += grid.mass[j] * q * q * q;
+                ++count;
+            });
+            densities[s] = rho;
+            neighbor_counts[s] = count;
+        });
+        float query_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        build_neighbor_grid(grid, config, particles, h + skin, scheduler);
+        build_neighbor_list(list, grid, particles, h, skin, best_sph_kernels(), scheduler);
+        float list_build_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        scheduler.parallel_for(0, particles.size(), [&](size_t s) {
+            const int slot = static_cast<int>(s);
+            const Vec3 pos = grid.position(slot);
+            const int* slots = list.slots(slot);
+            float rho = 0.0f;
+            for (int k = 0; k < list.count(slot); ++k) {
+                const int j = slots[k];
+                Vec3 rij = pos - grid.position(j);
+                float r2 = dot(rij, rij);
+                if (r2 <= h * h) {
+                    float q = 1.0f - std::sqrt(r2) / h;
+                    rho += grid.mass[j] * q * q * q;
+                }
+            }
+            densities[s] = rho;
+        });
+        float list_query_ms = elapsed_ms(start);
+        if (rep == 0) continue;  // Warm-up.
+        result.build_ms += build_ms / kNeighborRepeats;
+        result.query_ms += query_ms / kNeighborRepeats;
+        result.list_build_ms += list_build_ms / kNeighborRepeats;
+        result.list_query_ms += list_query_ms / kNeighborRepeats;
+    }
+
+    double total_neighbors = 0.0;
+    for (int c : neighbor_counts) total_neighbors += c;
+    if (!neighbor_counts.empty()) {
+        result.avg_neighbors = static_cast<float>(total_neighbors / static_cast<double>(neighbor_counts.size()));
+        result.avg_list_neighbors = static_cast<float>(list.neighbors.size() - kSphRunPadding) /
+                                    static_cast<float>(neighbor_counts.size());
+    }
+    return result;
+}
+
+std::vector<NeighborModeBenchmarkResult> benchmark_neighbor_modes(const FluidSettings& settings, int steps, float dt) {
+    std::vector<NeighborModeBenchmarkResult> results;
+    steps = std::max(1, steps);
+    for (NeighborMode mode : {NeighborMode::Grid, NeighborMode::VerletList}) {
+        FluidSettings run_settings = settings;
+        run_settings.neighbor_mode = mode;
+        run_settings.max_substeps = 1;  // Time single SPH steps.
+
+        FluidExperiment sim;
+        settle(sim, run_settings, kWarmupSteps, dt);
+
+        NeighborModeBenchmarkResult result{};
+        result.mode = mode;
+        result.steps = steps;
+        float total_ms = 0.0f;
+        for (int i = 0; i < steps; ++i) {
+            sim.update(dt);
+            total_ms += sim.stats().step_ms;
+            if (mode == NeighborMode::Grid || sim.stats().neighbor_list_age == 0) {
+                ++result.rebuilds;
+            }
+        }
+        result.avg_step_ms = total_ms / static_cast<float>(steps);
+        result.substep_dt = sim.stats().substep_dt;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<ReorderBenchmarkResult> benchmark_reorder(const FluidSettings& settings,
+                                                      const std::vector<int>& intervals,
+                                                      int steps,
+                                                      float dt) {
+    std::vector<ReorderBenchmarkResult> results;
+    steps = std::max(1, steps);
+    std::vector<int> runs{0};
+    runs.insert(runs.end(), intervals.begin(), intervals.end());
+    for (int interval : runs) {
+        FluidSettings run_settings = settings;
+        run_settings.reorder_interval = std::max(0, interval);
+        run_settings.max_substeps = 1;  // Time single SPH steps.
+
+        FluidExperiment sim;
+        settle(sim, run_settings, kWarmupSteps, dt);
+
+        ReorderBenchmarkResult result{};
+        result.reorder_interval = run_settings.reorder_interval;
+        float total_ms = 0.0f;
+        for (int i = 0; i < steps; ++i) {
+            sim.update(dt);
+            total_ms += sim.stats().step_ms;
+        }
+        result.avg_step_ms = total_ms / static_cast<float>(steps);
+        result.reorder_ms = interval > 0 ? sim.stats().reorder_ms : 0.0f;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<SubstepBenchmarkResult> benchmark_substeps(const FluidSettings& settings,
+                                                      const std::vector<float>& frame_dts,
+                                                      int frames) {
+    std::vector<SubstepBenchmarkResult> results;
+    frames = std::max(1, frames);
+    for (float dt : frame_dts) {
+        FluidExperiment sim;
+        settle(sim, settings, kWarmupSteps, dt);
+
+        SubstepBenchmarkResult result{};
+        result.frame_dt = dt;
+        int substeps = 0;
+        float ratio = 0.0f;
+        for (int i = 0; i < frames; ++i) {
+            sim.update(dt);
+            const FluidStats& stats = sim.stats();
+            result.avg_frame_ms += stats.step_ms / static_cast<float>(frames);
+            result.max_frame_ms = std::max(result.max_frame_ms, stats.step_ms);
+            result.max_speed = std::max(result.max_speed, stats.max_speed);
+            substeps += stats.substeps;
+            ratio += stats.sim_time_ratio;
+        }
+        result.avg_substeps = static_cast<float>(substeps) / static_cast<float>(frames);
+        result.sim_time_ratio = ratio / static_cast<float>(frames);
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<SolverBenchmarkResult> benchmark_solvers(const FluidSettings& settings, int frames, float dt) {
+    std::vector<SolverBenchmarkResult> results;
+    frames = std::max(1, frames);
+    for (SolverType solver : {SolverType::Sph, SolverType::Pbf}) {
+        FluidSettings run_settings = settings;
+        run_settings.solver = solver;
+        run_settings.frame_budget_ms = 0.0f;
+
+        FluidExperiment sim;
+        settle(sim, run_settings, kWarmupSteps, dt);
+
+        SolverBenchmarkResult result{};
+        result.solver = solver;
+        const double sim_start = sim.stats().sim_time;
+        float wall_ms = 0.0f;
+        int substeps = 0;
+        for (int i = 0; i < frames; ++i) {
+            sim.update(dt);
+            wall_ms += sim.stats().step_ms;
+            substeps += sim.stats().substeps;
+            result.max_speed = std::max(result.max_speed, sim.stats().max_speed);
+        }
+        const float simulated = static_cast<float>(sim.stats().sim_time - sim_start);
+        result.sim_seconds_per_wall_second = wall_ms > 0.0f ? simulated * 1000.0f / wall_ms : 0.0f;
+        result.avg_substeps = static_cast<float>(substeps) / static_cast<float>(frames);
+        result.avg_substep_ms = substeps > 0 ? wall_ms / static_cast<float>(substeps) : 0.0f;
+        std::tie(result.avg_compression, result.max_compression) = measure_compression(sim);
+        result.avg_height = sim.stats().avg_height - sim.volume().config().origin.y;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<KernelBenchmarkResult> benchmark_sph_kernels(int particle_count, float kernel_radius, int thread_count) {
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, thread_count)));
+    ParticleStore particles;
+    VolumeConfig config = seed_uniform_particles(std::max(0, particle_count), particles);
+    NeighborGrid grid{};
+    const float h = kernel_radius;
+    build_neighbor_grid(grid, config, particles, h, scheduler);
+
+    const size_t n = particles.size();
+    FloatArray densities(n + kSphRunPadding, 0.0f);
+    FloatArray pressures(n + kSphRunPadding, 0.0f);
+    std::vector<float> reference(n, 0.0f);
+    std::vector<Vec3> forces(n);
+    SphNeighborData data{grid.px.data(), grid.py.data(), grid.pz.data(), grid.vx.data(), grid.vy.data(),
+                         grid.vz.data(), grid.mass.data(), densities.data(), pressures.data()};
+
+    std::vector<KernelBenchmarkResult> results;
+    const SimdLevel best = detect_simd_level();
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2}) {
+        if (level > best) break;
+        const SphKernels& kernels = sph_kernels(level);
+        KernelBenchmarkResult result{};
+        result.level = level;
+        result.width = kernels.width;
+        for (int rep = 0; rep <= kNeighborRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            scheduler.parallel_for(0, n, [&](size_t s) {
+                const Vec3 pos = grid.position(static_cast<int>(s));
+                float rho = 0.0f;
+                for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+                    rho += kernels.density(data, begin, end, pos, h);
+                });
+                densities[s] = rho;
+                pressures[s] = rho * 0.01f;  // Any positive pressure exercises the full force path.
+            });
+            float density_ms = elapsed_ms(start);
+
+            start = std::chrono::steady_clock::now();
+            scheduler.parallel_for(0, n, [&](size_t s) {
+                SphParticle self{grid.position(static_cast<int>(s)), grid.velocity(static_cast<int>(s)), densities[s],
+                                 pressures[s]};
+                Vec3 accel{};
+                for_each_neighbor_run(grid, self.position, [&](int begin, int end) {
+                    accel = accel + kernels.force(data, begin, end, self, h, 0.01f);
+                });
+                forces[s] = accel;
+            });
+            float force_ms = elapsed_ms(start);
+            if (rep == 0) continue;  // Warm-up.
+            result.density_ms += density_ms / kNeighborRepeats;
+            result.force_ms += force_ms / kNeighborRepeats;
+        }
+        for (size_t s = 0; s < n; ++s) {
+            if (level == SimdLevel::Scalar) {
+                reference[s] = densities[s];
+            } else {
+                result.max_abs_error = std::max(result.max_abs_error, std::fabs(densities[s] - reference[s]));
+            }
+        }
+        float total_ms = result.density_ms + result.force_ms;
+        result.particles_per_ms = total_ms > 0.0f ? static_cast<float>(n) / total_ms : 0.0f;
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<PairBenchmarkResult> benchmark_pair_modes(int particle_count, float kernel_radius, int thread_count) {
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, thread_count)));
+    ParticleStore particles;
+    VolumeConfig config = seed_uniform_particles(std::max(0, particle_count), particles);
+    NeighborGrid grid{};
+    const float h = kernel_radius;
+    build_neighbor_grid(grid, config, particles, h, scheduler);
+
+    const size_t n = particles.size();
+    FloatArray densities(n + kSphRunPadding, 0.0f);
+    FloatArray pressures(n + kSphRunPadding, 0.0f);
+    FloatArray ax(n + kSphRunPadding, 0.0f);
+    FloatArray ay(n + kSphRunPadding, 0.0f);
+    FloatArray az(n + kSphRunPadding, 0.0f);
+    std::vector<float> reference_density(n, 0.0f);
+    std::vector<Vec3> reference_accel(n);
+    SphNeighborData data{grid.px.data(), grid.py.data(), grid.pz.data(), grid.vx.data(), grid.vy.data(),
+                         grid.vz.data(), grid.mass.data(), densities.data(), pressures.data()};
+    const SphKernels& kernels = sph_kernels(detect_simd_level());
+    constexpr float kViscosity = 0.01f;
+
+    std::vector<PairBenchmarkResult> results;
+    for (bool symmetric : {false, true}) {
+        PairBenchmarkResult result{};
+        result.symmetric = symmetric;
+        for (int rep = 0; rep <= kNeighborRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            if (symmetric) {
+                accumulate_pair_densities(grid, kernels, data, h, densities.data(), scheduler);
+            } else {
+                scheduler.parallel_for(0, n, [&](size_t s) {
+                    const Vec3 pos = grid.position(static_cast<int>(s));
+                    float rho = 0.0f;
+                    for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+                        rho += kernels.density(data, begin, end, pos, h);
+                    });
+                    densities[s] = rho;
+                });
+            }
+            float density_ms = elapsed_ms(start);
+            // Pressures are fixed from the full-stencil densities so both modes see the same inputs.
+            if (!symmetric && rep == 0) {
+                scheduler.parallel_for(0, n, [&](size_t s) { pressures[s] = densities[s] * 0.01f; });
+            }
+
+            start = std::chrono::steady_clock::now();
+            if (symmetric) {
+                accumulate_pair_forces(grid, kernels, data, h, kViscosity, ax.data(), ay.data(), az.data(), scheduler);
+            } else {
+                scheduler.parallel_for(0, n, [&](size_t s) {
+                    SphParticle self{grid.position(static_cast<int>(s)), grid.velocity(static_cast<int>(s)),
+                                     densities[s], pressures[s]};
+                    Vec3 accel{};
+                    for_each_neighbor_run(grid, self.position, [&](int begin, int end) {
+                        accel = accel + kernels.force(data, begin, end, self, h, kViscosity);
+                    });
+                    ax[s] = accel.x;
+                    ay[s] = accel.y;
+                    az[s] = accel.z;
+                });
+            }
+            float force_ms = elapsed_ms(start);
+            if (rep == 0) continue;  // Warm-up.
+            result.density_ms += density_ms / kNeighborRepeats;
+            result.force_ms += force_ms / kNeighborRepeats;
+        }
+
+        float max_accel = 0.0f;
+        for (size_t s = 0; s < n; ++s) {
+            const Vec3 accel{ax[s], ay[s], az[s]};
+            if (!symmetric) {
+                reference_density[s] = densities[s];
+                reference_accel[s] = accel;
+                continue;
+            }
+            result.max_density_error = std::max(
+                result.max_density_error, std::fabs(densities[s] - reference_density[s]) / reference_density[s]);
+            result.max_force_error = std::max(result.max_force_error, length(accel - reference_accel[s]));
+        }
+        if (symmetric) {
+            for (const Vec3& accel : reference_accel) {
+                max_accel = std::max(max_accel, length(accel));
+            }
+            result.max_force_error = max_accel > 0.0f ? result.max_force_error / max_accel : 0.0f;
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+namespace {
+
+void run_steps(const FluidSettings& settings) {
+    for (const auto& row : benchmark_step_scaling(settings, 30, 1.0f / 60.0f)) {
+        BenchLine("")("threads", row.thread_count)("avg_step_ms", row.avg_step_ms)("min_step_ms", row.min_step_ms);
+    }
+}
+
+void run_neighbors(const FluidSettings& settings) {
+    for (int count : {4096, 65536, 262144}) {
+        const auto row = benchmark_neighbor_grid(count, settings.kernel_radius, settings.thread_count);
+        BenchLine("neighbors")("particles", row.particle_count)
+            ("build_ms", row.build_ms)
+            ("query_ms", row.query_ms)
+            ("avg_neighbors", row.avg_neighbors)
+            ("list_build_ms", row.list_build_ms)
+            ("list_query_ms", row.list_query_ms)
+            ("avg_list_neighbors", row.avg_list_neighbors);
+    }
+}
+
+void run_neighbor_modes(const FluidSettings& settings) {
+    for (const auto& row : benchmark_neighbor_modes(settings, 30, 1.0f / 60.0f)) {
+        BenchLine("neighbor")("mode", row.mode == NeighborMode::VerletList ? "verlet" : "grid")
+            ("avg_step_ms", row.avg_step_ms)
+            ("rebuilds", row.rebuilds, "/", row.steps)
+            ("substep_dt", row.substep_dt);
+    }
+}
+
+void run_reorder(const FluidSettings& settings) {
+    for (const auto& row : benchmark_reorder(settings, {1, 16, 64}, 30, 1.0f / 60.0f)) {
+        BenchLine("reorder")("interval", row.reorder_interval)("avg_step_ms", row.avg_step_ms)
+            ("reorder_ms", row.reorder_ms);
+    }
+}
+
+void run_substeps(const FluidSettings& settings) {
+    for (const auto& row : benchmark_substeps(settings, {1.0f / 240.0f, 1.0f / 60.0f, 1.0f / 15.0f}, 30)) {
+        BenchLine("substeps")("frame_dt", row.frame_dt)
+            ("avg_frame_ms", row.avg_frame_ms)
+            ("max_frame_ms", row.max_frame_ms)
+            ("avg_substeps", row.avg_substeps)
+            ("sim_time_ratio", row.sim_time_ratio)
+            ("max_speed", row.max_speed);
+    }
+}
+
+void run_sph_kernels(const FluidSettings& settings) {
+    for (const auto& row : benchmark_sph_kernels(65536, settings.kernel_radius, settings.thread_count)) {
+        BenchLine("sph kernels")("width", row.width)
+            ("density_ms", row.density_ms)
+            ("force_ms", row.force_ms)
+            ("particles_per_ms", row.particles_per_ms)
+            ("max_abs_error", row.max_abs_error);
+    }
+}
+
+void run_sph_pairs(const FluidSettings& settings) {
+    for (const auto& row : benchmark_pair_modes(65536, settings.kernel_radius, settings.thread_count)) {
+        BenchLine("sph pairs")("mode", row.symmetric ? "symmetric" : "full")
+            ("density_ms", row.density_ms)
+            ("force_ms", row.force_ms)
+            ("max_density_error", row.max_density_error)
+            ("max_force_error", row.max_force_error);
+    }
+}
+
+void run_solvers(const FluidSettings& settings) {
+    for (const auto& row : benchmark_solvers(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("")("solver", row.solver == SolverType::Pbf ? "pbf" : "sph")
+            ("sim_per_wall", row.sim_seconds_per_wall_second)
+            ("avg_substeps", row.avg_substeps)
+            ("substep_ms", row.avg_substep_ms)
+            ("max_speed", row.max_speed)
+            ("avg_compression", row.avg_compression)
+            ("max_compression", row.max_compression)
+            ("avg_y", row.avg_height);
+    }
+}
+
+constexpr BenchSuite kSuites[] = {
+    {"steps", "step time per thread count", run_steps},
+    {"neighbors", "neighbor grid and Verlet list build/query", run_neighbors},
+    {"neighbor_modes", "step time, grid vs. Verlet list", run_neighbor_modes},
+    {"reorder", "step time per Morton reorder interval", run_reorder},
+    {"substeps", "adaptive substep cost per frame dt", run_substeps},
+    {"sph_kernels", "SPH kernels per SIMD width", run_sph_kernels},
+    {"sph_pairs", "full vs. symmetric pair passes", run_sph_pairs},
+    {"solvers", "SPH vs. PBF sim-seconds per wall-second", run_solvers},
+};
+
+}  // namespace
+
+std::span<const BenchSuite> neighbor_grid_bench_suites() {
+    return kSuites;
+}
+
+}  // namespace rayol::fluid
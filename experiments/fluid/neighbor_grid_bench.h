@@ -0,0 +1,124 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "bench_harness.h"
+#include "fluid_experiment.h"
+
+// Neighbor search, SPH kernel and stepping benchmarks: FluidExperiment::update across thread counts,
+// neighbor modes, reorder intervals, substep settings and solvers, plus the neighbor grid, Verlet list
+// and SPH kernels on their own.
+
+namespace rayol::fluid {
+
+struct StepBenchmarkResult {
+    int thread_count = 0;
+    int particle_count = 0;
+    float avg_step_ms = 0.0f;
+    float min_step_ms = 0.0f;
+};
+
+struct NeighborBenchmarkResult {
+    int particle_count = 0;
+    float build_ms = 0.0f;  // build_neighbor_grid
+    float query_ms = 0.0f;  // one poly6 density pass over all particles
+    float avg_neighbors = 0.0f;
+    float list_build_ms = 0.0f;  // build_neighbor_list with the default skin (grid build included)
+    float list_query_ms = 0.0f;  // the same density pass over the Verlet list
+    float avg_list_neighbors = 0.0f;
+};
+
+struct NeighborModeBenchmarkResult {
+    NeighborMode mode = NeighborMode::Grid;
+    float avg_step_ms = 0.0f;
+    int rebuilds = 0;  // Verlet list rebuilds over the timed steps (every step in grid mode).
+    int steps = 0;
+    float substep_dt = 0.0f;  // Seconds per step; list mode caps the CFL number, so its steps are shorter.
+};
+
+struct ReorderBenchmarkResult {
+    int reorder_interval = 0;  // 0 = never reordered
+    float avg_step_ms = 0.0f;
+    float reorder_ms = 0.0f;  // cost of one reorder (included in avg_step_ms, amortized)
+};
+
+struct SubstepBenchmarkResult {
+    float frame_dt = 0.0f;       // Requested seconds per update().
+    float avg_frame_ms = 0.0f;   // Wall time per update() including all substeps.
+    float max_frame_ms = 0.0f;
+    float avg_substeps = 0.0f;
+    float sim_time_ratio = 0.0f;  // Average simulated / requested time.
+    float max_speed = 0.0f;       // Largest particle speed seen (kMaxSpeed clamps show up as 20).
+};
+
+struct SolverBenchmarkResult {
+    SolverType solver = SolverType::Sph;
+    float sim_seconds_per_wall_second = 0.0f;
+    float avg_substeps = 0.0f;   // Substeps per frame the CFL limit asked for.
+    float avg_substep_ms = 0.0f;  // Wall time per substep (resplat and stats amortized in).
+    float max_speed = 0.0f;       // Largest particle speed seen; kMaxSpeed (20) means clamping kicked in.
+    // Volume preservation at the end of the run: kernel density relative to the PBF rest lattice
+    // (1 = rest spacing, > 1 = compressed), and the mean particle height above the volume origin.
+    float avg_compression = 0.0f;
+    float max_compression = 0.0f;
+    float avg_height = 0.0f;
+};
+
+struct KernelBenchmarkResult {
+    SimdLevel level = SimdLevel::Scalar;
+    int width = 1;
+    float density_ms = 0.0f;  // one density pass over all particles
+    float force_ms = 0.0f;    // one pressure/viscosity force pass
+    float particles_per_ms = 0.0f;  // particles through density + force per millisecond
+    float max_abs_error = 0.0f;     // largest density deviation from the scalar kernels
+};
+
+struct PairBenchmarkResult {
+    bool symmetric = false;  // Half-stencil pair passes instead of the full 27-cell scan.
+    float density_ms = 0.0f;
+    float force_ms = 0.0f;
+    float max_density_error = 0.0f;  // Largest relative deviation from the full-stencil pass.
+    float max_force_error = 0.0f;    // Largest acceleration deviation relative to the largest magnitude.
+};
+
+// Time FluidExperiment::update with a fixed dt at 1, 2, 4, ... threads up to hardware concurrency.
+// Each run starts from a fresh seed and skips a few warm-up steps before timing.
+std::vector<StepBenchmarkResult> benchmark_step_scaling(const FluidSettings& settings, int steps, float dt);
+
+// Time neighbor grid build and a density query pass for uniformly seeded particles, then the same
+// for a Verlet list. The domain is scaled with the particle count so the per-particle neighbor count
+// stays comparable across sizes.
+NeighborBenchmarkResult benchmark_neighbor_grid(int particle_count, float kernel_radius, int thread_count);
+
+// Time FluidExperiment::update in grid and Verlet list neighbor modes from the same settings.
+std::vector<NeighborModeBenchmarkResult> benchmark_neighbor_modes(const FluidSettings& settings, int steps, float dt);
+
+// Time FluidExperiment::update without Morton reordering, then with reorders every interval steps.
+std::vector<ReorderBenchmarkResult> benchmark_reorder(const FluidSettings& settings,
+                                                      const std::vector<int>& intervals,
+                                                      int steps,
+                                                      float dt);
+
+// Run FluidExperiment::update at each frame dt with the given substep settings and report the frame
+// cost and how much of the requested time was simulated.
+std::vector<SubstepBenchmarkResult> benchmark_substeps(const FluidSettings& settings,
+                                                      const std::vector<float>& frame_dts,
+                                                      int frames);
+
+// Run the SPH and PBF solvers from the same settings (frame budget off, so every frame is simulated
+// in full) and report simulated seconds per wall-clock second and how well each holds its volume.
+std::vector<SolverBenchmarkResult> benchmark_solvers(const FluidSettings& settings, int frames, float dt);
+
+// Time the SPH density and force kernels at every SIMD level the CPU supports on the same
+// neighbor grid as benchmark_neighbor_grid.
+std::vector<KernelBenchmarkResult> benchmark_sph_kernels(int particle_count, float kernel_radius, int thread_count);
+
+// Time the full-stencil SPH density and force passes against the symmetric half-stencil pair passes
+// with the best supported kernels, on the same neighbor grid as benchmark_neighbor_grid.
+std::vector<PairBenchmarkResult> benchmark_pair_modes(int particle_count, float kernel_radius, int thread_count);
+
+// Suites for rayol_fluid_bench, in run order.
+std::span<const BenchSuite> neighbor_grid_bench_suites();
+
+}  // namespace rayol::fluid
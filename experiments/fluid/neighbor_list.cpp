@@ -0,0 +1,103 @@
+#include "neighbor_list.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace rayol::fluid {
+
+namespace {
+// Build chunks per thread (for stealing) and the smallest chunk worth its own buffer.
+constexpr size_t kChunksPerThread = 4;
+constexpr size_t kMinSlotsPerChunk = 256;
+}  // namespace
+
+void build_neighbor_list(NeighborList& list,
+                         const NeighborGrid& grid,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         float skin,
+                         const SphKernels& kernels,
+                         TaskScheduler& scheduler) {
+    const size_t n = grid.order.size();
+    list.skin = skin;
+    list.cutoff = kernel_radius + skin;
+    const float r2_max = list.cutoff * list.cutoff;
+    SphNeighborData data{};
+    data.px = grid.px.data();
+    data.py = grid.py.data();
+    data.pz = grid.pz.data();
+
+    // One pass over the grid: fixed-size chunks append into their own buffer, then a prefix sum
+    // over chunk sizes places each buffer into the CSR array in slot order.
+    size_t chunks = std::min<size_t>(n / kMinSlotsPerChunk, scheduler.thread_count() * kChunksPerThread);
+    chunks = std::max<size_t>(1, chunks);
+    const size_t grain = (n + chunks - 1) / chunks;
+    list.chunk_neighbors.resize(chunks);
+    list.chunk_offsets.assign(chunks + 1, 0);
+    list.start.resize(n + 1);
+    scheduler.parallel_for(0, chunks, [&](size_t c) {
+        std::vector<int>& out = list.chunk_neighbors[c];
+        size_t used = 0;
+        const size_t end = std::min(n, (c + 1) * grain);
+        for (size_t s = c * grain; s < end; ++s) {
+            const Vec3 pos = grid.position(static_cast<int>(s));
+            list.start[s] = static_cast<int>(used);  // Chunk-local until the prefix sum below.
+            for_each_neighbor_run(grid, pos, [&](int begin, int run_end) {
+                const size_t room = used + static_cast<size_t>(run_end - begin + kSphRunPadding);
+                if (out.size() < room) {
+                    out.resize(std::max(room, out.size() * 2));
+                }
+                used += static_cast<size_t>(kernels.select(data, begin, run_end, pos, r2_max, out.data() + used));
+            });
+        }
+        list.chunk_offsets[c + 1] = static_cast<int>(used);
+    }, 1);
+    for (size_t c = 0; c < chunks; ++c) {
+        list.chunk_offsets[c + 1] += list.chunk_offsets[c];
+    }
+    list.start[n] = list.chunk_offsets[chunks];
+
+    list.neighbors.resize(static_cast<size_t>(list.start[n]) + kSphRunPadding);
+    std::fill(list.neighbors.end() - kSphRunPadding, list.neighbors.end(), 0);
+    scheduler.parallel_for(0, chunks, [&](size_t c) {
+        const int offset = list.chunk_offsets[c];
+        const int* chunk = list.chunk_neighbors[c].data();
+        std::copy(chunk, chunk + (list.chunk_offsets[c + 1] - offset), list.neighbors.begin() + offset);
+        const size_t end = std::min(n, (c + 1) * grain);
+        for (size_t s = c * grain; s < end; ++s) {
+            list.start[s] += offset;
+        }
+    }, 1);
+
+    list.ref_px.assign(particles.px.begin(), particles.px.end());
+    list.ref_py.assign(particles.py.begin(), particles.py.end());
+    list.ref_pz.assign(particles.pz.begin(), particles.pz.end());
+}
+
+bool neighbor_list_expired(const NeighborList& list,
+                           const ParticleStore& particles,
+                           float kernel_radius,
+                           float skin,
+                           TaskScheduler& scheduler) {
+    const size_t n = particles.size();
+    if (list.empty() || list.start.size() != n + 1 || list.ref_px.size() != n) return true;
+    if (list.skin != skin || list.cutoff != kernel_radius + skin) return true;
+
+    const float limit2 = 0.25f * skin * skin;
+    std::atomic<bool> moved{false};
+    scheduler.parallel_for_range(0, n, 0, [&](size_t begin, size_t end) {
+        if (moved.load(std::memory_order_relaxed)) return;
+        for (size_t i = begin; i < end; ++i) {
+            float dx = particles.px[i] - list.ref_px[i];
+            float dy = particles.py[i] - list.ref_py[i];
+            float dz = particles.pz[i] - list.ref_pz[i];
+            if (dx * dx + dy * dy + dz * dz > limit2) {
+                moved.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    return moved.load();
+}
+
+}  // namespace rayol::fluid
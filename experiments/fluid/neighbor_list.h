@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "fluid_sim.h"
+#include "neighbor_grid.h"
+#include "sph_kernels.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+// Verlet neighbor list in CSR form: for every sorted slot of the grid it was built from, the slots
+// within cutoff = kernel radius + skin. Reused across steps while no particle has moved more than
+// skin / 2 (so no pair can have closed from beyond the cutoff to inside the kernel radius).
+struct NeighborList {
+    float cutoff = 0.0f;
+    float skin = 0.0f;
+    // Slot s owns neighbors[start[s], start[s + 1]); slot count + 1 entries. neighbors carries
+    // kSphRunPadding trailing zero slots for the masked SIMD tails.
+    std::vector<int> start;
+    std::vector<int> neighbors;
+    // Particle positions (particle index order) when the list was built.
+    FloatArray ref_px, ref_py, ref_pz;
+
+    // Build scratch, kept to avoid reallocating on every rebuild.
+    std::vector<std::vector<int>> chunk_neighbors;
+    std::vector<int> chunk_offsets;
+
+    bool empty() const { return start.empty(); }
+    void clear() {
+        start.clear();
+        neighbors.clear();
+    }
+    int count(int slot) const { return start[slot + 1] - start[slot]; }
+    const int* slots(int slot) const { return neighbors.data() + start[slot]; }
+};
+
+// Build the list from a grid whose cell size is at least kernel_radius + skin (so the 27-cell
+// block still covers the cutoff) and record the current particle positions. Candidates are tested
+// with kernels.select.
+void build_neighbor_list(NeighborList& list,
+                         const NeighborGrid& grid,
+                         const ParticleStore& particles,
+                         float kernel_radius,
+                         float skin,
+                         const SphKernels& kernels,
+                         TaskScheduler& scheduler);
+
+// True when the list no longer guarantees every pair within kernel_radius: it is empty, was built
+// for another particle count or cutoff, or some particle has moved more than skin / 2 since.
+bool neighbor_list_expired(const NeighborList& list,
+                           const ParticleStore& particles,
+                           float kernel_radius,
+                           float skin,
+                           TaskScheduler& scheduler);
+
+}  // namespace rayol::fluid
@@ -0,0 +1,91 @@
+#include "pbf_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace rayol::fluid {
+
+namespace {
+// Largest position correction per iteration, as a fraction of the kernel radius.
+constexpr float kMaxCorrection = 0.25f;
+}  // namespace
+
+float pbf_rest_density(float spacing) {
+    if (spacing <= 0.0f) return 1.0f;
+    const int reach = static_cast<int>(std::ceil(1.0f / spacing));
+    float rho = 0.0f;
+    for (int z = -reach; z <= reach; ++z) {
+        for (int y = -reach; y <= reach; ++y) {
+            for (int x = -reach; x <= reach; ++x) {
+                float r = spacing * std::sqrt(static_cast<float>(x * x + y * y + z * z));
+                if (r <= 1.0f) {
+                    float q = 1.0f - r;
+                    rho += q * q * q;
+                }
+            }
+        }
+    }
+    return rho;
+}
+
+void solve_pbf_density(PbfSolver& pbf,
+                       NeighborGrid& grid,
+                       const PbfParams& params,
+                       const SphKernels& kernels,
+                       TaskScheduler& scheduler) {
+    const size_t n = grid.order.size();
+    if (n == 0 || params.iterations <= 0) return;
+    const float h = params.kernel_radius > 0.0f ? params.kernel_radius : 0.01f;
+    const float inv_rho0 = 1.0f / std::max(params.rest_density, 1e-6f);
+    const float eps = std::max(params.relaxation, 0.0f) / (h * h);
+    const float max_dp = kMaxCorrection * h;
+    const Vec3 lo = params.min_bound;
+    const Vec3 hi = params.max_bound;
+
+    for (FloatArray* a : {&pbf.density, &pbf.lambda, &pbf.next_px, &pbf.next_py, &pbf.next_pz}) {
+        a->resize(n + kSphRunPadding, 0.0f);
+    }
+
+    for (int iteration = 0; iteration < params.iterations; ++iteration) {
+        SphNeighborData data{};
+        data.px = grid.px.data();
+        data.py = grid.py.data();
+        data.pz = grid.pz.data();
+        data.mass = grid.mass.data();
+        data.lambda = pbf.lambda.data();
+
+        scheduler.parallel_for(0, n, [&](size_t s) {
+            const Vec3 pos = grid.position(static_cast<int>(s));
+            PbfSums sums{};
+            for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+                kernels.pbf_lambda(data, begin, end, pos, h, inv_rho0, sums);
+            });
+            pbf.density[s] = sums.density;
+            float c = std::max(sums.density * inv_rho0 - 1.0f, 0.0f);
+            pbf.lambda[s] = -c / (sums.grad_sq + dot(sums.grad, sums.grad) + eps);
+        });
+
+        // Position correction per slot into the next buffers (Jacobi: every slot reads the
+        // previous iteration's positions).
+        scheduler.parallel_for(0, n, [&](size_t s) {
+            const Vec3 pos = grid.position(static_cast<int>(s));
+            Vec3 dp{};
+            for_each_neighbor_run(grid, pos, [&](int begin, int end) {
+                dp = dp + kernels.pbf_correction(data, begin, end, pos, pbf.lambda[s], h, inv_rho0);
+            });
+            // A correction longer than a fraction of h comes from overlapping particles; applying it
+            // whole would throw them past their neighbors and out of the stencil.
+            const float dp_len = length(dp);
+            if (dp_len > max_dp) dp = dp * (max_dp / dp_len);
+            pbf.next_px[s] = std::clamp(pos.x + dp.x, lo.x, hi.x);
+            pbf.next_py[s] = std::clamp(pos.y + dp.y, lo.y, hi.y);
+            pbf.next_pz[s] = std::clamp(pos.z + dp.z, lo.z, hi.z);
+        });
+        std::swap(grid.px, pbf.next_px);
+        std::swap(grid.py, pbf.next_py);
+        std::swap(grid.pz, pbf.next_pz);
+    }
+}
+
+}  // namespace rayol::fluid
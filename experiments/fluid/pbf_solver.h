@@ -0,0 +1,49 @@
+#pragma once
+
+#include "fluid_sim.h"
+#include "neighbor_grid.h"
+#include "sph_kernels.h"
+#include "task_scheduler.h"
+
+namespace rayol::fluid {
+
+// Rest state of the PBF solver: particles on a cubic lattice at this fraction of the kernel radius
+// (~30 neighbors each). pbf_rest_density(kPbfRestSpacing) is the matching target density.
+constexpr float kPbfRestSpacing = 0.5f;
+
+struct PbfParams {
+    float kernel_radius = 0.06f;
+    float rest_density = 1.0f;  // Target kernel-sum density (see pbf_rest_density).
+    int iterations = 4;
+    // Constraint force mixing: softens the projection where the gradient sum is small (few
+    // neighbors), in units of 1 / kernel_radius^2.
+    float relaxation = 0.5f;
+    Vec3 min_bound{};  // Projected positions are clamped to this box.
+    Vec3 max_bound{};
+};
+
+// Per-slot scratch of the PBF constraint solve, kept to avoid reallocating every step.
+struct PbfSolver {
+    FloatArray density;  // Kernel-sum density at the last iteration's positions.
+    FloatArray lambda;
+    FloatArray next_px, next_py, next_pz;
+};
+
+// Kernel-sum density (unit masses, the sim's (1 - r/h)^3 kernel) of a particle inside an infinite
+// cubic lattice with the given spacing as a fraction of the kernel radius.
+float pbf_rest_density(float spacing);
+
+// Position-based fluids density projection (Macklin & Mueller 2013) on the grid's gathered,
+// predicted positions: params.iterations Jacobi iterations of lambda_i = -C_i / (sum |grad C|^2 + eps)
+// then dp_i = sum (lambda_i + lambda_j) grad W_ij / rho0. The constraint is unilateral
+// (C = max(rho / rho0 - 1, 0)) so free surfaces do not pull particles together, which stands in for
+// the tensile s_corr term. grid.px/py/pz are updated in place; neighbor runs still come from the
+// cells of the build, which stay close because a step moves particles by well under a cell.
+// pbf.density holds per-slot densities on return.
+void solve_pbf_density(PbfSolver& pbf,
+                       NeighborGrid& grid,
+                       const PbfParams& params,
+                       const SphKernels& kernels,
+                       TaskScheduler& scheduler);
+
+}  // namespace rayol::fluid
@@ -1,10 +1,176 @@
 #include "raymarch.h"
 
 #include <algorithm>
+#include <bit>
 #include <cmath>
 
 namespace rayol::fluid {
 
+namespace {
+// Steps whose densities are sampled in one DensityVolume::sample_n batch. Steps past an early
+// exit are wasted, so this stays small.
+constexpr int kSampleBatch = 16;
+
+Vec3 cross3(Vec3 a, Vec3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+
+// Central differences from six independent samples (the pre-fused gradient).
+Vec3 six_sample_gradient(const DensityVolume& volume, Vec3 pos) {
+    float h = volume.config().voxel_size;
+    Vec3 dx = {h, 0.0f, 0.0f};
+    Vec3 dy = {0.0f, h, 0.0f};
+    Vec3 dz = {0.0f, 0.0f, h};
+    float gx = volume.sample(pos + dx) - volume.sample(pos - dx);
+    float gy = volume.sample(pos + dy) - volume.sample(pos - dy);
+    float gz = volume.sample(pos + dz) - volume.sample(pos - dz);
+    return {gx / (2.0f * h), gy / (2.0f * h), gz / (2.0f * h)};
+}
+
+// Macrocell containing pos and the distance at which the ray leaves it. Positions rounding just
+// outside the macrocell grid at the box faces report no cell.
+struct MacrocellSpan {
+    int cell = -1;
+    float exit = 0.0f;
+};
+
+MacrocellSpan macrocell_span(const DensityVolume& volume, const Ray& ray, Vec3 inv_dir, Vec3 pos) {
+    const VolumeConfig& cfg = volume.config();
+    const float size = static_cast<float>(kMacrocellSize) * cfg.voxel_size;
+    const Vec3 rel = pos - cfg.origin;
+    const int cx = static_cast<int>(std::floor(rel.x / size));
+    const int cy = static_cast<int>(std::floor(rel.y / size));
+    const int cz = static_cast<int>(std::floor(rel.z / size));
+    const Int3& cells = volume.macrocell_dims();
+    if (cx < 0 || cy < 0 || cz < 0 || cx >= cells.x || cy >= cells.y || cz >= cells.z) return {};
+    // Exit through the far slab on each axis (a zero direction gives +inf on that axis).
+    auto far_t = [&](int c, float dir, float origin_axis, float ray_origin, float inv) {
+        const float face = origin_axis + (static_cast<float>(c) + (dir >= 0.0f ? 1.0f : 0.0f)) * size;
+        return (face - ray_origin) * inv;
+    };
+    const float tx = far_t(cx, ray.dir.x, cfg.origin.x, ray.origin.x, inv_dir.x);
+    const float ty = far_t(cy, ray.dir.y, cfg.origin.y, ray.origin.y, inv_dir.y);
+    const float tz = far_t(cz, ray.dir.z, cfg.origin.z, ray.origin.z, inv_dir.z);
+    return {volume.macrocell_id(cx, cy, cz), std::min(std::min(tx, ty), tz)};
+}
+
+// Entry and exit distances of a ray with a volume's box (exit <= enter = miss).
+struct BoxSpan {
+    float enter = 0.0f;
+    float exit = 0.0f;
+};
+
+BoxSpan box_span(const VolumeConfig& cfg, const Ray& ray) {
+    const Vec3 inv_dir{1.0f / ray.dir.x, 1.0f / ray.dir.y, 1.0f / ray.dir.z};
+    auto axis = [&](float origin, int dim, float ray_origin, float inv, float& lo, float& hi) {
+        const float t0 = (origin - ray_origin) * inv;
+        const float t1 = (origin + static_cast<float>(dim) * cfg.voxel_size - ray_origin) * inv;
+        lo = std::min(t0, t1);
+        hi = std::max(t0, t1);
+    };
+    float x0, x1, y0, y1, z0, z1;
+    axis(cfg.origin.x, cfg.dims.x, ray.origin.x, inv_dir.x, x0, x1);
+    axis(cfg.origin.y, cfg.dims.y, ray.origin.y, inv_dir.y, y0, y1);
+    axis(cfg.origin.z, cfg.dims.z, ray.origin.z, inv_dir.z, z0, z1);
+    return {std::max(std::max(x0, y0), z0), std::min(std::min(x1, y1), z1)};
+}
+
+// ray_march_volume with AdaptiveStepSettings over [t, t_end]. Each sample stands for the step after
+// it, integrated exactly for a constant density (1 - exp(-sigma_t h) rather than sigma_t h) since the
+// steps can be long.
+RayMarchResult march_adaptive(const DensityVolume& volume, const Ray& ray, Vec3 inv_dir, float t, float t_end,
+                              const RayMarchSettings& settings, const std::function<Vec3(Vec3, Vec3, float)>& shade,
+                              const DirectionalLightShade& light) {
+    const AdaptiveStepSettings& adaptive = settings.adaptive;
+    const float base_step = std::max(0.0001f, settings.step);
+    const float max_scale = std::max(1.0f, adaptive.max_scale);
+    const bool skip_empty = settings.skip_empty && volume.macrocells_current();
+    RayMarchResult r{};
+    auto fetch = [&](float at) {
+        ++r.steps;
+        return volume.sample(ray.origin + ray.dir * at) * settings.density_scale;
+    };
+    float current = 0.0f;
+    bool have_current = false;  // Fetched ahead by the previous step's crossing check.
+    float cell_exit = t;
+    while (t < t_end && r.transmittance > 0.001f) {
+        if (adaptive.step_budget > 0 && r.steps >= adaptive.step_budget && !have_current) break;
+        const Vec3 pos = ray.origin + ray.dir * t;
+        if (skip_empty && t >= cell_exit) {
+            const MacrocellSpan span = macrocell_span(volume, ray, inv_dir, pos);
+            cell_exit = span.exit;
+            if (span.cell >= 0 && volume.macrocell(span.cell).max <= 0.0f) {
+                // Land just past the face so the next lookup finds the following cell.
+                const float next = std::min(span.exit, t_end) + base_step * 0.01f;
+                r.skipped_steps += static_cast<int>(std::ceil((next - t) / base_step));
+                t = next;
+                have_current = false;
+                continue;
+            }
+        }
+        if (!have_current) current = fetch(t);
+        have_current = false;
+        const float density = current;
+
+        const float min_step = std::max(base_step, t * adaptive.distance_scale);
+        float h = min_step * max_scale;
+        if (density > 0.0f) {
+            // Longest step adding at most target_opacity of the pixel: T (1 - exp(-sigma_t h)) <= target.
+            const float allowed = adaptive.target_opacity / r.transmittance;
+            if (allowed < 1.0f) h = -std::log1p(-allowed) / (density * settings.absorption);
+            h = std::clamp(h, min_step, min_step * max_scale);
+        }
+        if (adaptive.step_budget > 0) {
+            const int left = adaptive.step_budget - r.steps;
+            h = left > 0 ? std::max(h, (t_end - t) / static_cast<float>(left)) : t_end - t;
+        }
+        h = std::min(h, t_end - t);
+
+        // A long step out of thin fog that lands on the surface stops at the crossing instead.
+        float next = 0.0f;
+        if (h > min_step && density < adaptive.iso && t + h < t_end) {
+            next = fetch(t + h);
+            have_current = true;
+            if (next >= adaptive.iso) {
+                float lo = t;
+                float hi = t + h;
+                for (int i = 0; i < adaptive.refine_iterations; ++i) {
+                    const float mid = 0.5f * (lo + hi);
+                    ++r.steps;
+                    if (volume.sample(ray.origin + ray.dir * mid) * settings.density_scale >= adaptive.iso) {
+                        hi = mid;
+                    } else {
+                        lo = mid;
+                    }
+                }
+                h = hi - t;
+                if (adaptive.refine_iterations > 0) next = fetch(hi);
+            }
+        }
+
+        if (density > 0.0f) {
+            const float sigma_t = density * settings.absorption;
+            const float opacity = 1.0f - std::exp(-sigma_t * h);
+            r.optical_depth += sigma_t * h;
+            // Gradients only where there is something to shade; the fused fetch repeats the density.
+            const Vec3 normal = normalize(volume.sample_with_gradient(pos).gradient);
+            const Vec3 surface_light = shade ? shade(pos, normal, density) : light(pos, normal, density);
+            r.color = r.color + r.transmittance * (surface_light * opacity);
+            r.transmittance *= 1.0f - opacity;
+        }
+        t += h;
+        current = next;
+    }
+    return r;
+}
+}  // namespace
+
+Ray camera_ray(const CameraData& camera, float ndc_x, float ndc_y) {
+    const Vec3 forward = normalize(camera.forward);
+    const Vec3 right = normalize(camera.right);
+    const Vec3 up = normalize(cross3(right, forward));
+    const Vec3 dir = forward + right * (ndc_x * camera.aspect * camera.tan_half_fov) + up * (ndc_y * camera.tan_half_fov);
+    return {camera.pos, normalize(dir)};
+}
+
 RayMarchResult ray_march_volume(const DensityVolume& volume, const Ray& input_ray, const RayMarchSettings& settings,
                                 const std::function<Vec3(Vec3, Vec3, float)>& shade) {
     Ray ray = input_ray;
@@ -34,20 +200,70 @@ RayMarchResult ray_march_volume(const DensityVolume& volume, const Ray& input_ra
         return {};
     }
 
-    Vec3 light_dir = normalize(settings.light_dir);
+    const DirectionalLightShade light(settings);
     float step = std::max(0.0001f, settings.step);
 
     Vec3 accum_color{};
     float transmittance = 1.0f;
     float optical = 0.0f;
     int steps = 0;
+    int skipped = 0;
 
     float t_start = std::max(0.0f, t_enter);
     float t_end = std::min(t_exit, t_start + settings.max_distance);
+    if (settings.adaptive.enabled) {
+        return march_adaptive(volume, ray, inv_dir, t_start, t_end, settings, shade, light);
+    }
 
-    for (float t = t_start; t < t_end && transmittance > 0.001f; t += step, ++steps) {
+    Vec3 batch_pos[kSampleBatch];
+    float batch_density[kSampleBatch];
+    // Gradients of the batch's non-empty steps, in step order; empty steps never need one.
+    Vec3 shaded_pos[kSampleBatch];
+    DensitySample shaded[kSampleBatch];
+    int batch_count = 0;
+    int batch_next = 0;
+    int shaded_next = 0;
+    // Macrocell walk: each time t leaves the current cell, look up the next one and, if it is empty,
+    // advance t over its steps with the same additions the loop makes.
+    const bool skip_empty = settings.skip_empty && volume.macrocells_current();
+    float cell_exit = t_start;
+    for (float t = t_start; t < t_end && transmittance > 0.001f; t += step) {
         Vec3 pos = ray.origin + ray.dir * t;
-        float density = volume.sample(pos) * settings.density_scale;
+        if (skip_empty && t >= cell_exit) {
+            const MacrocellSpan span = macrocell_span(volume, ray, inv_dir, pos);
+            cell_exit = span.exit;
+            if (span.cell >= 0 && volume.macrocell(span.cell).max <= 0.0f) {
+                ++skipped;
+                while (t + step < cell_exit && t + step < t_end) {
+                    t += step;
+                    ++skipped;
+                }
+                batch_next = batch_count = 0;  // Prefetched samples past here are out of order now.
+                continue;
+            }
+        }
+        ++steps;
+        float density = 0.0f;
+        if (settings.fast_sampling) {
+            if (batch_next == batch_count) {
+                // Sample the next batch of steps ahead, advancing t exactly as the loop does.
+                batch_count = 0;
+                batch_next = 0;
+                for (float bt = t; bt < t_end && batch_count < kSampleBatch; bt += step) {
+                    batch_pos[batch_count++] = ray.origin + ray.dir * bt;
+                }
+                volume.sample_n({batch_pos, static_cast<size_t>(batch_count)}, {batch_density, static_cast<size_t>(batch_count)});
+                size_t shaded_count = 0;
+                for (int i = 0; i < batch_count; ++i) {
+                    if (batch_density[i] * settings.density_scale > 0.0f) shaded_pos[shaded_count++] = batch_pos[i];
+                }
+                volume.sample_with_gradient_n({shaded_pos, shaded_count}, {shaded, shaded_count});
+                shaded_next = 0;
+            }
+            density = batch_density[batch_next++] * settings.density_scale;
+        } else {
+            density = volume.sample(pos) * settings.density_scale;
+        }
         if (density <= 0.0f) {
             continue;
         }
@@ -56,22 +272,156 @@ RayMarchResult ray_march_volume(const DensityVolume& volume, const Ray& input_ra
         float attenuation = std::exp(-sigma_t * step);
         optical += sigma_t * step;
 
-        Vec3 normal = normalize(volume.gradient(pos));
-        Vec3 surface_light{};
-        if (shade) {
-            surface_light = shade(pos, normal, density);
-        } else {
-            float n_dot_l = std::max(0.0f, -dot(normal, light_dir));
-            Vec3 ambient = {settings.ambient, settings.ambient, settings.ambient};
-            surface_light = settings.light_color * n_dot_l + ambient;
-        }
+        Vec3 grad = settings.fast_sampling ? shaded[shaded_next++].gradient : six_sample_gradient(volume, pos);
+        Vec3 normal = normalize(grad);
+        Vec3 surface_light = shade ? shade(pos, normal, density) : light(pos, normal, density);
 
         Vec3 in_scatter = surface_light * (sigma_t * step);
         accum_color = accum_color + transmittance * in_scatter;
         transmittance *= attenuation;
     }
 
-    return {.color = accum_color, .transmittance = transmittance, .optical_depth = optical, .steps = steps};
+    return {.color = accum_color, .transmittance = transmittance, .optical_depth = optical, .steps = steps,
+            .skipped_steps = skipped};
+}
+
+void begin_ray_packet(const DensityVolume& volume, const Ray* rays, int count, const RayMarchSettings& settings,
+                      RayPacket& packet) {
+    packet.active = 0;
+    packet.sample_count = 0;
+    packet.dense = false;
+    const VolumeConfig& cfg = volume.config();
+    for (int lane = 0; lane < count; ++lane) {
+        Ray& ray = packet.rays[lane];
+        ray = {rays[lane].origin, normalize(rays[lane].dir)};
+        packet.inv_dir[lane] = {1.0f / ray.dir.x, 1.0f / ray.dir.y, 1.0f / ray.dir.z};
+        packet.result[lane] = {};
+        const BoxSpan span = box_span(cfg, ray);
+        if (span.exit <= span.enter) continue;
+        packet.t[lane] = std::max(0.0f, span.enter);
+        packet.t_end[lane] = std::min(span.exit, packet.t[lane] + settings.max_distance);
+        packet.cell_exit[lane] = packet.t[lane];
+        packet.active |= 1u << lane;
+    }
+}
+
+bool step_ray_packet(const DensityVolume& volume, const RayMarchSettings& settings, RayPacket& packet) {
+    const float step = std::max(0.0001f, settings.step);
+    const bool skip_empty = settings.skip_empty && volume.macrocells_current();
+    int n = 0;
+    // Per lane, the loop of ray_march_volume up to its next sample: the lane's t already holds the
+    // loop's increment, and empty macrocells are passed over with the same additions.
+    for (uint32_t lanes = packet.active; lanes != 0; lanes &= lanes - 1) {
+        const int lane = std::countr_zero(lanes);
+        const Ray& ray = packet.rays[lane];
+        RayMarchResult& r = packet.result[lane];
+        float& t = packet.t[lane];
+        const float t_end = packet.t_end[lane];
+        bool sampled = false;
+        for (; t < t_end && r.transmittance > 0.001f; t += step) {
+            if (skip_empty && t >= packet.cell_exit[lane]) {
+                const MacrocellSpan span = macrocell_span(volume, ray, packet.inv_dir[lane], ray.origin + ray.dir * t);
+                packet.cell_exit[lane] = span.exit;
+                if (span.cell >= 0 && volume.macrocell(span.cell).max <= 0.0f) {
+                    ++r.skipped_steps;
+                    while (t + step < span.exit && t + step < t_end) {
+                        t += step;
+                        ++r.skipped_steps;
+                    }
+                    continue;
+                }
+            }
+            ++r.steps;
+            packet.sample_lane[n] = lane;
+            packet.sample_pos[n++] = ray.origin + ray.dir * t;
+            t += step;
+            sampled = true;
+            break;
+        }
+        if (!sampled) packet.active &= ~(1u << lane);
+    }
+    packet.sample_count = n;
+    if (n == 0) return false;
+
+    const size_t count = static_cast<size_t>(n);
+    if (packet.dense) {
+        // Inside the fluid: one fused fetch for every lane (its densities equal sample_n's bit for bit),
+        // then drop the empty samples' gradients.
+        volume.sample_with_gradient_n({packet.sample_pos, count}, {packet.shaded, count});
+        int shaded_count = 0;
+        for (int s = 0; s < n; ++s) {
+            packet.density[s] = packet.shaded[s].density * settings.density_scale;
+            if (packet.density[s] > 0.0f) packet.shaded[shaded_count++] = packet.shaded[s];
+        }
+        packet.dense = shaded_count == n;
+        return true;
+    }
+    volume.sample_n({packet.sample_pos, count}, {packet.density, count});
+    Vec3 shaded_pos[kRayPacketSize];
+    size_t shaded_count = 0;
+    for (int s = 0; s < n; ++s) {
+        packet.density[s] *= settings.density_scale;
+        if (packet.density[s] > 0.0f) shaded_pos[shaded_count++] = packet.sample_pos[s];
+    }
+    volume.sample_with_gradient_n({shaded_pos, shaded_count}, {packet.shaded, shaded_count});
+    packet.dense = shaded_count == count;
+    return true;
+}
+
+SphereTraceResult sphere_trace_distance(const DistanceVolume& field, const Ray& input_ray,
+                                        const SphereTraceSettings& settings) {
+    SphereTraceResult result{};
+    if (field.empty()) return result;
+    Ray ray = input_ray;
+    ray.dir = normalize(ray.dir);
+    const BoxSpan span = box_span(field.config(), ray);
+    if (span.exit <= span.enter) return result;
+
+    const float voxel = field.config().voxel_size;
+    const float epsilon = settings.hit_epsilon * voxel;
+    const float min_step = std::max(settings.min_step * voxel, 1e-6f);
+    const float fixed_step = settings.fixed_step * voxel;
+    const float t_start = std::max(0.0f, span.enter);
+    const float t_end = std::min(span.exit, t_start + settings.max_distance);
+
+    float t = t_start;
+    float t_prev = t;
+    float phi_prev = 0.0f;
+    while (t <= t_end && (fixed_step > 0.0f || result.iterations < settings.max_iterations)) {
+        float phi = field.sample(ray.origin + ray.dir * t);
+        ++result.iterations;
+        const bool crossed = fixed_step > 0.0f ? phi <= 0.0f : phi <= epsilon;
+        if (crossed) {
+            // Landed inside: bracket the crossing between the last two samples and tighten it.
+            if (phi < 0.0f && result.iterations > 1) {
+                float t_out = t_prev, phi_out = phi_prev;
+                float t_in = t;
+                float phi_in = phi;
+                for (int i = 0; i < settings.refine_iterations && phi_out - phi_in > 0.0f; ++i) {
+                    t = t_out + (t_in - t_out) * phi_out / (phi_out - phi_in);
+                    phi = field.sample(ray.origin + ray.dir * t);
+                    ++result.iterations;
+                    if (std::abs(phi) <= epsilon) break;
+                    if (phi > 0.0f) {
+                        t_out = t;
+                        phi_out = phi;
+                    } else {
+                        t_in = t;
+                        phi_in = phi;
+                    }
+                }
+            }
+            result.hit = true;
+            result.t = t;
+            result.position = ray.origin + ray.dir * t;
+            result.normal = normalize(field.gradient(result.position));
+            return result;
+        }
+        t_prev = t;
+        phi_prev = phi;
+        t += fixed_step > 0.0f ? fixed_step : std::max(phi, min_step);
+    }
+    return result;
 }
 
 }  // namespace rayol::fluid
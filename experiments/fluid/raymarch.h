@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 
+#include "distance_field.h"
 #include "fluid_sim.h"
+#include "light_volume.h"
 
 namespace rayol::fluid {
 
@@ -11,6 +16,38 @@ struct Ray {
     Vec3 dir{0.0f, 0.0f, 1.0f};
 };
 
+// Pinhole camera of the fluid draw (FluidRenderer) and of CpuVolumeRenderer.
+struct CameraData {
+    Vec3 pos{0.0f, 0.0f, -1.0f};
+    Vec3 forward{0.0f, 0.0f, 1.0f};
+    Vec3 right{1.0f, 0.0f, 0.0f};
+    float tan_half_fov{0.577f};  // tan(30 deg)
+    float aspect{16.0f / 9.0f};
+};
+
+// Ray through the image point at (ndc_x, ndc_y) in [-1, 1], as volume_raymarch.frag builds it: up is
+// cross(right, forward) and ndc_y = 1 is the top row of the framebuffer.
+Ray camera_ray(const CameraData& camera, float ndc_x, float ndc_y);
+
+// Step lengths of an adaptive march, as multiples of RayMarchSettings::step (mirrored by the
+// kAdaptive constants of volume_raymarch.frag).
+struct AdaptiveStepSettings {
+    bool enabled = false;
+    float max_scale = 4.0f;         // Longest step, taken through empty or thin fog.
+    // Largest opacity one step may add to the pixel: steps shrink as the fog thickens and grow again
+    // once little light is left (the opacity is weighted by the transmittance so far).
+    float target_opacity = 0.02f;
+    // Shortest step per unit of distance from the ray origin, e.g. a pixel's footprint, so far
+    // regions take longer steps. 0 = the base step everywhere.
+    float distance_scale = 0.0f;
+    // A long step whose end reaches this (scaled) density is cut back to the crossing, found by
+    // bisection; the march goes on from there at short steps.
+    float iso = 0.35f;
+    int refine_iterations = 4;
+    // Samples per ray (0 = unlimited): steps stretch so the rest of the ray fits the samples left.
+    int step_budget = 0;
+};
+
 struct RayMarchSettings {
     float step = 0.01f;
     float max_distance = 5.0f;
@@ -19,17 +56,140 @@ struct RayMarchSettings {
     Vec3 light_dir{-0.4f, -1.0f, -0.2f};
     Vec3 light_color{1.0f, 0.95f, 0.9f};
     float ambient = 0.1f;
+    // Batched (SIMD) density samples along the ray and fused sample/gradient fetches. false = one
+    // sample() per step and a six-sample central-difference gradient (reference, for benchmarks).
+    bool fast_sampling = true;
+    // Jump over macrocells whose every sample is 0 (DensityVolume::macrocell max <= 0), landing on
+    // the same step positions a full march would. Needs current macrocells; ignored otherwise.
+    bool skip_empty = true;
+    // Optical depth toward the light, built for light_dir; shadows the light (not the ambient) by
+    // exp(-depth * density_scale * absorption). Null = unshadowed.
+    const LightVolume* light_volume = nullptr;
+    // Variable step lengths instead of `step` everywhere (ray_march_volume only; one sample and fused
+    // gradient per step, macrocells skipped whole).
+    AdaptiveStepSettings adaptive{};
 };
 
 struct RayMarchResult {
     Vec3 color{};
     float transmittance = 1.0f;
     float optical_depth = 0.0f;
-    int steps = 0;
+    int steps = 0;          // Steps sampled.
+    int skipped_steps = 0;  // Steps passed over inside empty macrocells (never sampled).
 };
 
 // CPU reference ray marcher for the density volume. Shade callback gets position, normal, and density.
 RayMarchResult ray_march_volume(const DensityVolume& volume, const Ray& ray, const RayMarchSettings& settings,
                                 const std::function<Vec3(Vec3 pos, Vec3 normal, float density)>& shade = {});
 
+// Default shading of the march: one directional light, shadowed through the settings' light volume
+// when there is one, plus ambient.
+struct DirectionalLightShade {
+    explicit DirectionalLightShade(const RayMarchSettings& settings)
+        : light_dir(normalize(settings.light_dir)), light_color(settings.light_color), ambient(settings.ambient),
+          light_volume(settings.light_volume), sigma_scale(settings.density_scale * settings.absorption) {}
+
+    Vec3 operator()(Vec3 pos, Vec3 normal, float /*density*/) const {
+        float n_dot_l = std::max(0.0f, -dot(normal, light_dir));
+        if (light_volume) n_dot_l *= light_volume->transmittance(pos, sigma_scale);
+        return light_color * n_dot_l + Vec3{ambient, ambient, ambient};
+    }
+
+    Vec3 light_dir;
+    Vec3 light_color;
+    float ambient;
+    const LightVolume* light_volume;
+    float sigma_scale;
+};
+
+// Rays marched in lockstep by ray_march_packet: one step of every lane is one 8-wide gathered
+// density fetch (and one for the gradients of its non-empty samples).
+constexpr int kRayPacketSize = 8;
+
+// Lane state of ray_march_packet. begin_ray_packet sets it up; each step_ray_packet advances every
+// active lane to its next sampled step (over empty macrocells) and fetches that step's samples.
+struct RayPacket {
+    Ray rays[kRayPacketSize];
+    Vec3 inv_dir[kRayPacketSize];
+    float t[kRayPacketSize] = {};  // Next step of each lane.
+    float t_end[kRayPacketSize] = {};
+    float cell_exit[kRayPacketSize] = {};
+    RayMarchResult result[kRayPacketSize];
+    uint32_t active = 0;  // Lanes still inside the box and not yet opaque.
+    // Lanes sampled by the current step in lane order, with their positions and scaled densities;
+    // gradients of the samples with density > 0 follow in the same order.
+    int sample_count = 0;
+    int sample_lane[kRayPacketSize] = {};
+    Vec3 sample_pos[kRayPacketSize];
+    float density[kRayPacketSize] = {};
+    DensitySample shaded[kRayPacketSize];
+    bool dense = false;  // The last step had no empty sample: fetch density and gradient together.
+};
+
+void begin_ray_packet(const DensityVolume& volume, const Ray* rays, int count, const RayMarchSettings& settings,
+                      RayPacket& packet);
+// False once every lane has finished (nothing was sampled).
+bool step_ray_packet(const DensityVolume& volume, const RayMarchSettings& settings, RayPacket& packet);
+
+// ray_march_volume for up to kRayPacketSize rays at once, best with coherent rays (neighboring
+// pixels). Each lane lands on the same steps, takes the same samples and composites them in the same
+// order as a fast_sampling ray_march_volume, so results match it exactly; fast_sampling and adaptive
+// are ignored.
+// Lanes drop out of the packet on their own when they leave the box or turn opaque. `shade` is
+// called as shade(pos, normal, density) -> Vec3 and inlined, unlike the std::function callback.
+template <typename Shade>
+void ray_march_packet(const DensityVolume& volume, const Ray* rays, int count, const RayMarchSettings& settings,
+                      RayMarchResult* results, const Shade& shade) {
+    count = std::clamp(count, 0, kRayPacketSize);
+    RayPacket packet;
+    begin_ray_packet(volume, rays, count, settings, packet);
+    const float step = std::max(0.0001f, settings.step);
+    while (step_ray_packet(volume, settings, packet)) {
+        int shaded = 0;
+        for (int s = 0; s < packet.sample_count; ++s) {
+            const float density = packet.density[s];
+            if (density <= 0.0f) continue;
+            RayMarchResult& r = packet.result[packet.sample_lane[s]];
+            const float sigma_t = density * settings.absorption;
+            const float attenuation = std::exp(-sigma_t * step);
+            r.optical_depth += sigma_t * step;
+            const Vec3 normal = normalize(packet.shaded[shaded++].gradient);
+            const Vec3 in_scatter = shade(packet.sample_pos[s], normal, density) * (sigma_t * step);
+            r.color = r.color + r.transmittance * in_scatter;
+            r.transmittance *= attenuation;
+        }
+    }
+    std::copy_n(packet.result, count, results);
+}
+
+inline void ray_march_packet(const DensityVolume& volume, const Ray* rays, int count,
+                             const RayMarchSettings& settings, RayMarchResult* results) {
+    ray_march_packet(volume, rays, count, settings, results, DirectionalLightShade(settings));
+}
+
+struct SphereTraceSettings {
+    float max_distance = 5.0f;
+    int max_iterations = 128;  // Sphere tracing only; fixed steps run to the end of the box.
+    // Distances in voxels: a hit is a field value below hit_epsilon, and steps never go below
+    // min_step so rays grazing the surface still advance.
+    float hit_epsilon = 0.05f;
+    float min_step = 0.1f;
+    int refine_iterations = 4;  // Regula falsi steps when a step lands inside the surface.
+    // > 0: march steps of this many voxels until the field is <= 0 instead of stepping by the field
+    // (the iso search the density march does; reference for benchmarks).
+    float fixed_step = 0.0f;
+};
+
+struct SphereTraceResult {
+    bool hit = false;
+    float t = 0.0f;
+    Vec3 position{};
+    Vec3 normal{};       // Normalized field gradient at the hit.
+    int iterations = 0;  // Field samples of the search, refinement included (not the normal's).
+};
+
+// Find the first zero crossing of the distance field along the ray, inside the field's box.
+SphereTraceResult sphere_trace_distance(const DistanceVolume& field, const Ray& ray,
+                                        const SphereTraceSettings& settings);
+
 }  // namespace rayol::fluid
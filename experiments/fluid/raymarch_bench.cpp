@@ -0,0 +1,414 @@
+#include "raymarch_bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "density_splat.h"
+#include "raymarch.h"
+
+namespace rayol::fluid {
+
+VolumeSamplingBenchmarkResult benchmark_volume_sampling(const FluidSettings& settings, int frames, float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const DensityVolume& volume = sim.volume();
+    const VolumeConfig& cfg = volume.config();
+    const Vec3 extent = sim.volume_extent();
+    VolumeSamplingBenchmarkResult result{};
+
+    // Random points over the lower half of the domain, where the fluid pools.
+    constexpr size_t kPoints = 1 << 16;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Vec3> points(kPoints);
+    for (Vec3& p : points) {
+        p = {cfg.origin.x + unit(rng) * extent.x, cfg.origin.y + 0.5f * unit(rng) * extent.y,
+             cfg.origin.z + unit(rng) * extent.z};
+    }
+    std::vector<float> scalar(kPoints);
+    std::vector<float> batched(kPoints);
+    std::vector<Vec3> six(kPoints);
+    std::vector<DensitySample> fused(kPoints);
+    std::vector<DensitySample> fused_batched(kPoints);
+    auto per_point_ns = [&](auto start) { return elapsed_ms(start) * 1.0e6f / static_cast<float>(kPoints); };
+    result.sample_ns = result.sample_n_ns = result.gradient_ns = result.fused_ns = result.fused_n_ns =
+        std::numeric_limits<float>::max();
+    for (int rep = 0; rep < kSplatRepeats; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kPoints; ++i) {
+            scalar[i] = volume.sample(points[i]);
+        }
+        result.sample_ns = std::min(result.sample_ns, per_point_ns(start));
+
+        start = std::chrono::steady_clock::now();
+        volume.sample_n(points, batched);
+        result.sample_n_ns = std::min(result.sample_n_ns, per_point_ns(start));
+
+        start = std::chrono::steady_clock::now();
+        const float h = cfg.voxel_size;
+        for (size_t i = 0; i < kPoints; ++i) {
+            const Vec3 p = points[i];
+            scalar[i] = volume.sample(p);
+            six[i] = {(volume.sample(p + Vec3{h, 0.0f, 0.0f}) - volume.sample(p - Vec3{h, 0.0f, 0.0f})) / (2.0f * h),
+                      (volume.sample(p + Vec3{0.0f, h, 0.0f}) - volume.sample(p - Vec3{0.0f, h, 0.0f})) / (2.0f * h),
+                      (volume.sample(p + Vec3{0.0f, 0.0f, h}) - volume.sample(p - Vec3{0.0f, 0.0f, h})) / (2.0f * h)};
+        }
+        result.gradient_ns = std::min(result.gradient_ns, per_point_ns(start));
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kPoints; ++i) {
+            fused[i] = volume.sample_with_gradient(points[i]);
+        }
+        result.fused_ns = std::min(result.fused_ns, per_point_ns(start));
+
+        start = std::chrono::steady_clock::now();
+        volume.sample_with_gradient_n(points, fused_batched);
+        result.fused_n_ns = std::min(result.fused_n_ns, per_point_ns(start));
+    }
+    float peak = 0.0f;
+    float peak_gradient = 0.0f;
+    for (size_t i = 0; i < kPoints; ++i) {
+        peak = std::max(peak, scalar[i]);
+        peak_gradient = std::max(peak_gradient, length(six[i]));
+        result.max_sample_error = std::max(result.max_sample_error, std::fabs(batched[i] - scalar[i]));
+        result.max_sample_error = std::max(result.max_sample_error, std::fabs(fused[i].density - scalar[i]));
+        result.max_sample_error = std::max(result.max_sample_error, std::fabs(fused_batched[i].density - scalar[i]));
+        result.max_gradient_error = std::max(result.max_gradient_error, length(fused[i].gradient - six[i]));
+        result.max_gradient_error = std::max(result.max_gradient_error, length(fused_batched[i].gradient - six[i]));
+    }
+    if (peak > 0.0f) result.max_sample_error /= peak;
+    if (peak_gradient > 0.0f) result.max_gradient_error /= peak_gradient;
+
+    RayMarchSettings march{};
+    march.step = 0.5f * cfg.voxel_size;
+    march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+    march.skip_empty = false;
+    std::vector<Vec3> reference_color;
+    std::vector<Vec3> fast_color;
+    march.fast_sampling = false;
+    result.reference_rays_per_sec = march_ray_grid(volume, march, reference_color).rays_per_sec;
+    march.fast_sampling = true;
+    result.fast_rays_per_sec = march_ray_grid(volume, march, fast_color).rays_per_sec;
+    result.max_color_error = max_color_difference(reference_color, fast_color);
+    return result;
+}
+
+std::vector<EmptySpaceBenchmarkResult> benchmark_empty_space_skipping(const FluidSettings& settings,
+                                                                      const std::vector<int>& dims,
+                                                                      int frames,
+                                                                      float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const ParticleStore& particles = sim.particles();
+    const float h = sim.settings().kernel_radius;
+    const Vec3 extent = sim.volume_extent();
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    SplatScratch scratch{};
+
+    std::vector<EmptySpaceBenchmarkResult> results;
+    std::vector<Vec3> full_color;
+    std::vector<Vec3> skip_color;
+    for (int dim : dims) {
+        if (dim <= 0) continue;
+        VolumeConfig config = sim.volume().config();
+        config.dims = {dim, dim, dim};
+        config.voxel_size = extent.x / static_cast<float>(dim);
+        DensityVolume volume(config);
+
+        EmptySpaceBenchmarkResult result{};
+        result.dim = dim;
+        result.update_ms = std::numeric_limits<float>::max();
+        for (int rep = 0; rep < kSplatRepeats; ++rep) {
+            splat_density_slabs(volume, particles, h, nullptr, scratch, scheduler);  // Full rebuild next.
+            const auto start = std::chrono::steady_clock::now();
+            volume.update_macrocells();
+            result.update_ms = std::min(result.update_ms, elapsed_ms(start));
+        }
+        const std::vector<MacrocellRange>& cells = volume.macrocells();
+        const auto empty = std::count_if(cells.begin(), cells.end(), [](const MacrocellRange& c) { return c.max <= 0.0f; });
+        result.empty_fraction = cells.empty() ? 0.0f : static_cast<float>(empty) / static_cast<float>(cells.size());
+
+        float peak = 0.0f;
+        for (const MacrocellRange& c : cells) {
+            peak = std::max(peak, c.max);
+        }
+        RayMarchSettings march{};
+        march.step = 0.5f * config.voxel_size;
+        march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+        march.skip_empty = false;
+        const RayGridTiming full = march_ray_grid(volume, march, full_color);
+        march.skip_empty = true;
+        const RayGridTiming skip = march_ray_grid(volume, march, skip_color);
+        result.steps_per_ray = full.steps_per_ray;
+        result.skip_steps_per_ray = skip.steps_per_ray;
+        result.skipped_per_ray = skip.skipped_per_ray;
+        result.rays_per_sec = full.rays_per_sec;
+        result.skip_rays_per_sec = skip.rays_per_sec;
+        result.max_color_error = max_color_difference(full_color, skip_color);
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<VolumeLayoutBenchmarkResult> benchmark_volume_layouts(const FluidSettings& settings,
+                                                                  int dim,
+                                                                  int frames,
+                                                                  float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const ParticleStore& particles = sim.particles();
+    const float h = sim.settings().kernel_radius;
+    const Vec3 extent = sim.volume_extent();
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, settings.thread_count)));
+    SplatScratch scratch{};
+
+    VolumeConfig config = sim.volume().config();
+    config.dims = {std::max(1, dim), std::max(1, dim), std::max(1, dim)};
+    config.voxel_size = extent.x / static_cast<float>(config.dims.x);
+    constexpr size_t kPoints = 1 << 16;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Vec3> points(kPoints);
+    for (Vec3& p : points) {
+        p = {config.origin.x + unit(rng) * extent.x, config.origin.y + 0.5f * unit(rng) * extent.y,
+             config.origin.z + unit(rng) * extent.z};
+    }
+    std::vector<float> samples(kPoints);
+    std::vector<DensitySample> gradients(kPoints);
+    std::vector<float> staging;
+    std::vector<float> dense;
+    std::vector<float> reference_dense;
+    std::vector<float> reference_samples;
+    std::vector<DensitySample> reference_gradients;
+    auto per_point_ns = [&](auto start) { return elapsed_ms(start) * 1.0e6f / static_cast<float>(kPoints); };
+
+    std::vector<VolumeLayoutBenchmarkResult> results;
+    for (VoxelLayout layout : {VoxelLayout::Linear, VoxelLayout::Tiled4, VoxelLayout::Morton}) {
+        config.layout = layout;
+        DensityVolume volume(config);
+        VolumeLayoutBenchmarkResult result{};
+        result.layout = layout;
+        result.serial_splat_ms = result.slab_splat_ms = result.sample_ns = result.sample_n_ns = result.gradient_ns =
+            result.gradient_n_ns = result.upload_ms = std::numeric_limits<float>::max();
+        for (int rep = 0; rep < kSplatRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            volume.clear();
+            volume.splat_particles(particles, h);
+            result.serial_splat_ms = std::min(result.serial_splat_ms, elapsed_ms(start));
+
+            start = std::chrono::steady_clock::now();
+            splat_density_slabs(volume, particles, h, nullptr, scratch, scheduler);
+            result.slab_splat_ms = std::min(result.slab_splat_ms, elapsed_ms(start));
+        }
+        for (int rep = 0; rep < kSplatRepeats; ++rep) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < kPoints; ++i) {
+                samples[i] = volume.sample(points[i]);
+            }
+            result.sample_ns = std::min(result.sample_ns, per_point_ns(start));
+
+            start = std::chrono::steady_clock::now();
+            volume.sample_n(points, samples);
+            result.sample_n_ns = std::min(result.sample_n_ns, per_point_ns(start));
+
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < kPoints; ++i) {
+                gradients[i] = volume.sample_with_gradient(points[i]);
+            }
+            result.gradient_ns = std::min(result.gradient_ns, per_point_ns(start));
+
+            start = std::chrono::steady_clock::now();
+            volume.sample_with_gradient_n(points, gradients);
+            result.gradient_n_ns = std::min(result.gradient_n_ns, per_point_ns(start));
+
+            // Upload packing as in FluidRenderer::upload_cpu_density: the pool as is for Linear,
+            // brick by brick otherwise.
+            start = std::chrono::steady_clock::now();
+            staging.resize(volume.pool().size());
+            if (layout == VoxelLayout::Linear) {
+                std::memcpy(staging.data(), volume.pool().data(), volume.pool().size() * sizeof(float));
+            } else {
+                volume.for_each_brick([&](int brick) {
+                    const size_t slot = static_cast<size_t>(volume.brick_slot(brick));
+                    volume.copy_brick_linear(brick, staging.data() + slot * kBrickVoxels);
+                });
+            }
+            result.upload_ms = std::min(result.upload_ms, elapsed_ms(start));
+        }
+
+        // Slab splat (the volume's current contents) and samples against the Linear run.
+        volume.copy_dense(dense);
+        if (layout == VoxelLayout::Linear) {
+            reference_dense = dense;
+            reference_samples = samples;
+            reference_gradients = gradients;
+        } else {
+            for (size_t i = 0; i < dense.size(); ++i) {
+                result.max_error = std::max(result.max_error, std::fabs(dense[i] - reference_dense[i]));
+            }
+            for (size_t i = 0; i < kPoints; ++i) {
+                result.max_error = std::max(result.max_error, std::fabs(samples[i] - reference_samples[i]));
+                const Vec3 gradient_error = gradients[i].gradient - reference_gradients[i].gradient;
+                result.max_error = std::max(result.max_error, length(gradient_error));
+            }
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+std::vector<DensityFormatBenchmarkResult> benchmark_density_formats(const FluidSettings& settings, int frames,
+                                                                    float dt) {
+    FluidExperiment sim;
+    settle(sim, settings, frames, dt);
+    const DensityVolume& volume = sim.volume();
+    const VolumeConfig& cfg = volume.config();
+    const float peak = sim.stats().max_density;
+    const double voxels = static_cast<double>(cfg.dims.x) * cfg.dims.y * cfg.dims.z;
+    constexpr double kMb = 1.0 / (1024.0 * 1024.0);
+
+    RayMarchSettings march{};
+    march.step = 0.5f * cfg.voxel_size;
+    march.density_scale = peak > 0.0f ? 4.0f / peak : 1.0f;  // Partly translucent fluid.
+    std::vector<Vec3> reference_color;
+    std::vector<Vec3> color;
+    march_ray_grid(volume, march, reference_color);
+
+    std::vector<DensityFormatBenchmarkResult> results;
+    std::vector<uint8_t> staging;
+    float linear[kBrickVoxels];
+    for (DensityFormat format : {DensityFormat::Float32, DensityFormat::Float16, DensityFormat::Unorm16}) {
+        DensityFormatBenchmarkResult result{};
+        result.format = format;
+        const size_t texel_bytes = density_format_bytes(format);
+        const float range = density_texel_range(format, peak);
+        const float encode_scale = 1.0f / range;
+        result.upload_mb = static_cast<float>(static_cast<double>(volume.pool().size() * texel_bytes) * kMb);
+        result.texture_mb = static_cast<float>(voxels * static_cast<double>(texel_bytes) * kMb);
+
+        // Conversion as in FluidRenderer::upload_cpu_density: the pool in one call for Linear, brick by
+        // brick otherwise.
+        staging.resize(std::max<size_t>(volume.pool().size(), 1) * texel_bytes);
+        auto encode = [&](bool simd) {
+            return best_of_ms(kSplatRepeats, [&] {
+                if (volume.layout() == VoxelLayout::Linear) {
+                    encode_density(format, volume.pool().data(), volume.pool().size(), encode_scale, staging.data(),
+                                   simd);
+                } else {
+                    volume.for_each_brick([&](int brick) {
+                        const size_t slot = static_cast<size_t>(volume.brick_slot(brick));
+                        volume.copy_brick_linear(brick, linear);
+                        encode_density(format, linear, kBrickVoxels, encode_scale,
+                                       staging.data() + slot * kBrickVoxels * texel_bytes, simd);
+                    });
+                }
+            });
+        };
+        result.scalar_encode_ms = encode(false);
+        result.encode_ms = encode(true);
+
+        // What the GPU reads back, as a float volume. Quantizing never turns 0 into non-zero, so the
+        // float volume's macrocells still mark the empty cells.
+        DensityVolume decoded = volume;
+        double error_sum = 0.0;
+        double error_count = 0.0;
+        decoded.for_each_brick([&](int brick) {
+            float* data = decoded.brick_data(brick);
+            for (int i = 0; i < kBrickVoxels; ++i) {
+                const float value = quantize_density(format, data[i] * encode_scale) * range;
+                const float error = std::fabs(value - data[i]);
+                result.max_error = std::max(result.max_error, error);
+                error_sum += error;
+                data[i] = value;
+            }
+            error_count += kBrickVoxels;
+        });
+        if (peak > 0.0f) {
+            result.max_error /= peak;
+            result.mean_error = error_count > 0.0 ? static_cast<float>(error_sum / error_count) / peak : 0.0f;
+        }
+        march_ray_grid(decoded, march, color);
+        result.max_color_error = max_color_difference(reference_color, color);
+        results.push_back(result);
+    }
+    return results;
+}
+
+namespace {
+
+void run_sampling(const FluidSettings& settings) {
+    const auto row = benchmark_volume_sampling(settings, 120, 1.0f / 60.0f);
+    BenchLine("volume sampling")("sample_ns", row.sample_ns)
+        ("sample_n_ns", row.sample_n_ns)
+        ("six_sample_gradient_ns", row.gradient_ns)
+        ("fused_ns", row.fused_ns)
+        ("fused_n_ns", row.fused_n_ns)
+        ("sample_error", row.max_sample_error)
+        ("gradient_error", row.max_gradient_error)
+        ("rays_per_sec", row.reference_rays_per_sec)
+        ("fast_rays_per_sec", row.fast_rays_per_sec)
+        ("color_error", row.max_color_error);
+}
+
+void run_empty_space(const FluidSettings& settings) {
+    for (const auto& row : benchmark_empty_space_skipping(settings, {32, 64, 128}, 120, 1.0f / 60.0f)) {
+        BenchLine("empty space")("dim", row.dim)
+            ("macrocell_update_ms", row.update_ms)
+            ("empty", row.empty_fraction)
+            ("steps_per_ray", row.steps_per_ray)
+            ("skip_steps_per_ray", row.skip_steps_per_ray)
+            ("skipped_per_ray", row.skipped_per_ray)
+            ("rays_per_sec", row.rays_per_sec)
+            ("skip_rays_per_sec", row.skip_rays_per_sec)
+            ("color_error", row.max_color_error);
+    }
+}
+
+void run_layouts(const FluidSettings& settings) {
+    const char* layout_names[] = {"linear", "tiled4", "morton"};
+    for (const auto& row : benchmark_volume_layouts(settings, 128, 120, 1.0f / 60.0f)) {
+        BenchLine("voxel")("layout", layout_names[static_cast<int>(row.layout)])
+            ("serial_splat_ms", row.serial_splat_ms)
+            ("slab_splat_ms", row.slab_splat_ms)
+            ("sample_ns", row.sample_ns)
+            ("sample_n_ns", row.sample_n_ns)
+            ("gradient_ns", row.gradient_ns)
+            ("gradient_n_ns", row.gradient_n_ns)
+            ("upload_ms", row.upload_ms)
+            ("max_error", row.max_error);
+    }
+}
+
+void run_density_formats(const FluidSettings& settings) {
+    const char* format_names[] = {"r32f", "r16f", "r16unorm"};
+    for (const auto& row : benchmark_density_formats(settings, 120, 1.0f / 60.0f)) {
+        BenchLine("density")("format", format_names[static_cast<int>(row.format)])
+            ("upload_mb", row.upload_mb)
+            ("texture_mb", row.texture_mb)
+            ("encode_ms", row.encode_ms)
+            ("scalar_encode_ms", row.scalar_encode_ms)
+            ("max_error", row.max_error)
+            ("mean_error", row.mean_error)
+            ("color_error", row.max_color_error);
+    }
+}
+
+constexpr BenchSuite kSuites[] = {
+    {"sampling", "scalar vs. batched sampling and fused gradients", run_sampling},
+    {"empty_space", "ray-march steps with and without macrocell skipping", run_empty_space},
+    {"layouts", "splat/sample/gradient/upload cost per voxel layout", run_layouts},
+    {"density_formats", "upload size, conversion cost and error per texel format", run_density_formats},
+};
+
+}  // namespace
+
+std::span<const BenchSuite> raymarch_bench_suites() {
+    return kSuites;
+}
+
+}  // namespace rayol::fluid
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "bench_harness.h"
+#include "fluid_experiment.h"
+
+// Volume sampling benchmarks: point sampling and gradients, macrocell empty-space skipping, voxel
+// layouts and density texel formats, each checked against a CPU ray march of the float volume.
+
+namespace rayol::fluid {
+
+struct VolumeSamplingBenchmarkResult {
+    float sample_ns = 0.0f;     // DensityVolume::sample per point
+    float sample_n_ns = 0.0f;   // DensityVolume::sample_n per point
+    float gradient_ns = 0.0f;   // sample() plus a six-sample central-difference gradient per point
+    float fused_ns = 0.0f;      // DensityVolume::sample_with_gradient per point
+    float fused_n_ns = 0.0f;    // DensityVolume::sample_with_gradient_n per point
+    float max_sample_error = 0.0f;    // Batched and fused vs. sample, relative to the peak density
+    float max_gradient_error = 0.0f;  // Fused (single and batched) vs. six-sample, relative to the largest gradient
+    float reference_rays_per_sec = 0.0f;  // ray_march_volume with fast_sampling off
+    float fast_rays_per_sec = 0.0f;       // ray_march_volume with fast_sampling on
+    float max_color_error = 0.0f;         // Largest color channel difference between the two
+};
+
+struct EmptySpaceBenchmarkResult {
+    int dim = 0;                      // Volume edge in voxels (same domain, finer voxels)
+    float update_ms = 0.0f;           // Full DensityVolume::update_macrocells after a resplat
+    float empty_fraction = 0.0f;      // Share of macrocells with max <= 0
+    float steps_per_ray = 0.0f;       // Sampled steps per ray, fixed-step march
+    float skip_steps_per_ray = 0.0f;  // Sampled steps per ray with macrocell skipping
+    float skipped_per_ray = 0.0f;     // Steps per ray jumped over by the skipping march
+    float rays_per_sec = 0.0f;
+    float skip_rays_per_sec = 0.0f;
+    float max_color_error = 0.0f;     // Largest color channel difference between the two marches
+};
+
+struct VolumeLayoutBenchmarkResult {
+    VoxelLayout layout = VoxelLayout::Linear;
+    float serial_splat_ms = 0.0f;  // DensityVolume::splat_particles
+    float slab_splat_ms = 0.0f;    // splat_density_slabs
+    float sample_ns = 0.0f;        // DensityVolume::sample per point
+    float sample_n_ns = 0.0f;      // DensityVolume::sample_n per point
+    float gradient_ns = 0.0f;      // DensityVolume::sample_with_gradient per point
+    float gradient_n_ns = 0.0f;    // DensityVolume::sample_with_gradient_n per point
+    float upload_ms = 0.0f;        // Allocated bricks converted to x-major staging (copy_brick_linear)
+    float max_error = 0.0f;        // Largest voxel or sample difference from the Linear volume
+};
+
+struct DensityFormatBenchmarkResult {
+    DensityFormat format = DensityFormat::Float32;
+    float upload_mb = 0.0f;          // Staging bytes of a full upload (every allocated brick)
+    float texture_mb = 0.0f;         // Density image footprint
+    float encode_ms = 0.0f;          // Full upload conversion into staging, SIMD where the CPU has it
+    float scalar_encode_ms = 0.0f;   // Same with the scalar converter
+    float max_error = 0.0f;          // Largest |decoded - float| voxel difference over the peak density
+    float mean_error = 0.0f;         // Mean of the same over allocated voxels
+    float max_color_error = 0.0f;    // CPU ray march of the decoded volume against the float one
+};
+
+// Settle a sim from `settings` for `frames` steps, then time point sampling (scalar vs. batched,
+// six-sample vs. fused vs. batched fused gradient) at random points in the volume and CPU ray marching of a 128x128
+// ray grid with and without the fast sampling paths.
+VolumeSamplingBenchmarkResult benchmark_volume_sampling(const FluidSettings& settings, int frames, float dt);
+
+// Settle a sim from `settings` for `frames` steps, resplat its particles into volumes of each
+// dims^3 over the same domain, and compare a 128x128 CPU ray march with and without macrocell
+// empty-space skipping (steps, throughput, color difference), plus the macrocell rebuild cost.
+std::vector<EmptySpaceBenchmarkResult> benchmark_empty_space_skipping(const FluidSettings& settings,
+                                                                      const std::vector<int>& dims,
+                                                                      int frames,
+                                                                      float dt);
+
+// Settle a sim from `settings`, then splat it into `dim`^3 volumes with each voxel layout and time
+// the splats, random-point sampling over the lower half of the domain and upload conversion, and
+// check every layout reproduces the Linear volume.
+std::vector<VolumeLayoutBenchmarkResult> benchmark_volume_layouts(const FluidSettings& settings,
+                                                                  int dim,
+                                                                  int frames,
+                                                                  float dt);
+
+// Run the sim for `frames`, then convert its final volume to each density texel format as a full
+// FluidRenderer upload would, reporting staging/texture size, conversion cost and the error of the
+// decoded voxels and of a ray march through them against the float volume.
+std::vector<DensityFormatBenchmarkResult> benchmark_density_formats(const FluidSettings& settings, int frames,
+                                                                    float dt);
+
+// Suites for rayol_fluid_bench, in run order.
+std::span<const BenchSuite> raymarch_bench_suites();
+
+}  // namespace rayol::fluid
@@ -8,25 +8,130 @@ layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler3D uDensity;
 layout(binding = 1) uniform sampler2D uBlueNoise;
+// Per 4^3-voxel macrocell: r = min, g = max of every voxel a sample inside the cell can read.
+layout(binding = 2) uniform sampler3D uMacrocells;
+// Particle signed distance field on the density grid (world units, negative inside), clamp-to-edge.
+layout(binding = 3) uniform sampler3D uDistance;
+// Optical depth toward the light in density texel units over the same box (LightVolume), clamp-to-edge.
+layout(binding = 4) uniform sampler3D uLight;
 
 layout(push_constant) uniform Params {
     vec4 volumeOrigin_step;   // xyz = origin, w = step
     vec4 volumeExtent_scale;  // xyz = extent, w = densityScale
     vec4 lightDir_absorb;     // xyz = light dir, w = absorption
     vec4 lightColor_ambient;  // xyz = light color, w = ambient
-    vec4 camera_pos;          // xyz = camera position, w unused
+    vec4 camera_pos;          // xyz = camera position, w = 1: surface from uDistance (sphere traced)
     vec4 camera_forward;      // xyz = forward, w = tan(fov/2)
     vec4 camera_right;        // xyz = right, w = aspect
     float maxDistance;
     uint frameIndex;
-    vec2 padding;
+    float macrocellSize;  // World size of a macrocell
+    uint flags;           // kUse* bits; bits 8-31 = adaptive sample budget per ray and pass (0 = unlimited)
 } params;
 
+const uint kUseMacrocells = 1u;   // Else march every step (no current macrocells)
+const uint kUseLightVolume = 2u;  // Else unshadowed
+const uint kUseAdaptiveSteps = 4u;
+
+// Adaptive steps, as AdaptiveStepSettings in raymarch.h: longest step in base steps, largest opacity
+// one fog step may add, bisection steps at a surface crossing.
+const float kAdaptiveMaxScale = 4.0;
+const float kAdaptiveOpacity = 0.02;
+const int kAdaptiveRefine = 4;
+
 float sampleDensity(vec3 worldPos) {
     vec3 uvw = (worldPos - params.volumeOrigin_step.xyz) / params.volumeExtent_scale.xyz;
     return texture(uDensity, uvw).r * params.volumeExtent_scale.w;
 }
 
+// Largest scaled density a sample in the macrocell containing worldPos can see; infinite when
+// macrocells are off or the point rounds outside the grid.
+float macrocellMax(vec3 worldPos, out ivec3 cell) {
+    cell = ivec3(floor((worldPos - params.volumeOrigin_step.xyz) / params.macrocellSize));
+    if ((params.flags & kUseMacrocells) == 0u || any(lessThan(cell, ivec3(0))) ||
+        any(greaterThanEqual(cell, textureSize(uMacrocells, 0)))) {
+        return 1.0 / 0.0;
+    }
+    return texelFetch(uMacrocells, cell, 0).g * params.volumeExtent_scale.w;
+}
+
+// Last step position inside the cell, so the caller's `t += stepSize` lands on the first step past it.
+float lastStepInCell(ivec3 cell, vec3 origin, vec3 dir, vec3 invDir, float t, float stepSize) {
+    vec3 cellFar = params.volumeOrigin_step.xyz + (vec3(cell) + step(vec3(0.0), dir)) * params.macrocellSize;
+    vec3 tFar = (cellFar - origin) * invDir;
+    float tCellExit = min(min(tFar.x, tFar.y), tFar.z);
+    return t + max(ceil((tCellExit - t) / stepSize) - 1.0, 0.0) * stepSize;
+}
+
+// Fraction of the light reaching worldPos: one lookup of the light volume, scaled like a density sample.
+float lightTransmittance(vec3 worldPos) {
+    if ((params.flags & kUseLightVolume) == 0u) return 1.0;
+    vec3 uvw = (worldPos - params.volumeOrigin_step.xyz) / params.volumeExtent_scale.xyz;
+    return exp(-texture(uLight, uvw).r * params.volumeExtent_scale.w * params.lightDir_absorb.w);
+}
+
+// Stretch an adaptive step so the rest of the ray fits the samples left in the budget.
+float budgetStep(float stepLen, float t, float tExit, uint samples, uint budget) {
+    if (budget == 0u) return stepLen;
+    return samples >= budget ? tExit - t : max(stepLen, (tExit - t) / float(budget - samples));
+}
+
+float sampleDistance(vec3 worldPos) {
+    vec3 uvw = (worldPos - params.volumeOrigin_step.xyz) / params.volumeExtent_scale.xyz;
+    return texture(uDistance, uvw).r;
+}
+
+vec3 distanceGradient(vec3 worldPos, float h) {
+    vec3 dx = vec3(h, 0.0, 0.0);
+    vec3 dy = vec3(0.0, h, 0.0);
+    vec3 dz = vec3(0.0, 0.0, h);
+    return vec3(sampleDistance(worldPos + dx) - sampleDistance(worldPos - dx),
+                sampleDistance(worldPos + dy) - sampleDistance(worldPos - dy),
+                sampleDistance(worldPos + dz) - sampleDistance(worldPos - dz));
+}
+
+// First zero crossing of the distance field in [t, tExit]. Steps by the field (it is 1-Lipschitz, so a
+// step never passes the surface by more than filtering error), at least a tenth of a voxel; a step
+// that lands inside is refined by regula falsi between the last two samples. Mirrors
+// sphere_trace_distance in raymarch.cpp.
+bool sphereTrace(vec3 origin, vec3 dir, float t, float tExit, out vec3 hitPos, out vec3 hitNormal) {
+    float voxel = params.volumeExtent_scale.x / float(textureSize(uDistance, 0).x);
+    float epsilon = 0.05 * voxel;
+    float minStep = 0.1 * voxel;
+    float tPrev = t;
+    float phiPrev = 0.0;
+    hitPos = vec3(0.0);
+    hitNormal = vec3(0.0);
+    for (int i = 0; i < 128 && t <= tExit; ++i) {
+        float phi = sampleDistance(origin + dir * t);
+        if (phi <= epsilon) {
+            if (phi < 0.0 && i > 0) {
+                float tOut = tPrev, phiOut = phiPrev;
+                float tIn = t, phiIn = phi;
+                for (int j = 0; j < 4; ++j) {
+                    t = tOut + (tIn - tOut) * phiOut / (phiOut - phiIn);
+                    float phiMid = sampleDistance(origin + dir * t);
+                    if (abs(phiMid) <= epsilon) break;
+                    if (phiMid > 0.0) {
+                        tOut = t;
+                        phiOut = phiMid;
+                    } else {
+                        tIn = t;
+                        phiIn = phiMid;
+                    }
+                }
+            }
+            hitPos = origin + dir * t;
+            hitNormal = distanceGradient(hitPos, voxel);
+            return true;
+        }
+        tPrev = t;
+        phiPrev = phi;
+        t += max(phi, minStep);
+    }
+    return false;
+}
+
 vec3 gradient(vec3 worldPos, float h) {
     vec3 dx = vec3(h, 0.0, 0.0);
     vec3 dy = vec3(0.0, h, 0.0);
@@ -92,6 +197,8 @@ void main() {
     vec3 up = normalize(cross(right, forward));
     vec3 dir = normalize(forward + ndc.x * aspect * tanHalfFov * right + ndc.y * tanHalfFov * up);
     vec3 origin = params.camera_pos.xyz;
+    // World size of a pixel per unit of distance: adaptive steps never go below it.
+    float pixelFootprint = 2.0 * tanHalfFov * fwidth(vUV.y);
 
     // Compute entry/exit distances with the axis-aligned volume box.
     vec3 boxMin = params.volumeOrigin_step.xyz;
@@ -119,16 +226,51 @@ void main() {
     vec3 hitPos = vec3(0.0);
     vec3 hitNormal = vec3(0.0);
 
-    // Iso-surface search.
-    for (; t < tExit; t += stepSize) {
+    // Iso-surface search: sphere trace the distance field when there is one (a few dozen samples),
+    // otherwise step through the density.
+    // Adaptive steps grow with the distance to the iso level and are bisected back to the crossing.
+    ivec3 cell;
+    bool adaptive = (params.flags & kUseAdaptiveSteps) != 0u;
+    uint budget = adaptive ? params.flags >> 8 : 0u;
+    uint samples = 0u;
+    float stepLen = stepSize;
+    float tPrev = t;
+    if (params.camera_pos.w > 0.5) {
+        hit = sphereTrace(origin, dir, max(tEnter, 0.0), tExit, hitPos, hitNormal);
+        t = tExit;
+    }
+    for (; t < tExit; t += stepLen) {
         vec3 pos = origin + dir * t;
+        stepLen = stepSize;
+        if (macrocellMax(pos, cell) < iso) {
+            t = lastStepInCell(cell, origin, dir, invDir, t, stepSize);  // Nothing here reaches the surface.
+            tPrev = t;
+            continue;
+        }
+        if (budget != 0u && samples >= budget) break;
         float density = sampleDensity(pos);
+        ++samples;
         if (density >= iso) {
+            if (adaptive) {
+                float lo = tPrev;
+                float hi = t;
+                for (int i = 0; i < kAdaptiveRefine; ++i) {
+                    float mid = 0.5 * (lo + hi);
+                    if (sampleDensity(origin + dir * mid) >= iso) hi = mid; else lo = mid;
+                }
+                pos = origin + dir * hi;
+            }
             hitPos = pos;
             hitNormal = normalize(gradient(hitPos, stepSize * 0.5));
             hit = true;
             break;
         }
+        if (adaptive) {
+            float minStep = max(stepSize, t * pixelFootprint);
+            stepLen = minStep * mix(kAdaptiveMaxScale, 1.0, clamp(density / iso, 0.0, 1.0));
+            stepLen = budgetStep(stepLen, t, tExit, samples, budget);
+        }
+        tPrev = t;
     }
 
     vec3 gridColor = renderGrid(origin, dir);
@@ -145,12 +287,13 @@ void main() {
         vec3 lightColor = params.lightColor_ambient.xyz;
         float ambient = params.lightColor_ambient.w;
 
-        float NdotL = max(0.0, dot(N, L));
+        float shadow = lightTransmittance(hitPos);
+        float NdotL = max(0.0, dot(N, L)) * shadow;
         vec3 diffuse = baseColor * lightColor * NdotL;
 
         vec3 H = normalize(L + V);
         float NdotH = max(0.0, dot(N, H));
-        float spec = pow(NdotH, 64.0);
+        float spec = pow(NdotH, 64.0) * shadow;
         vec3 specularColor = vec3(1.0);
 
         // Simple Fresnel term to give a glancing-edge highlight.
@@ -167,20 +310,40 @@ void main() {
     vec3 accum = vec3(0.0);
     float transmittance = 1.0;
 
+    // Adaptive fog steps add at most kAdaptiveOpacity of the pixel each (weighted by the transmittance,
+    // so they grow again behind thick fog). No iso crossings to refine: the surface search found none.
     t = max(tEnter, 0.0) + jitter * stepSize;
-    for (; t < tExit && transmittance > 0.001; t += stepSize) {
+    samples = 0u;
+    for (; t < tExit && transmittance > 0.001; t += stepLen) {
         vec3 pos = origin + dir * t;
+        stepLen = stepSize;
+        if (macrocellMax(pos, cell) <= 0.0) {
+            t = lastStepInCell(cell, origin, dir, invDir, t, stepSize);  // Empty space.
+            continue;
+        }
+        if (budget != 0u && samples >= budget) break;
         float density = sampleDensity(pos);
+        ++samples;
+        float sigmaT = density * params.lightDir_absorb.w;
+        if (adaptive) {
+            float minStep = max(stepSize, t * pixelFootprint);
+            stepLen = minStep * kAdaptiveMaxScale;
+            float allowed = kAdaptiveOpacity / transmittance;
+            if (density > 0.0 && allowed < 1.0) {
+                stepLen = clamp(-log(1.0 - allowed) / sigmaT, minStep, minStep * kAdaptiveMaxScale);
+            }
+            stepLen = min(budgetStep(stepLen, t, tExit, samples, budget), tExit - t);
+        }
         if (density <= 0.0) continue;
 
-        float sigmaT = density * params.lightDir_absorb.w;
-        float attenuation = exp(-sigmaT * stepSize);
+        float attenuation = exp(-sigmaT * stepLen);
 
         vec3 n = normalize(gradient(pos, stepSize * 0.5));
-        float nDotL = max(0.0, -dot(n, lightDir));
+        float nDotL = max(0.0, -dot(n, lightDir)) * lightTransmittance(pos);
         vec3 lighting = ambientColor + params.lightColor_ambient.xyz * nDotL;
 
-        vec3 inScatter = lighting * (sigmaT * stepSize);
+        // Exact for a constant density over the step, which the long adaptive steps need.
+        vec3 inScatter = lighting * (adaptive ? 1.0 - attenuation : sigmaT * stepLen);
         accum += transmittance * inScatter;
         transmittance *= attenuation;
     }
@@ -0,0 +1,23 @@
+#pragma once
+
+// x86 SIMD support shared by the kernels with runtime-dispatched AVX2 paths. SSE2 is part of the
+// x86-64 baseline; AVX2 paths must only run after detect_simd_level() (sph_kernels.h) reports it.
+#if defined(__x86_64__) || defined(_M_X64)
+#define RAYOL_FLUID_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#else
+#define RAYOL_FLUID_X86 0
+#endif
+
+// GCC/Clang need per-function target attributes to emit AVX2 code in a baseline (SSE2) build;
+// MSVC accepts the intrinsics anywhere.
+#if RAYOL_FLUID_X86 && (defined(__GNUC__) || defined(__clang__))
+#define RAYOL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define RAYOL_TARGET_AVX2_F16C __attribute__((target("avx2,f16c")))  // No FMA: rounding must match scalar code.
+#else
+#define RAYOL_TARGET_AVX2
+#define RAYOL_TARGET_AVX2_F16C
+#endif
@@ -0,0 +1,751 @@
+#include "sph_kernels.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "simd_target.h"
+
+namespace rayol::fluid {
+
+namespace {
+
+// Neighbor sources: the kernels below are written once over "neighbor k of count" and instantiated
+// for a contiguous run of slots (grid mode) and for an explicit slot list (Verlet list mode).
+struct RunSlots {
+    int begin;
+    int operator()(int k) const { return begin + k; }
+};
+
+struct ListSlots {
+    const int* slots;
+    int operator()(int k) const { return slots[k]; }
+};
+
+template <typename Slots>
+float density_scalar_impl(const SphNeighborData& d, Slots slots, int count, Vec3 pos, float h) {
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    float rho = 0.0f;
+    for (int k = 0; k < count; ++k) {
+        const int j = slots(k);
+        float dx = pos.x - d.px[j];
+        float dy = pos.y - d.py[j];
+        float dz = pos.z - d.pz[j];
+        float r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 <= r2_max) {
+            float q = 1.0f - std::sqrt(r2) * inv_h;
+            rho += d.mass[j] * q * q * q;
+        }
+    }
+    return rho;
+}
+
+template <typename Slots>
+Vec3 force_scalar_impl(const SphNeighborData& d, Slots slots, int count, const SphParticle& self, float h,
+                       float viscosity) {
+    if (self.density <= 0.0f) return {};
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    Vec3 accel{};
+    for (int k = 0; k < count; ++k) {
+        const int j = slots(k);
+        Vec3 rij{self.position.x - d.px[j], self.position.y - d.py[j], self.position.z - d.pz[j]};
+        float r2 = dot(rij, rij);
+        float rho_j = d.density[j];
+        if (r2 <= 0.0f || r2 >= r2_max || rho_j <= 0.0f) continue;
+
+        float r = std::sqrt(r2);
+        float q = 1.0f - r * inv_h;
+        float p_term = (self.pressure + d.pressure[j]) * 0.5f;
+        if (p_term > 0.0f) {
+            // -spiky_gradient * p_term / (rho_i * rho_j), with spiky_gradient = -rij * q^2 / (h * r).
+            accel = accel + rij * (q * q * p_term / (h * r * self.density * rho_j));
+        }
+        Vec3 vel_diff{d.vx[j] - self.velocity.x, d.vy[j] - self.velocity.y, d.vz[j] - self.velocity.z};
+        accel = accel + vel_diff * (viscosity * q / rho_j);
+    }
+    return accel;
+}
+
+float density_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, float h) {
+    return density_scalar_impl(d, RunSlots{begin}, end - begin, pos, h);
+}
+
+Vec3 force_scalar(const SphNeighborData& d, int begin, int end, const SphParticle& self, float h, float viscosity) {
+    return force_scalar_impl(d, RunSlots{begin}, end - begin, self, h, viscosity);
+}
+
+int select_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, float r2_max, int* out) {
+    // Branchless: most candidates are rejected, so a predicted branch per pair costs more than
+    // always storing and advancing the cursor conditionally.
+    int count = 0;
+    for (int j = begin; j < end; ++j) {
+        float dx = pos.x - d.px[j];
+        float dy = pos.y - d.py[j];
+        float dz = pos.z - d.pz[j];
+        out[count] = j;
+        count += (dx * dx + dy * dy + dz * dz <= r2_max) ? 1 : 0;
+    }
+    return count;
+}
+
+float density_list_scalar(const SphNeighborData& d, const int* slots, int count, Vec3 pos, float h) {
+    return density_scalar_impl(d, ListSlots{slots}, count, pos, h);
+}
+
+Vec3 force_list_scalar(const SphNeighborData& d, const int* slots, int count, const SphParticle& self, float h,
+                       float viscosity) {
+    return force_scalar_impl(d, ListSlots{slots}, count, self, h, viscosity);
+}
+
+float density_pairs_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, float mass, float h, float* rho) {
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    float rho_i = 0.0f;
+    for (int j = begin; j < end; ++j) {
+        float dx = pos.x - d.px[j];
+        float dy = pos.y - d.py[j];
+        float dz = pos.z - d.pz[j];
+        float r2 = dx * dx + dy * dy + dz * dz;
+        if (r2 <= r2_max) {
+            float q = 1.0f - std::sqrt(r2) * inv_h;
+            float w = q * q * q;
+            rho_i += d.mass[j] * w;
+            rho[j] += mass * w;
+        }
+    }
+    return rho_i;
+}
+
+Vec3 force_pairs_scalar(const SphNeighborData& d, int begin, int end, const SphParticle& self, float h,
+                        float viscosity, float* ax, float* ay, float* az) {
+    if (self.density <= 0.0f) return {};
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    Vec3 accel{};
+    for (int j = begin; j < end; ++j) {
+        Vec3 rij{self.position.x - d.px[j], self.position.y - d.py[j], self.position.z - d.pz[j]};
+        float r2 = dot(rij, rij);
+        float rho_j = d.density[j];
+        if (r2 <= 0.0f || r2 >= r2_max || rho_j <= 0.0f) continue;
+
+        float r = std::sqrt(r2);
+        float q = 1.0f - r * inv_h;
+        float p_term = std::max((self.pressure + d.pressure[j]) * 0.5f, 0.0f);
+        // Pressure is antisymmetric (rji = -rij); viscosity divides by the other particle's density.
+        Vec3 pressure = rij * (q * q * p_term / (h * r * self.density * rho_j));
+        Vec3 vel_diff{d.vx[j] - self.velocity.x, d.vy[j] - self.velocity.y, d.vz[j] - self.velocity.z};
+        Vec3 visc_i = vel_diff * (viscosity * q / rho_j);
+        Vec3 visc_j = vel_diff * (-viscosity * q / self.density);
+        accel = accel + pressure + visc_i;
+        ax[j] += visc_j.x - pressure.x;
+        ay[j] += visc_j.y - pressure.y;
+        az[j] += visc_j.z - pressure.z;
+    }
+    return accel;
+}
+
+void pbf_lambda_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, float h, float inv_rho0,
+                       PbfSums& sums) {
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    const float grad_scale = 3.0f * inv_h * inv_rho0;
+    for (int j = begin; j < end; ++j) {
+        Vec3 rij{pos.x - d.px[j], pos.y - d.py[j], pos.z - d.pz[j]};
+        float r2 = dot(rij, rij);
+        if (r2 > r2_max) continue;
+        float r = std::sqrt(r2);
+        float q = 1.0f - r * inv_h;
+        sums.density += d.mass[j] * q * q * q;
+        if (r2 <= 0.0f || r2 >= r2_max) continue;
+        float g = d.mass[j] * q * q * grad_scale;
+        sums.grad_sq += g * g;
+        sums.grad = sums.grad + rij * (g / r);
+    }
+}
+
+Vec3 pbf_correction_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, float lambda, float h,
+                           float inv_rho0) {
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    const float grad_scale = 3.0f * inv_h * inv_rho0;
+    Vec3 dp{};
+    for (int j = begin; j < end; ++j) {
+        Vec3 rij{pos.x - d.px[j], pos.y - d.py[j], pos.z - d.pz[j]};
+        float r2 = dot(rij, rij);
+        if (r2 <= 0.0f || r2 >= r2_max) continue;
+        float r = std::sqrt(r2);
+        float q = 1.0f - r * inv_h;
+        // grad_i W points along -rij.
+        dp = dp - rij * ((lambda + d.lambda[j]) * d.mass[j] * q * q * grad_scale / r);
+    }
+    return dp;
+}
+
+Vec3 xsph_scalar(const SphNeighborData& d, int begin, int end, Vec3 pos, Vec3 velocity, float h) {
+    const float r2_max = h * h;
+    const float inv_h = 1.0f / h;
+    Vec3 blend{};
+    for (int j = begin; j < end; ++j) {
+        float dx = pos.x - d.px[j];
+        float dy = pos.y - d.py[j];
+        float dz = pos.z - d.pz[j];
+        float r2 = dx * dx + dy * dy + dz * dz;
+        float rho_j = d.density[j];
+        if (r2 >= r2_max || rho_j <= 0.0f) continue;
+        float q = 1.0f - std::sqrt(r2) * inv_h;
+        Vec3 dv{d.vx[j] - velocity.x, d.vy[j] - velocity.y, d.vz[j] - velocity.z};
+        blend = blend + dv * (d.mass[j] * q * q * q / rho_j);
+    }
+    return blend;
+}
+
+#if RAYOL_FLUID_X86
+
+// Vector loads of neighbors [k, k + width): plain unaligned loads for runs, gathers for lists.
+// seek(k) positions the source once per block; load(array) may then be called for every field.
+struct RunLanes4 {
+    int begin;
+    int offset = 0;
+    void seek(int k) { offset = begin + k; }
+    __m128 load(const float* a) const { return _mm_loadu_ps(a + offset); }
+};
+
+struct ListLanes4 {
+    const int* slots;
+    const int* at = nullptr;
+    void seek(int k) { at = slots + k; }
+    __m128 load(const float* a) const { return _mm_setr_ps(a[at[0]], a[at[1]], a[at[2]], a[at[3]]); }
+};
+
+struct RunLanes8 {
+    int begin;
+    int offset = 0;
+    void seek(int k) { offset = begin + k; }
+    RAYOL_TARGET_AVX2 __m256 load(const float* a) const { return _mm256_loadu_ps(a + offset); }
+};
+
+struct ListLanes8 {
+    const int* slots;
+    __m256i index{};
+    RAYOL_TARGET_AVX2 void seek(int k) { index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots + k)); }
+    RAYOL_TARGET_AVX2 __m256 load(const float* a) const { return _mm256_i32gather_ps(a, index, 4); }
+};
+
+inline float hsum_sse(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+template <typename Lanes>
+float density_sse_impl(const SphNeighborData& d, Lanes src, int count, Vec3 pos, float h) {
+    const __m128 xi = _mm_set1_ps(pos.x);
+    const __m128 yi = _mm_set1_ps(pos.y);
+    const __m128 zi = _mm_set1_ps(pos.z);
+    const __m128 r2_max = _mm_set1_ps(h * h);
+    const __m128 inv_h = _mm_set1_ps(1.0f / h);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 acc = _mm_setzero_ps();
+    for (int k = 0; k < count; k += 4) {
+        src.seek(k);
+        __m128 dx = _mm_sub_ps(xi, src.load(d.px));
+        __m128 dy = _mm_sub_ps(yi, src.load(d.py));
+        __m128 dz = _mm_sub_ps(zi, src.load(d.pz));
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps(static_cast<float>(count - k)));
+        __m128 inside = _mm_and_ps(valid, _mm_cmple_ps(r2, r2_max));
+        __m128 q = _mm_sub_ps(one, _mm_mul_ps(_mm_sqrt_ps(r2), inv_h));
+        __m128 w = _mm_mul_ps(_mm_mul_ps(q, q), _mm_mul_ps(q, src.load(d.mass)));
+        acc = _mm_add_ps(acc, _mm_and_ps(inside, w));
+    }
+    return hsum_sse(acc);
+}
+
+template <typename Lanes>
+Vec3 force_sse_impl(const SphNeighborData& d, Lanes src, int count, const SphParticle& self, float h,
+                    float viscosity) {
+    if (self.density <= 0.0f) return {};
+    const __m128 xi = _mm_set1_ps(self.position.x);
+    const __m128 yi = _mm_set1_ps(self.position.y);
+    const __m128 zi = _mm_set1_ps(self.position.z);
+    const __m128 vxi = _mm_set1_ps(self.velocity.x);
+    const __m128 vyi = _mm_set1_ps(self.velocity.y);
+    const __m128 vzi = _mm_set1_ps(self.velocity.z);
+    const __m128 p_i = _mm_set1_ps(self.pressure);
+    const __m128 h_rho_i = _mm_set1_ps(h * self.density);
+    const __m128 r2_max = _mm_set1_ps(h * h);
+    const __m128 inv_h = _mm_set1_ps(1.0f / h);
+    const __m128 visc = _mm_set1_ps(viscosity);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 ax = zero;
+    __m128 ay = zero;
+    __m128 az = zero;
+    for (int k = 0; k < count; k += 4) {
+        src.seek(k);
+        __m128 dx = _mm_sub_ps(xi, src.load(d.px));
+        __m128 dy = _mm_sub_ps(yi, src.load(d.py));
+        __m128 dz = _mm_sub_ps(zi, src.load(d.pz));
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 rho_j = src.load(d.density);
+        __m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps(static_cast<float>(count - k)));
+        __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(r2, zero), _mm_cmplt_ps(r2, r2_max)),
+                                 _mm_and_ps(valid, _mm_cmpgt_ps(rho_j, zero)));
+        if (_mm_movemask_ps(mask) == 0) continue;
+
+        __m128 r = _mm_sqrt_ps(r2);
+        __m128 q = _mm_sub_ps(one, _mm_mul_ps(r, inv_h));
+        __m128 p_term = _mm_max_ps(_mm_mul_ps(_mm_add_ps(p_i, src.load(d.pressure)), half), zero);
+        __m128 pressure = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(q, q), p_term), _mm_mul_ps(_mm_mul_ps(h_rho_i, r), rho_j));
+        pressure = _mm_and_ps(mask, pressure);
+        __m128 visc_k = _mm_and_ps(mask, _mm_div_ps(_mm_mul_ps(visc, q), rho_j));
+
+        ax = _mm_add_ps(ax, _mm_add_ps(_mm_mul_ps(pressure, dx), _mm_mul_ps(visc_k, _mm_sub_ps(src.load(d.vx), vxi))));
+        ay = _mm_add_ps(ay, _mm_add_ps(_mm_mul_ps(pressure, dy), _mm_mul_ps(visc_k, _mm_sub_ps(src.load(d.vy), vyi))));
+        az = _mm_add_ps(az, _mm_add_ps(_mm_mul_ps(pressure, dz), _mm_mul_ps(visc_k, _mm_sub_ps(src.load(d.vz), vzi))));
+    }
+    return {hsum_sse(ax), hsum_sse(ay), hsum_sse(az)};
+}
+
+float density_sse(const SphNeighborData& d, int begin, int end, Vec3 pos, float h) {
+    return density_sse_impl(d, RunLanes4{begin}, end - begin, pos, h);
+}
+
+Vec3 force_sse(const SphNeighborData& d, int begin, int end, const SphParticle& self, float h, float viscosity) {
+    return force_sse_impl(d, RunLanes4{begin}, end - begin, self, h, viscosity);
+}
+
+float density_list_sse(const SphNeighborData& d, const int* slots, int count, Vec3 pos, float h) {
+    return density_sse_impl(d, ListLanes4{slots}, count, pos, h);
+}
+
+Vec3 force_list_sse(const SphNeighborData& d, const int* slots, int count, const SphParticle& self, float h,
+                    float viscosity) {
+    return force_sse_impl(d, ListLanes4{slots}, count, self, h, viscosity);
+}
+
+RAYOL_TARGET_AVX2 inline float hsum_avx(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuf = _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(lo, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+template <typename Lanes>
+RAYOL_TARGET_AVX2 float density_avx2_impl(const SphNeighborData& d, Lanes src, int count, Vec3 pos, float h) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < count; k += 8) {
+        src.seek(k);
+        __m256 dx = _mm256_sub_ps(xi, src.load(d.px));
+        __m256 dy = _mm256_sub_ps(yi, src.load(d.py));
+        __m256 dz = _mm256_sub_ps(zi, src.load(d.pz));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(count - k)), _CMP_LT_OQ);
+        __m256 inside = _mm256_and_ps(valid, _mm256_cmp_ps(r2, r2_max, _CMP_LE_OQ));
+        __m256 q = _mm256_fnmadd_ps(_mm256_sqrt_ps(r2), inv_h, one);
+        __m256 w = _mm256_mul_ps(_mm256_mul_ps(q, q), _mm256_mul_ps(q, src.load(d.mass)));
+        acc = _mm256_add_ps(acc, _mm256_and_ps(inside, w));
+    }
+    return hsum_avx(acc);
+}
+
+template <typename Lanes>
+RAYOL_TARGET_AVX2 Vec3 force_avx2_impl(const SphNeighborData& d, Lanes src, int count, const SphParticle& self,
+                                       float h, float viscosity) {
+    if (self.density <= 0.0f) return {};
+    const __m256 xi = _mm256_set1_ps(self.position.x);
+    const __m256 yi = _mm256_set1_ps(self.position.y);
+    const __m256 zi = _mm256_set1_ps(self.position.z);
+    const __m256 vxi = _mm256_set1_ps(self.velocity.x);
+    const __m256 vyi = _mm256_set1_ps(self.velocity.y);
+    const __m256 vzi = _mm256_set1_ps(self.velocity.z);
+    const __m256 p_i = _mm256_set1_ps(self.pressure);
+    const __m256 h_rho_i = _mm256_set1_ps(h * self.density);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 visc = _mm256_set1_ps(viscosity);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 ax = zero;
+    __m256 ay = zero;
+    __m256 az = zero;
+    for (int k = 0; k < count; k += 8) {
+        src.seek(k);
+        __m256 dx = _mm256_sub_ps(xi, src.load(d.px));
+        __m256 dy = _mm256_sub_ps(yi, src.load(d.py));
+        __m256 dz = _mm256_sub_ps(zi, src.load(d.pz));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 rho_j = src.load(d.density);
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(count - k)), _CMP_LT_OQ);
+        __m256 mask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r2, zero, _CMP_GT_OQ),
+                                                  _mm256_cmp_ps(r2, r2_max, _CMP_LT_OQ)),
+                                    _mm256_and_ps(valid, _mm256_cmp_ps(rho_j, zero, _CMP_GT_OQ)));
+        if (_mm256_movemask_ps(mask) == 0) continue;
+
+        __m256 r = _mm256_sqrt_ps(r2);
+        __m256 q = _mm256_fnmadd_ps(r, inv_h, one);
+        __m256 p_term = _mm256_max_ps(_mm256_mul_ps(_mm256_add_ps(p_i, src.load(d.pressure)), half), zero);
+        __m256 pressure = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(q, q), p_term),
+                                        _mm256_mul_ps(_mm256_mul_ps(h_rho_i, r), rho_j));
+        pressure = _mm256_and_ps(mask, pressure);
+        __m256 visc_k = _mm256_and_ps(mask, _mm256_div_ps(_mm256_mul_ps(visc, q), rho_j));
+
+        ax = _mm256_fmadd_ps(pressure, dx, ax);
+        ay = _mm256_fmadd_ps(pressure, dy, ay);
+        az = _mm256_fmadd_ps(pressure, dz, az);
+        ax = _mm256_fmadd_ps(visc_k, _mm256_sub_ps(src.load(d.vx), vxi), ax);
+        ay = _mm256_fmadd_ps(visc_k, _mm256_sub_ps(src.load(d.vy), vyi), ay);
+        az = _mm256_fmadd_ps(visc_k, _mm256_sub_ps(src.load(d.vz), vzi), az);
+    }
+    return {hsum_avx(ax), hsum_avx(ay), hsum_avx(az)};
+}
+
+RAYOL_TARGET_AVX2 float density_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, float h) {
+    return density_avx2_impl(d, RunLanes8{begin}, end - begin, pos, h);
+}
+
+RAYOL_TARGET_AVX2 Vec3 force_avx2(const SphNeighborData& d, int begin, int end, const SphParticle& self, float h,
+                                  float viscosity) {
+    return force_avx2_impl(d, RunLanes8{begin}, end - begin, self, h, viscosity);
+}
+
+// Lane permutations for left-packing an 8-lane mask: entry m lists the set lanes of m in order,
+// three bits per lane, so select_avx2 can compress a block with one permute instead of a bit loop.
+constexpr std::array<uint32_t, 256> make_pack_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t mask = 0; mask < 256; ++mask) {
+        uint32_t packed = 0;
+        int out = 0;
+        for (uint32_t lane = 0; lane < 8; ++lane) {
+            if (mask & (1u << lane)) {
+                packed |= lane << (3 * out++);
+            }
+        }
+        table[mask] = packed;
+    }
+    return table;
+}
+constexpr std::array<uint32_t, 256> kPackTable = make_pack_table();
+
+RAYOL_TARGET_AVX2 int select_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, float r2_max, int* out) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 limit = _mm256_set1_ps(r2_max);
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i lane_bits = _mm256_set1_epi32(7);
+    int count = 0;
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        unsigned bits = static_cast<unsigned>(
+            _mm256_movemask_ps(_mm256_and_ps(valid, _mm256_cmp_ps(r2, limit, _CMP_LE_OQ))));
+        // Left-pack the selected slot ids and store all 8 lanes; only the first popcount are kept.
+        __m256i perm = _mm256_and_si256(
+            _mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(kPackTable[bits])), shifts), lane_bits);
+        __m256i ids = _mm256_add_epi32(_mm256_set1_epi32(j), _mm256_permutevar8x32_epi32(lane_ids, perm));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + count), ids);
+        count += std::popcount(bits);
+    }
+    return count;
+}
+
+RAYOL_TARGET_AVX2 float density_list_avx2(const SphNeighborData& d, const int* slots, int count, Vec3 pos, float h) {
+    return density_avx2_impl(d, ListLanes8{slots}, count, pos, h);
+}
+
+RAYOL_TARGET_AVX2 Vec3 force_list_avx2(const SphNeighborData& d, const int* slots, int count, const SphParticle& self,
+                                       float h, float viscosity) {
+    return force_avx2_impl(d, ListLanes8{slots}, count, self, h, viscosity);
+}
+
+RAYOL_TARGET_AVX2 float density_pairs_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, float mass, float h,
+                                           float* rho) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 m_i = _mm256_set1_ps(mass);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 acc = _mm256_setzero_ps();
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        __m256 inside = _mm256_and_ps(valid, _mm256_cmp_ps(r2, r2_max, _CMP_LE_OQ));
+        __m256 q = _mm256_fnmadd_ps(_mm256_sqrt_ps(r2), inv_h, one);
+        __m256 w = _mm256_and_ps(inside, _mm256_mul_ps(_mm256_mul_ps(q, q), q));
+        acc = _mm256_fmadd_ps(w, _mm256_loadu_ps(d.mass + j), acc);
+        // Masked read-modify-write: slots past the run may belong to a cell another thread owns.
+        const __m256i store = _mm256_castps_si256(valid);
+        _mm256_maskstore_ps(rho + j, store, _mm256_fmadd_ps(w, m_i, _mm256_maskload_ps(rho + j, store)));
+    }
+    return hsum_avx(acc);
+}
+
+RAYOL_TARGET_AVX2 Vec3 force_pairs_avx2(const SphNeighborData& d, int begin, int end, const SphParticle& self, float h,
+                                        float viscosity, float* ax_out, float* ay_out, float* az_out) {
+    if (self.density <= 0.0f) return {};
+    const __m256 xi = _mm256_set1_ps(self.position.x);
+    const __m256 yi = _mm256_set1_ps(self.position.y);
+    const __m256 zi = _mm256_set1_ps(self.position.z);
+    const __m256 vxi = _mm256_set1_ps(self.velocity.x);
+    const __m256 vyi = _mm256_set1_ps(self.velocity.y);
+    const __m256 vzi = _mm256_set1_ps(self.velocity.z);
+    const __m256 p_i = _mm256_set1_ps(self.pressure);
+    const __m256 h_rho_i = _mm256_set1_ps(h * self.density);
+    const __m256 visc_over_rho_i = _mm256_set1_ps(viscosity / self.density);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 visc = _mm256_set1_ps(viscosity);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 ax = zero;
+    __m256 ay = zero;
+    __m256 az = zero;
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 rho_j = _mm256_loadu_ps(d.density + j);
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        __m256 mask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r2, zero, _CMP_GT_OQ),
+                                                  _mm256_cmp_ps(r2, r2_max, _CMP_LT_OQ)),
+                                    _mm256_and_ps(valid, _mm256_cmp_ps(rho_j, zero, _CMP_GT_OQ)));
+        if (_mm256_movemask_ps(mask) == 0) continue;
+
+        __m256 r = _mm256_sqrt_ps(r2);
+        __m256 q = _mm256_fnmadd_ps(r, inv_h, one);
+        __m256 p_term = _mm256_max_ps(_mm256_mul_ps(_mm256_add_ps(p_i, _mm256_loadu_ps(d.pressure + j)), half), zero);
+        __m256 pressure = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(q, q), p_term),
+                                        _mm256_mul_ps(_mm256_mul_ps(h_rho_i, r), rho_j));
+        pressure = _mm256_and_ps(mask, pressure);
+        __m256 visc_i = _mm256_and_ps(mask, _mm256_div_ps(_mm256_mul_ps(visc, q), rho_j));
+        __m256 visc_j = _mm256_and_ps(mask, _mm256_mul_ps(visc_over_rho_i, q));
+
+        __m256 dvx = _mm256_sub_ps(_mm256_loadu_ps(d.vx + j), vxi);
+        __m256 dvy = _mm256_sub_ps(_mm256_loadu_ps(d.vy + j), vyi);
+        __m256 dvz = _mm256_sub_ps(_mm256_loadu_ps(d.vz + j), vzi);
+        __m256 px = _mm256_mul_ps(pressure, dx);
+        __m256 py = _mm256_mul_ps(pressure, dy);
+        __m256 pz = _mm256_mul_ps(pressure, dz);
+        ax = _mm256_add_ps(ax, _mm256_fmadd_ps(visc_i, dvx, px));
+        ay = _mm256_add_ps(ay, _mm256_fmadd_ps(visc_i, dvy, py));
+        az = _mm256_add_ps(az, _mm256_fmadd_ps(visc_i, dvz, pz));
+
+        // j receives -pressure and the viscosity pull towards i (vi - vj = -dv).
+        const __m256i store = _mm256_castps_si256(valid);
+        __m256 jx = _mm256_sub_ps(_mm256_maskload_ps(ax_out + j, store), _mm256_fmadd_ps(visc_j, dvx, px));
+        __m256 jy = _mm256_sub_ps(_mm256_maskload_ps(ay_out + j, store), _mm256_fmadd_ps(visc_j, dvy, py));
+        __m256 jz = _mm256_sub_ps(_mm256_maskload_ps(az_out + j, store), _mm256_fmadd_ps(visc_j, dvz, pz));
+        _mm256_maskstore_ps(ax_out + j, store, jx);
+        _mm256_maskstore_ps(ay_out + j, store, jy);
+        _mm256_maskstore_ps(az_out + j, store, jz);
+    }
+    return {hsum_avx(ax), hsum_avx(ay), hsum_avx(az)};
+}
+
+RAYOL_TARGET_AVX2 void pbf_lambda_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, float h,
+                                       float inv_rho0, PbfSums& sums) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 grad_scale = _mm256_set1_ps(3.0f * inv_rho0 / h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 rho = zero;
+    __m256 grad_sq = zero;
+    __m256 gx = zero;
+    __m256 gy = zero;
+    __m256 gz = zero;
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        __m256 inside = _mm256_and_ps(valid, _mm256_cmp_ps(r2, r2_max, _CMP_LE_OQ));
+        if (_mm256_movemask_ps(inside) == 0) continue;
+        __m256 grad_mask = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(r2, zero, _CMP_GT_OQ),
+                                                               _mm256_cmp_ps(r2, r2_max, _CMP_LT_OQ)));
+
+        __m256 r = _mm256_sqrt_ps(r2);
+        __m256 q = _mm256_fnmadd_ps(r, inv_h, one);
+        __m256 mq2 = _mm256_mul_ps(_mm256_loadu_ps(d.mass + j), _mm256_mul_ps(q, q));
+        rho = _mm256_add_ps(rho, _mm256_and_ps(inside, _mm256_mul_ps(mq2, q)));
+        __m256 g = _mm256_and_ps(grad_mask, _mm256_mul_ps(mq2, grad_scale));
+        grad_sq = _mm256_fmadd_ps(g, g, grad_sq);
+        // g / r is 0 / 0 on masked lanes; the mask clears the NaN.
+        __m256 k = _mm256_and_ps(grad_mask, _mm256_div_ps(g, r));
+        gx = _mm256_fmadd_ps(k, dx, gx);
+        gy = _mm256_fmadd_ps(k, dy, gy);
+        gz = _mm256_fmadd_ps(k, dz, gz);
+    }
+    sums.density += hsum_avx(rho);
+    sums.grad_sq += hsum_avx(grad_sq);
+    sums.grad = sums.grad + Vec3{hsum_avx(gx), hsum_avx(gy), hsum_avx(gz)};
+}
+
+RAYOL_TARGET_AVX2 Vec3 pbf_correction_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, float lambda,
+                                           float h, float inv_rho0) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 lambda_i = _mm256_set1_ps(lambda);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 grad_scale = _mm256_set1_ps(3.0f * inv_rho0 / h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 dpx = zero;
+    __m256 dpy = zero;
+    __m256 dpz = zero;
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        __m256 mask = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(r2, zero, _CMP_GT_OQ),
+                                                         _mm256_cmp_ps(r2, r2_max, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps(mask) == 0) continue;
+
+        __m256 r = _mm256_sqrt_ps(r2);
+        __m256 q = _mm256_fnmadd_ps(r, inv_h, one);
+        __m256 lambdas = _mm256_add_ps(lambda_i, _mm256_loadu_ps(d.lambda + j));
+        __m256 k = _mm256_mul_ps(_mm256_mul_ps(lambdas, _mm256_loadu_ps(d.mass + j)),
+                                 _mm256_mul_ps(_mm256_mul_ps(q, q), grad_scale));
+        k = _mm256_and_ps(mask, _mm256_div_ps(k, r));
+        dpx = _mm256_fnmadd_ps(k, dx, dpx);
+        dpy = _mm256_fnmadd_ps(k, dy, dpy);
+        dpz = _mm256_fnmadd_ps(k, dz, dpz);
+    }
+    return {hsum_avx(dpx), hsum_avx(dpy), hsum_avx(dpz)};
+}
+
+RAYOL_TARGET_AVX2 Vec3 xsph_avx2(const SphNeighborData& d, int begin, int end, Vec3 pos, Vec3 velocity, float h) {
+    const __m256 xi = _mm256_set1_ps(pos.x);
+    const __m256 yi = _mm256_set1_ps(pos.y);
+    const __m256 zi = _mm256_set1_ps(pos.z);
+    const __m256 vxi = _mm256_set1_ps(velocity.x);
+    const __m256 vyi = _mm256_set1_ps(velocity.y);
+    const __m256 vzi = _mm256_set1_ps(velocity.z);
+    const __m256 r2_max = _mm256_set1_ps(h * h);
+    const __m256 inv_h = _mm256_set1_ps(1.0f / h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 bx = zero;
+    __m256 by = zero;
+    __m256 bz = zero;
+    for (int j = begin; j < end; j += 8) {
+        __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(d.px + j));
+        __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(d.py + j));
+        __m256 dz = _mm256_sub_ps(zi, _mm256_loadu_ps(d.pz + j));
+        __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        __m256 rho_j = _mm256_loadu_ps(d.density + j);
+        __m256 valid = _mm256_cmp_ps(lanes, _mm256_set1_ps(static_cast<float>(end - j)), _CMP_LT_OQ);
+        __m256 mask = _mm256_and_ps(_mm256_and_ps(valid, _mm256_cmp_ps(r2, r2_max, _CMP_LT_OQ)),
+                                    _mm256_cmp_ps(rho_j, zero, _CMP_GT_OQ));
+        if (_mm256_movemask_ps(mask) == 0) continue;
+
+        __m256 q = _mm256_fnmadd_ps(_mm256_sqrt_ps(r2), inv_h, one);
+        __m256 w = _mm256_mul_ps(_mm256_mul_ps(q, q), _mm256_mul_ps(q, _mm256_loadu_ps(d.mass + j)));
+        w = _mm256_and_ps(mask, _mm256_div_ps(w, rho_j));
+        bx = _mm256_fmadd_ps(w, _mm256_sub_ps(_mm256_loadu_ps(d.vx + j), vxi), bx);
+        by = _mm256_fmadd_ps(w, _mm256_sub_ps(_mm256_loadu_ps(d.vy + j), vyi), by);
+        bz = _mm256_fmadd_ps(w, _mm256_sub_ps(_mm256_loadu_ps(d.vz + j), vzi), bz);
+    }
+    return {hsum_avx(bx), hsum_avx(by), hsum_avx(bz)};
+}
+
+#endif  // RAYOL_FLUID_X86
+
+// SSE2 lacks masked stores and lane permutes, so its table reuses the scalar select and pair kernels
+// (and the scalar PBF kernels, which only exist at the scalar and AVX2 levels).
+const SphKernels kScalarKernels{SimdLevel::Scalar, 1, density_scalar, force_scalar, density_list_scalar,
+                                force_list_scalar, select_scalar, density_pairs_scalar, force_pairs_scalar,
+                                pbf_lambda_scalar, pbf_correction_scalar, xsph_scalar};
+#if RAYOL_FLUID_X86
+const SphKernels kSseKernels{SimdLevel::Sse, 4, density_sse, force_sse, density_list_sse,
+                             force_list_sse, select_scalar, density_pairs_scalar, force_pairs_scalar,
+                             pbf_lambda_scalar, pbf_correction_scalar, xsph_scalar};
+const SphKernels kAvx2Kernels{SimdLevel::Avx2, 8, density_avx2, force_avx2, density_list_avx2,
+                              force_list_avx2, select_avx2, density_pairs_avx2, force_pairs_avx2,
+                              pbf_lambda_avx2, pbf_correction_avx2, xsph_avx2};
+#endif
+
+}  // namespace
+
+SimdLevel detect_simd_level() {
+#if RAYOL_FLUID_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::Avx2;
+    }
+#elif defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    if (os_avx && fma && avx2) {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Sse;  // SSE2 is part of the x86-64 baseline.
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const SphKernels& sph_kernels(SimdLevel level) {
+    static const SimdLevel supported = detect_simd_level();
+    level = std::min(level, supported);
+#if RAYOL_FLUID_X86
+    if (level == SimdLevel::Avx2) return kAvx2Kernels;
+    if (level == SimdLevel::Sse) return kSseKernels;
+#endif
+    return kScalarKernels;
+}
+
+const SphKernels& best_sph_kernels() { return sph_kernels(SimdLevel::Avx2); }
+
+}  // namespace rayol::fluid
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "fluid_sim.h"
+
+namespace rayol::fluid {
+
+// Readable floats required past the last element of every SphNeighborData array, and readable
+// slot entries past the end of every neighbor list. SIMD kernels run the tail of a neighbor run or
+// list as one masked full-width iteration instead of a scalar loop.
+constexpr int kSphRunPadding = 8;
+
+// SoA view of cell-ordered neighbor data; kernels read contiguous runs [begin, end) of it.
+struct SphNeighborData {
+    const float* px = nullptr;
+    const float* py = nullptr;
+    const float* pz = nullptr;
+    const float* vx = nullptr;
+    const float* vy = nullptr;
+    const float* vz = nullptr;
+    const float* mass = nullptr;
+    const float* density = nullptr;
+    const float* pressure = nullptr;
+    const float* lambda = nullptr;  // PBF constraint multipliers (pbf_correction only).
+};
+
+// The particle whose neighbors are being summed.
+struct SphParticle {
+    Vec3 position{};
+    Vec3 velocity{};
+    float density = 0.0f;
+    float pressure = 0.0f;
+};
+
+// Running sums of one particle's PBF density constraint: kernel density, sum over neighbors of
+// |grad_j C|^2 and the (unsigned) sum of grad_j C vectors, whose square is |grad_i C|^2.
+struct PbfSums {
+    float density = 0.0f;
+    float grad_sq = 0.0f;
+    Vec3 grad{};
+};
+
+enum class SimdLevel {
+    Scalar,
+    Sse,   // 4 lanes (SSE2)
+    Avx2,  // 8 lanes (AVX2 + FMA)
+};
+
+// Density and pressure/viscosity force sums over one contiguous neighbor run. Both use the
+// bounded heuristic kernels of the sim: poly6 ~ (1 - r/h)^3, spiky gradient ~ (1 - r/h)^2 / h,
+// viscosity laplacian ~ (1 - r/h). Pairs at r == 0 (including the particle itself) add to the
+// density but not to the force. The *_list variants take explicit sorted slots (a Verlet list)
+// instead of a contiguous run; padded list entries must still be valid slots. select writes the
+// slots of a run within sqrt(r2_max) of pos to out and returns how many; out needs room for
+// end - begin + kSphRunPadding entries since SIMD variants store whole blocks.
+struct SphKernels {
+    SimdLevel level = SimdLevel::Scalar;
+    int width = 1;
+    float (*density)(const SphNeighborData& data, int begin, int end, Vec3 pos, float h) = nullptr;
+    Vec3 (*force)(const SphNeighborData& data, int begin, int end, const SphParticle& self, float h,
+                  float viscosity) = nullptr;
+    float (*density_list)(const SphNeighborData& data, const int* slots, int count, Vec3 pos, float h) = nullptr;
+    Vec3 (*force_list)(const SphNeighborData& data, const int* slots, int count, const SphParticle& self, float h,
+                       float viscosity) = nullptr;
+    int (*select)(const SphNeighborData& data, int begin, int end, Vec3 pos, float r2_max, int* out) = nullptr;
+    // Symmetric pair sums for half-stencil traversal: every j in [begin, end) is a distinct particle
+    // visited once per pair. The return value is particle i's share; j's equal (density) or opposite
+    // (pressure) share is added in place to rho[j] / ax[j], ay[j], az[j]. Only slots inside the run
+    // are written.
+    float (*density_pairs)(const SphNeighborData& data, int begin, int end, Vec3 pos, float mass, float h,
+                           float* rho) = nullptr;
+    Vec3 (*force_pairs)(const SphNeighborData& data, int begin, int end, const SphParticle& self, float h,
+                        float viscosity, float* ax, float* ay, float* az) = nullptr;
+    // Position-based fluids sums over a run, with W = (1 - r/h)^3 and grad W = -3 (1 - r/h)^2 / h * rij / r
+    // scaled by 1 / rho0. pbf_lambda accumulates into sums; pbf_correction returns
+    // sum (lambda_i + lambda_j) m_j grad W / rho0 from data.lambda; xsph returns
+    // sum m_j W (v_j - v_i) / rho_j from data.density.
+    void (*pbf_lambda)(const SphNeighborData& data, int begin, int end, Vec3 pos, float h, float inv_rho0,
+                       PbfSums& sums) = nullptr;
+    Vec3 (*pbf_correction)(const SphNeighborData& data, int begin, int end, Vec3 pos, float lambda, float h,
+                           float inv_rho0) = nullptr;
+    Vec3 (*xsph)(const SphNeighborData& data, int begin, int end, Vec3 pos, Vec3 velocity, float h) = nullptr;
+};
+
+// Widest SIMD level the running CPU supports (and this build can target).
+SimdLevel detect_simd_level();
+// Kernel table for a level; levels the CPU lacks fall back to the next narrower one.
+const SphKernels& sph_kernels(SimdLevel level);
+// Kernel table for detect_simd_level(), resolved once.
+const SphKernels& best_sph_kernels();
+
+}  // namespace rayol::fluid
@@ -0,0 +1,57 @@
+#include "splat_weights.h"
+
+#include <cmath>
+
+#include "fluid_sim.h"
+
+namespace rayol::fluid {
+
+namespace {
+constexpr float kPi = 3.14159265359f;
+// Poly6's per-axis variance is h^2 / 11; the Gaussian uses the same so splats keep their width.
+constexpr float kGaussianVarianceScale = 1.0f / 11.0f;
+}  // namespace
+
+float gaussian_axis_weight(float d2, float support) {
+    if (d2 >= support * support || support <= 0.0f) return 0.0f;
+    const float variance = kGaussianVarianceScale * support * support;
+    // poly6_weight integrates to h rather than 1 (its h^9 term is h^8; density scales are tuned to
+    // that), so each axis carries cbrt(h) to give the Gaussian the same splat mass.
+    return std::cbrt(support) * std::exp(-0.5f * d2 / variance) / std::sqrt(2.0f * kPi * variance);
+}
+
+void build_splat_weight_table(SplatWeightTable& table, SplatKernel kernel, float kernel_radius) {
+    table.kernel = kernel;
+    table.kernel_radius = kernel_radius;
+    const float h2 = kernel_radius * kernel_radius;
+    table.inv_step = h2 > 0.0f ? static_cast<float>(kSplatTableSize) / h2 : 0.0f;
+    table.weights.assign(kSplatTableSize + 1, 0.0f);
+    for (int i = 0; i < kSplatTableSize; ++i) {
+        const float d2 = h2 * static_cast<float>(i) / static_cast<float>(kSplatTableSize);
+        table.weights[i] = kernel == SplatKernel::Gaussian ? gaussian_axis_weight(d2, kernel_radius)
+                                                           : poly6_weight(d2, kernel_radius);
+    }
+    // Gaussian is truncated rather than going to zero; keep the last interval flat up to the cut.
+    if (kernel == SplatKernel::Gaussian) {
+        table.weights[kSplatTableSize] = table.weights[kSplatTableSize - 1];
+    }
+}
+
+const SplatWeightTable* SplatWeightCache::get(SplatKernel kernel, float kernel_radius) {
+    if (kernel == SplatKernel::Poly6) return nullptr;
+    for (const SplatWeightTable& table : tables_) {
+        if (table.kernel == kernel && table.kernel_radius == kernel_radius) return &table;
+    }
+    SplatWeightTable* slot = nullptr;
+    tables_.reserve(kMaxTables);  // Returned pointers must survive later insertions.
+    if (tables_.size() < kMaxTables) {
+        slot = &tables_.emplace_back();
+    } else {
+        slot = &tables_[next_evict_];
+        next_evict_ = (next_evict_ + 1) % kMaxTables;
+    }
+    build_splat_weight_table(*slot, kernel, kernel_radius);
+    return slot;
+}
+
+}  // namespace rayol::fluid
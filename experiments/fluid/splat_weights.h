@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace rayol::fluid {
+
+enum class SplatKernel {
+    Poly6,       // Exact poly6 per voxel (reference).
+    Poly6Table,  // Poly6 from a radial table indexed by r^2, linearly interpolated.
+    Gaussian,    // Separable Gaussian matched to poly6's mass and variance (sigma = h / sqrt(11)), cube support.
+};
+
+// Interpolated entries per table, over squared distance [0, h^2]. Poly6's (1 - u)^3 then stays within
+// ~3e-6 of exact relative to its peak.
+constexpr int kSplatTableSize = 512;
+
+// Kernel weights tabulated for one kernel radius, in absolute units so a lookup is one multiply, a
+// floor and a lerp. Poly6Table holds the 3D weight by r^2; Gaussian holds the per-axis factor by d^2,
+// and the voxel weight is the product of the three axis factors. Lookups at or beyond h^2 return 0.
+struct SplatWeightTable {
+    SplatKernel kernel = SplatKernel::Poly6;
+    float kernel_radius = 0.0f;
+    float inv_step = 0.0f;  // Table entries per unit of squared distance.
+    std::vector<float> weights;  // kSplatTableSize + 1 entries; the last is the (zero) end point.
+
+    float lookup(float d2) const {
+        const float f = d2 * inv_step;
+        if (!(f < static_cast<float>(kSplatTableSize))) return 0.0f;
+        const int i = static_cast<int>(f);
+        const float t = f - static_cast<float>(i);
+        return weights[i] + (weights[i + 1] - weights[i]) * t;
+    }
+};
+
+void build_splat_weight_table(SplatWeightTable& table, SplatKernel kernel, float kernel_radius);
+
+// Per-axis factor of the Gaussian splat kernel, computed directly (particles whose support differs
+// from the table's kernel radius).
+float gaussian_axis_weight(float d2, float support);
+
+// The few tables in use at once (one per kernel and radius), rebuilt only when a key is new. Not
+// thread-safe: each owner (sim, renderer) keeps its own.
+class SplatWeightCache {
+public:
+    // Table for the key, or nullptr for SplatKernel::Poly6 (no table needed).
+    const SplatWeightTable* get(SplatKernel kernel, float kernel_radius);
+
+private:
+    static constexpr size_t kMaxTables = 4;
+    std::vector<SplatWeightTable> tables_;
+    size_t next_evict_ = 0;
+};
+
+}  // namespace rayol::fluid
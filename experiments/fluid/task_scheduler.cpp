@@ -0,0 +1,174 @@
+#include "task_scheduler.h"
+
+#include <algorithm>
+
+namespace rayol::fluid {
+
+namespace {
+// Automatic grain: aim for a few chunks per thread so stealing can rebalance uneven work
+// (e.g. particles piling up on the floor) without paying per-index scheduling overhead.
+constexpr size_t kChunksPerThread = 8;
+constexpr size_t kMinGrain = 32;
+
+// Scheduler the current thread is working for; nested loops on it run inline.
+thread_local const TaskScheduler* t_active_scheduler = nullptr;
+}  // namespace
+
+TaskScheduler::TaskScheduler(unsigned int thread_count) { start(thread_count); }
+
+TaskScheduler::~TaskScheduler() { stop(); }
+
+void TaskScheduler::resize(unsigned int thread_count) {
+    std::lock_guard<std::mutex> submit(submit_mutex_);
+    stop();
+    start(thread_count);
+}
+
+void TaskScheduler::start(unsigned int thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    thread_count = std::max(1u, thread_count);
+
+    slots_.clear();
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        slots_.push_back(std::make_unique<Slot>());
+    }
+    workers_.reserve(thread_count - 1);
+    for (unsigned int i = 1; i < thread_count; ++i) {
+        workers_.emplace_back([this, i]() { worker_main(i); });
+    }
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    stopping_ = false;
+}
+
+void TaskScheduler::worker_main(unsigned int slot) {
+    t_active_scheduler = this;
+    uint64_t seen = 0;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        seen = job_.id;
+    }
+    for (;;) {
+        Job job{};
+        {
+            std::unique_lock<std::mutex> lock(state_mutex_);
+            work_cv_.wait(lock, [&]() { return stopping_ || job_.id != seen; });
+            if (stopping_) return;
+            job = job_;
+            seen = job.id;
+        }
+        execute(slot, job);
+    }
+}
+
+void TaskScheduler::run(size_t begin, size_t end, size_t grain, ChunkFn fn, const void* ctx) {
+    const size_t total = end - begin;
+    const size_t threads = slots_.size();
+    if (grain == 0) {
+        size_t target_chunks = threads * kChunksPerThread;
+        grain = std::max(kMinGrain, (total + target_chunks - 1) / target_chunks);
+    }
+    const size_t chunks = (total + grain - 1) / grain;
+    if (threads <= 1 || chunks <= 1 || t_active_scheduler == this) {
+        for (size_t b = begin; b < end; b += grain) {
+            fn(ctx, b, std::min(b + grain, end));
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submit_mutex_);
+    Job job{};
+    job.fn = fn;
+    job.ctx = ctx;
+    job.begin = begin;
+    job.end = end;
+    job.grain = grain;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        job.id = job_.id + 1;
+    }
+
+    // Hand every slot a contiguous share of chunks before waking the workers.
+    for (size_t s = 0; s < threads; ++s) {
+        Slot& slot = *slots_[s];
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.job = job.id;
+        slot.next = s * chunks / threads;
+        slot.end = (s + 1) * chunks / threads;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        job_ = job;
+        remaining_.store(chunks, std::memory_order_relaxed);
+    }
+    work_cv_.notify_all();
+
+    const TaskScheduler* outer = t_active_scheduler;
+    t_active_scheduler = this;
+    execute(0, job);
+    t_active_scheduler = outer;
+
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    done_cv_.wait(lock, [&]() { return remaining_.load(std::memory_order_acquire) == 0; });
+}
+
+void TaskScheduler::execute(unsigned int slot, const Job& job) {
+    size_t chunk = 0;
+    while (claim(slot, job.id, chunk) || steal(slot, job.id, chunk)) {
+        size_t chunk_begin = job.begin + chunk * job.grain;
+        size_t chunk_end = std::min(chunk_begin + job.grain, job.end);
+        job.fn(job.ctx, chunk_begin, chunk_end);
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            done_cv_.notify_all();
+        }
+    }
+}
+
+bool TaskScheduler::claim(unsigned int slot, uint64_t job_id, size_t& chunk) {
+    Slot& own = *slots_[slot];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.job != job_id || own.next >= own.end) return false;
+    chunk = own.next++;
+    return true;
+}
+
+bool TaskScheduler::steal(unsigned int slot, uint64_t job_id, size_t& chunk) {
+    const unsigned int threads = thread_count();
+    for (unsigned int offset = 1; offset < threads; ++offset) {
+        Slot& victim = *slots_[(slot + offset) % threads];
+        size_t first = 0;
+        size_t last = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.job != job_id || victim.next >= victim.end) continue;
+            size_t take = (victim.end - victim.next + 1) / 2;
+            first = victim.end - take;
+            last = victim.end;
+            victim.end = first;
+        }
+        Slot& own = *slots_[slot];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.job = job_id;
+        own.next = first + 1;
+        own.end = last;
+        chunk = first;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace rayol::fluid
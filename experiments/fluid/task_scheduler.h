@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rayol::fluid {
+
+// Long-lived work-stealing scheduler for the sim's data-parallel loops. A range is cut into
+// fixed-size chunks; every worker starts on a contiguous share and, once idle, steals the upper
+// half of a busy worker's remainder. The calling thread works as slot 0, so a one-thread
+// scheduler runs everything inline. Calls from several threads are serialized.
+class TaskScheduler {
+public:
+    // thread_count == 0 uses std::thread::hardware_concurrency().
+    explicit TaskScheduler(unsigned int thread_count = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Join the workers and restart with a new thread count (0 = hardware concurrency).
+    void resize(unsigned int thread_count);
+    // Threads participating in a loop, including the caller.
+    unsigned int thread_count() const { return static_cast<unsigned int>(slots_.size()); }
+
+    // Run func(i) for every i in [begin, end). grain is indices per chunk (0 = automatic).
+    template <typename Func>
+    void parallel_for(size_t begin, size_t end, const Func& func, size_t grain = 0) {
+        parallel_for_range(begin, end, grain, [&func](size_t chunk_begin, size_t chunk_end) {
+            for (size_t i = chunk_begin; i < chunk_end; ++i) {
+                func(i);
+            }
+        });
+    }
+
+    // Run func(chunk_begin, chunk_end) for every chunk of [begin, end).
+    template <typename Func>
+    void parallel_for_range(size_t begin, size_t end, size_t grain, const Func& func) {
+        if (end <= begin) return;
+        run(begin, end, grain,
+            [](const void* ctx, size_t chunk_begin, size_t chunk_end) {
+                (*static_cast<const Func*>(ctx))(chunk_begin, chunk_end);
+            },
+            &func);
+    }
+
+    // Deterministic reduction: [begin, end) is cut into fixed chunks of `grain` indices (0 = a
+    // default that does not depend on the thread count), map(chunk_begin, chunk_end) -> T runs per
+    // chunk in parallel, and the partials are folded with combine(T, T) in chunk order. The result is
+    // bit-identical for any thread count, unlike per-thread accumulators.
+    template <typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, const Map& map, const Combine& combine) {
+        if (end <= begin) return identity;
+        if (grain == 0) grain = kReduceGrain;
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        std::vector<T> partials(chunks, identity);
+        parallel_for(0, chunks, [&](size_t c) {
+            size_t chunk_begin = begin + c * grain;
+            partials[c] = map(chunk_begin, std::min(chunk_begin + grain, end));
+        }, 1);
+        T result = identity;
+        for (const T& partial : partials) {
+            result = combine(result, partial);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t kReduceGrain = 2048;
+
+    using ChunkFn = void (*)(const void* ctx, size_t chunk_begin, size_t chunk_end);
+
+    struct Job {
+        uint64_t id = 0;
+        ChunkFn fn = nullptr;
+        const void* ctx = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t grain = 1;
+    };
+
+    // Per-thread queue of chunk indices [next, end) belonging to job `job`.
+    struct alignas(64) Slot {
+        std::mutex mutex;
+        uint64_t job = 0;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    void start(unsigned int thread_count);
+    void stop();
+    void worker_main(unsigned int slot);
+    void run(size_t begin, size_t end, size_t grain, ChunkFn fn, const void* ctx);
+    void execute(unsigned int slot, const Job& job);
+    bool claim(unsigned int slot, uint64_t job_id, size_t& chunk);
+    bool steal(unsigned int slot, uint64_t job_id, size_t& chunk);
+
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::vector<std::thread> workers_;
+
+    std::mutex submit_mutex_;
+    std::mutex state_mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    Job job_{};
+    std::atomic<size_t> remaining_{0};
+    bool stopping_ = false;
+};
+
+}  // namespace rayol::fluid
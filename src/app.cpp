@@ -7,6 +7,8 @@
 #include <algorithm>
 
 #include "vulkan/context.h"
+#include "experiments/fluid/async_sim.h"
+#include "experiments/fluid/cpu_renderer.h"
 #include "experiments/fluid/fluid_experiment.h"
 #include "experiments/fluid/fluid_renderer.h"
 #include "ui/imgui_layer.h"
@@ -83,6 +85,7 @@ int App::run() {
     bool rotating_camera = false;
     ui::UiState ui_state{};
     fluid::FluidExperiment fluid;
+    fluid::AsyncFluidSim fluid_async(fluid);  // Declared after fluid so its worker stops first.
     fluid::FluidRenderer fluid_renderer;
     Camera camera;
     {
@@ -160,9 +163,21 @@ int App::run() {
                 fluid_frame_index = 0;
             }
         } else {  // Mode::Running
+            if (ui_state.fluid_async != fluid_async.running()) {
+                if (ui_state.fluid_async) {
+                    fluid_async.start();
+                } else {
+                    fluid_async.stop();
+                }
+            }
+            // Async mode draws the latest snapshot the sim worker published; the view stays valid
+            // until the next acquire() below, a frame later.
+            const fluid::FluidFrameView fluid_frame = fluid_async.running() ? fluid_async.acquire().view()
+                                                                            : fluid.frame();
+
             ui::FluidUiIntents fluid_intents{};
             auto ui_callback = [&](bool& /*exit_flag*/) {
-                fluid_intents = ui::render_fluid_ui(ui_state, fluid.stats());
+                fluid_intents = ui::render_fluid_ui(ui_state, *fluid_frame.stats);
             };
 
             // Camera controls: WASD move, Space/LCtrl up/down, right mouse + move to look.
@@ -198,7 +213,7 @@ int App::run() {
 
             FluidDrawData fluid_draw{};
             fluid_draw.renderer = &fluid_renderer;
-            fluid_draw.sim = &fluid;
+            fluid_draw.frame = fluid_frame;
             fluid_draw.enabled = ui_state.fluid_enabled;
             fluid_draw.frame_index = fluid_frame_index;
             fluid_draw.density_scale = ui_state.fluid_density_scale;
@@ -221,24 +236,112 @@ int App::run() {
             settings.voxel_size = ui_state.fluid_voxel_size;
             settings.gravity_y = ui_state.fluid_gravity_y;
             settings.paused = ui_state.fluid_paused;
-            fluid.configure(settings);
+            settings.thread_count = ui_state.fluid_threads;
+            settings.use_simd = ui_state.fluid_simd;
+            settings.solver = ui_state.fluid_pbf ? fluid::SolverType::Pbf : fluid::SolverType::Sph;
+            settings.pbf_iterations = ui_state.fluid_pbf_iterations;
+            settings.pbf_cfl_number = ui_state.fluid_pbf_cfl;
+            settings.neighbor_mode = ui_state.fluid_verlet_lists ? fluid::NeighborMode::VerletList
+                                                                 : fluid::NeighborMode::Grid;
+            settings.verlet_skin = ui_state.fluid_verlet_skin;
+            settings.symmetric_pairs = ui_state.fluid_symmetric_pairs;
+            settings.reorder_interval = ui_state.fluid_reorder_interval;
+            settings.cfl_number = ui_state.fluid_cfl;
+            settings.max_substeps = ui_state.fluid_max_substeps;
+            settings.frame_budget_ms = ui_state.fluid_frame_budget_ms;
+            settings.splat_mode = static_cast<fluid::SplatMode>(ui_state.fluid_splat_mode);
+            settings.splat_kernel = static_cast<fluid::SplatKernel>(ui_state.fluid_splat_kernel);
+            settings.incremental_splat = ui_state.fluid_incremental_splat;
+            settings.splat_move_threshold = ui_state.fluid_splat_move_threshold;
+            settings.splat_rebuild_interval = ui_state.fluid_splat_rebuild_interval;
+            settings.voxel_layout = static_cast<fluid::VoxelLayout>(ui_state.fluid_voxel_layout);
+            settings.dynamic_domain = ui_state.fluid_dynamic_domain;
+            settings.domain_margin = ui_state.fluid_domain_margin;
+            settings.distance_field = ui_state.fluid_distance_field;
+            settings.sdf_radius = ui_state.fluid_sdf_radius;
+            settings.sdf_smoothing = ui_state.fluid_sdf_smoothing;
+            settings.sdf_band = ui_state.fluid_sdf_band;
+            settings.gpu_distance_field = ui_state.fluid_gpu_distance_field;
+            settings.light_volume = ui_state.fluid_light_volume;
+            settings.light_downsample = ui_state.fluid_light_downsample;
+            settings.gpu_light_volume = ui_state.fluid_gpu_light_volume;
+            settings.adaptive_steps = ui_state.fluid_adaptive_steps;
+            settings.frame_step_budget = ui_state.fluid_frame_step_budget;
+            settings.density_format = static_cast<fluid::DensityFormat>(ui_state.fluid_density_format);
+            settings.gpu_splat = ui_state.fluid_gpu_splat;
+            if (fluid_async.running()) {
+                fluid_async.post_configure(settings);
+            } else {
+                fluid.configure(settings);
+            }
+            if (fluid_intents.cpu_render && fluid_frame.valid()) {
+                // Reference image of what the draw's volume pass sees, from the same camera.
+                fluid::CpuRenderSettings render{};
+                render.march.step = fluid_frame.volume->config().voxel_size * 0.75f;
+                render.march.density_scale = ui_state.fluid_density_scale;
+                render.march.absorption = ui_state.fluid_absorption;
+                render.march.light_volume = fluid_frame.light;
+                render.march.adaptive.enabled = ui_state.fluid_adaptive_steps;
+                render.frame_step_budget = static_cast<long long>(ui_state.fluid_frame_step_budget) * 1000000;
+                fluid::CameraData cam{};
+                cam.pos = fluid_draw.camera_pos;
+                cam.forward = fluid_draw.camera_forward;
+                cam.right = fluid_draw.camera_right;
+                cam.tan_half_fov = std::tan(fluid_draw.camera_fov_y * 0.5f);
+                cam.aspect = static_cast<float>(render.width) / static_cast<float>(render.height);
+                const unsigned int render_threads = static_cast<unsigned int>(std::max(0, ui_state.fluid_threads));
+                // A gpu_splat sim volume only marks the footprint; splat the density the draw sees here.
+                const fluid::DensityVolume* volume = fluid_frame.volume;
+                fluid::DensityVolume splatted;
+                if (fluid_frame.stats->density_footprint) {
+                    fluid::SplatWeightCache weights;
+                    fluid::SplatScratch scratch;
+                    fluid::TaskScheduler scheduler(render_threads);
+                    const float h = fluid_frame.settings->kernel_radius;
+                    splatted.resize(volume->config());
+                    fluid::splat_density_slabs(splatted, *fluid_frame.particles, h,
+                                               weights.get(fluid_frame.settings->splat_kernel, h), scratch, scheduler);
+                    splatted.update_macrocells();
+                    volume = &splatted;
+                }
+                fluid::CpuVolumeRenderer cpu_renderer(render_threads);
+                const fluid::CpuRenderStats& stats = cpu_renderer.render(*volume, cam, render);
+                const bool written = cpu_renderer.write_ppm("fluid_cpu_render.ppm") &&
+                                     cpu_renderer.write_pfm("fluid_cpu_render.pfm");
+                std::cerr << "[fluid] cpu render " << render.width << "x" << render.height
+                          << " ms=" << stats.render_ms
+                          << " threads=" << stats.thread_count
+                          << " rays_per_sec=" << stats.rays_per_sec
+                          << " steps_per_sec=" << stats.steps_per_sec
+                          << " steps_per_ray=" << static_cast<double>(stats.steps) / static_cast<double>(stats.rays)
+                          << (written ? " -> fluid_cpu_render.ppm/.pfm" : "") << std::endl;
+            }
             if (fluid_intents.reset) {
-                if (!fluid.particles().empty()) {
-                    const auto& p = fluid.particles().front();
-                    std::cerr << "[fluid] reset request: first particle before=" << p.position.x << "," << p.position.y
-                              << "," << p.position.z << std::endl;
+                if (!fluid_frame.particles->empty()) {
+                    const fluid::Vec3 p = fluid_frame.particles->position(0);
+                    std::cerr << "[fluid] reset request: first particle before=" << p.x << "," << p.y
+                              << "," << p.z << std::endl;
                 }
-                fluid.reset();
                 fluid_frame_index = 0;
                 ui_state.fluid_paused = false;  // Ensure motion resumes after a reset.
-                if (!fluid.particles().empty()) {
-                    const auto& p = fluid.particles().front();
-                    std::cerr << "[fluid] reset done: first particle after=" << p.position.x << "," << p.position.y
-                              << "," << p.position.z << std::endl;
+                if (fluid_async.running()) {
+                    fluid_async.post_reset();
+                    std::cerr << "[fluid] reset queued for the sim worker" << std::endl;
+                } else {
+                    fluid.reset();
+                    if (!fluid.particles().empty()) {
+                        const fluid::Vec3 p = fluid.particles().position(0);
+                        std::cerr << "[fluid] reset done: first particle after=" << p.x << "," << p.y
+                                  << "," << p.z << std::endl;
+                    }
                 }
             }
             if (ui_state.fluid_enabled) {
-                fluid.update(dt);
+                if (fluid_async.running()) {
+                    fluid_async.post_update(dt);
+                } else {
+                    fluid.update(dt);
+                }
                 fluid_frame_index++;
             }
 
@@ -246,13 +349,25 @@ int App::run() {
             log_timer += dt;
             if (log_timer >= 1.0f) {
                 log_timer = 0.0f;
-                const auto& stats = fluid.stats();
+                const auto& stats = fluid_async.running() ? *fluid_frame.stats : fluid.stats();
                 std::cerr << "[fluid] stats frame=" << fluid_frame_index
                           << " particles=" << stats.particle_count
                           << " max_dens=" << stats.max_density
                           << " avg_dens=" << stats.avg_density
                           << " avg_speed=" << stats.avg_speed
                           << " max_speed=" << stats.max_speed
+                          << " step_ms=" << stats.step_ms
+                          << " splat_ms=" << stats.splat_ms
+                          << " splatted=" << stats.splat_particles
+                          << " bricks=" << stats.occupied_bricks << "/" << stats.total_bricks
+                          << " empty_macrocells=" << stats.empty_macrocells << "/" << stats.total_macrocells
+                          << " domain=" << stats.domain_dims.x << "x" << stats.domain_dims.y << "x" << stats.domain_dims.z
+                          << " frame_ms=" << dt * 1000.0f
+                          << " async=" << fluid_async.running()
+                          << " threads=" << stats.thread_count
+                          << " list_age=" << stats.neighbor_list_age
+                          << " substeps=" << stats.substeps
+                          << " sim_ratio=" << stats.sim_time_ratio
                           << " avg_y=" << stats.avg_height
                           << " cam_y=" << camera.position.y
                           << " dens_scale=" << ui_state.fluid_density_scale
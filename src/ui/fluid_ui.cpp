@@ -20,6 +20,70 @@ FluidUiIntents render_fluid_ui(UiState& state, const fluid::FluidStats& stats) {
     ImGui::SliderFloat("Kernel radius", &state.fluid_kernel_radius, 0.01f, 0.2f, "%.3f");
     ImGui::SliderFloat("Voxel size", &state.fluid_voxel_size, 0.01f, 0.05f, "%.3f");
     ImGui::SliderFloat("Gravity Y", &state.fluid_gravity_y, -20.0f, 0.0f, "%.2f");
+    ImGui::SliderInt("Sim threads (0 = auto)", &state.fluid_threads, 0, 64);
+    ImGui::Checkbox("Async sim (background thread)", &state.fluid_async);
+    ImGui::Checkbox("SIMD kernels", &state.fluid_simd);
+    ImGui::Checkbox("PBF solver (position based)", &state.fluid_pbf);
+    ImGui::BeginDisabled(!state.fluid_pbf);
+    ImGui::SliderInt("PBF iterations", &state.fluid_pbf_iterations, 1, 16);
+    ImGui::SliderFloat("PBF CFL number", &state.fluid_pbf_cfl, 0.1f, 1.0f, "%.2f");
+    ImGui::EndDisabled();
+    // Neighbor options below only affect the SPH solver; PBF always scans the grid.
+    ImGui::BeginDisabled(state.fluid_pbf);
+    ImGui::Checkbox("Verlet neighbor lists", &state.fluid_verlet_lists);
+    ImGui::BeginDisabled(!state.fluid_verlet_lists);
+    ImGui::SliderFloat("List skin (x radius)", &state.fluid_verlet_skin, 0.05f, 1.0f, "%.2f");
+    ImGui::EndDisabled();
+    ImGui::BeginDisabled(state.fluid_verlet_lists);
+    ImGui::Checkbox("Symmetric pairs (half stencil)", &state.fluid_symmetric_pairs);
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    ImGui::SliderInt("Reorder interval (0 = off)", &state.fluid_reorder_interval, 0, 256);
+    ImGui::SliderFloat("CFL number (0 = off)", &state.fluid_cfl, 0.0f, 1.0f, "%.2f");
+    ImGui::BeginDisabled(state.fluid_cfl <= 0.0f);
+    ImGui::SliderInt("Max substeps", &state.fluid_max_substeps, 1, 32);
+    ImGui::SliderFloat("Frame budget ms (0 = off)", &state.fluid_frame_budget_ms, 0.0f, 50.0f, "%.1f");
+    ImGui::EndDisabled();
+    const char* splat_modes[] = {"Auto", "Serial", "Slab scatter", "Grid gather"};
+    ImGui::Combo("Density splat", &state.fluid_splat_mode, splat_modes, IM_ARRAYSIZE(splat_modes));
+    const char* splat_kernels[] = {"Poly6 (exact)", "Poly6 table", "Separable Gaussian"};
+    ImGui::Combo("Splat kernel", &state.fluid_splat_kernel, splat_kernels, IM_ARRAYSIZE(splat_kernels));
+    // Serial stays the exact reference, so incremental updates are off there.
+    ImGui::BeginDisabled(state.fluid_splat_mode == 1);
+    ImGui::Checkbox("Incremental splat", &state.fluid_incremental_splat);
+    ImGui::BeginDisabled(!state.fluid_incremental_splat);
+    ImGui::SliderFloat("Move threshold (voxels)", &state.fluid_splat_move_threshold, 0.0f, 1.0f, "%.2f");
+    ImGui::SliderInt("Full rebuild interval", &state.fluid_splat_rebuild_interval, 1, 600);
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    const char* voxel_layouts[] = {"Linear", "4^3 tiles", "Morton"};
+    ImGui::Combo("Voxel layout", &state.fluid_voxel_layout, voxel_layouts, IM_ARRAYSIZE(voxel_layouts));
+    const char* density_formats[] = {"R32 float", "R16 float", "R16 unorm"};
+    ImGui::Combo("Density texels", &state.fluid_density_format, density_formats, IM_ARRAYSIZE(density_formats));
+    ImGui::Checkbox("Splat on GPU", &state.fluid_gpu_splat);
+    ImGui::Checkbox("Fit volume to fluid", &state.fluid_dynamic_domain);
+    ImGui::BeginDisabled(!state.fluid_dynamic_domain);
+    ImGui::SliderInt("Domain margin (voxels)", &state.fluid_domain_margin, 0, 16);
+    ImGui::EndDisabled();
+    ImGui::Checkbox("Surface from particle SDF", &state.fluid_distance_field);
+    ImGui::BeginDisabled(!state.fluid_distance_field);
+    ImGui::SliderFloat("SDF radius (x kernel)", &state.fluid_sdf_radius, 0.2f, 1.0f, "%.2f");
+    ImGui::SliderFloat("SDF smoothing (x radius)", &state.fluid_sdf_smoothing, 0.05f, 1.0f, "%.2f");
+    ImGui::SliderFloat("SDF band (voxels)", &state.fluid_sdf_band, 1.0f, 8.0f, "%.1f");
+    ImGui::Checkbox("Build SDF on GPU", &state.fluid_gpu_distance_field);
+    ImGui::EndDisabled();
+    ImGui::Checkbox("Shadow with light volume", &state.fluid_light_volume);
+    ImGui::BeginDisabled(!state.fluid_light_volume);
+    ImGui::SliderInt("Light downsample", &state.fluid_light_downsample, 1, 4);
+    ImGui::Checkbox("Sweep light on GPU", &state.fluid_gpu_light_volume);
+    ImGui::EndDisabled();
+    ImGui::Checkbox("Adaptive steps", &state.fluid_adaptive_steps);
+    ImGui::BeginDisabled(!state.fluid_adaptive_steps);
+    ImGui::SliderInt("Step budget (M/frame, 0 = off)", &state.fluid_frame_step_budget, 0, 256);
+    ImGui::EndDisabled();
+    if (ImGui::Button("Save CPU render")) {
+        intents.cpu_render = true;
+    }
     // Higher ceilings make the volume visible on typical GPUs; defaults are set in UiState.
     ImGui::SliderFloat("Density scale", &state.fluid_density_scale, 0.1f, 200.0f, "%.2f");
     ImGui::SliderFloat("Absorption", &state.fluid_absorption, 0.1f, 50.0f, "%.2f");
@@ -30,6 +94,31 @@ FluidUiIntents render_fluid_ui(UiState& state, const fluid::FluidStats& stats) {
     ImGui::Text("Avg density: %.4f", stats.avg_density);
     ImGui::Text("Avg speed: %.4f", stats.avg_speed);
     ImGui::Text("Max speed: %.4f", stats.max_speed);
+    ImGui::Text("Step: %.2f ms on %d threads, %d-wide kernels", stats.step_ms, stats.thread_count, stats.simd_width);
+    ImGui::Text("Substeps: %d x %.2f ms, sim/real time %.2f", stats.substeps, stats.substep_dt * 1000.0f,
+                stats.sim_time_ratio);
+    const char* splat_names[] = {"auto", "serial", "slab scatter", "grid gather"};
+    if (stats.splat_incremental) {
+        ImGui::Text("Splat: %.2f ms (delta, %d of %d particles)", stats.splat_ms, stats.splat_particles,
+                    stats.particle_count);
+    } else {
+        ImGui::Text("Splat: %.2f ms (%s)", stats.splat_ms, splat_names[static_cast<int>(stats.splat_mode)]);
+    }
+    ImGui::Text("Bricks: %d / %d (%.1f MB)", stats.occupied_bricks, stats.total_bricks,
+                static_cast<double>(stats.volume_bytes) / (1024.0 * 1024.0));
+    ImGui::Text("Empty macrocells: %d / %d (update %.2f ms)", stats.empty_macrocells, stats.total_macrocells,
+                stats.macrocell_ms);
+    ImGui::Text("Domain: %d x %d x %d voxels (%d refits)", stats.domain_dims.x, stats.domain_dims.y,
+                stats.domain_dims.z, stats.domain_refits);
+    if (state.fluid_distance_field) {
+        ImGui::Text("SDF: %.2f ms (%d band voxels)", stats.distance_ms, stats.distance_band_voxels);
+    }
+    if (state.fluid_light_volume) {
+        ImGui::Text("Light volume: %.2f ms", stats.light_ms);
+    }
+    if (state.fluid_verlet_lists) {
+        ImGui::Text("Neighbor list age: %d steps", stats.neighbor_list_age);
+    }
     ImGui::EndDisabled();
     ImGui::End();
 
@@ -6,7 +6,8 @@
 namespace rayol::ui {
 
 struct FluidUiIntents {
-    bool reset = false;  // User requested a reset/reseed.
+    bool reset = false;      // User requested a reset/reseed.
+    bool cpu_render = false; // User requested a CPU reference render of the current frame (written to disk).
 };
 
 // Render fluid control panel and return intents.
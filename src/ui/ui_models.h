@@ -14,6 +14,39 @@ struct UiState {
     float fluid_kernel_radius = 0.06f;  // Splat kernel radius
     float fluid_voxel_size = 0.02f;     // Voxel size for density volume
     float fluid_gravity_y = -9.8f;      // Gravity along Y
+    int fluid_threads = 0;              // Sim worker threads (0 = hardware concurrency)
+    bool fluid_simd = true;             // SIMD SPH kernels (scalar fallback when off)
+    bool fluid_pbf = false;             // Position-based fluids solver instead of explicit SPH
+    int fluid_pbf_iterations = 4;       // PBF Jacobi iterations per step
+    float fluid_pbf_cfl = 0.6f;         // CFL number used while the PBF solver runs
+    bool fluid_verlet_lists = false;    // Cached Verlet neighbor lists instead of a per-step grid scan
+    float fluid_verlet_skin = 0.3f;     // Verlet list margin as a fraction of the kernel radius
+    bool fluid_symmetric_pairs = false; // Grid mode: evaluate each SPH pair once and apply both sides
+    int fluid_reorder_interval = 16;    // Steps between Morton particle reorders (0 = never)
+    float fluid_cfl = 0.4f;             // CFL number for adaptive substeps (0 = one step per frame)
+    int fluid_max_substeps = 8;         // Substep cap per frame
+    float fluid_frame_budget_ms = 12.0f; // Sim time budget per frame (0 = unlimited)
+    int fluid_splat_mode = 0;           // fluid::SplatMode: auto, serial, slab scatter, grid gather
+    int fluid_splat_kernel = 0;         // fluid::SplatKernel: exact poly6, poly6 table, separable Gaussian
+    bool fluid_incremental_splat = false; // Re-splat only particles that moved (full rebuild periodically)
+    float fluid_splat_move_threshold = 0.1f; // Voxels a particle moves before it is re-splatted
+    int fluid_splat_rebuild_interval = 60;   // Incremental frames between full rebuilds
+    int fluid_voxel_layout = 0;         // fluid::VoxelLayout: linear, 4^3 tiles, Morton (inside each brick)
+    bool fluid_dynamic_domain = false;  // Fit the density volume to the particles instead of the container
+    int fluid_domain_margin = 4;        // Voxels of slack around the particles before the domain is refit
+    bool fluid_distance_field = false;  // Sphere-trace a narrow-band particle SDF for the surface
+    float fluid_sdf_radius = 0.5f;      // SDF sphere radius as a fraction of the kernel radius
+    float fluid_sdf_smoothing = 0.3f;   // Smooth-min width as a fraction of the sphere radius
+    float fluid_sdf_band = 3.0f;        // Narrow band half-width in voxels
+    bool fluid_gpu_distance_field = false; // Build the SDF in the renderer's compute pass
+    bool fluid_light_volume = false;    // Shadow the lighting with a swept light transmittance volume
+    int fluid_light_downsample = 2;     // Density voxels per light volume voxel along each axis
+    bool fluid_gpu_light_volume = false; // Sweep the light volume in the renderer's compute pass
+    bool fluid_adaptive_steps = false;  // March with adaptive step lengths
+    int fluid_frame_step_budget = 0;    // Density samples per frame in millions (0 = unlimited)
+    int fluid_density_format = 0;       // fluid::DensityFormat of the density texture: R32F, R16F, R16 unorm
+    bool fluid_gpu_splat = false;       // Splat the density texture from the particles in compute
+    bool fluid_async = true;            // Step the sim on a background thread, render its latest snapshot
     // Rendering multipliers are high by default so the volume is clearly visible on start.
     float fluid_density_scale = 30.0f;   // Render density multiplier
     float fluid_absorption = 10.0f;      // Absorption coefficient
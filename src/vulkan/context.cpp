@@ -84,8 +84,8 @@ void VulkanContext::record_commands(VkCommandBuffer cmd, size_t image_index, con
     vkBeginCommandBuffer(cmd, &begin_info);
 
     // Fluid compute before the render pass.
-    if (fluid && fluid->renderer && fluid->sim) {
-        fluid->renderer->record_compute(cmd, *fluid->sim, fluid->enabled);
+    if (fluid && fluid->renderer && fluid->frame.valid()) {
+        fluid->renderer->record_compute(cmd, fluid->frame, fluid->enabled, sync_.current_frame());
     }
 
     VkClearValue clear_value{};
@@ -101,7 +101,7 @@ void VulkanContext::record_commands(VkCommandBuffer cmd, size_t image_index, con
     render_pass_info.pClearValues = &clear_value;
 
     vkCmdBeginRenderPass(cmd, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-    if (fluid && fluid->renderer && fluid->sim) {
+    if (fluid && fluid->renderer && fluid->frame.valid()) {
         fluid::FluidRenderer::CameraData cam{};
         cam.pos = fluid->camera_pos;
         cam.forward = fluid->camera_forward;
@@ -111,7 +111,7 @@ void VulkanContext::record_commands(VkCommandBuffer cmd, size_t image_index, con
                      static_cast<float>(swapchain_.extent().height);
         fluid->renderer->set_camera(cam);
 
-        fluid->renderer->record_draw(cmd, *fluid->sim, fluid->enabled, fluid->frame_index,
+        fluid->renderer->record_draw(cmd, fluid->frame, fluid->enabled, fluid->frame_index,
                                      fluid->density_scale, fluid->absorption);
     }
     if (imgui_layer_) {
@@ -17,7 +17,7 @@ namespace rayol {
 
 struct FluidDrawData {
     fluid::FluidRenderer* renderer{nullptr};
-    const fluid::FluidExperiment* sim{nullptr};
+    fluid::FluidFrameView frame{};  // Sim state to draw: the live sim or an async snapshot.
     bool enabled{false};
     uint32_t frame_index{0};
     float density_scale{1.0f};